@@ -182,6 +182,7 @@ enum
   PROP_MAX_BUFFERING_TIME,
   PROP_BANDWIDTH_USAGE,
   PROP_MAX_BITRATE,
+  PROP_LOW_LATENCY,
   PROP_LAST
 };
 
@@ -189,6 +190,7 @@ enum
 #define DEFAULT_MAX_BUFFERING_TIME       30     /* in seconds */
 #define DEFAULT_BANDWIDTH_USAGE         0.8     /* 0 to 1     */
 #define DEFAULT_MAX_BITRATE        24000000     /* in bit/s  */
+#define DEFAULT_LOW_LATENCY           FALSE
 
 /* Clock drift compensation for live streams */
 #define SLOW_CLOCK_UPDATE_INTERVAL  (1000000 * 30 * 60) /* 30 minutes */
@@ -373,6 +375,13 @@ gst_dash_demux_class_init (GstDashDemuxClass * klass)
           1000, G_MAXUINT, DEFAULT_MAX_BITRATE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_LOW_LATENCY,
+      g_param_spec_boolean ("low-latency", "Low latency",
+          "For live streams, request segments as soon as they start being "
+          "available instead of once they are complete. Requires a server "
+          "delivering segments with chunked transfer while they are produced",
+          DEFAULT_LOW_LATENCY, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_add_pad_template (gstelement_class,
       gst_static_pad_template_get (&gst_dash_demux_audiosrc_template));
   gst_element_class_add_pad_template (gstelement_class,
@@ -433,6 +442,7 @@ gst_dash_demux_init (GstDashDemux * demux)
   /* Properties */
   demux->max_buffering_time = DEFAULT_MAX_BUFFERING_TIME * GST_SECOND;
   demux->max_bitrate = DEFAULT_MAX_BITRATE;
+  demux->low_latency = DEFAULT_LOW_LATENCY;
 
   g_mutex_init (&demux->client_lock);
 
@@ -457,6 +467,9 @@ gst_dash_demux_set_property (GObject * object, guint prop_id,
     case PROP_MAX_BITRATE:
       demux->max_bitrate = g_value_get_uint (value);
       break;
+    case PROP_LOW_LATENCY:
+      demux->low_latency = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -480,6 +493,9 @@ gst_dash_demux_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_MAX_BITRATE:
       g_value_set_uint (value, demux->max_bitrate);
       break;
+    case PROP_LOW_LATENCY:
+      g_value_set_boolean (value, demux->low_latency);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -934,6 +950,16 @@ gst_dash_demux_stream_update_headers_info (GstAdaptiveDemuxStream * stream)
   }
 }
 
+/* In key unit trick modes and in reverse playback subsegments are
+ * requested one by one, so that only the ones that are going to be used
+ * are downloaded */
+static gboolean
+gst_dash_demux_stream_sidx_per_entry (GstAdaptiveDemuxStream * stream)
+{
+  return stream->demux->segment.rate < 0.0 ||
+      (stream->demux->segment.flags & GST_SEGMENT_FLAG_TRICKMODE_KEY_UNITS);
+}
+
 static GstFlowReturn
 gst_dash_demux_stream_update_fragment_info (GstAdaptiveDemuxStream * stream)
 {
@@ -942,6 +968,7 @@ gst_dash_demux_stream_update_fragment_info (GstAdaptiveDemuxStream * stream)
   GstClockTime ts;
   GstMediaFragmentInfo fragment;
   gboolean isombff;
+  GstSidxBox *sidx = SIDX (dashstream);
 
   gst_adaptive_demux_stream_fragment_clear (&stream->fragment);
 
@@ -950,7 +977,13 @@ gst_dash_demux_stream_update_fragment_info (GstAdaptiveDemuxStream * stream)
   if (GST_ADAPTIVE_DEMUX_STREAM_NEED_HEADER (stream) && isombff) {
     gst_dash_demux_stream_update_headers_info (stream);
     dashstream->sidx_base_offset = stream->fragment.index_range_end + 1;
-    if (dashstream->sidx_index != 0) {
+    if (dashstream->sidx_parser.status == GST_ISOFF_SIDX_PARSER_FINISHED) {
+      /* the index of this representation was already parsed, only the
+       * header is needed before jumping to the subsegment */
+      g_free (stream->fragment.index_uri);
+      stream->fragment.index_uri = NULL;
+    } else if (dashstream->sidx_index != 0 ||
+        gst_dash_demux_stream_sidx_per_entry (stream)) {
       /* request only the index to be downloaded as we need to reposition the
        * stream to a subsegment */
       return GST_FLOW_OK;
@@ -959,7 +992,7 @@ gst_dash_demux_stream_update_fragment_info (GstAdaptiveDemuxStream * stream)
 
   if (gst_mpd_client_get_next_fragment_timestamp (dashdemux->client,
           dashstream->index, &ts)) {
-    if (GST_ADAPTIVE_DEMUX_STREAM_NEED_HEADER (stream)) {
+    if (GST_ADAPTIVE_DEMUX_STREAM_NEED_HEADER (stream) && !isombff) {
       gst_adaptive_demux_stream_fragment_clear (&stream->fragment);
       gst_dash_demux_stream_update_headers_info (stream);
     }
@@ -968,13 +1001,15 @@ gst_dash_demux_stream_update_fragment_info (GstAdaptiveDemuxStream * stream)
         &fragment);
 
     stream->fragment.uri = fragment.uri;
-    if (isombff && dashstream->sidx_index != 0) {
+    if (isombff
+        && dashstream->sidx_parser.status == GST_ISOFF_SIDX_PARSER_FINISHED
+        && sidx->entry_index >= 0 && sidx->entry_index < sidx->entries_count) {
       GstSidxBoxEntry *entry = SIDX_CURRENT_ENTRY (dashstream);
       stream->fragment.range_start =
-          dashstream->sidx_base_offset + entry->offset;
+          dashstream->sidx_base_offset + sidx->first_offset + entry->offset;
       stream->fragment.timestamp = entry->pts;
       stream->fragment.duration = entry->duration;
-      if (stream->demux->segment.rate < 0.0) {
+      if (gst_dash_demux_stream_sidx_per_entry (stream)) {
         stream->fragment.range_end =
             stream->fragment.range_start + entry->size - 1;
       } else {
@@ -994,22 +1029,63 @@ gst_dash_demux_stream_update_fragment_info (GstAdaptiveDemuxStream * stream)
   return GST_FLOW_EOS;
 }
 
+/* Returns the index of the subsegment that should be downloaded after the
+ * one at @index. In key unit trick modes subsegments not starting with a
+ * stream access point are skipped, as are the ones that would be played in
+ * less than the current subsegment duration at the current rate. Falls back
+ * to the adjacent subsegment if none qualifies. */
+static gint
+gst_dash_demux_stream_sidx_next_entry (GstAdaptiveDemuxStream * stream,
+    gint index)
+{
+  GstDashDemuxStream *dashstream = (GstDashDemuxStream *) stream;
+  GstSidxBox *sidx = SIDX (dashstream);
+  gdouble rate = stream->demux->segment.rate;
+  gint step = rate > 0.0 ? 1 : -1;
+  GstClockTime skip;
+  gint i;
+
+  if (!(stream->demux->segment.flags & GST_SEGMENT_FLAG_TRICKMODE_KEY_UNITS)
+      || index < 0 || index >= sidx->entries_count)
+    return index + step;
+
+  skip = sidx->entries[index].duration * ABS (rate);
+
+  for (i = index + step; i >= 0 && i < sidx->entries_count; i += step) {
+    GstSidxBoxEntry *entry = &sidx->entries[i];
+
+    if (!entry->starts_with_sap)
+      continue;
+    if (step > 0 && entry->pts < sidx->entries[index].pts + skip)
+      continue;
+    if (step < 0 && entry->pts + skip > sidx->entries[index].pts)
+      continue;
+    return i;
+  }
+
+  return index + step;
+}
+
 static void
 gst_dash_demux_stream_sidx_seek (GstDashDemuxStream * dashstream,
     GstClockTime ts)
 {
   GstSidxBox *sidx = SIDX (dashstream);
-  gint i;
+  gint lo = 0, hi = sidx->entries_count;
 
-  /* TODO optimize to a binary search */
-  for (i = 0; i < sidx->entries_count; i++) {
-    if (sidx->entries[i].pts + sidx->entries[i].duration >= ts)
-      break;
+  /* first entry ending at or after ts, entries are sorted by pts */
+  while (lo < hi) {
+    gint mid = lo + (hi - lo) / 2;
+
+    if (sidx->entries[mid].pts + sidx->entries[mid].duration >= ts)
+      hi = mid;
+    else
+      lo = mid + 1;
   }
-  sidx->entry_index = i;
-  dashstream->sidx_index = i;
-  if (i < sidx->entries_count)
-    dashstream->sidx_current_remaining = sidx->entries[i].size;
+  sidx->entry_index = lo;
+  dashstream->sidx_index = lo;
+  if (lo < sidx->entries_count)
+    dashstream->sidx_current_remaining = sidx->entries[lo].size;
   else
     dashstream->sidx_current_remaining = 0;
 }
@@ -1060,16 +1136,10 @@ gst_dash_demux_stream_advance_subfragment (GstAdaptiveDemuxStream * stream)
   gboolean fragment_finished = TRUE;
 
   if (dashstream->sidx_parser.status == GST_ISOFF_SIDX_PARSER_FINISHED) {
-    if (stream->demux->segment.rate > 0.0) {
-      sidx->entry_index++;
-      if (sidx->entry_index < sidx->entries_count) {
-        fragment_finished = FALSE;
-      }
-    } else {
-      sidx->entry_index--;
-      if (sidx->entry_index >= 0) {
-        fragment_finished = FALSE;
-      }
+    sidx->entry_index =
+        gst_dash_demux_stream_sidx_next_entry (stream, sidx->entry_index);
+    if (sidx->entry_index >= 0 && sidx->entry_index < sidx->entries_count) {
+      fragment_finished = FALSE;
     }
   }
 
@@ -1251,7 +1321,10 @@ gst_dash_demux_seek (GstAdaptiveDemux * demux, GstEvent * seek)
       iter = g_list_next (iter)) {
     GstDashDemuxStream *dashstream = iter->data;
 
-    if (flags & GST_SEEK_FLAG_FLUSH) {
+    /* a completely parsed index is still valid for the same
+     * representation, keep it to avoid downloading it again */
+    if ((flags & GST_SEEK_FLAG_FLUSH) &&
+        dashstream->sidx_parser.status != GST_ISOFF_SIDX_PARSER_FINISHED) {
       gst_isoff_sidx_parser_clear (&dashstream->sidx_parser);
       gst_isoff_sidx_parser_init (&dashstream->sidx_parser);
     }
@@ -1389,9 +1462,17 @@ gst_dash_demux_stream_get_fragment_waiting_time (GstAdaptiveDemuxStream *
   GstDateTime *seg_end_time;
   GstActiveStream *active_stream = dashstream->active_stream;
 
-  seg_end_time =
-      gst_mpd_client_get_next_segment_availability_end_time (dashdemux->client,
-      active_stream);
+  /* In low latency mode the segment is requested as soon as the server
+   * starts producing it, its chunks are then pushed downstream as they are
+   * received through chunked transfer */
+  if (dashdemux->low_latency)
+    seg_end_time =
+        gst_mpd_client_get_next_segment_availability_start_time
+        (dashdemux->client, active_stream);
+  else
+    seg_end_time =
+        gst_mpd_client_get_next_segment_availability_end_time
+        (dashdemux->client, active_stream);
 
   if (seg_end_time) {
     gint64 diff;
@@ -1498,7 +1579,7 @@ gst_dash_demux_data_received (GstAdaptiveDemux * demux,
     guint consumed;
 
     available = gst_adapter_available (stream->adapter);
-    buffer = gst_adapter_take_buffer (stream->adapter, available);
+    buffer = gst_adapter_take_buffer_fast (stream->adapter, available);
 
     if (dash_stream->sidx_parser.status != GST_ISOFF_SIDX_PARSER_FINISHED) {
       res =
@@ -1530,18 +1611,21 @@ gst_dash_demux_data_received (GstAdaptiveDemux * demux,
       }
     }
     ret = gst_adaptive_demux_stream_push_buffer (stream, buffer);
-  } else if (dash_stream->sidx_parser.status == GST_ISOFF_SIDX_PARSER_FINISHED) {
+  } else if (!stream->downloading_header &&
+      dash_stream->sidx_parser.status == GST_ISOFF_SIDX_PARSER_FINISHED) {
 
     while (ret == GST_FLOW_OK
         && ((available = gst_adapter_available (stream->adapter)) > 0)) {
       gboolean advance = FALSE;
 
+      /* the subsegment data is pushed as it arrives, sharing the memory of
+       * the downloaded buffers instead of merging it */
       if (available < dash_stream->sidx_current_remaining) {
-        buffer = gst_adapter_take_buffer (stream->adapter, available);
+        buffer = gst_adapter_take_buffer_fast (stream->adapter, available);
         dash_stream->sidx_current_remaining -= available;
       } else {
         buffer =
-            gst_adapter_take_buffer (stream->adapter,
+            gst_adapter_take_buffer_fast (stream->adapter,
             dash_stream->sidx_current_remaining);
         dash_stream->sidx_current_remaining = 0;
         advance = TRUE;
@@ -1562,7 +1646,7 @@ gst_dash_demux_data_received (GstAdaptiveDemux * demux,
     /* this should be the main header, just push it all */
     ret =
         gst_adaptive_demux_stream_push_buffer (stream,
-        gst_adapter_take_buffer (stream->adapter,
+        gst_adapter_take_buffer_fast (stream->adapter,
             gst_adapter_available (stream->adapter)));
   }
 
@@ -96,6 +96,7 @@ struct _GstDashDemux
   /* Properties */
   GstClockTime max_buffering_time;      /* Maximum buffering time accumulated during playback */
   guint64 max_bitrate;          /* max of bitrate supported by target decoder         */
+  gboolean low_latency;         /* request live segments at availability start time   */
 
   gint n_audio_streams;
   gint n_video_streams;
@@ -5408,9 +5408,11 @@ gst_mpdparser_get_list_and_nb_of_audio_language (GstMpdClient * client,
 }
 
 
-GstDateTime *
-gst_mpd_client_get_next_segment_availability_end_time (GstMpdClient * client,
-    GstActiveStream * stream)
+/* Wall clock time at which the current segment of @stream starts
+ * (@end == FALSE) or finishes (@end == TRUE) being available */
+static GstDateTime *
+gst_mpd_client_get_next_segment_availability_time (GstMpdClient * client,
+    GstActiveStream * stream, gboolean end)
 {
   GstDateTime *availability_start_time, *rv;
   gint seg_idx;
@@ -5444,13 +5446,29 @@ gst_mpd_client_get_next_segment_availability_end_time (GstMpdClient * client,
     }
   }
 
-  offset = (1 + seg_idx) * seg_duration;
+  offset = (end ? 1 + seg_idx : seg_idx) * seg_duration;
   rv = gst_mpd_client_add_time_difference (availability_start_time,
       offset / GST_USECOND);
   gst_date_time_unref (availability_start_time);
   return rv;
 }
 
+GstDateTime *
+gst_mpd_client_get_next_segment_availability_end_time (GstMpdClient * client,
+    GstActiveStream * stream)
+{
+  return gst_mpd_client_get_next_segment_availability_time (client, stream,
+      TRUE);
+}
+
+GstDateTime *
+gst_mpd_client_get_next_segment_availability_start_time (GstMpdClient *
+    client, GstActiveStream * stream)
+{
+  return gst_mpd_client_get_next_segment_availability_time (client, stream,
+      FALSE);
+}
+
 gint
 gst_mpd_client_check_time_position (GstMpdClient * client,
     GstActiveStream * stream, GstClockTime ts, gint64 * diff)
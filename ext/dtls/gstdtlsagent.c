@@ -31,6 +31,8 @@
 
 #include "gstdtlsagent.h"
 
+#include "gstdtlsconnection.h"
+
 #ifdef __APPLE__
 # define __AVAILABILITYMACROS__
 # define DEPRECATED_IN_MAC_OS_X_VERSION_10_7_AND_LATER
@@ -60,6 +62,12 @@ struct _GstDtlsAgentPrivate
   SSL_CTX *ssl_context;
 
   GstDtlsCertificate *certificate;
+
+  /* Handshake work of the connections of this agent whose decoder opted
+   * in, NULL until one did */
+  GMutex handshake_lock;
+  GThreadPool *handshake_pool;
+  guint handshake_threads;
 };
 
 static void gst_dtls_agent_finalize (GObject * gobject);
@@ -69,6 +77,8 @@ const gchar *gst_dtls_agent_peek_id (GstDtlsAgent *);
 
 static GRWLock *ssl_locks;
 
+static void handle_handshake (gpointer data, gpointer user_data);
+
 static void
 ssl_locking_function (gint mode, gint lock_num, const gchar * file, gint line)
 {
@@ -168,6 +178,10 @@ gst_dtls_agent_init (GstDtlsAgent * self)
   GstDtlsAgentPrivate *priv = GST_DTLS_AGENT_GET_PRIVATE (self);
   self->priv = priv;
 
+  g_mutex_init (&priv->handshake_lock);
+  priv->handshake_pool = NULL;
+  priv->handshake_threads = 0;
+
   ERR_clear_error ();
 
   priv->ssl_context = SSL_CTX_new (DTLSv1_method ());
@@ -197,6 +211,14 @@ gst_dtls_agent_finalize (GObject * gobject)
 {
   GstDtlsAgentPrivate *priv = GST_DTLS_AGENT (gobject)->priv;
 
+  /* The queued handshakes hold a reference to their connection, and so to
+   * the agent. Don't wait, this can run in one of the pool threads */
+  if (priv->handshake_pool) {
+    g_thread_pool_free (priv->handshake_pool, FALSE, FALSE);
+    priv->handshake_pool = NULL;
+  }
+  g_mutex_clear (&priv->handshake_lock);
+
   SSL_CTX_free (priv->ssl_context);
   priv->ssl_context = NULL;
 
@@ -272,3 +294,59 @@ _gst_dtls_agent_peek_context (GstDtlsAgent * self)
   g_return_val_if_fail (GST_IS_DTLS_AGENT (self), NULL);
   return self->priv->ssl_context;
 }
+
+static void
+handle_handshake (gpointer data, gpointer user_data)
+{
+  GstDtlsConnection *connection = data;
+
+  _gst_dtls_connection_process_pending (connection);
+  g_object_unref (connection);
+}
+
+void
+_gst_dtls_agent_set_handshake_threads (GstDtlsAgent * self, guint n_threads)
+{
+  GstDtlsAgentPrivate *priv;
+
+  g_return_if_fail (GST_IS_DTLS_AGENT (self));
+
+  priv = self->priv;
+
+  g_mutex_lock (&priv->handshake_lock);
+  /* The agent is shared, don't shrink the pool under other elements */
+  if (n_threads > priv->handshake_threads) {
+    GST_DEBUG_OBJECT (self, "using %u handshake threads", n_threads);
+
+    priv->handshake_threads = n_threads;
+    if (!priv->handshake_pool) {
+      priv->handshake_pool =
+          g_thread_pool_new (handle_handshake, self, n_threads, FALSE, NULL);
+    } else {
+      g_thread_pool_set_max_threads (priv->handshake_pool, n_threads, NULL);
+    }
+  }
+  g_mutex_unlock (&priv->handshake_lock);
+}
+
+gboolean
+_gst_dtls_agent_push_handshake (GstDtlsAgent * self,
+    GstDtlsConnection * connection)
+{
+  GstDtlsAgentPrivate *priv;
+  gboolean pushed = FALSE;
+
+  g_return_val_if_fail (GST_IS_DTLS_AGENT (self), FALSE);
+
+  priv = self->priv;
+
+  g_mutex_lock (&priv->handshake_lock);
+  if (priv->handshake_pool) {
+    g_thread_pool_push (priv->handshake_pool, g_object_ref (connection),
+        NULL);
+    pushed = TRUE;
+  }
+  g_mutex_unlock (&priv->handshake_lock);
+
+  return pushed;
+}
@@ -45,6 +45,8 @@ typedef struct _GstDtlsAgent        GstDtlsAgent;
 typedef struct _GstDtlsAgentClass   GstDtlsAgentClass;
 typedef struct _GstDtlsAgentPrivate GstDtlsAgentPrivate;
 
+struct _GstDtlsConnection;
+
 /*
  * GstDtlsAgent:
  *
@@ -77,6 +79,19 @@ gchar *gst_dtls_agent_get_certificate_pem(GstDtlsAgent *self);
 void _gst_dtls_init_openssl(void);
 const GstDtlsAgentContext _gst_dtls_agent_peek_context(GstDtlsAgent *);
 
+/*
+ * Processes the handshake records of the connections of the agent that opt
+ * in in a pool of up to n_threads threads. The pool is shared by all the
+ * users of the agent and only grows.
+ */
+void _gst_dtls_agent_set_handshake_threads(GstDtlsAgent *, guint n_threads);
+
+/*
+ * Queues the pending handshake records of the connection for processing in
+ * the pool. Returns FALSE if the agent has no handshake threads.
+ */
+gboolean _gst_dtls_agent_push_handshake(GstDtlsAgent *, struct _GstDtlsConnection *);
+
 G_END_DECLS
 
 #endif /* gstdtlsagent_h */
@@ -53,6 +53,10 @@ G_DEFINE_TYPE_WITH_CODE (GstDtlsConnection, gst_dtls_connection, G_TYPE_OBJECT,
 #define SRTP_KEY_LEN 16
 #define SRTP_SALT_LEN 14
 
+/* DTLS record content type, the first byte of a record */
+#define DTLS_CONTENT_TYPE_APPLICATION_DATA 23
+#define DTLS_RECORD_HEADER_SIZE 13
+
 enum
 {
   SIGNAL_ON_ENCODER_KEY,
@@ -81,6 +85,7 @@ struct _GstDtlsConnectionPrivate
 {
   SSL *ssl;
   BIO *bio;
+  GstDtlsAgent *agent;
 
   gboolean is_client;
   gboolean is_alive;
@@ -96,6 +101,10 @@ struct _GstDtlsConnectionPrivate
 
   gboolean timeout_pending;
   GThreadPool *thread_pool;
+
+  /* handshake records waiting for the agent's handshake threads */
+  GQueue pending_records;
+  gboolean handshake_scheduled;
 };
 
 static void gst_dtls_connection_finalize (GObject * gobject);
@@ -105,6 +114,8 @@ static void gst_dtls_connection_set_property (GObject *, guint prop_id,
 static void log_state (GstDtlsConnection *, const gchar * str);
 static void export_srtp_keys (GstDtlsConnection *);
 static void openssl_poll (GstDtlsConnection *);
+static gint process_locked (GstDtlsConnection *, gpointer data, gint len);
+static gboolean has_application_data (const guint8 * data, gint len);
 static int openssl_verify_callback (int preverify_ok,
     X509_STORE_CTX * x509_ctx);
 
@@ -169,6 +180,7 @@ gst_dtls_connection_init (GstDtlsConnection * self)
 
   priv->ssl = NULL;
   priv->bio = NULL;
+  priv->agent = NULL;
 
   priv->send_closure = NULL;
 
@@ -189,6 +201,9 @@ gst_dtls_connection_init (GstDtlsConnection * self)
   priv->thread_pool = g_thread_pool_new (handle_timeout, self, 1, FALSE, NULL);
   g_assert (priv->thread_pool);
   priv->timeout_pending = FALSE;
+
+  g_queue_init (&priv->pending_records);
+  priv->handshake_scheduled = FALSE;
 }
 
 static void
@@ -203,6 +218,14 @@ gst_dtls_connection_finalize (GObject * gobject)
   SSL_free (priv->ssl);
   priv->ssl = NULL;
 
+  g_queue_foreach (&priv->pending_records, (GFunc) g_bytes_unref, NULL);
+  g_queue_clear (&priv->pending_records);
+
+  if (priv->agent) {
+    g_object_unref (priv->agent);
+    priv->agent = NULL;
+  }
+
   if (priv->send_closure) {
     g_closure_unref (priv->send_closure);
     priv->send_closure = NULL;
@@ -231,6 +254,7 @@ gst_dtls_connection_set_property (GObject * object, guint prop_id,
       agent = GST_DTLS_AGENT (g_value_get_object (value));
       g_return_if_fail (GST_IS_DTLS_AGENT (agent));
 
+      priv->agent = g_object_ref (agent);
       ssl_context = _gst_dtls_agent_peek_context (agent);
 
       priv->ssl = SSL_new (ssl_context);
@@ -275,6 +299,10 @@ gst_dtls_connection_start (GstDtlsConnection * self, gboolean is_client)
   priv->bio_buffer_offset = 0;
   priv->keys_exported = FALSE;
 
+  /* records of a previous run, the scheduled handshake finds nothing */
+  g_queue_foreach (&priv->pending_records, (GFunc) g_bytes_unref, NULL);
+  g_queue_clear (&priv->pending_records);
+
   priv->is_client = is_client;
   if (priv->is_client) {
     SSL_set_connect_state (priv->ssl);
@@ -475,7 +503,8 @@ gst_dtls_connection_set_send_callback (GstDtlsConnection * self,
 }
 
 gint
-gst_dtls_connection_process (GstDtlsConnection * self, gpointer data, gint len)
+gst_dtls_connection_process (GstDtlsConnection * self, gpointer data, gint len,
+    gboolean handshake_in_pool)
 {
   GstDtlsConnectionPrivate *priv;
   gint result;
@@ -490,33 +519,75 @@ gst_dtls_connection_process (GstDtlsConnection * self, gpointer data, gint len)
   g_mutex_lock (&priv->mutex);
   GST_TRACE_OBJECT (self, "locked @ process");
 
-  g_warn_if_fail (!priv->bio_buffer);
+  /* Hand the handshake records over to the agent's handshake threads, the
+   * application data is decoded in place below once they are processed.
+   * A peer can send its Finished and the first application data in one
+   * datagram, which has to be decoded here to return the data */
+  if (handshake_in_pool && len > 0 && priv->is_alive &&
+      !SSL_is_init_finished (priv->ssl) &&
+      !has_application_data (data, len) &&
+      (priv->handshake_scheduled ||
+          _gst_dtls_agent_push_handshake (priv->agent, self))) {
+    GST_LOG_OBJECT (self, "queueing handshake record of %d bytes", len);
+    g_queue_push_tail (&priv->pending_records, g_bytes_new (data, len));
+    priv->handshake_scheduled = TRUE;
+
+    GST_TRACE_OBJECT (self, "unlocking @ process");
+    g_mutex_unlock (&priv->mutex);
 
-  priv->bio_buffer = data;
-  priv->bio_buffer_len = len;
-  priv->bio_buffer_offset = 0;
-
-  log_state (self, "process start");
+    return 0;
+  }
 
-  if (SSL_want_write (priv->ssl)) {
-    openssl_poll (self);
-    log_state (self, "process want write, after poll");
+  while (priv->handshake_scheduled && priv->is_alive) {
+    GST_TRACE_OBJECT (self, "waiting for the queued handshake records");
+    g_cond_wait (&priv->condition, &priv->mutex);
   }
 
-  result = SSL_read (priv->ssl, data, len);
+  result = process_locked (self, data, len);
 
-  log_state (self, "process after read");
+  GST_TRACE_OBJECT (self, "unlocking @ process");
+  g_mutex_unlock (&priv->mutex);
 
-  openssl_poll (self);
+  return result;
+}
 
-  log_state (self, "process after poll");
+void
+_gst_dtls_connection_process_pending (GstDtlsConnection * self)
+{
+  GstDtlsConnectionPrivate *priv;
+  GBytes *record;
 
-  GST_DEBUG_OBJECT (self, "read result: %d", result);
+  g_return_if_fail (GST_IS_DTLS_CONNECTION (self));
 
-  GST_TRACE_OBJECT (self, "unlocking @ process");
-  g_mutex_unlock (&priv->mutex);
+  priv = self->priv;
 
-  return result;
+  GST_TRACE_OBJECT (self, "locking @ process_pending");
+  g_mutex_lock (&priv->mutex);
+  GST_TRACE_OBJECT (self, "locked @ process_pending");
+
+  while ((record = g_queue_pop_head (&priv->pending_records))) {
+    gsize size;
+    gpointer data;
+    gint result;
+
+    data = g_bytes_unref_to_data (record, &size);
+
+    /* only datagrams without application data are queued */
+    if (priv->is_alive) {
+      result = process_locked (self, data, size);
+      g_warn_if_fail (result <= 0);
+    }
+
+    /* the BIO must not point to the record once it is freed */
+    priv->bio_buffer = NULL;
+    g_free (data);
+  }
+
+  priv->handshake_scheduled = FALSE;
+  g_cond_broadcast (&priv->condition);
+
+  GST_TRACE_OBJECT (self, "unlocking @ process_pending");
+  g_mutex_unlock (&priv->mutex);
 }
 
 gint
@@ -559,12 +630,69 @@ gst_dtls_connection_send (GstDtlsConnection * self, gpointer data, gint len)
      ######   #######  ##    ##
 */
 
+/* Walks the records of a datagram */
+static gboolean
+has_application_data (const guint8 * data, gint len)
+{
+  gint offset = 0;
+
+  while (offset + DTLS_RECORD_HEADER_SIZE <= len) {
+    if (data[offset] == DTLS_CONTENT_TYPE_APPLICATION_DATA)
+      return TRUE;
+    offset += DTLS_RECORD_HEADER_SIZE + GST_READ_UINT16_BE (data + offset + 11);
+  }
+
+  return FALSE;
+}
+
+static gint
+process_locked (GstDtlsConnection * self, gpointer data, gint len)
+{
+  GstDtlsConnectionPrivate *priv = self->priv;
+  gboolean established;
+  gint result;
+
+  g_warn_if_fail (!priv->bio_buffer);
+
+  priv->bio_buffer = data;
+  priv->bio_buffer_len = len;
+  priv->bio_buffer_offset = 0;
+
+  log_state (self, "process start");
+
+  /* Once the keys are exported there is nothing left to drive, retransmitted
+   * handshake messages are answered by SSL_read itself */
+  established = priv->keys_exported && SSL_is_init_finished (priv->ssl);
+
+  if (!established && SSL_want_write (priv->ssl)) {
+    openssl_poll (self);
+    log_state (self, "process want write, after poll");
+  }
+
+  result = SSL_read (priv->ssl, data, len);
+
+  log_state (self, "process after read");
+
+  if (!established) {
+    openssl_poll (self);
+    log_state (self, "process after poll");
+  }
+
+  GST_DEBUG_OBJECT (self, "read result: %d", result);
+
+  return result;
+}
+
 static void
 log_state (GstDtlsConnection * self, const gchar * str)
 {
   GstDtlsConnectionPrivate *priv = self->priv;
   guint states = 0;
 
+  /* called several times per record, skip querying the state for nothing */
+  if (gst_debug_category_get_threshold (GST_CAT_DEFAULT) < GST_LEVEL_LOG)
+    return;
+
   states |= (! !SSL_is_init_finished (priv->ssl) << 0);
   states |= (! !SSL_in_init (priv->ssl) << 4);
   states |= (! !SSL_in_before (priv->ssl) << 8);
@@ -109,8 +109,10 @@ void gst_dtls_connection_set_send_callback(GstDtlsConnection *, GClosure *);
 /*
  * Processes data that has been recevied, the transformation is done in-place.
  * Returns the length of the plaintext data that was decoded, if no data is available, 0<= will be returned.
+ * If handshake_in_pool is TRUE, datagrams holding only handshake records are
+ * queued for the handshake threads of the agent, if it has any.
  */
-gint gst_dtls_connection_process(GstDtlsConnection *, gpointer ptr, gint len);
+gint gst_dtls_connection_process(GstDtlsConnection *, gpointer ptr, gint len, gboolean handshake_in_pool);
 
 /*
  * If the DTLS handshake is completed this function will encode the given data.
@@ -118,6 +120,13 @@ gint gst_dtls_connection_process(GstDtlsConnection *, gpointer ptr, gint len);
  */
 gint gst_dtls_connection_send(GstDtlsConnection *, gpointer ptr, gint len);
 
+/* internal */
+
+/*
+ * Processes the handshake records queued for the agent's handshake threads.
+ */
+void _gst_dtls_connection_process_pending(GstDtlsConnection *);
+
 G_END_DECLS
 
 #endif /* gstdtlsconnection_h */
@@ -63,6 +63,7 @@ enum
   PROP_CONNECTION_ID,
   PROP_PEM,
   PROP_PEER_PEM,
+  PROP_HANDSHAKE_THREADS,
 
   PROP_DECODER_KEY,
   PROP_SRTP_CIPHER,
@@ -75,6 +76,7 @@ static GParamSpec *properties[NUM_PROPERTIES];
 #define DEFAULT_CONNECTION_ID NULL
 #define DEFAULT_PEM NULL
 #define DEFAULT_PEER_PEM NULL
+#define DEFAULT_HANDSHAKE_THREADS 0
 
 #define DEFAULT_DECODER_KEY NULL
 #define DEFAULT_SRTP_CIPHER 0
@@ -149,6 +151,15 @@ gst_dtls_dec_class_init (GstDtlsDecClass * klass)
       "The X509 certificate received in the DTLS handshake, in PEM format",
       DEFAULT_PEER_PEM, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
 
+  properties[PROP_HANDSHAKE_THREADS] =
+      g_param_spec_uint ("handshake-threads",
+      "Handshake threads",
+      "Process the handshake of the connection in a pool of threads shared "
+      "with the other elements using the same certificate, sized to the "
+      "largest value they set. 0 processes it in the streaming thread",
+      0, G_MAXUINT, DEFAULT_HANDSHAKE_THREADS,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
   properties[PROP_DECODER_KEY] =
       g_param_spec_boxed ("decoder-key",
       "Decoder key",
@@ -191,6 +202,7 @@ gst_dtls_dec_init (GstDtlsDec * self)
   self->connection_id = NULL;
   self->connection = NULL;
   self->peer_pem = NULL;
+  self->handshake_threads = DEFAULT_HANDSHAKE_THREADS;
 
   self->decoder_key = NULL;
   self->srtp_cipher = DEFAULT_SRTP_CIPHER;
@@ -268,10 +280,21 @@ gst_dtls_dec_set_property (GObject * object, guint prop_id,
         g_object_unref (self->agent);
       }
       self->agent = get_agent_by_pem (g_value_get_string (value));
+      if (self->handshake_threads) {
+        _gst_dtls_agent_set_handshake_threads (self->agent,
+            self->handshake_threads);
+      }
       if (self->connection_id) {
         create_connection (self, self->connection_id);
       }
       break;
+    case PROP_HANDSHAKE_THREADS:
+      self->handshake_threads = g_value_get_uint (value);
+      if (self->agent && self->handshake_threads) {
+        _gst_dtls_agent_set_handshake_threads (self->agent,
+            self->handshake_threads);
+      }
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (self, prop_id, pspec);
   }
@@ -294,6 +317,9 @@ gst_dtls_dec_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_PEER_PEM:
       g_value_set_string (value, self->peer_pem);
       break;
+    case PROP_HANDSHAKE_THREADS:
+      g_value_set_uint (value, self->handshake_threads);
+      break;
     case PROP_DECODER_KEY:
       g_value_set_boxed (value, self->decoder_key);
       break;
@@ -494,7 +520,7 @@ process_buffer (GstDtlsDec * self, GstBuffer * buffer)
 
   size =
       gst_dtls_connection_process (self->connection, map_info.data,
-      map_info.size);
+      map_info.size, self->handshake_threads > 0);
   gst_buffer_unmap (buffer, &map_info);
 
   if (size <= 0)
@@ -59,6 +59,7 @@ struct _GstDtlsDec {
     GMutex connection_mutex;
     gchar *connection_id;
     gchar *peer_pem;
+    guint handshake_threads;
 
     GstBuffer *decoder_key;
     guint srtp_cipher;
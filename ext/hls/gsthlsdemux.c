@@ -67,12 +67,18 @@ enum
 
 #define DEFAULT_FRAGMENTS_CACHE 1
 
+/* Number of distinct keys prefetched ahead of the current fragment, and
+ * upper bound of the key cache size */
+#define KEYS_PREFETCH_COUNT 2
+#define KEYS_CACHE_MAX_SIZE 8
+
 /* GObject */
 static void gst_hls_demux_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
 static void gst_hls_demux_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
 static void gst_hls_demux_dispose (GObject * obj);
+static void gst_hls_demux_finalize (GObject * obj);
 
 /* GstElement */
 static GstStateChangeReturn
@@ -89,6 +95,9 @@ static gboolean gst_hls_demux_change_playlist (GstHLSDemux * demux,
     guint max_bitrate, gboolean * changed);
 static GstBuffer *gst_hls_demux_decrypt_fragment (GstHLSDemux * demux,
     GstBuffer * encrypted_buffer, GError ** err);
+static GstBuffer *gst_hls_demux_get_key (GstHLSDemux * demux,
+    const gchar * key_uri, GError ** err);
+static void gst_hls_demux_prefetch_keys (GstHLSDemux * demux);
 static gboolean
 gst_hls_demux_decrypt_start (GstHLSDemux * demux, const guint8 * key_data,
     const guint8 * iv_data);
@@ -131,10 +140,22 @@ gst_hls_demux_dispose (GObject * obj)
 
   gst_hls_demux_reset (GST_ADAPTIVE_DEMUX_CAST (demux));
   gst_m3u8_client_free (demux->client);
+  demux->client = NULL;
 
   G_OBJECT_CLASS (parent_class)->dispose (obj);
 }
 
+static void
+gst_hls_demux_finalize (GObject * obj)
+{
+  GstHLSDemux *demux = GST_HLS_DEMUX (obj);
+
+  g_hash_table_unref (demux->keys);
+  g_mutex_clear (&demux->keys_lock);
+
+  G_OBJECT_CLASS (parent_class)->finalize (obj);
+}
+
 static void
 gst_hls_demux_class_init (GstHLSDemuxClass * klass)
 {
@@ -149,6 +170,7 @@ gst_hls_demux_class_init (GstHLSDemuxClass * klass)
   gobject_class->set_property = gst_hls_demux_set_property;
   gobject_class->get_property = gst_hls_demux_get_property;
   gobject_class->dispose = gst_hls_demux_dispose;
+  gobject_class->finalize = gst_hls_demux_finalize;
 
 #ifndef GST_REMOVE_DEPRECATED
   g_object_class_install_property (gobject_class, PROP_FRAGMENTS_CACHE,
@@ -202,6 +224,10 @@ static void
 gst_hls_demux_init (GstHLSDemux * demux)
 {
   demux->do_typefind = TRUE;
+
+  demux->keys = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) gst_buffer_unref);
+  g_mutex_init (&demux->keys_lock);
 }
 
 static void
@@ -402,6 +428,8 @@ gst_hls_demux_update_manifest (GstAdaptiveDemux * demux)
   if (!gst_hls_demux_update_playlist (hlsdemux, TRUE, NULL))
     return GST_FLOW_ERROR;
 
+  gst_hls_demux_prefetch_keys (hlsdemux);
+
   return GST_FLOW_OK;
 }
 
@@ -465,6 +493,8 @@ gst_hls_demux_process_manifest (GstAdaptiveDemux * demux, GstBuffer * buf)
     }
   }
 
+  gst_hls_demux_prefetch_keys (hlsdemux);
+
   return gst_hls_demux_setup_streams (demux);
 }
 
@@ -492,43 +522,23 @@ gst_hls_demux_start_fragment (GstAdaptiveDemux * demux,
 
   if (hlsdemux->current_key) {
     GError *err = NULL;
-    GstFragment *key_fragment;
     GstBuffer *key_buffer;
     GstMapInfo key_info;
 
-    /* new key? */
-    if (hlsdemux->key_url
-        && strcmp (hlsdemux->key_url, hlsdemux->current_key) == 0) {
-      key_fragment = g_object_ref (hlsdemux->key_fragment);
-    } else {
-      g_free (hlsdemux->key_url);
-      hlsdemux->key_url = NULL;
-
-      if (hlsdemux->key_fragment)
-        g_object_unref (hlsdemux->key_fragment);
-      hlsdemux->key_fragment = NULL;
-
-      GST_INFO_OBJECT (demux, "Fetching key %s", hlsdemux->current_key);
-      key_fragment =
-          gst_uri_downloader_fetch_uri (demux->downloader,
-          hlsdemux->current_key, hlsdemux->client->main ?
-          hlsdemux->client->main->uri : NULL, FALSE, FALSE,
-          hlsdemux->client->current ? hlsdemux->client->current->
-          allowcache : TRUE, &err);
-      if (key_fragment == NULL)
-        goto key_failed;
-      hlsdemux->key_url = g_strdup (hlsdemux->current_key);
-      hlsdemux->key_fragment = g_object_ref (key_fragment);
-    }
+    key_buffer = gst_hls_demux_get_key (hlsdemux, hlsdemux->current_key, &err);
+    if (key_buffer == NULL)
+      goto key_failed;
 
-    key_buffer = gst_fragment_get_buffer (key_fragment);
-    gst_buffer_map (key_buffer, &key_info, GST_MAP_READ);
+    if (!gst_buffer_map (key_buffer, &key_info, GST_MAP_READ)
+        || key_info.size < 16) {
+      gst_buffer_unref (key_buffer);
+      goto key_failed;
+    }
 
     gst_hls_demux_decrypt_start (hlsdemux, key_info.data, hlsdemux->current_iv);
 
     gst_buffer_unmap (key_buffer, &key_info);
     gst_buffer_unref (key_buffer);
-    g_object_unref (key_fragment);
   }
 
   return TRUE;
@@ -660,7 +670,7 @@ gst_hls_demux_data_received (GstAdaptiveDemux * demux,
   /* Is it encrypted? */
   if (hlsdemux->current_key) {
     GError *err = NULL;
-    GstBuffer *tmp_buffer;
+    gsize size;
 
     /* must be a multiple of 16 */
     available = available & (~0xF);
@@ -678,9 +688,23 @@ gst_hls_demux_data_received (GstAdaptiveDemux * demux,
       return GST_FLOW_ERROR;
     }
 
-    tmp_buffer = hlsdemux->pending_buffer;
-    hlsdemux->pending_buffer = buffer;
-    buffer = tmp_buffer;
+    if (hlsdemux->pending_buffer) {
+      buffer = gst_buffer_append (hlsdemux->pending_buffer, buffer);
+      hlsdemux->pending_buffer = NULL;
+    }
+
+    /* Only the last block can contain padding, so hold back just that one
+     * until the end of the fragment and push the rest right away */
+    size = gst_buffer_get_size (buffer);
+    if (size > 16) {
+      hlsdemux->pending_buffer =
+          gst_buffer_copy_region (buffer, GST_BUFFER_COPY_MEMORY, size - 16,
+          16);
+      gst_buffer_resize (buffer, 0, size - 16);
+    } else {
+      hlsdemux->pending_buffer = buffer;
+      buffer = NULL;
+    }
   } else {
     buffer = gst_adapter_take_buffer (stream->adapter, available);
     if (hlsdemux->pending_buffer) {
@@ -793,12 +817,9 @@ gst_hls_demux_reset (GstAdaptiveDemux * ademux)
   demux->do_typefind = TRUE;
   demux->reset_pts = TRUE;
 
-  g_free (demux->key_url);
-  demux->key_url = NULL;
-
-  if (demux->key_fragment)
-    g_object_unref (demux->key_fragment);
-  demux->key_fragment = NULL;
+  g_mutex_lock (&demux->keys_lock);
+  g_hash_table_remove_all (demux->keys);
+  g_mutex_unlock (&demux->keys_lock);
 
   if (demux->client) {
     gst_m3u8_client_free (demux->client);
@@ -1151,6 +1172,7 @@ decrypt_fragment (GstHLSDemux * demux, gsize length,
   if (G_UNLIKELY (length > G_MAXINT || length % 16 != 0))
     return FALSE;
 
+  /* EVP handles encrypted_data == decrypted_data for in-place decryption */
   len = (int) length;
   if (!EVP_DecryptUpdate (&demux->aes_ctx, decrypted_data, &len, encrypted_data,
           len))
@@ -1184,6 +1206,7 @@ decrypt_fragment (GstHLSDemux * demux, gsize length,
   if (length % 16 != 0)
     return FALSE;
 
+  /* nettle's CBC decryption supports overlapping src and dst */
   CBC_DECRYPT (&demux->aes_ctx, aes_decrypt, length, decrypted_data,
       encrypted_data);
 
@@ -1230,8 +1253,11 @@ decrypt_fragment (GstHLSDemux * demux, gsize length,
 {
   gcry_error_t err = 0;
 
-  err = gcry_cipher_decrypt (demux->aes_ctx, decrypted_data, length,
-      encrypted_data, length);
+  if (encrypted_data == decrypted_data)
+    err = gcry_cipher_decrypt (demux->aes_ctx, decrypted_data, length, NULL, 0);
+  else
+    err = gcry_cipher_decrypt (demux->aes_ctx, decrypted_data, length,
+        encrypted_data, length);
 
   return err == 0;
 }
@@ -1246,46 +1272,152 @@ gst_hls_demux_decrypt_end (GstHLSDemux * demux)
 }
 #endif
 
+/* Decrypts @encrypted_buffer in place. The buffer memory is only copied
+ * if it is shared with someone else, otherwise the data taken from the
+ * adapter is decrypted directly into the same memory */
 static GstBuffer *
 gst_hls_demux_decrypt_fragment (GstHLSDemux * demux,
     GstBuffer * encrypted_buffer, GError ** err)
 {
-  GstBuffer *decrypted_buffer = NULL;
-  GstMapInfo encrypted_info, decrypted_info;
+  GstBuffer *buffer;
+  GstMapInfo info;
 
-  decrypted_buffer =
-      gst_buffer_new_allocate (NULL, gst_buffer_get_size (encrypted_buffer),
-      NULL);
+  buffer = gst_buffer_make_writable (encrypted_buffer);
 
-  gst_buffer_map (encrypted_buffer, &encrypted_info, GST_MAP_READ);
-  gst_buffer_map (decrypted_buffer, &decrypted_info, GST_MAP_WRITE);
+  if (!gst_buffer_map (buffer, &info, GST_MAP_READWRITE))
+    goto map_error;
 
-  if (!decrypt_fragment (demux, encrypted_info.size,
-          encrypted_info.data, decrypted_info.data))
+  if (!decrypt_fragment (demux, info.size, info.data, info.data))
     goto decrypt_error;
 
+  gst_buffer_unmap (buffer, &info);
 
-  gst_buffer_unmap (decrypted_buffer, &decrypted_info);
-  gst_buffer_unmap (encrypted_buffer, &encrypted_info);
-
-  gst_buffer_unref (encrypted_buffer);
+  return buffer;
 
-  return decrypted_buffer;
+map_error:
+  GST_ERROR_OBJECT (demux, "Failed to map buffer for decryption");
+  g_set_error (err, GST_STREAM_ERROR, GST_STREAM_ERROR_DECRYPT,
+      "Failed to map buffer for decryption");
+  gst_buffer_unref (buffer);
+  return NULL;
 
 decrypt_error:
   GST_ERROR_OBJECT (demux, "Failed to decrypt fragment");
   g_set_error (err, GST_STREAM_ERROR, GST_STREAM_ERROR_DECRYPT,
       "Failed to decrypt fragment");
 
-  gst_buffer_unmap (decrypted_buffer, &decrypted_info);
-  gst_buffer_unmap (encrypted_buffer, &encrypted_info);
-
-  gst_buffer_unref (encrypted_buffer);
-  gst_buffer_unref (decrypted_buffer);
+  gst_buffer_unmap (buffer, &info);
+  gst_buffer_unref (buffer);
 
   return NULL;
 }
 
+static GstBuffer *
+gst_hls_demux_fetch_key (GstHLSDemux * demux, const gchar * key_uri,
+    GError ** err)
+{
+  GstAdaptiveDemux *adaptive_demux = GST_ADAPTIVE_DEMUX_CAST (demux);
+  GstFragment *key_fragment;
+  GstBuffer *key_buffer;
+  gchar *main_uri;
+  gboolean allow_cache;
+
+  GST_M3U8_CLIENT_LOCK (demux->client);
+  main_uri = demux->client->main ? g_strdup (demux->client->main->uri) : NULL;
+  allow_cache = demux->client->current ?
+      demux->client->current->allowcache : TRUE;
+  GST_M3U8_CLIENT_UNLOCK (demux->client);
+
+  GST_INFO_OBJECT (demux, "Fetching key %s", key_uri);
+  key_fragment =
+      gst_uri_downloader_fetch_uri (adaptive_demux->downloader, key_uri,
+      main_uri, FALSE, FALSE, allow_cache, err);
+  g_free (main_uri);
+
+  if (key_fragment == NULL)
+    return NULL;
+
+  key_buffer = gst_fragment_get_buffer (key_fragment);
+  g_object_unref (key_fragment);
+
+  return key_buffer;
+}
+
+static void
+gst_hls_demux_cache_key (GstHLSDemux * demux, const gchar * key_uri,
+    GstBuffer * key_buffer)
+{
+  g_mutex_lock (&demux->keys_lock);
+  if (!g_hash_table_contains (demux->keys, key_uri)) {
+    /* Keys are only used for a short while, so just start over when the
+     * cache is full instead of tracking their usage */
+    if (g_hash_table_size (demux->keys) >= KEYS_CACHE_MAX_SIZE)
+      g_hash_table_remove_all (demux->keys);
+    g_hash_table_insert (demux->keys, g_strdup (key_uri),
+        gst_buffer_ref (key_buffer));
+  }
+  g_mutex_unlock (&demux->keys_lock);
+}
+
+/* Returns the key for @key_uri, from the cache if it was already fetched
+ * or prefetched, or downloads it otherwise */
+static GstBuffer *
+gst_hls_demux_get_key (GstHLSDemux * demux, const gchar * key_uri,
+    GError ** err)
+{
+  GstBuffer *key_buffer;
+
+  g_mutex_lock (&demux->keys_lock);
+  key_buffer = g_hash_table_lookup (demux->keys, key_uri);
+  if (key_buffer)
+    gst_buffer_ref (key_buffer);
+  g_mutex_unlock (&demux->keys_lock);
+
+  if (key_buffer)
+    return key_buffer;
+
+  key_buffer = gst_hls_demux_fetch_key (demux, key_uri, err);
+  if (key_buffer)
+    gst_hls_demux_cache_key (demux, key_uri, key_buffer);
+
+  return key_buffer;
+}
+
+/* Fetches the keys of the next fragments ahead of time. Called after
+ * playlist (re)loads, which don't happen in the fragment download loop */
+static void
+gst_hls_demux_prefetch_keys (GstHLSDemux * demux)
+{
+  GstAdaptiveDemux *adaptive_demux = GST_ADAPTIVE_DEMUX_CAST (demux);
+  gchar **keys;
+  guint i;
+
+  keys = gst_m3u8_client_get_upcoming_keys (demux->client,
+      KEYS_PREFETCH_COUNT, adaptive_demux->segment.rate > 0);
+
+  for (i = 0; keys && keys[i] && !adaptive_demux->cancelled; i++) {
+    GstBuffer *key_buffer;
+    gboolean cached;
+
+    g_mutex_lock (&demux->keys_lock);
+    cached = g_hash_table_contains (demux->keys, keys[i]);
+    g_mutex_unlock (&demux->keys_lock);
+    if (cached)
+      continue;
+
+    key_buffer = gst_hls_demux_fetch_key (demux, keys[i], NULL);
+    if (key_buffer == NULL) {
+      /* Not fatal, it will be fetched again when actually needed */
+      GST_DEBUG_OBJECT (demux, "Failed to prefetch key %s", keys[i]);
+      continue;
+    }
+    gst_hls_demux_cache_key (demux, keys[i], key_buffer);
+    gst_buffer_unref (key_buffer);
+  }
+
+  g_strfreev (keys);
+}
+
 static gint64
 gst_hls_demux_get_manifest_update_interval (GstAdaptiveDemux * demux)
 {
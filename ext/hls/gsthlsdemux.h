@@ -74,9 +74,11 @@ struct _GstHLSDemux
   GstClockTime current_pts;
 #endif
 
-  /* Cache for the last key */
-  gchar *key_url;
-  GstFragment *key_fragment;
+  /* Cache of fetched keys: key URI -> GstBuffer. Keys of upcoming
+   * fragments are prefetched on playlist updates so that the download
+   * loop doesn't have to block on a key fetch when the key changes */
+  GHashTable *keys;
+  GMutex keys_lock;
 
   /* decryption tooling */
 #if defined(HAVE_OPENSSL)
@@ -89,8 +91,8 @@ struct _GstHLSDemux
   gchar *current_key;
   guint8 *current_iv;
   GstBuffer *pending_buffer; /* decryption scenario:
-                              * the last buffer can only be pushed when
-                              * resized, so need to store and wait for
+                              * the last block can only be pushed when
+                              * unpadded, so need to store and wait for
                               * EOS to know it is the last */
 
   gboolean reset_pts;
@@ -1068,6 +1068,44 @@ gst_m3u8_client_get_next_fragment (GstM3U8Client * client,
   return TRUE;
 }
 
+/* Returns a NULL-terminated array of the distinct key URIs used by the
+ * current fragment and up to @max_keys - 1 different keys after it, in
+ * playback order. Free with g_strfreev() */
+gchar **
+gst_m3u8_client_get_upcoming_keys (GstM3U8Client * client, guint max_keys,
+    gboolean forward)
+{
+  GPtrArray *keys;
+  const gchar *last_key = NULL;
+  GList *l;
+
+  g_return_val_if_fail (client != NULL, NULL);
+
+  keys = g_ptr_array_new ();
+
+  GST_M3U8_CLIENT_LOCK (client);
+  if (client->current == NULL || max_keys == 0)
+    goto done;
+
+  l = client->current_file;
+  if (l == NULL)
+    l = find_next_fragment (client, client->current->files, forward);
+
+  for (; l && keys->len < max_keys; l = forward ? l->next : l->prev) {
+    GstM3U8MediaFile *file = GST_M3U8_MEDIA_FILE (l->data);
+
+    if (file->key == NULL || g_strcmp0 (file->key, last_key) == 0)
+      continue;
+    last_key = file->key;
+    g_ptr_array_add (keys, g_strdup (file->key));
+  }
+
+done:
+  GST_M3U8_CLIENT_UNLOCK (client);
+  g_ptr_array_add (keys, NULL);
+  return (gchar **) g_ptr_array_free (keys, FALSE);
+}
+
 gboolean
 gst_m3u8_client_has_next_fragment (GstM3U8Client * client, gboolean forward)
 {
@@ -32,7 +32,20 @@
  * |[
  * gst-launch -v videotestsrc ! ffenc_flv ! flvmux ! rtmpsink location='rtmp://localhost/path/to/stream live=1'
  * ]| Encode a test video stream to FLV video format and stream it via RTMP.
+ * |[
+ * gst-launch-1.0 -v videotestsrc is-live=1 ! x264enc ! flvmux streamable=1 ! rtmpsink async-send=1 leaky=1 location='rtmp://localhost/path/to/stream live=1'
+ * ]| Stream live video from a dedicated send thread, dropping video until the
+ * next keyframe when the server can't keep up instead of stalling the encoder.
  * </refsect2>
+ *
+ * By default the data is written to the server from the streaming thread, one
+ * buffer at a time. With #GstRTMPSink:async-send, the buffers are queued for a
+ * dedicated thread. It takes what was queued while it was busy, up to
+ * #GstRTMPSink:max-batch-size bytes, and writes it buffer by buffer with the
+ * socket corked where TCP_CORK is available, so that the batch leaves in as
+ * few TCP segments as possible. When more than #GstRTMPSink:max-queue-size
+ * bytes are waiting, the streaming thread blocks, or with #GstRTMPSink:leaky
+ * the buffers are dropped.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -45,6 +58,9 @@
 
 #ifdef G_OS_WIN32
 #include <winsock2.h>
+#else
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #endif
 
 #include <stdlib.h>
@@ -53,13 +69,29 @@ GST_DEBUG_CATEGORY_STATIC (gst_rtmp_sink_debug);
 #define GST_CAT_DEFAULT gst_rtmp_sink_debug
 
 #define DEFAULT_LOCATION NULL
+#define DEFAULT_ASYNC_SEND FALSE
+#define DEFAULT_MAX_QUEUE_SIZE (2 * 1024 * 1024)
+#define DEFAULT_MAX_BATCH_SIZE (64 * 1024)
+#define DEFAULT_LEAKY FALSE
 
 enum
 {
   PROP_0,
-  PROP_LOCATION
+  PROP_LOCATION,
+  PROP_ASYNC_SEND,
+  PROP_MAX_QUEUE_SIZE,
+  PROP_MAX_BATCH_SIZE,
+  PROP_LEAKY,
+  PROP_STATS
 };
 
+/* a buffer waiting for the send thread */
+typedef struct
+{
+  GstBuffer *buf;
+  gint64 queued;                /* monotonic time, in us */
+} GstRTMPSinkItem;
+
 static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
@@ -76,6 +108,8 @@ static void gst_rtmp_sink_finalize (GObject * object);
 static gboolean gst_rtmp_sink_stop (GstBaseSink * sink);
 static gboolean gst_rtmp_sink_start (GstBaseSink * sink);
 static gboolean gst_rtmp_sink_event (GstBaseSink * sink, GstEvent * event);
+static gboolean gst_rtmp_sink_unlock (GstBaseSink * sink);
+static gboolean gst_rtmp_sink_unlock_stop (GstBaseSink * sink);
 static GstFlowReturn gst_rtmp_sink_render (GstBaseSink * sink, GstBuffer * buf);
 
 #define gst_rtmp_sink_parent_class parent_class
@@ -103,6 +137,83 @@ gst_rtmp_sink_class_init (GstRTMPSinkClass * klass)
       g_param_spec_string ("location", "RTMP Location", "RTMP url",
           DEFAULT_LOCATION, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstRTMPSink:async-send:
+   *
+   * Write to the server from a dedicated thread, so that a slow network
+   * doesn't stall the streaming thread. Takes effect at the next start.
+   *
+   * Since: 1.8
+   */
+  g_object_class_install_property (gobject_class, PROP_ASYNC_SEND,
+      g_param_spec_boolean ("async-send", "Async send",
+          "Write to the server from a dedicated thread", DEFAULT_ASYNC_SEND,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTMPSink:max-queue-size:
+   *
+   * The maximum number of bytes waiting for the send thread, in async mode.
+   *
+   * Since: 1.8
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_QUEUE_SIZE,
+      g_param_spec_uint ("max-queue-size", "Max queue size",
+          "Maximum number of bytes waiting to be sent in async mode "
+          "(0 = unlimited)", 0, G_MAXUINT, DEFAULT_MAX_QUEUE_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTMPSink:max-batch-size:
+   *
+   * The maximum number of bytes the send thread takes from the queue at
+   * once and sends in one corked batch, in async mode. A single bigger
+   * buffer is still written at once.
+   *
+   * Since: 1.8
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_BATCH_SIZE,
+      g_param_spec_uint ("max-batch-size", "Max batch size",
+          "Maximum number of bytes sent to the server in one batch in async "
+          "mode", 1, G_MAXUINT, DEFAULT_MAX_BATCH_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTMPSink:leaky:
+   *
+   * In async mode, drop the buffers that don't fit in the queue instead of
+   * blocking. After a drop, the delta units are dropped too until the next
+   * keyframe, so that the video can still be decoded.
+   *
+   * Since: 1.8
+   */
+  g_object_class_install_property (gobject_class, PROP_LEAKY,
+      g_param_spec_boolean ("leaky", "Leaky",
+          "Drop buffers instead of blocking when the send queue is full",
+          DEFAULT_LEAKY, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTMPSink:stats:
+   *
+   * Statistics of the sending, in a structure with the fields:
+   *
+   *   "queued-buffers": #guint, the number of buffers waiting to be sent
+   *   "queued-bytes": #guint64, the number of bytes waiting to be sent
+   *   "writes": #guint64, the number of times data was flushed to the
+   *       server. A batch sent with the socket corked counts once
+   *   "bytes-sent": #guint64, the number of bytes written
+   *   "dropped": #guint64, the number of buffers dropped by a leaky queue
+   *   "average-send-latency": #guint64, the average time between the
+   *       rendering of a buffer and the end of its write, in nanoseconds
+   *   "max-send-latency": #guint64, the maximum of that time
+   *
+   * Since: 1.8
+   */
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Statistics of the sending", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_set_static_metadata (gstelement_class,
       "RTMP output sink",
       "Sink/Network", "Sends FLV content to a server via RTMP",
@@ -115,6 +226,9 @@ gst_rtmp_sink_class_init (GstRTMPSinkClass * klass)
   gstbasesink_class->stop = GST_DEBUG_FUNCPTR (gst_rtmp_sink_stop);
   gstbasesink_class->render = GST_DEBUG_FUNCPTR (gst_rtmp_sink_render);
   gstbasesink_class->event = gst_rtmp_sink_event;
+  gstbasesink_class->unlock = GST_DEBUG_FUNCPTR (gst_rtmp_sink_unlock);
+  gstbasesink_class->unlock_stop =
+      GST_DEBUG_FUNCPTR (gst_rtmp_sink_unlock_stop);
 
   GST_DEBUG_CATEGORY_INIT (gst_rtmp_sink_debug, "rtmpsink", 0,
       "RTMP server element");
@@ -133,6 +247,15 @@ gst_rtmp_sink_init (GstRTMPSink * sink)
     GST_ERROR_OBJECT (sink, "WSAStartup failed: 0x%08x", WSAGetLastError ());
   }
 #endif
+
+  sink->async_send = DEFAULT_ASYNC_SEND;
+  sink->max_queue_size = DEFAULT_MAX_QUEUE_SIZE;
+  sink->max_batch_size = DEFAULT_MAX_BATCH_SIZE;
+  sink->leaky = DEFAULT_LEAKY;
+
+  g_mutex_init (&sink->lock);
+  g_cond_init (&sink->cond);
+  g_queue_init (&sink->queue);
 }
 
 static void
@@ -144,10 +267,254 @@ gst_rtmp_sink_finalize (GObject * object)
   WSACleanup ();
 #endif
   g_free (sink->uri);
+  g_mutex_clear (&sink->lock);
+  g_cond_clear (&sink->cond);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static void
+gst_rtmp_sink_item_free (GstRTMPSinkItem * item)
+{
+  gst_buffer_unref (item->buf);
+  g_slice_free (GstRTMPSinkItem, item);
+}
+
+/* called with the lock */
+static void
+gst_rtmp_sink_clear_queue (GstRTMPSink * sink)
+{
+  GstRTMPSinkItem *item;
+
+  while ((item = g_queue_pop_head (&sink->queue)))
+    gst_rtmp_sink_item_free (item);
+  sink->queued_bytes = 0;
+}
+
+/* called with the lock */
+static void
+gst_rtmp_sink_add_writes (GstRTMPSink * sink, guint writes, gsize size)
+{
+  sink->writes += writes;
+  sink->bytes_sent += size;
+}
+
+/* called with the lock, @latency in us */
+static void
+gst_rtmp_sink_add_latency (GstRTMPSink * sink, gint64 latency)
+{
+  guint64 ns = MAX (latency, 0) * GST_USECOND;
+
+  sink->latency_sum += ns;
+  sink->latency_max = MAX (sink->latency_max, ns);
+  sink->latency_count++;
+}
+
+static gboolean
+gst_rtmp_sink_write (GstRTMPSink * sink, GstBuffer * buf)
+{
+  GstMapInfo map;
+  gboolean ret;
+
+  GST_LOG_OBJECT (sink, "Sending %" G_GSIZE_FORMAT " bytes to RTMP server",
+      gst_buffer_get_size (buf));
+
+  /* librtmp parses the FLV tags itself and sends one packet per tag */
+  if (!gst_buffer_map (buf, &map, GST_MAP_READ))
+    return FALSE;
+  ret = RTMP_Write (sink->rtmp, (char *) map.data, map.size) > 0;
+  gst_buffer_unmap (buf, &map);
+
+  return ret;
+}
+
+/* librtmp sends each RTMP packet on its own and disables Nagle, corking
+ * makes the kernel hold the data until the batch is complete. Returns
+ * FALSE if the socket could not be corked */
+static gboolean
+gst_rtmp_sink_set_cork (GstRTMPSink * sink, gboolean cork)
+{
+#ifdef TCP_CORK
+  int val = cork;
+
+  return setsockopt (RTMP_Socket (sink->rtmp), IPPROTO_TCP, TCP_CORK,
+      &val, sizeof (val)) == 0;
+#else
+  return FALSE;
+#endif
+}
+
+static gpointer
+gst_rtmp_sink_send_thread (GstRTMPSink * sink)
+{
+  g_mutex_lock (&sink->lock);
+  while (TRUE) {
+    GQueue batch = G_QUEUE_INIT;
+    GstRTMPSinkItem *item;
+    GList *l;
+    gsize size = 0;
+    guint writes = 0;
+    gboolean corked, ret = TRUE;
+    gint64 now;
+
+    while (!sink->send_stop && g_queue_is_empty (&sink->queue))
+      g_cond_wait (&sink->cond, &sink->lock);
+    if (sink->send_stop)
+      break;
+
+    /* take what was queued while we were writing */
+    while ((item = g_queue_peek_head (&sink->queue))) {
+      gsize item_size = gst_buffer_get_size (item->buf);
+
+      if (size && size + item_size > sink->max_batch_size)
+        break;
+
+      g_queue_pop_head (&sink->queue);
+      g_queue_push_tail (&batch, item);
+      size += item_size;
+    }
+    sink->queued_bytes -= size;
+    sink->sending = TRUE;
+    g_cond_broadcast (&sink->cond);
+    g_mutex_unlock (&sink->lock);
+
+    /* each buffer is written as is, without copying them together */
+    corked = batch.length > 1 && gst_rtmp_sink_set_cork (sink, TRUE);
+    for (l = batch.head; l && ret; l = l->next) {
+      item = l->data;
+      ret = gst_rtmp_sink_write (sink, item->buf);
+      writes++;
+    }
+    if (corked) {
+      /* uncorking pushes out what the kernel held back */
+      gst_rtmp_sink_set_cork (sink, FALSE);
+      writes = 1;
+    }
+    now = g_get_monotonic_time ();
+
+    if (!ret)
+      GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, (NULL),
+          ("Failed to write data"));
+
+    g_mutex_lock (&sink->lock);
+    sink->sending = FALSE;
+    if (ret) {
+      gst_rtmp_sink_add_writes (sink, writes, size);
+    } else {
+      /* render refuses new data until a flush, drop what was queued */
+      sink->have_write_error = TRUE;
+      gst_rtmp_sink_clear_queue (sink);
+    }
+    while ((item = g_queue_pop_head (&batch))) {
+      if (ret)
+        gst_rtmp_sink_add_latency (sink, now - item->queued);
+      gst_rtmp_sink_item_free (item);
+    }
+    g_cond_broadcast (&sink->cond);
+  }
+  g_mutex_unlock (&sink->lock);
+
+  return NULL;
+}
+
+/* Takes ownership of @buf */
+static GstFlowReturn
+gst_rtmp_sink_queue_buffer (GstRTMPSink * sink, GstBuffer * buf)
+{
+  GstRTMPSinkItem *item;
+  gsize size = gst_buffer_get_size (buf);
+
+  g_mutex_lock (&sink->lock);
+  if (sink->need_keyframe) {
+    if (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT))
+      goto dropped;
+    sink->need_keyframe = FALSE;
+  }
+
+  while (TRUE) {
+    if (sink->flushing)
+      goto flushing;
+    if (sink->have_write_error)
+      goto write_failed;
+
+    /* a buffer bigger than the queue is still accepted when it is empty */
+    if (!sink->max_queue_size || g_queue_is_empty (&sink->queue) ||
+        sink->queued_bytes + size <= sink->max_queue_size)
+      break;
+
+    if (sink->leaky) {
+      sink->need_keyframe = TRUE;
+      goto dropped;
+    }
+
+    GST_LOG_OBJECT (sink, "Queue full, waiting for the send thread");
+    g_cond_wait (&sink->cond, &sink->lock);
+  }
+
+  item = g_slice_new (GstRTMPSinkItem);
+  item->buf = buf;
+  item->queued = g_get_monotonic_time ();
+  g_queue_push_tail (&sink->queue, item);
+  sink->queued_bytes += size;
+  g_cond_broadcast (&sink->cond);
+  g_mutex_unlock (&sink->lock);
+
+  return GST_FLOW_OK;
+
+dropped:
+  {
+    GST_DEBUG_OBJECT (sink, "Dropping buffer of size %" G_GSIZE_FORMAT, size);
+    sink->dropped++;
+    g_mutex_unlock (&sink->lock);
+    gst_buffer_unref (buf);
+    return GST_FLOW_OK;
+  }
+flushing:
+  {
+    g_mutex_unlock (&sink->lock);
+    gst_buffer_unref (buf);
+    return GST_FLOW_FLUSHING;
+  }
+write_failed:
+  {
+    /* the send thread posted the error */
+    g_mutex_unlock (&sink->lock);
+    gst_buffer_unref (buf);
+    return GST_FLOW_ERROR;
+  }
+}
+
+/* Waits until the send thread wrote everything queued */
+static void
+gst_rtmp_sink_drain (GstRTMPSink * sink)
+{
+  g_mutex_lock (&sink->lock);
+  while ((!g_queue_is_empty (&sink->queue) || sink->sending) &&
+      !sink->flushing && !sink->have_write_error)
+    g_cond_wait (&sink->cond, &sink->lock);
+  g_mutex_unlock (&sink->lock);
+}
+
+static GstStructure *
+gst_rtmp_sink_create_stats (GstRTMPSink * sink)
+{
+  GstStructure *s;
+
+  g_mutex_lock (&sink->lock);
+  s = gst_structure_new ("application/x-rtmp-sink-stats",
+      "queued-buffers", G_TYPE_UINT, g_queue_get_length (&sink->queue),
+      "queued-bytes", G_TYPE_UINT64, sink->queued_bytes,
+      "writes", G_TYPE_UINT64, sink->writes,
+      "bytes-sent", G_TYPE_UINT64, sink->bytes_sent,
+      "dropped", G_TYPE_UINT64, sink->dropped,
+      "average-send-latency", G_TYPE_UINT64,
+      sink->latency_count ? sink->latency_sum / sink->latency_count : 0,
+      "max-send-latency", G_TYPE_UINT64, sink->latency_max, NULL);
+  g_mutex_unlock (&sink->lock);
+
+  return s;
+}
+
 
 static gboolean
 gst_rtmp_sink_start (GstBaseSink * basesink)
@@ -181,6 +548,20 @@ gst_rtmp_sink_start (GstBaseSink * basesink)
   sink->first = TRUE;
   sink->have_write_error = FALSE;
 
+  sink->flushing = FALSE;
+  sink->send_stop = FALSE;
+  sink->need_keyframe = FALSE;
+  sink->writes = 0;
+  sink->bytes_sent = 0;
+  sink->dropped = 0;
+  sink->latency_sum = 0;
+  sink->latency_max = 0;
+  sink->latency_count = 0;
+
+  if (sink->async_send)
+    sink->send_thread = g_thread_new ("rtmpsink-send",
+        (GThreadFunc) gst_rtmp_sink_send_thread, sink);
+
   return TRUE;
 }
 
@@ -189,6 +570,22 @@ gst_rtmp_sink_stop (GstBaseSink * basesink)
 {
   GstRTMPSink *sink = GST_RTMP_SINK (basesink);
 
+  /* a write in progress is completed first, or fails on the send timeout
+   * of librtmp */
+  if (sink->send_thread) {
+    g_mutex_lock (&sink->lock);
+    sink->send_stop = TRUE;
+    g_cond_broadcast (&sink->cond);
+    g_mutex_unlock (&sink->lock);
+
+    g_thread_join (sink->send_thread);
+    sink->send_thread = NULL;
+  }
+
+  g_mutex_lock (&sink->lock);
+  gst_rtmp_sink_clear_queue (sink);
+  g_mutex_unlock (&sink->lock);
+
   gst_buffer_replace (&sink->cache, NULL);
 
   if (sink->rtmp) {
@@ -208,8 +605,7 @@ static GstFlowReturn
 gst_rtmp_sink_render (GstBaseSink * bsink, GstBuffer * buf)
 {
   GstRTMPSink *sink = GST_RTMP_SINK (bsink);
-  GstBuffer *reffed_buf = NULL;
-  GstMapInfo map = GST_MAP_INFO_INIT;
+  gint64 start;
 
   if (sink->rtmp == NULL) {
     /* Do not crash */
@@ -243,28 +639,30 @@ gst_rtmp_sink_render (GstBaseSink * bsink, GstBuffer * buf)
     return GST_FLOW_OK;
   }
 
+  gst_buffer_ref (buf);
   if (sink->cache) {
     GST_LOG_OBJECT (sink, "Joining 2nd buffer of size %" G_GSIZE_FORMAT
         " to cached buf", gst_buffer_get_size (buf));
-    gst_buffer_ref (buf);
-    reffed_buf = buf = gst_buffer_append (sink->cache, buf);
+    buf = gst_buffer_append (sink->cache, buf);
     sink->cache = NULL;
   }
 
+  if (sink->send_thread)
+    return gst_rtmp_sink_queue_buffer (sink, buf);
+
   if (sink->have_write_error)
     goto write_failed;
 
-  GST_LOG_OBJECT (sink, "Sending %" G_GSIZE_FORMAT " bytes to RTMP server",
-      gst_buffer_get_size (buf));
-
-  gst_buffer_map (buf, &map, GST_MAP_READ);
-
-  if (RTMP_Write (sink->rtmp, (char *) map.data, map.size) <= 0)
+  start = g_get_monotonic_time ();
+  if (!gst_rtmp_sink_write (sink, buf))
     goto write_failed;
 
-  gst_buffer_unmap (buf, &map);
-  if (reffed_buf)
-    gst_buffer_unref (reffed_buf);
+  g_mutex_lock (&sink->lock);
+  gst_rtmp_sink_add_writes (sink, 1, gst_buffer_get_size (buf));
+  gst_rtmp_sink_add_latency (sink, g_get_monotonic_time () - start);
+  g_mutex_unlock (&sink->lock);
+
+  gst_buffer_unref (buf);
 
   return GST_FLOW_OK;
 
@@ -272,9 +670,7 @@ gst_rtmp_sink_render (GstBaseSink * bsink, GstBuffer * buf)
 write_failed:
   {
     GST_ELEMENT_ERROR (sink, RESOURCE, WRITE, (NULL), ("Failed to write data"));
-    gst_buffer_unmap (buf, &map);
-    if (reffed_buf)
-      gst_buffer_unref (reffed_buf);
+    gst_buffer_unref (buf);
     sink->have_write_error = TRUE;
     return GST_FLOW_ERROR;
   }
@@ -374,6 +770,27 @@ gst_rtmp_sink_set_property (GObject * object, guint prop_id,
       gst_rtmp_sink_uri_set_uri (GST_URI_HANDLER (sink),
           g_value_get_string (value), NULL);
       break;
+    case PROP_ASYNC_SEND:
+      sink->async_send = g_value_get_boolean (value);
+      break;
+    case PROP_MAX_QUEUE_SIZE:
+      g_mutex_lock (&sink->lock);
+      sink->max_queue_size = g_value_get_uint (value);
+      /* render might be waiting for room */
+      g_cond_broadcast (&sink->cond);
+      g_mutex_unlock (&sink->lock);
+      break;
+    case PROP_MAX_BATCH_SIZE:
+      g_mutex_lock (&sink->lock);
+      sink->max_batch_size = g_value_get_uint (value);
+      g_mutex_unlock (&sink->lock);
+      break;
+    case PROP_LEAKY:
+      g_mutex_lock (&sink->lock);
+      sink->leaky = g_value_get_boolean (value);
+      g_cond_broadcast (&sink->cond);
+      g_mutex_unlock (&sink->lock);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -387,7 +804,14 @@ gst_rtmp_sink_event (GstBaseSink * sink, GstEvent * event)
 
   switch (event->type) {
     case GST_EVENT_FLUSH_STOP:
+      g_mutex_lock (&rtmpsink->lock);
       rtmpsink->have_write_error = FALSE;
+      g_mutex_unlock (&rtmpsink->lock);
+      break;
+    case GST_EVENT_EOS:
+      /* everything is sent when EOS is posted */
+      if (rtmpsink->send_thread)
+        gst_rtmp_sink_drain (rtmpsink);
       break;
     default:
       break;
@@ -396,6 +820,36 @@ gst_rtmp_sink_event (GstBaseSink * sink, GstEvent * event)
   return GST_BASE_SINK_CLASS (parent_class)->event (sink, event);
 }
 
+static gboolean
+gst_rtmp_sink_unlock (GstBaseSink * basesink)
+{
+  GstRTMPSink *sink = GST_RTMP_SINK (basesink);
+
+  /* render or EOS might be waiting for the send thread. What was queued
+   * before a flush must not be sent after it, and the data after it doesn't
+   * continue the frames dropped before */
+  g_mutex_lock (&sink->lock);
+  sink->flushing = TRUE;
+  gst_rtmp_sink_clear_queue (sink);
+  sink->need_keyframe = FALSE;
+  g_cond_broadcast (&sink->cond);
+  g_mutex_unlock (&sink->lock);
+
+  return TRUE;
+}
+
+static gboolean
+gst_rtmp_sink_unlock_stop (GstBaseSink * basesink)
+{
+  GstRTMPSink *sink = GST_RTMP_SINK (basesink);
+
+  g_mutex_lock (&sink->lock);
+  sink->flushing = FALSE;
+  g_mutex_unlock (&sink->lock);
+
+  return TRUE;
+}
+
 static void
 gst_rtmp_sink_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec)
@@ -406,6 +860,21 @@ gst_rtmp_sink_get_property (GObject * object, guint prop_id,
     case PROP_LOCATION:
       g_value_set_string (value, sink->uri);
       break;
+    case PROP_ASYNC_SEND:
+      g_value_set_boolean (value, sink->async_send);
+      break;
+    case PROP_MAX_QUEUE_SIZE:
+      g_value_set_uint (value, sink->max_queue_size);
+      break;
+    case PROP_MAX_BATCH_SIZE:
+      g_value_set_uint (value, sink->max_batch_size);
+      break;
+    case PROP_LEAKY:
+      g_value_set_boolean (value, sink->leaky);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_rtmp_sink_create_stats (sink));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
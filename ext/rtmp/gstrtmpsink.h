@@ -56,6 +56,33 @@ struct _GstRTMPSink {
   GstBuffer *cache; /* Cached buffer */
   gboolean first;
   gboolean have_write_error;
+
+  /* properties */
+  gboolean async_send;
+  guint max_queue_size;
+  guint max_batch_size;
+  gboolean leaky;
+
+  /* async send: the buffers are queued by render and written by the send
+   * thread, in corked batches of what was queued while it was writing. All
+   * of it and the error flag are protected by the lock in async mode */
+  GThread *send_thread;
+  GMutex lock;
+  GCond cond;
+  GQueue queue;
+  guint64 queued_bytes;
+  gboolean sending;
+  gboolean send_stop;
+  gboolean flushing;
+  gboolean need_keyframe;
+
+  /* statistics, protected by the lock */
+  guint64 writes;
+  guint64 bytes_sent;
+  guint64 dropped;
+  guint64 latency_sum;
+  guint64 latency_max;
+  guint64 latency_count;
 };
 
 struct _GstRTMPSinkClass {
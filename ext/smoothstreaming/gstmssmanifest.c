@@ -1101,6 +1101,78 @@ gst_mss_manifest_is_live (GstMssManifest * manifest)
   return manifest->is_live;
 }
 
+/* Merges the fragments of a refreshed live manifest into @stream: fragments
+ * that were already known are kept as they are, so the current position
+ * stays valid without seeking, new ones are appended and the ones that
+ * left the manifest window before the current position are dropped.
+ *
+ * Takes ownership of @fragments on success. Returns %FALSE if the new list
+ * doesn't continue the current one, the caller should then replace it */
+static gboolean
+gst_mss_stream_merge_fragments (GstMssStream * stream, GList * fragments)
+{
+  GList *last = g_list_last (stream->fragments);
+  GList *new_last = g_list_last (fragments);
+  GstMssStreamFragment *last_fragment;
+  guint64 window_start = ((GstMssStreamFragment *) fragments->data)->time;
+  GList *iter;
+  guint added = 0;
+
+  if (last == NULL)
+    return FALSE;
+
+  last_fragment = last->data;
+  if (((GstMssStreamFragment *) new_last->data)->time < last_fragment->time)
+    return FALSE;
+
+  for (iter = fragments; iter; iter = g_list_next (iter)) {
+    GstMssStreamFragment *fragment = iter->data;
+    guint64 end = fragment->time + fragment->duration * fragment->repetitions;
+    guint64 last_end = last_fragment->time +
+        last_fragment->duration * last_fragment->repetitions;
+
+    if (fragment->time == last_fragment->time) {
+      /* the last fragment of a live manifest can get more repetitions */
+      last_fragment->repetitions =
+          MAX (last_fragment->repetitions, fragment->repetitions);
+      if (fragment->duration)
+        last_fragment->duration = fragment->duration;
+      g_free (fragment);
+    } else if (fragment->time < last_end) {
+      /* already known, but the refreshed manifest can restart inside the
+       * repetitions of the last fragment and extend them */
+      if (last_fragment->duration && end > last_end)
+        last_fragment->repetitions =
+            (end - last_fragment->time) / last_fragment->duration;
+      g_free (fragment);
+    } else {
+      /* appending to the last link doesn't walk the list */
+      g_list_append (last, fragment);
+      last = g_list_next (last);
+      added++;
+    }
+  }
+  g_list_free (fragments);
+
+  /* drop what slid out of the manifest window, but never the fragments
+   * that weren't downloaded yet */
+  while (stream->fragments && stream->fragments != stream->current_fragment
+      && stream->fragments != last) {
+    GstMssStreamFragment *fragment = stream->fragments->data;
+
+    if (fragment->time + fragment->duration * fragment->repetitions >
+        window_start)
+      break;
+    g_free (fragment);
+    stream->fragments = g_list_delete_link (stream->fragments,
+        stream->fragments);
+  }
+
+  GST_DEBUG ("Stream %s: %u new fragments", stream->url, added);
+
+  return TRUE;
+}
+
 static void
 gst_mss_stream_reload_fragments (GstMssStream * stream, xmlNodePtr streamIndex)
 {
@@ -1121,12 +1193,20 @@ gst_mss_stream_reload_fragments (GstMssStream * stream, xmlNodePtr streamIndex)
     }
   }
 
-  /* store the new fragments list */
-  if (builder.fragments) {
+  if (builder.fragments == NULL)
+    return;
+
+  builder.fragments = g_list_reverse (builder.fragments);
+
+  if (!gst_mss_stream_merge_fragments (stream, builder.fragments)) {
+    /* the timeline was restarted, store the new fragments list */
     g_list_free_full (stream->fragments, g_free);
-    stream->fragments = g_list_reverse (builder.fragments);
+    stream->fragments = builder.fragments;
     stream->current_fragment = stream->fragments;
     gst_mss_stream_seek (stream, current_gst_time);
+  } else if (stream->current_fragment == NULL) {
+    /* we were at the end of the list, continue with the new fragments */
+    gst_mss_stream_seek (stream, current_gst_time);
   }
 }
 
@@ -179,6 +179,20 @@ rtcp_buffer_get_ssrc (GstBuffer * buf, guint32 * ssrc)
   return ret;
 }
 
+/* Get the session an SSRC belongs to, when the streams are spread over
+ * @n_shards sessions. libsrtp looks the streams of a session up in a list,
+ * and different sessions can be used from different threads. SSRCs are
+ * mixed in case a sender picks them sequentially
+ */
+guint
+gst_srtp_get_shard (guint32 ssrc, guint n_shards)
+{
+  if (n_shards <= 1)
+    return 0;
+
+  return ((ssrc * 2654435761u) >> 16) % n_shards;
+}
+
 void
 set_crypto_policy_cipher_auth (GstSrtpCipherType cipher,
     GstSrtpAuthType auth, crypto_policy_t * policy)
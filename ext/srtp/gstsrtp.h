@@ -63,11 +63,16 @@ typedef enum
   GST_SRTP_AUTH_HMAC_SHA1_80
 } GstSrtpAuthType;
 
+/* Maximum number of libsrtp sessions the SSRCs can be spread over */
+#define GST_SRTP_MAX_SHARDS 64
+
 void     gst_srtp_init_event_reporter    (void);
 gboolean gst_srtp_get_soft_limit_reached (void);
 
 gboolean rtcp_buffer_get_ssrc (GstBuffer * buf, guint32 * ssrc);
 
+guint gst_srtp_get_shard (guint32 ssrc, guint n_shards);
+
 const gchar *enum_nick_from_value (GType enum_gtype, gint value);
 gint enum_value_from_nick (GType enum_gtype, const gchar *nick);
 
@@ -127,6 +127,7 @@ GST_DEBUG_CATEGORY_STATIC (gst_srtp_dec_debug);
 #define GST_CAT_DEFAULT gst_srtp_dec_debug
 
 #define DEFAULT_REPLAY_WINDOW_SIZE 128
+#define DEFAULT_SHARDS 1
 
 /* Filter signals and args */
 enum
@@ -142,7 +143,8 @@ enum
 enum
 {
   PROP_0,
-  PROP_REPLAY_WINDOW_SIZE
+  PROP_REPLAY_WINDOW_SIZE,
+  PROP_SHARDS
 };
 
 /* the capabilities of the inputs and outputs.
@@ -276,6 +278,21 @@ gst_srtp_dec_class_init (GstSrtpDecClass * klass)
           64, 0x8000, DEFAULT_REPLAY_WINDOW_SIZE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstSrtpDec:shards:
+   *
+   * Number of independent libsrtp sessions the SSRCs are spread over, which
+   * keeps the lookup of the stream of each packet short with many SSRCs.
+   *
+   * Since: 1.8
+   */
+  g_object_class_install_property (gobject_class, PROP_SHARDS,
+      g_param_spec_uint ("shards", "Shards",
+          "Number of libsrtp sessions the SSRCs are spread over",
+          1, GST_SRTP_MAX_SHARDS, DEFAULT_SHARDS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
   /* Install signals */
   /**
    * GstSrtpDec::request-key:
@@ -358,6 +375,8 @@ static void
 gst_srtp_dec_init (GstSrtpDec * filter)
 {
   filter->replay_window_size = DEFAULT_REPLAY_WINDOW_SIZE;
+  filter->shards = DEFAULT_SHARDS;
+  filter->n_sessions = 1;
 
   filter->rtp_sinkpad =
       gst_pad_new_from_static_template (&rtp_sink_template, "rtp_sink");
@@ -404,7 +423,6 @@ gst_srtp_dec_init (GstSrtpDec * filter)
   gst_element_add_pad (GST_ELEMENT (filter), filter->rtcp_sinkpad);
   gst_element_add_pad (GST_ELEMENT (filter), filter->rtcp_srcpad);
 
-  filter->first_session = TRUE;
   filter->roc_changed = FALSE;
 }
 
@@ -420,6 +438,9 @@ gst_srtp_dec_set_property (GObject * object, guint prop_id,
     case PROP_REPLAY_WINDOW_SIZE:
       filter->replay_window_size = g_value_get_uint (value);
       break;
+    case PROP_SHARDS:
+      filter->shards = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -440,6 +461,9 @@ gst_srtp_dec_get_property (GObject * object, guint prop_id,
     case PROP_REPLAY_WINDOW_SIZE:
       g_value_set_uint (value, filter->replay_window_size);
       break;
+    case PROP_SHARDS:
+      g_value_set_uint (value, filter->shards);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -448,6 +472,13 @@ gst_srtp_dec_get_property (GObject * object, guint prop_id,
   GST_OBJECT_UNLOCK (filter);
 }
 
+/* Called with the object lock held */
+static srtp_t *
+get_session_for_ssrc (GstSrtpDec * filter, guint32 ssrc)
+{
+  return &filter->sessions[gst_srtp_get_shard (ssrc, filter->n_sessions)];
+}
+
 static void
 gst_srtp_dec_remove_stream (GstSrtpDec * filter, guint ssrc)
 {
@@ -459,7 +490,10 @@ gst_srtp_dec_remove_stream (GstSrtpDec * filter, guint ssrc)
   stream = g_hash_table_lookup (filter->streams, GUINT_TO_POINTER (ssrc));
 
   if (stream) {
-    srtp_remove_stream (filter->session, ssrc);
+    srtp_t session = *get_session_for_ssrc (filter, ssrc);
+
+    if (session)
+      srtp_remove_stream (session, ssrc);
     g_hash_table_remove (filter->streams, GUINT_TO_POINTER (ssrc));
   }
 }
@@ -558,6 +592,7 @@ init_session_stream (GstSrtpDec * filter, guint32 ssrc,
 {
   err_status_t ret;
   srtp_policy_t policy;
+  srtp_t *session;
   GstMapInfo map;
   guchar tmp[1];
 
@@ -566,6 +601,8 @@ init_session_stream (GstSrtpDec * filter, guint32 ssrc,
   if (!stream)
     return err_status_bad_param;
 
+  session = get_session_for_ssrc (filter, ssrc);
+
   GST_INFO_OBJECT (filter, "Setting RTP policy...");
   set_crypto_policy_cipher_auth (stream->rtp_cipher, stream->rtp_auth,
       &policy.rtp);
@@ -588,10 +625,10 @@ init_session_stream (GstSrtpDec * filter, guint32 ssrc,
   /* If it is the first stream, create the session
    * If not, add the stream policy to the session
    */
-  if (filter->first_session)
-    ret = srtp_create (&filter->session, &policy);
+  if (!*session)
+    ret = srtp_create (session, &policy);
   else
-    ret = srtp_add_stream (filter->session, &policy);
+    ret = srtp_add_stream (*session, &policy);
 
   if (stream->key)
     gst_buffer_unmap (stream->key, &map);
@@ -599,7 +636,7 @@ init_session_stream (GstSrtpDec * filter, guint32 ssrc,
   if (ret == err_status_ok) {
     srtp_stream_t srtp_stream;
 
-    srtp_stream = srtp_get_stream (filter->session, htonl (ssrc));
+    srtp_stream = srtp_get_stream (*session, htonl (ssrc));
     if (srtp_stream) {
       /* Here, we just set the ROC, but we also need to set the initial
        * RTP sequence number later, otherwise libsrtp will not be able
@@ -608,7 +645,6 @@ init_session_stream (GstSrtpDec * filter, guint32 ssrc,
       filter->roc_changed = TRUE;
     }
 
-    filter->first_session = FALSE;
     g_hash_table_insert (filter->streams, GUINT_TO_POINTER (stream->ssrc),
         stream);
   }
@@ -732,17 +768,20 @@ static void
 gst_srtp_dec_clear_streams (GstSrtpDec * filter)
 {
   guint nb = 0;
+  guint i;
 
   GST_OBJECT_LOCK (filter);
 
-  if (!filter->first_session)
-    srtp_dealloc (filter->session);
+  for (i = 0; i < GST_SRTP_MAX_SHARDS; i++) {
+    if (filter->sessions[i]) {
+      srtp_dealloc (filter->sessions[i]);
+      filter->sessions[i] = NULL;
+    }
+  }
 
   if (filter->streams)
     nb = g_hash_table_foreach_remove (filter->streams, remove_yes, NULL);
 
-  filter->first_session = TRUE;
-
   GST_OBJECT_UNLOCK (filter);
 
   GST_DEBUG_OBJECT (filter, "Cleared %d streams", nb);
@@ -1096,6 +1135,7 @@ gst_srtp_dec_decode_buffer (GstSrtpDec * filter, GstPad * pad, GstBuffer * buf,
   GstMapInfo map;
   err_status_t err;
   gint size;
+  srtp_t session;
 
   GST_LOG_OBJECT (pad, "Received %s buffer of size %" G_GSIZE_FORMAT
       " with SSRC = %u", is_rtcp ? "RTCP" : "RTP", gst_buffer_get_size (buf),
@@ -1111,15 +1151,18 @@ unprotect:
 
   gst_srtp_init_event_reporter ();
 
+  /* the stream may have been updated while the lock was released */
+  session = *get_session_for_ssrc (filter, ssrc);
+
   if (is_rtcp)
-    err = srtp_unprotect_rtcp (filter->session, map.data, &size);
+    err = srtp_unprotect_rtcp (session, map.data, &size);
   else {
     /* If ROC has changed, we know we need to set the initial RTP
      * sequence number too. */
     if (filter->roc_changed) {
       srtp_stream_t stream;
 
-      stream = srtp_get_stream (filter->session, htonl (ssrc));
+      stream = srtp_get_stream (session, htonl (ssrc));
 
       if (stream) {
         guint16 seqnum = 0;
@@ -1138,7 +1181,7 @@ unprotect:
 
       filter->roc_changed = FALSE;
     }
-    err = srtp_unprotect (filter->session, map.data, &size);
+    err = srtp_unprotect (session, map.data, &size);
   }
 
   GST_OBJECT_UNLOCK (filter);
@@ -1280,6 +1323,7 @@ gst_srtp_dec_change_state (GstElement * element, GstStateChange transition)
           NULL, (GDestroyNotify) free_stream);
       filter->rtp_has_segment = FALSE;
       filter->rtcp_has_segment = FALSE;
+      filter->n_sessions = filter->shards;
       break;
     case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
       break;
@@ -50,6 +50,8 @@
 #include <gst/gst.h>
 #include <srtp/srtp.h>
 
+#include "gstsrtp.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_SRTP_DEC \
@@ -77,8 +79,11 @@ struct _GstSrtpDec
   GstPad *rtcp_sinkpad, *rtcp_srcpad;
 
   gboolean ask_update;
-  srtp_t session;
-  gboolean first_session;
+  /* SSRCs are spread over n_sessions independent sessions, created with
+   * their first stream */
+  srtp_t sessions[GST_SRTP_MAX_SHARDS];
+  guint n_sessions;
+  guint shards;
   GHashTable *streams;
 
   gboolean rtp_has_segment;
@@ -135,6 +135,13 @@ GST_DEBUG_CATEGORY_STATIC (gst_srtp_enc_debug);
 #define DEFAULT_RANDOM_KEY      FALSE
 #define DEFAULT_REPLAY_WINDOW_SIZE 128
 #define DEFAULT_ALLOW_REPEAT_TX FALSE
+#define DEFAULT_SHARDS          1
+
+/* Room needed after the packet for the SRTP trailer */
+#define TRAILER_ROOM (SRTP_MAX_TRAILER_LEN + 10)
+
+/* Packets up to the Ethernet MTU are protected into pooled buffers */
+#define POOL_BUFFER_SIZE (1500 + TRAILER_ROOM)
 
 #define HAS_CRYPTO(filter) (filter->rtp_cipher != GST_SRTP_CIPHER_NULL || \
       filter->rtcp_cipher != GST_SRTP_CIPHER_NULL ||                      \
@@ -159,17 +166,42 @@ enum
   PROP_RTCP_AUTH,
   PROP_RANDOM_KEY,
   PROP_REPLAY_WINDOW_SIZE,
-  PROP_ALLOW_REPEAT_TX
+  PROP_ALLOW_REPEAT_TX,
+  PROP_SHARDS
 };
 
 typedef struct ProcessBufferItData
 {
   GstSrtpEnc *filter;
   GstPad *pad;
-  GstBufferList *out_list;
   gboolean is_rtcp;
+  err_status_t err;
 } ProcessBufferItData;
 
+/* A buffer list being protected by the workers, one shard each */
+typedef struct ProcessListData
+{
+  GstSrtpEnc *filter;
+  GstPad *pad;
+  gboolean is_rtcp;
+
+  GstBuffer **buffers;
+  guint *shards;
+  guint n_buffers;
+
+  GMutex lock;
+  GCond cond;
+  guint pending;
+  err_status_t err;
+  gboolean soft_limit_reached;
+} ProcessListData;
+
+typedef struct ProcessShardTask
+{
+  ProcessListData *data;
+  guint shard;
+} ProcessShardTask;
+
 /* the capabilities of the inputs and outputs.
  *
  * describe the real formats here.
@@ -245,6 +277,9 @@ static GstPad *gst_srtp_enc_request_new_pad (GstElement * element,
 
 static void gst_srtp_enc_release_pad (GstElement * element, GstPad * pad);
 
+static void gst_srtp_enc_process_shard (gpointer task_data,
+    gpointer user_data);
+
 
 static guint32
 gst_srtp_enc_get_rollover_counter (GstSrtpEnc * filter, guint32 ssrc)
@@ -256,8 +291,9 @@ gst_srtp_enc_get_rollover_counter (GstSrtpEnc * filter, guint32 ssrc)
 
   GST_DEBUG_OBJECT (filter, "retrieving SRTP Rollover Counter, ssrc: %u", ssrc);
 
-  if (filter->session) {
-    stream = srtp_get_stream (filter->session, htonl (ssrc));
+  if (!filter->first_session) {
+    stream = srtp_get_stream (filter->sessions[gst_srtp_get_shard (ssrc,
+                filter->n_sessions)], htonl (ssrc));
     if (stream)
       roc = stream->rtp_rdbx.index >> 16;
   }
@@ -343,6 +379,23 @@ gst_srtp_enc_class_init (GstSrtpEncClass * klass)
           "or a severe security weakness is introduced!)",
           DEFAULT_ALLOW_REPEAT_TX, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstSrtpEnc:shards:
+   *
+   * Number of independent libsrtp sessions the SSRCs are spread over. With
+   * more than one, the packets of a buffer list are protected in parallel,
+   * one thread per session, keeping the order of the packets of each SSRC.
+   * Takes effect the next time the session is created.
+   *
+   * Since: 1.8
+   */
+  g_object_class_install_property (gobject_class, PROP_SHARDS,
+      g_param_spec_uint ("shards", "Shards",
+          "Number of libsrtp sessions the SSRCs are spread over",
+          1, GST_SRTP_MAX_SHARDS, DEFAULT_SHARDS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
   /**
    * GstSrtpEnc::soft-limit:
    * @gstsrtpenc: the element on which the signal is emitted
@@ -387,6 +440,8 @@ gst_srtp_enc_init (GstSrtpEnc * filter)
   filter->rtcp_auth = DEFAULT_RTCP_AUTH;
   filter->replay_window_size = DEFAULT_REPLAY_WINDOW_SIZE;
   filter->allow_repeat_tx = DEFAULT_ALLOW_REPEAT_TX;
+  filter->shards = DEFAULT_SHARDS;
+  filter->n_sessions = 1;
 }
 
 static guint
@@ -411,6 +466,7 @@ gst_srtp_enc_create_session (GstSrtpEnc * filter)
   srtp_policy_t policy;
   GstMapInfo map;
   guchar tmp[1];
+  guint i;
 
   memset (&policy, 0, sizeof (srtp_policy_t));
 
@@ -458,15 +514,39 @@ gst_srtp_enc_create_session (GstSrtpEnc * filter)
   policy.window_size = filter->replay_window_size;
   policy.allow_repeat_tx = filter->allow_repeat_tx;
 
-  /* If it is the first stream, create the session
-   * If not, add the stream to the session
+  /* Every session gets the same policy, the stream of an SSRC is created
+   * in its session the first time the SSRC is seen
    */
-  ret = srtp_create (&filter->session, &policy);
-  filter->first_session = FALSE;
+  for (i = 0; i < filter->shards; i++) {
+    ret = srtp_create (&filter->sessions[i], &policy);
+    if (ret != err_status_ok) {
+      while (i--)
+        srtp_dealloc (filter->sessions[i]);
+      break;
+    }
+  }
 
   if (HAS_CRYPTO (filter))
     gst_buffer_unmap (filter->key, &map);
 
+  if (ret != err_status_ok)
+    return ret;
+
+  filter->n_sessions = filter->shards;
+  filter->first_session = FALSE;
+
+  GST_DEBUG_OBJECT (filter, "Created %u sessions", filter->n_sessions);
+
+  if (filter->n_sessions > 1) {
+    /* the streaming thread protects one of the shards itself */
+    if (!filter->workers)
+      filter->workers = g_thread_pool_new (gst_srtp_enc_process_shard, NULL,
+          filter->n_sessions - 1, FALSE, NULL);
+    else
+      g_thread_pool_set_max_threads (filter->workers, filter->n_sessions - 1,
+          NULL);
+  }
+
   return ret;
 }
 
@@ -475,8 +555,12 @@ gst_srtp_enc_create_session (GstSrtpEnc * filter)
 static void
 gst_srtp_enc_reset_no_lock (GstSrtpEnc * filter)
 {
-  if (!filter->first_session)
-    srtp_dealloc (filter->session);
+  guint i;
+
+  if (!filter->first_session) {
+    for (i = 0; i < filter->n_sessions; i++)
+      srtp_dealloc (filter->sessions[i]);
+  }
 
   filter->first_session = TRUE;
   filter->key_changed = FALSE;
@@ -683,6 +767,10 @@ gst_srtp_enc_set_property (GObject * object, guint prop_id,
       filter->allow_repeat_tx = g_value_get_boolean (value);
       break;
 
+    case PROP_SHARDS:
+      filter->shards = g_value_get_uint (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -724,6 +812,9 @@ gst_srtp_enc_get_property (GObject * object, guint prop_id,
     case PROP_ALLOW_REPEAT_TX:
       g_value_set_boolean (value, filter->allow_repeat_tx);
       break;
+    case PROP_SHARDS:
+      g_value_set_uint (value, filter->shards);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1006,64 +1097,136 @@ gst_srtp_enc_check_set_caps (GstSrtpEnc * filter, GstPad * pad,
   return GST_FLOW_OK;
 }
 
+/* libsrtp writes the trailer right after the packet, which must be 32 bits
+ * aligned. Only checks what can be known without mapping @buf */
+static gboolean
+gst_srtp_enc_can_protect_in_place (GstBuffer * buf)
+{
+  gsize size, offset, maxsize;
+
+  if (gst_buffer_n_memory (buf) != 1 || !gst_buffer_is_writable (buf) ||
+      !gst_memory_is_writable (gst_buffer_peek_memory (buf, 0)))
+    return FALSE;
+
+  size = gst_buffer_get_sizes (buf, &offset, &maxsize);
+
+  return maxsize - offset - size >= TRAILER_ROOM;
+}
+
+/* Get the session of the SSRC libsrtp will look the stream of @buf up
+ * with. Packets too short to have one are rejected by libsrtp anyway.
+ *
+ * Called with the object lock held */
+static guint
+gst_srtp_enc_get_shard (GstSrtpEnc * filter, GstBuffer * buf,
+    gboolean is_rtcp)
+{
+  guint8 ssrc[4];
+
+  if (filter->n_sessions == 1)
+    return 0;
+
+  if (gst_buffer_extract (buf, is_rtcp ? 4 : 8, ssrc, 4) != 4)
+    return 0;
+
+  return gst_srtp_get_shard (GST_READ_UINT32_BE (ssrc), filter->n_sessions);
+}
+
+/* Called with the object lock held, by the streaming thread or by a worker
+ * while the streaming thread waits for it. Takes ownership of @buf and
+ * returns the protected buffer, which is @buf itself if it could be
+ * protected in place. On failure, returns NULL and sets @err; the error has
+ * to be posted once the lock is released */
 static GstBuffer *
 gst_srtp_enc_process_buffer (GstSrtpEnc * filter, GstPad * pad,
-    GstBuffer * buf, gboolean is_rtcp)
+    srtp_t session, GstBuffer * buf, gboolean is_rtcp, err_status_t * err)
 {
-  gint size_max, size;
+  gint size;
   GstBuffer *bufout = NULL;
   GstMapInfo mapout;
-  err_status_t err;
 
-  /* Create a bigger buffer to add protection */
   size = gst_buffer_get_size (buf);
-  size_max = size + SRTP_MAX_TRAILER_LEN + 10;
-  bufout = gst_buffer_new_allocate (NULL, size_max, NULL);
 
-  gst_buffer_map (bufout, &mapout, GST_MAP_READWRITE);
+  if (gst_srtp_enc_can_protect_in_place (buf)) {
+    gst_buffer_set_size (buf, size + TRAILER_ROOM);
+    gst_buffer_map (buf, &mapout, GST_MAP_READWRITE);
 
-  gst_buffer_extract (buf, 0, mapout.data, size);
+    if (((guintptr) mapout.data & 3) == 0) {
+      bufout = buf;
+      buf = NULL;
+    } else {
+      gst_buffer_unmap (buf, &mapout);
+      gst_buffer_set_size (buf, size);
+    }
+  }
 
-  GST_OBJECT_LOCK (filter);
+  if (!bufout) {
+    /* Create a bigger buffer to add protection */
+    if (filter->pool && size + TRAILER_ROOM <= POOL_BUFFER_SIZE)
+      gst_buffer_pool_acquire_buffer (filter->pool, &bufout, NULL);
+    if (!bufout)
+      bufout = gst_buffer_new_allocate (NULL, size + TRAILER_ROOM, NULL);
 
-  gst_srtp_init_event_reporter ();
+    gst_buffer_map (bufout, &mapout, GST_MAP_READWRITE);
+    gst_buffer_extract (buf, 0, mapout.data, size);
+  }
 
   if (is_rtcp)
-    err = srtp_protect_rtcp (filter->session, mapout.data, &size);
+    *err = srtp_protect_rtcp (session, mapout.data, &size);
   else
-    err = srtp_protect (filter->session, mapout.data, &size);
-
-  GST_OBJECT_UNLOCK (filter);
+    *err = srtp_protect (session, mapout.data, &size);
 
   gst_buffer_unmap (bufout, &mapout);
 
-  if (err == err_status_ok) {
-    /* Buffer protected */
-    gst_buffer_set_size (bufout, size);
-    gst_buffer_copy_into (bufout, buf, GST_BUFFER_COPY_METADATA, 0, -1);
+  if (*err != err_status_ok) {
+    GST_WARNING_OBJECT (pad, "Unable to protect buffer (code %d)", *err);
+    gst_buffer_unref (bufout);
+    if (buf)
+      gst_buffer_unref (buf);
+    return NULL;
+  }
 
-    GST_LOG_OBJECT (pad, "Encoding %s buffer of size %d",
-        is_rtcp ? "RTCP" : "RTP", size);
+  /* Buffer protected */
+  GST_LOG_OBJECT (pad, "Encoding %s buffer of size %d%s",
+      is_rtcp ? "RTCP" : "RTP", size, buf ? "" : " in place");
 
-  } else if (err == err_status_key_expired) {
+  gst_buffer_set_size (bufout, size);
+  if (buf) {
+    gst_buffer_copy_into (bufout, buf, GST_BUFFER_COPY_METADATA, 0, -1);
+    gst_buffer_unref (buf);
+  }
 
+  return bufout;
+}
+
+static void
+gst_srtp_enc_post_protect_error (GstSrtpEnc * filter, err_status_t err)
+{
+  if (err == err_status_key_expired) {
     GST_ELEMENT_ERROR (GST_ELEMENT_CAST (filter), STREAM, ENCODE,
         ("Key usage limit has been reached"),
         ("Unable to protect buffer (hard key usage limit reached)"));
-    goto fail;
-
   } else {
     /* srtp_protect failed */
     GST_ELEMENT_ERROR (filter, LIBRARY, FAILED, (NULL),
         ("Unable to protect buffer (protect failed) code %d", err));
-    goto fail;
   }
+}
 
-  return bufout;
+static void
+gst_srtp_enc_check_soft_limit (GstSrtpEnc * filter, gboolean reached)
+{
+  GST_OBJECT_LOCK (filter);
 
-fail:
-  gst_buffer_unref (bufout);
-  return NULL;
+  if (reached) {
+    GST_OBJECT_UNLOCK (filter);
+    g_signal_emit (filter, gst_srtp_enc_signals[SIGNAL_SOFT_LIMIT], 0);
+    GST_OBJECT_LOCK (filter);
+    if (filter->random_key && !filter->key_changed)
+      gst_srtp_enc_replace_random_key (filter);
+  }
+
+  GST_OBJECT_UNLOCK (filter);
 }
 
 static GstFlowReturn
@@ -1074,73 +1237,191 @@ gst_srtp_enc_chain (GstPad * pad, GstObject * parent, GstBuffer * buf,
   GstFlowReturn ret = GST_FLOW_OK;
   GstPad *otherpad;
   GstBuffer *bufout = NULL;
+  err_status_t err;
+  gboolean soft_limit_reached;
 
   if ((ret = gst_srtp_enc_check_set_caps (filter, pad, is_rtcp)) != GST_FLOW_OK) {
-    goto out;
+    gst_buffer_unref (buf);
+    return ret;
   }
 
+  otherpad = get_rtp_other_pad (pad);
+
   GST_OBJECT_LOCK (filter);
 
   if (!HAS_CRYPTO (filter)) {
     GST_OBJECT_UNLOCK (filter);
-    otherpad = get_rtp_other_pad (pad);
     return gst_pad_push (otherpad, buf);
   }
 
-  GST_OBJECT_UNLOCK (filter);
-
-  if ((bufout = gst_srtp_enc_process_buffer (filter, pad, buf, is_rtcp))) {
-    /* Push buffer to source pad */
-    otherpad = get_rtp_other_pad (pad);
-    ret = gst_pad_push (otherpad, bufout);
-    bufout = NULL;
-
-    if (ret != GST_FLOW_OK)
-      goto out;
-  } else {
-    goto fail;
-  }
+  gst_srtp_init_event_reporter ();
+  bufout = gst_srtp_enc_process_buffer (filter, pad,
+      filter->sessions[gst_srtp_enc_get_shard (filter, buf, is_rtcp)], buf,
+      is_rtcp, &err);
+  soft_limit_reached = gst_srtp_get_soft_limit_reached ();
 
-  GST_OBJECT_LOCK (filter);
+  GST_OBJECT_UNLOCK (filter);
 
-  if (gst_srtp_get_soft_limit_reached ()) {
-    GST_OBJECT_UNLOCK (filter);
-    g_signal_emit (filter, gst_srtp_enc_signals[SIGNAL_SOFT_LIMIT], 0);
-    GST_OBJECT_LOCK (filter);
-    if (filter->random_key && !filter->key_changed)
-      gst_srtp_enc_replace_random_key (filter);
+  if (!bufout) {
+    gst_srtp_enc_post_protect_error (filter, err);
+    return GST_FLOW_ERROR;
   }
 
-  GST_OBJECT_UNLOCK (filter);
-
-out:
+  /* Push buffer to source pad */
+  ret = gst_pad_push (otherpad, bufout);
 
-  gst_buffer_unref (buf);
+  if (ret == GST_FLOW_OK)
+    gst_srtp_enc_check_soft_limit (filter, soft_limit_reached);
 
   return ret;
-
-fail:
-  ret = GST_FLOW_ERROR;
-  goto out;
 }
 
 static gboolean
 process_buffer_it (GstBuffer ** buffer, guint index, gpointer user_data)
 {
   ProcessBufferItData *data = user_data;
-  GstBuffer *bufout;
+  err_status_t err;
 
-  if ((bufout =
-          gst_srtp_enc_process_buffer (data->filter, data->pad, *buffer,
-              data->is_rtcp))) {
-    gst_buffer_list_add (data->out_list, bufout);
-  } else {
+  /* replaces the buffer in the list, or removes it on failure */
+  *buffer = gst_srtp_enc_process_buffer (data->filter, data->pad,
+      data->filter->sessions[0], *buffer, data->is_rtcp, &err);
+
+  if (!*buffer) {
     GST_WARNING_OBJECT (data->filter, "Error encoding buffer, dropping");
+    if (data->err == err_status_ok)
+      data->err = err;
   }
 
   return TRUE;
 }
 
+static gboolean
+steal_buffer_it (GstBuffer ** buffer, guint index, gpointer user_data)
+{
+  ProcessListData *data = user_data;
+
+  /* the list is emptied, @index does not move */
+  data->buffers[data->n_buffers++] = *buffer;
+  *buffer = NULL;
+
+  return TRUE;
+}
+
+/* Protects the buffers of one shard, in order */
+static void
+gst_srtp_enc_process_shard (gpointer task_data, gpointer user_data)
+{
+  ProcessShardTask *task = task_data;
+  ProcessListData *data = task->data;
+  srtp_t session = data->filter->sessions[task->shard];
+  err_status_t err, first_err = err_status_ok;
+  gboolean soft_limit_reached;
+  guint i;
+
+  gst_srtp_init_event_reporter ();
+
+  for (i = 0; i < data->n_buffers; i++) {
+    if (data->shards[i] != task->shard)
+      continue;
+
+    data->buffers[i] = gst_srtp_enc_process_buffer (data->filter, data->pad,
+        session, data->buffers[i], data->is_rtcp, &err);
+    if (!data->buffers[i] && first_err == err_status_ok)
+      first_err = err;
+  }
+
+  soft_limit_reached = gst_srtp_get_soft_limit_reached ();
+
+  g_mutex_lock (&data->lock);
+  if (data->err == err_status_ok)
+    data->err = first_err;
+  data->soft_limit_reached |= soft_limit_reached;
+  if (--data->pending == 0)
+    g_cond_signal (&data->cond);
+  g_mutex_unlock (&data->lock);
+}
+
+/* Spreads the buffers of @buf_list over the workers by shard, and puts the
+ * protected ones back in the list in their original order. Each shard is
+ * protected by a single thread, so the packets of an SSRC are protected in
+ * order.
+ *
+ * Called with the object lock held */
+static void
+gst_srtp_enc_process_list_sharded (GstSrtpEnc * filter, GstPad * pad,
+    GstBufferList * buf_list, gboolean is_rtcp, err_status_t * err,
+    gboolean * soft_limit_reached)
+{
+  ProcessListData data;
+  ProcessShardTask tasks[GST_SRTP_MAX_SHARDS];
+  guint counts[GST_SRTP_MAX_SHARDS] = { 0, };
+  ProcessShardTask *own_task = NULL;
+  guint i, len;
+
+  len = gst_buffer_list_length (buf_list);
+
+  data.filter = filter;
+  data.pad = pad;
+  data.is_rtcp = is_rtcp;
+  data.buffers = g_new (GstBuffer *, len);
+  data.shards = g_new (guint, len);
+  data.n_buffers = 0;
+  data.pending = 0;
+  data.err = err_status_ok;
+  data.soft_limit_reached = FALSE;
+  g_mutex_init (&data.lock);
+  g_cond_init (&data.cond);
+
+  gst_buffer_list_foreach (buf_list, steal_buffer_it, &data);
+
+  for (i = 0; i < data.n_buffers; i++) {
+    data.shards[i] = gst_srtp_enc_get_shard (filter, data.buffers[i], is_rtcp);
+    counts[data.shards[i]]++;
+  }
+
+  /* all tasks are counted before any can complete */
+  for (i = 0; i < filter->n_sessions; i++) {
+    if (counts[i] > 0)
+      data.pending++;
+  }
+
+  for (i = 0; i < filter->n_sessions; i++) {
+    if (counts[i] == 0)
+      continue;
+
+    tasks[i].data = &data;
+    tasks[i].shard = i;
+
+    if (!own_task)
+      own_task = &tasks[i];
+    else
+      g_thread_pool_push (filter->workers, &tasks[i], NULL);
+  }
+
+  if (own_task)
+    gst_srtp_enc_process_shard (own_task, NULL);
+
+  g_mutex_lock (&data.lock);
+  while (data.pending > 0)
+    g_cond_wait (&data.cond, &data.lock);
+  g_mutex_unlock (&data.lock);
+
+  for (i = 0; i < data.n_buffers; i++) {
+    if (data.buffers[i])
+      gst_buffer_list_add (buf_list, data.buffers[i]);
+    else
+      GST_WARNING_OBJECT (filter, "Error encoding buffer, dropping");
+  }
+
+  *err = data.err;
+  *soft_limit_reached = data.soft_limit_reached;
+
+  g_mutex_clear (&data.lock);
+  g_cond_clear (&data.cond);
+  g_free (data.buffers);
+  g_free (data.shards);
+}
+
 static GstFlowReturn
 gst_srtp_enc_chain_list (GstPad * pad, GstObject * parent,
     GstBufferList * buf_list, gboolean is_rtcp)
@@ -1148,8 +1429,8 @@ gst_srtp_enc_chain_list (GstPad * pad, GstObject * parent,
   GstSrtpEnc *filter = GST_SRTP_ENC (parent);
   GstFlowReturn ret = GST_FLOW_OK;
   GstPad *otherpad;
-  GstBufferList *out_list = NULL;
-  ProcessBufferItData process_data;
+  err_status_t err;
+  gboolean soft_limit_reached;
 
   GST_LOG_OBJECT (pad, "Buffer chain with list of %d",
       gst_buffer_list_length (buf_list));
@@ -1160,52 +1441,56 @@ gst_srtp_enc_chain_list (GstPad * pad, GstObject * parent,
   if ((ret = gst_srtp_enc_check_set_caps (filter, pad, is_rtcp)) != GST_FLOW_OK)
     goto out;
 
+  otherpad = get_rtp_other_pad (pad);
+
   GST_OBJECT_LOCK (filter);
 
   if (!HAS_CRYPTO (filter)) {
     GST_OBJECT_UNLOCK (filter);
-    otherpad = get_rtp_other_pad (pad);
     return gst_pad_push_list (otherpad, buf_list);
   }
 
-  GST_OBJECT_UNLOCK (filter);
+  /* The packets are protected in the list itself, in place when they are
+   * not shared, and the lock is only taken once for the whole list */
+  buf_list = gst_buffer_list_make_writable (buf_list);
 
-  out_list = gst_buffer_list_new ();
+  if (filter->n_sessions > 1 && filter->workers) {
+    gst_srtp_enc_process_list_sharded (filter, pad, buf_list, is_rtcp, &err,
+        &soft_limit_reached);
+  } else {
+    ProcessBufferItData process_data;
+
+    process_data.filter = filter;
+    process_data.pad = pad;
+    process_data.is_rtcp = is_rtcp;
+    process_data.err = err_status_ok;
+
+    gst_srtp_init_event_reporter ();
+    gst_buffer_list_foreach (buf_list, process_buffer_it, &process_data);
 
-  process_data.filter = filter;
-  process_data.pad = pad;
-  process_data.is_rtcp = is_rtcp;
-  process_data.out_list = out_list;
+    err = process_data.err;
+    soft_limit_reached = gst_srtp_get_soft_limit_reached ();
+  }
+
+  GST_OBJECT_UNLOCK (filter);
 
-  gst_buffer_list_foreach (buf_list, process_buffer_it, &process_data);
+  if (err != err_status_ok)
+    gst_srtp_enc_post_protect_error (filter, err);
 
-  if (!gst_buffer_list_length (out_list)) {
-    gst_buffer_list_unref (out_list);
+  if (!gst_buffer_list_length (buf_list)) {
     ret = GST_FLOW_OK;
     goto out;
   }
 
   /* Push buffer to source pad */
-  otherpad = get_rtp_other_pad (pad);
   GST_LOG_OBJECT (pad, "Pushing buffer chain of %d",
       gst_buffer_list_length (buf_list));
-  ret = gst_pad_push_list (otherpad, out_list);
-
-  if (ret != GST_FLOW_OK) {
-    goto out;
-  }
-
-  GST_OBJECT_LOCK (filter);
+  ret = gst_pad_push_list (otherpad, buf_list);
 
-  if (gst_srtp_get_soft_limit_reached ()) {
-    GST_OBJECT_UNLOCK (filter);
-    g_signal_emit (filter, gst_srtp_enc_signals[SIGNAL_SOFT_LIMIT], 0);
-    GST_OBJECT_LOCK (filter);
-    if (filter->random_key && !filter->key_changed)
-      gst_srtp_enc_replace_random_key (filter);
-  }
+  if (ret == GST_FLOW_OK)
+    gst_srtp_enc_check_soft_limit (filter, soft_limit_reached);
 
-  GST_OBJECT_UNLOCK (filter);
+  return ret;
 
 out:
 
@@ -1277,8 +1562,20 @@ gst_srtp_enc_change_state (GstElement * element, GstStateChange transition)
         gst_srtp_enc_reset_no_lock (filter);
       GST_OBJECT_UNLOCK (filter);
       break;
-    case GST_STATE_CHANGE_READY_TO_PAUSED:
+    case GST_STATE_CHANGE_READY_TO_PAUSED:{
+      GstBufferPool *pool = gst_buffer_pool_new ();
+      GstStructure *config = gst_buffer_pool_get_config (pool);
+
+      gst_buffer_pool_config_set_params (config, NULL, POOL_BUFFER_SIZE, 0,
+          0);
+      gst_buffer_pool_set_config (pool, config);
+      gst_buffer_pool_set_active (pool, TRUE);
+
+      GST_OBJECT_LOCK (filter);
+      filter->pool = pool;
+      GST_OBJECT_UNLOCK (filter);
       break;
+    }
     case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
       break;
     default:
@@ -1291,9 +1588,28 @@ gst_srtp_enc_change_state (GstElement * element, GstStateChange transition)
   switch (transition) {
     case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
       break;
-    case GST_STATE_CHANGE_PAUSED_TO_READY:
+    case GST_STATE_CHANGE_PAUSED_TO_READY:{
+      GstBufferPool *pool;
+
       gst_srtp_enc_reset (filter);
+
+      GST_OBJECT_LOCK (filter);
+      pool = filter->pool;
+      filter->pool = NULL;
+      GST_OBJECT_UNLOCK (filter);
+
+      if (pool) {
+        gst_buffer_pool_set_active (pool, FALSE);
+        gst_object_unref (pool);
+      }
+
+      /* the streaming threads are stopped, no task is running */
+      if (filter->workers) {
+        g_thread_pool_free (filter->workers, FALSE, TRUE);
+        filter->workers = NULL;
+      }
       break;
+    }
     case GST_STATE_CHANGE_READY_TO_NULL:
       break;
     default:
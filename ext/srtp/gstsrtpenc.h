@@ -50,6 +50,8 @@
 #include <gst/gst.h>
 #include <srtp/srtp.h>
 
+#include "gstsrtp.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_SRTP_ENC \
@@ -78,12 +80,21 @@ struct _GstSrtpEnc
   guint rtcp_cipher;
   guint rtcp_auth;
 
-  srtp_t session;
+  /* SSRCs are spread over n_sessions independent sessions */
+  srtp_t sessions[GST_SRTP_MAX_SHARDS];
+  guint n_sessions;
   gboolean first_session;
   gboolean key_changed;
 
   guint replay_window_size;
   gboolean allow_repeat_tx;
+  guint shards;
+
+  /* protect the shards of a buffer list in parallel */
+  GThreadPool *workers;
+
+  /* output buffers for packets that can't be protected in place */
+  GstBufferPool *pool;
 };
 
 struct _GstSrtpEncClass
@@ -88,6 +88,7 @@ GST_DEBUG_CATEGORY (adaptivedemux_debug);
 #define DEFAULT_LOOKBACK_FRAGMENTS 3
 #define DEFAULT_CONNECTION_SPEED 0
 #define DEFAULT_BITRATE_LIMIT 0.8
+#define DEFAULT_ABR_ALGORITHM GST_ADAPTIVE_DEMUX_ABR_AVERAGE
 
 enum
 {
@@ -95,6 +96,7 @@ enum
   PROP_LOOKBACK_FRAGMENTS,
   PROP_CONNECTION_SPEED,
   PROP_BITRATE_LIMIT,
+  PROP_ABR_ALGORITHM,
   PROP_LAST
 };
 
@@ -241,6 +243,9 @@ gst_adaptive_demux_set_property (GObject * object, guint prop_id,
     case PROP_BITRATE_LIMIT:
       demux->bitrate_limit = g_value_get_float (value);
       break;
+    case PROP_ABR_ALGORITHM:
+      demux->abr_algorithm = g_value_get_enum (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -263,6 +268,9 @@ gst_adaptive_demux_get_property (GObject * object, guint prop_id,
     case PROP_BITRATE_LIMIT:
       g_value_set_float (value, demux->bitrate_limit);
       break;
+    case PROP_ABR_ALGORITHM:
+      g_value_set_enum (value, demux->abr_algorithm);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -311,6 +319,13 @@ gst_adaptive_demux_class_init (GstAdaptiveDemuxClass * klass)
           0, 1, DEFAULT_BITRATE_LIMIT,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /* Only applies to streams created after it is set */
+  g_object_class_install_property (gobject_class, PROP_ABR_ALGORITHM,
+      g_param_spec_enum ("abr-algorithm", "ABR algorithm",
+          "Algorithm used to select the bitrate of the next fragments",
+          GST_TYPE_ADAPTIVE_DEMUX_ABR_ALGORITHM, DEFAULT_ABR_ALGORITHM,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gstelement_class->change_state = gst_adaptive_demux_change_state;
 
   gstbin_class->handle_message = gst_adaptive_demux_handle_message;
@@ -365,6 +380,7 @@ gst_adaptive_demux_init (GstAdaptiveDemux * demux,
   demux->num_lookback_fragments = DEFAULT_LOOKBACK_FRAGMENTS;
   demux->bitrate_limit = DEFAULT_BITRATE_LIMIT;
   demux->connection_speed = DEFAULT_CONNECTION_SPEED;
+  demux->abr_algorithm = DEFAULT_ABR_ALGORITHM;
 
   gst_element_add_pad (GST_ELEMENT (demux), demux->sinkpad);
 }
@@ -950,8 +966,8 @@ gst_adaptive_demux_stream_new (GstAdaptiveDemux * demux, GstPad * pad)
 
   stream->pad = pad;
   stream->demux = demux;
-  stream->fragment_bitrates =
-      g_malloc0 (sizeof (guint64) * demux->num_lookback_fragments);
+  stream->abr = gst_adaptive_demux_abr_new (demux->abr_algorithm,
+      demux->num_lookback_fragments);
   gst_pad_set_element_private (pad, stream);
 
   gst_pad_set_query_function (pad,
@@ -1021,7 +1037,7 @@ gst_adaptive_demux_stream_free (GstAdaptiveDemuxStream * stream)
   g_cond_clear (&stream->fragment_download_cond);
   g_mutex_clear (&stream->fragment_download_lock);
 
-  g_free (stream->fragment_bitrates);
+  gst_adaptive_demux_abr_free (stream->abr);
 
   if (stream->pad) {
     gst_object_unref (stream->pad);
@@ -1183,6 +1199,11 @@ gst_adaptive_demux_src_event (GstPad * pad, GstObject * parent,
           gst_event_set_seqnum (seg_evt, demux->priv->segment_seqnum);
           gst_event_replace (&stream->pending_segment, seg_evt);
           gst_event_unref (seg_evt);
+
+          /* Downstream was flushed, what was selected for the old buffer
+           * level doesn't apply anymore */
+          if (flags & GST_SEEK_FLAG_FLUSH)
+            gst_adaptive_demux_abr_reset (stream->abr);
         }
       }
 
@@ -1529,46 +1550,51 @@ gst_adaptive_demux_stream_queue_event (GstAdaptiveDemuxStream * stream,
   stream->pending_events = g_list_append (stream->pending_events, event);
 }
 
-static guint64
-_update_average_bitrate (GstAdaptiveDemux * demux,
-    GstAdaptiveDemuxStream * stream, guint64 new_bitrate)
+/* Returns how much data, in stream time, was pushed by @stream but not yet
+ * played back downstream, or GST_CLOCK_TIME_NONE if that is unknown */
+static GstClockTime
+gst_adaptive_demux_stream_get_buffer_level (GstAdaptiveDemuxStream * stream)
 {
-  gint index = stream->moving_index % demux->num_lookback_fragments;
+  gint64 position;
+  guint64 pushed;
+
+  if (!GST_CLOCK_TIME_IS_VALID (stream->segment.position))
+    return GST_CLOCK_TIME_NONE;
 
-  stream->moving_bitrate -= stream->fragment_bitrates[index];
-  stream->fragment_bitrates[index] = new_bitrate;
-  stream->moving_bitrate += new_bitrate;
+  if (!gst_pad_peer_query_position (stream->pad, GST_FORMAT_TIME, &position)
+      || position < 0)
+    return GST_CLOCK_TIME_NONE;
 
-  stream->moving_index += 1;
+  pushed = gst_segment_to_stream_time (&stream->segment, GST_FORMAT_TIME,
+      stream->segment.position);
+  if (!GST_CLOCK_TIME_IS_VALID (pushed))
+    return GST_CLOCK_TIME_NONE;
 
-  if (stream->moving_index > demux->num_lookback_fragments)
-    return stream->moving_bitrate / demux->num_lookback_fragments;
-  return stream->moving_bitrate / stream->moving_index;
+  return pushed > position ? pushed - position : 0;
 }
 
 static guint64
 gst_adaptive_demux_stream_update_current_bitrate (GstAdaptiveDemux * demux,
     GstAdaptiveDemuxStream * stream)
 {
-  guint64 average_bitrate;
-  guint64 fragment_bitrate;
+  GstClockTime buffer_level = GST_CLOCK_TIME_NONE;
 
-  fragment_bitrate =
-      (stream->fragment_total_size * 8) /
-      ((double) stream->fragment_total_time / G_GUINT64_CONSTANT (1000000));
+  gst_adaptive_demux_abr_add_fragment (stream->abr,
+      stream->fragment_total_size,
+      stream->fragment_total_time * GST_USECOND);
   stream->fragment_total_size = 0;
   stream->fragment_total_time = 0;
 
-  average_bitrate = _update_average_bitrate (demux, stream, fragment_bitrate);
-
-  GST_INFO_OBJECT (stream, "last fragment bitrate was %" G_GUINT64_FORMAT,
-      fragment_bitrate);
-  GST_INFO_OBJECT (stream,
-      "Last %u fragments average bitrate is %" G_GUINT64_FORMAT,
-      demux->num_lookback_fragments, average_bitrate);
+  /* Only the buffer based algorithm looks at it, avoid the query otherwise */
+  if (stream->abr->algorithm == GST_ADAPTIVE_DEMUX_ABR_BUFFER) {
+    buffer_level = gst_adaptive_demux_stream_get_buffer_level (stream);
+    GST_DEBUG_OBJECT (stream->pad, "Downstream buffer level %"
+        GST_TIME_FORMAT, GST_TIME_ARGS (buffer_level));
+  }
 
-  /* Conservative approach, make sure we don't upgrade too fast */
-  stream->current_download_rate = MIN (average_bitrate, fragment_bitrate);
+  stream->current_download_rate =
+      gst_adaptive_demux_abr_get_bitrate (stream->abr, buffer_level,
+      demux->bitrate_limit);
 
   if (demux->connection_speed) {
     GST_LOG_OBJECT (demux, "Connection-speed is set to %u kbps, using it",
@@ -1576,7 +1602,6 @@ gst_adaptive_demux_stream_update_current_bitrate (GstAdaptiveDemux * demux,
     return demux->connection_speed;
   }
 
-  stream->current_download_rate *= demux->bitrate_limit;
   GST_DEBUG_OBJECT (demux, "Bitrate after bitrate limit (%0.2f): %"
       G_GUINT64_FORMAT, demux->bitrate_limit, stream->current_download_rate);
 
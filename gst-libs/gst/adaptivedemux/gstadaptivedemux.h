@@ -25,6 +25,7 @@
 #include <gst/gst.h>
 #include <gst/base/gstadapter.h>
 #include <gst/uridownloader/gsturidownloader.h>
+#include <gst/adaptivedemux/gstadaptivedemuxabr.h>
 
 G_BEGIN_DECLS
 
@@ -164,10 +165,8 @@ struct _GstAdaptiveDemuxStream
   guint64 fragment_total_time;
   guint64 fragment_total_size;
 
-  /* Average for the last fragments */
-  guint64 moving_bitrate;
-  guint moving_index;
-  guint64 *fragment_bitrates;
+  /* Bitrate estimation */
+  GstAdaptiveDemuxAbr *abr;
 
   GstAdaptiveDemuxStreamFragment fragment;
 
@@ -211,6 +210,7 @@ struct _GstAdaptiveDemux
   guint num_lookback_fragments;
   gfloat bitrate_limit;         /* limit of the available bitrate to use */
   guint connection_speed;
+  GstAdaptiveDemuxAbrAlgorithm abr_algorithm;
 
   gboolean have_group_id;
   guint group_id;
@@ -0,0 +1,330 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Bitrate estimation for GstAdaptiveDemux streams.
+ *
+ * After each downloaded fragment the demuxer feeds its size and download
+ * time to the stream's #GstAdaptiveDemuxAbr, and then asks it for the
+ * bitrate to pass to the subclass' stream_select_bitrate. The subclass
+ * still picks the actual representation, so the algorithms here only
+ * produce a target bitrate.
+ *
+ * average: the historical behaviour, the minimum of the last fragment
+ *          rate and the average of the last num-lookback-fragments.
+ * ewma:    minimum of a fast and a slow moving average weighted by
+ *          download time, so that it reacts quickly to drops but slowly
+ *          to increases.
+ * buffer:  ewma throughput scaled by the downstream buffer level. When
+ *          little data is buffered the target is lowered and never
+ *          increased, which avoids stalls and up/down oscillation; when
+ *          the buffer is full the bitrate-limit safety margin is
+ *          progressively dropped.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include "gstadaptivedemuxabr.h"
+
+GST_DEBUG_CATEGORY_STATIC (adaptivedemuxabr_debug);
+#define GST_CAT_DEFAULT adaptivedemuxabr_debug
+
+/* Half-life of the moving averages, in download time */
+#define EWMA_FAST_HALF_LIFE (3 * GST_SECOND)
+#define EWMA_SLOW_HALF_LIFE (8 * GST_SECOND)
+
+#define DEFAULT_LOW_WATERMARK (5 * GST_SECOND)
+#define DEFAULT_HIGH_WATERMARK (20 * GST_SECOND)
+
+/* Fraction of the estimated throughput still used with an empty buffer */
+#define BUFFER_EMPTY_FACTOR 0.5
+
+GType
+gst_adaptive_demux_abr_algorithm_get_type (void)
+{
+  static GType gtype = 0;
+
+  if (gtype == 0) {
+    static const GEnumValue values[] = {
+      {GST_ADAPTIVE_DEMUX_ABR_AVERAGE,
+          "Average of the last fragments download rate (default)", "average"},
+      {GST_ADAPTIVE_DEMUX_ABR_EWMA,
+          "Exponentially weighted moving average of the download rate",
+          "ewma"},
+      {GST_ADAPTIVE_DEMUX_ABR_BUFFER,
+          "Download rate scaled by the downstream buffer level", "buffer"},
+      {0, NULL, NULL}
+    };
+
+    gtype = g_enum_register_static ("GstAdaptiveDemuxAbrAlgorithm", values);
+  }
+  return gtype;
+}
+
+/* average */
+static void
+average_reset (GstAdaptiveDemuxAbr * abr)
+{
+  abr->moving_bitrate = 0;
+  abr->moving_index = 0;
+  memset (abr->fragment_bitrates, 0,
+      sizeof (guint64) * abr->num_lookback_fragments);
+}
+
+static void
+average_add_fragment (GstAdaptiveDemuxAbr * abr, guint64 bitrate,
+    GstClockTime download_time)
+{
+  gint index = abr->moving_index % abr->num_lookback_fragments;
+
+  abr->moving_bitrate -= abr->fragment_bitrates[index];
+  abr->fragment_bitrates[index] = bitrate;
+  abr->moving_bitrate += bitrate;
+
+  abr->moving_index += 1;
+}
+
+static guint64
+average_get_bitrate (GstAdaptiveDemuxAbr * abr, GstClockTime buffer_level,
+    gfloat bitrate_limit)
+{
+  guint64 average;
+
+  if (abr->moving_index == 0)
+    return 0;
+
+  if (abr->moving_index > abr->num_lookback_fragments)
+    average = abr->moving_bitrate / abr->num_lookback_fragments;
+  else
+    average = abr->moving_bitrate / abr->moving_index;
+
+  GST_DEBUG ("Last %u fragments average bitrate is %" G_GUINT64_FORMAT,
+      abr->num_lookback_fragments, average);
+
+  /* Conservative approach, make sure we don't upgrade too fast */
+  return MIN (average, abr->last_bitrate) * bitrate_limit;
+}
+
+/* ewma */
+static void
+ewma_reset (GstAdaptiveDemuxAbr * abr)
+{
+  abr->ewma_fast = 0;
+  abr->ewma_slow = 0;
+  abr->ewma_total_time = 0;
+}
+
+static gdouble
+ewma_update (gdouble ewma, gdouble sample, GstClockTime download_time,
+    GstClockTime half_life)
+{
+  gdouble alpha = pow (0.5, (gdouble) download_time / half_life);
+
+  return alpha * ewma + (1.0 - alpha) * sample;
+}
+
+static void
+ewma_add_fragment (GstAdaptiveDemuxAbr * abr, guint64 bitrate,
+    GstClockTime download_time)
+{
+  /* Very small fragments downloaded from a cache would otherwise have no
+   * weight at all */
+  download_time = MAX (download_time, GST_MSECOND);
+
+  abr->ewma_fast = ewma_update (abr->ewma_fast, bitrate, download_time,
+      EWMA_FAST_HALF_LIFE);
+  abr->ewma_slow = ewma_update (abr->ewma_slow, bitrate, download_time,
+      EWMA_SLOW_HALF_LIFE);
+  abr->ewma_total_time += download_time;
+}
+
+static guint64
+ewma_get_throughput (GstAdaptiveDemuxAbr * abr)
+{
+  gdouble fast, slow;
+
+  if (abr->ewma_total_time == 0)
+    return 0;
+
+  /* Both averages start at 0, correct for that bias until enough data has
+   * been downloaded */
+  fast = abr->ewma_fast / (1.0 - pow (0.5,
+          (gdouble) abr->ewma_total_time / EWMA_FAST_HALF_LIFE));
+  slow = abr->ewma_slow / (1.0 - pow (0.5,
+          (gdouble) abr->ewma_total_time / EWMA_SLOW_HALF_LIFE));
+
+  GST_DEBUG ("Moving averages: fast %.0f, slow %.0f", fast, slow);
+
+  return (guint64) MIN (fast, slow);
+}
+
+static guint64
+ewma_get_bitrate (GstAdaptiveDemuxAbr * abr, GstClockTime buffer_level,
+    gfloat bitrate_limit)
+{
+  return ewma_get_throughput (abr) * bitrate_limit;
+}
+
+/* buffer */
+static guint64
+buffer_get_bitrate (GstAdaptiveDemuxAbr * abr, GstClockTime buffer_level,
+    gfloat bitrate_limit)
+{
+  guint64 throughput = ewma_get_throughput (abr);
+  gdouble factor;
+  guint64 bitrate;
+
+  if (!GST_CLOCK_TIME_IS_VALID (buffer_level)) {
+    /* Nothing known about downstream, plain throughput based decision */
+    return throughput * bitrate_limit;
+  }
+
+  if (buffer_level < abr->low_watermark) {
+    factor = bitrate_limit * (BUFFER_EMPTY_FACTOR + (1.0 -
+            BUFFER_EMPTY_FACTOR) * buffer_level / abr->low_watermark);
+  } else if (buffer_level < abr->high_watermark) {
+    factor = bitrate_limit;
+  } else {
+    gdouble excess = (gdouble) (buffer_level - abr->high_watermark) /
+        abr->high_watermark;
+
+    factor = bitrate_limit + (1.0 - bitrate_limit) * MIN (excess, 1.0);
+  }
+
+  bitrate = throughput * factor;
+
+  /* Only switch up once enough data is buffered to absorb a wrong guess */
+  if (buffer_level < abr->low_watermark && abr->last_selected != 0)
+    bitrate = MIN (bitrate, abr->last_selected);
+
+  GST_DEBUG ("Buffer level %" GST_TIME_FORMAT ", throughput %"
+      G_GUINT64_FORMAT ", factor %.2f", GST_TIME_ARGS (buffer_level),
+      throughput, factor);
+
+  return bitrate;
+}
+
+static const GstAdaptiveDemuxAbrFuncs abr_funcs[] = {
+  /* GST_ADAPTIVE_DEMUX_ABR_AVERAGE */
+  {average_reset, average_add_fragment, average_get_bitrate},
+  /* GST_ADAPTIVE_DEMUX_ABR_EWMA */
+  {ewma_reset, ewma_add_fragment, ewma_get_bitrate},
+  /* GST_ADAPTIVE_DEMUX_ABR_BUFFER */
+  {ewma_reset, ewma_add_fragment, buffer_get_bitrate}
+};
+
+GstAdaptiveDemuxAbr *
+gst_adaptive_demux_abr_new (GstAdaptiveDemuxAbrAlgorithm algorithm,
+    guint num_lookback_fragments)
+{
+  GstAdaptiveDemuxAbr *abr;
+
+  g_return_val_if_fail (algorithm < G_N_ELEMENTS (abr_funcs), NULL);
+  g_return_val_if_fail (num_lookback_fragments > 0, NULL);
+
+  GST_DEBUG_CATEGORY_INIT (adaptivedemuxabr_debug, "adaptivedemuxabr", 0,
+      "Adaptive Demux bitrate estimation");
+
+  abr = g_new0 (GstAdaptiveDemuxAbr, 1);
+  abr->algorithm = algorithm;
+  abr->funcs = &abr_funcs[algorithm];
+  abr->num_lookback_fragments = num_lookback_fragments;
+  abr->fragment_bitrates = g_new0 (guint64, num_lookback_fragments);
+  abr->low_watermark = DEFAULT_LOW_WATERMARK;
+  abr->high_watermark = DEFAULT_HIGH_WATERMARK;
+
+  return abr;
+}
+
+void
+gst_adaptive_demux_abr_free (GstAdaptiveDemuxAbr * abr)
+{
+  g_return_if_fail (abr != NULL);
+
+  g_free (abr->fragment_bitrates);
+  g_free (abr);
+}
+
+/**
+ * gst_adaptive_demux_abr_reset:
+ * @abr: a #GstAdaptiveDemuxAbr
+ *
+ * Forgets all the measurements and the last selected bitrate, like after a
+ * flushing seek.
+ */
+void
+gst_adaptive_demux_abr_reset (GstAdaptiveDemuxAbr * abr)
+{
+  g_return_if_fail (abr != NULL);
+
+  abr->last_bitrate = 0;
+  abr->last_selected = 0;
+  abr->funcs->reset (abr);
+}
+
+/**
+ * gst_adaptive_demux_abr_add_fragment:
+ * @abr: a #GstAdaptiveDemuxAbr
+ * @size: size of the downloaded fragment in bytes
+ * @download_time: time it took to download it
+ *
+ * Accounts a new download rate measurement.
+ */
+void
+gst_adaptive_demux_abr_add_fragment (GstAdaptiveDemuxAbr * abr, guint64 size,
+    GstClockTime download_time)
+{
+  guint64 bitrate;
+
+  g_return_if_fail (abr != NULL);
+
+  if (download_time == 0 || !GST_CLOCK_TIME_IS_VALID (download_time))
+    return;
+
+  bitrate = gst_util_uint64_scale (size * 8, GST_SECOND, download_time);
+  GST_INFO ("last fragment bitrate was %" G_GUINT64_FORMAT, bitrate);
+
+  abr->last_bitrate = bitrate;
+  abr->funcs->add_fragment (abr, bitrate, download_time);
+}
+
+/**
+ * gst_adaptive_demux_abr_get_bitrate:
+ * @abr: a #GstAdaptiveDemuxAbr
+ * @buffer_level: amount of data queued downstream of the demuxer, or
+ *     #GST_CLOCK_TIME_NONE if unknown
+ * @bitrate_limit: fraction of the estimated throughput that can be used
+ *
+ * Returns: the bitrate, in bits per second, to select for the next fragment
+ */
+guint64
+gst_adaptive_demux_abr_get_bitrate (GstAdaptiveDemuxAbr * abr,
+    GstClockTime buffer_level, gfloat bitrate_limit)
+{
+  g_return_val_if_fail (abr != NULL, 0);
+
+  abr->last_selected = abr->funcs->get_bitrate (abr, buffer_level,
+      bitrate_limit);
+
+  return abr->last_selected;
+}
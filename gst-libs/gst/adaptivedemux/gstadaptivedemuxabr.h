@@ -0,0 +1,115 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_ADAPTIVE_DEMUX_ABR_H_
+#define _GST_ADAPTIVE_DEMUX_ABR_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GstAdaptiveDemuxAbrAlgorithm:
+ * @GST_ADAPTIVE_DEMUX_ABR_AVERAGE: minimum of the last fragment download
+ *   rate and the average of the last num-lookback-fragments download rates
+ * @GST_ADAPTIVE_DEMUX_ABR_EWMA: minimum of a fast and a slow exponentially
+ *   weighted moving average of the download rate
+ * @GST_ADAPTIVE_DEMUX_ABR_BUFFER: EWMA throughput scaled by the amount of
+ *   data that is already buffered downstream
+ *
+ * Algorithm used to estimate the bitrate that can be requested for the next
+ * fragment.
+ */
+typedef enum
+{
+  GST_ADAPTIVE_DEMUX_ABR_AVERAGE,
+  GST_ADAPTIVE_DEMUX_ABR_EWMA,
+  GST_ADAPTIVE_DEMUX_ABR_BUFFER
+} GstAdaptiveDemuxAbrAlgorithm;
+
+#define GST_TYPE_ADAPTIVE_DEMUX_ABR_ALGORITHM \
+  (gst_adaptive_demux_abr_algorithm_get_type ())
+GType gst_adaptive_demux_abr_algorithm_get_type (void);
+
+typedef struct _GstAdaptiveDemuxAbr GstAdaptiveDemuxAbr;
+typedef struct _GstAdaptiveDemuxAbrFuncs GstAdaptiveDemuxAbrFuncs;
+
+/**
+ * GstAdaptiveDemuxAbrFuncs:
+ * @reset: forget all the measurements done so far
+ * @add_fragment: account the download rate of a newly downloaded fragment
+ * @get_bitrate: returns the bitrate to select for the next fragment
+ *
+ * Implementation of one of the #GstAdaptiveDemuxAbrAlgorithm.
+ */
+struct _GstAdaptiveDemuxAbrFuncs
+{
+  void     (*reset)        (GstAdaptiveDemuxAbr * abr);
+  void     (*add_fragment) (GstAdaptiveDemuxAbr * abr, guint64 bitrate,
+                            GstClockTime download_time);
+  guint64  (*get_bitrate)  (GstAdaptiveDemuxAbr * abr,
+                            GstClockTime buffer_level, gfloat bitrate_limit);
+};
+
+/**
+ * GstAdaptiveDemuxAbr:
+ *
+ * Per stream bitrate estimation state.
+ */
+struct _GstAdaptiveDemuxAbr
+{
+  GstAdaptiveDemuxAbrAlgorithm algorithm;
+  const GstAdaptiveDemuxAbrFuncs *funcs;
+
+  /* Last fragment download rate */
+  guint64 last_bitrate;
+  /* Last value returned by get_bitrate() */
+  guint64 last_selected;
+
+  /* Average for the last fragments */
+  guint num_lookback_fragments;
+  guint64 moving_bitrate;
+  guint moving_index;
+  guint64 *fragment_bitrates;
+
+  /* Exponentially weighted moving averages, weighted by download time */
+  gdouble ewma_fast;
+  gdouble ewma_slow;
+  GstClockTime ewma_total_time;
+
+  /* Downstream buffer level below which no upswitch happens and the
+   * bitrate is lowered, and above which the whole throughput can be
+   * used */
+  GstClockTime low_watermark;
+  GstClockTime high_watermark;
+};
+
+GstAdaptiveDemuxAbr * gst_adaptive_demux_abr_new (GstAdaptiveDemuxAbrAlgorithm algorithm,
+                                                  guint num_lookback_fragments);
+void     gst_adaptive_demux_abr_free (GstAdaptiveDemuxAbr * abr);
+void     gst_adaptive_demux_abr_reset (GstAdaptiveDemuxAbr * abr);
+void     gst_adaptive_demux_abr_add_fragment (GstAdaptiveDemuxAbr * abr,
+                                              guint64 size,
+                                              GstClockTime download_time);
+guint64  gst_adaptive_demux_abr_get_bitrate (GstAdaptiveDemuxAbr * abr,
+                                             GstClockTime buffer_level,
+                                             gfloat bitrate_limit);
+
+G_END_DECLS
+
+#endif
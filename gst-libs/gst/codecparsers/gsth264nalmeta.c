@@ -0,0 +1,139 @@
+/*
+ * GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gsth264nalmeta.h"
+
+GST_DEBUG_CATEGORY (h264_nal_meta_debug);
+#define GST_CAT_DEFAULT h264_nal_meta_debug
+
+static gboolean
+gst_h264_nal_meta_init (GstH264NalMeta * nal_meta, gpointer params,
+    GstBuffer * buffer)
+{
+  nal_meta->n_units = 0;
+  nal_meta->units = NULL;
+  nal_meta->keyframe = FALSE;
+
+  return TRUE;
+}
+
+static void
+gst_h264_nal_meta_free (GstH264NalMeta * nal_meta, GstBuffer * buffer)
+{
+  g_free (nal_meta->units);
+}
+
+static gboolean
+gst_h264_nal_meta_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  GstH264NalMeta *smeta, *dmeta;
+
+  smeta = (GstH264NalMeta *) meta;
+
+  if (GST_META_TRANSFORM_IS_COPY (type)) {
+    GstMetaTransformCopy *copy = data;
+
+    if (!copy->region) {
+      /* only copy if the complete data is copied as well */
+      dmeta = gst_buffer_add_h264_nal_meta (dest, smeta->units,
+          smeta->n_units);
+
+      if (!dmeta)
+        return FALSE;
+
+      dmeta->keyframe = smeta->keyframe;
+    }
+  } else {
+    /* return FALSE, if transform type is not supported */
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+GType
+gst_h264_nal_meta_api_get_type (void)
+{
+  static volatile GType type;
+  static const gchar *tags[] = { "memory", NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type = gst_meta_api_type_register ("GstH264NalMetaAPI", tags);
+    GST_DEBUG_CATEGORY_INIT (h264_nal_meta_debug, "h264nalmeta", 0,
+        "H.264 NAL units GstMeta");
+
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
+const GstMetaInfo *
+gst_h264_nal_meta_get_info (void)
+{
+  static const GstMetaInfo *h264_nal_meta_info = NULL;
+
+  if (g_once_init_enter (&h264_nal_meta_info)) {
+    const GstMetaInfo *meta = gst_meta_register (GST_H264_NAL_META_API_TYPE,
+        "GstH264NalMeta", sizeof (GstH264NalMeta),
+        (GstMetaInitFunction) gst_h264_nal_meta_init,
+        (GstMetaFreeFunction) gst_h264_nal_meta_free,
+        (GstMetaTransformFunction) gst_h264_nal_meta_transform);
+    g_once_init_leave (&h264_nal_meta_info, meta);
+  }
+
+  return h264_nal_meta_info;
+}
+
+/**
+ * gst_buffer_add_h264_nal_meta:
+ * @buffer: a #GstBuffer
+ * @units: (array length=n_units): the NAL units of @buffer
+ * @n_units: number of entries in @units
+ *
+ * Creates and adds a #GstH264NalMeta to a @buffer. @units is copied.
+ *
+ * Returns: (transfer none): a newly created #GstH264NalMeta
+ *
+ * Since: 1.8
+ */
+GstH264NalMeta *
+gst_buffer_add_h264_nal_meta (GstBuffer * buffer,
+    const GstH264NalMetaUnit * units, guint n_units)
+{
+  GstH264NalMeta *nal_meta;
+
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (units != NULL || n_units == 0, NULL);
+
+  nal_meta = (GstH264NalMeta *) gst_buffer_add_meta (buffer,
+      GST_H264_NAL_META_INFO, NULL);
+
+  GST_LOG ("adding %u NAL units to buffer %p", n_units, buffer);
+
+  nal_meta->n_units = n_units;
+  if (n_units)
+    nal_meta->units = g_memdup (units, n_units * sizeof (GstH264NalMetaUnit));
+
+  return nal_meta;
+}
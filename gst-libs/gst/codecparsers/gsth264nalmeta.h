@@ -0,0 +1,95 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_H264_NAL_META_H__
+#define __GST_H264_NAL_META_H__
+
+#ifndef GST_USE_UNSTABLE_API
+#warning "The H.264 parsing library is unstable API and may change in future."
+#warning "You can define GST_USE_UNSTABLE_API to avoid this warning."
+#endif
+
+#include <gst/gst.h>
+#include <gst/codecparsers/gsth264parser.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstH264NalMeta GstH264NalMeta;
+typedef struct _GstH264NalMetaUnit GstH264NalMetaUnit;
+
+GType gst_h264_nal_meta_api_get_type (void);
+#define GST_H264_NAL_META_API_TYPE  (gst_h264_nal_meta_api_get_type())
+#define GST_H264_NAL_META_INFO  (gst_h264_nal_meta_get_info())
+const GstMetaInfo * gst_h264_nal_meta_get_info (void);
+
+/**
+ * GstH264NalMetaUnit:
+ * @offset: offset of the NAL unit header in the buffer, after the start
+ *   code or length prefix
+ * @size: size of the NAL unit, without start code or length prefix
+ * @type: the #GstH264NalUnitType
+ * @slice_type: the #GstH264SliceType for slices whose header was parsed,
+ *   -1 otherwise
+ *
+ * Location of a NAL unit in a buffer.
+ *
+ * Since: 1.8
+ */
+struct _GstH264NalMetaUnit {
+  guint  offset;
+  guint  size;
+  guint8 type;
+  gint8  slice_type;
+};
+
+/**
+ * GstH264NalMeta:
+ * @meta: parent #GstMeta
+ * @n_units: number of entries in @units
+ * @units: the NAL units of the buffer, in stream order
+ * @keyframe: whether the buffer contains an intra coded picture
+ *
+ * Extra buffer metadata listing the NAL units of a parsed H.264 buffer,
+ * in the stream-format the buffer is in.
+ *
+ * Can be used by elements (payloaders, muxers, decoders) to avoid scanning
+ * the buffer for start codes again when it was done upstream.
+ *
+ * The meta is only copied along with the complete buffer data, and is not
+ * valid anymore once the data has been modified.
+ *
+ * Since: 1.8
+ */
+struct _GstH264NalMeta {
+  GstMeta             meta;
+
+  guint               n_units;
+  GstH264NalMetaUnit *units;
+  gboolean            keyframe;
+};
+
+#define gst_buffer_get_h264_nal_meta(b) ((GstH264NalMeta*)gst_buffer_get_meta((b),GST_H264_NAL_META_API_TYPE))
+
+GstH264NalMeta *
+gst_buffer_add_h264_nal_meta (GstBuffer * buffer,
+                              const GstH264NalMetaUnit * units,
+                              guint n_units);
+
+G_END_DECLS
+
+#endif
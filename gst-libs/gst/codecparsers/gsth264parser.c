@@ -85,6 +85,7 @@
 #endif
 
 #include "nalutils.h"
+#include "startcodeutils.h"
 #include "gsth264parser.h"
 
 #include <gst/base/gstbytereader.h>
@@ -388,6 +389,47 @@ gst_h264_sps_copy (GstH264SPS * dst_sps, const GstH264SPS * src_sps)
   return TRUE;
 }
 
+/* Parameter set cache */
+static gint
+gst_h264_parser_cache_lookup (GstH264NalParser * nalparser,
+    GstH264NalUnit * nalu)
+{
+  GBytes *key;
+  gpointer id;
+  gboolean found;
+
+  key = g_bytes_new_static (nalu->data + nalu->offset, nalu->size);
+  found = g_hash_table_lookup_extended (nalparser->ps_cache, key, NULL, &id);
+  g_bytes_unref (key);
+
+  return found ? GPOINTER_TO_INT (id) : -1;
+}
+
+static void
+gst_h264_parser_cache_drop (GstH264NalParser * nalparser, GBytes ** raw,
+    guint n)
+{
+  guint i;
+
+  for (i = 0; i < n; i++) {
+    if (raw[i]) {
+      g_hash_table_remove (nalparser->ps_cache, raw[i]);
+      g_bytes_unref (raw[i]);
+      raw[i] = NULL;
+    }
+  }
+}
+
+static void
+gst_h264_parser_cache_store (GstH264NalParser * nalparser, GBytes ** raw,
+    gint id, GstH264NalUnit * nalu)
+{
+  gst_h264_parser_cache_drop (nalparser, &raw[id], 1);
+
+  raw[id] = g_bytes_new (nalu->data + nalu->offset, nalu->size);
+  g_hash_table_insert (nalparser->ps_cache, raw[id], GINT_TO_POINTER (id));
+}
+
 /****** Parsing functions *****/
 
 static gboolean
@@ -1245,11 +1287,38 @@ gst_h264_nal_parser_new (void)
   GstH264NalParser *nalparser;
 
   nalparser = g_slice_new0 (GstH264NalParser);
+  nalparser->ps_cache = g_hash_table_new (g_bytes_hash, g_bytes_equal);
   INITIALIZE_DEBUG_CATEGORY;
 
   return nalparser;
 }
 
+/**
+ * gst_h264_nal_parser_set_partial_slice_hdr:
+ * @nalparser: a #GstH264NalParser
+ * @partial: whether to only parse the start of slice headers
+ *
+ * In partial mode gst_h264_parser_parse_slice_hdr() stops once it has read
+ * the fields that are needed to detect the first slice of a new picture
+ * and its type (7.4.1.2.4), up to and including @redundant_pic_cnt. This
+ * is all a parser needs to delimit access units and find keyframes, and
+ * avoids going through the reference list modifications, prediction weight
+ * tables and reference picture marking of every slice.
+ *
+ * The remaining fields of the #GstH264SliceHdr are not set, and
+ * @header_size and @n_emulation_prevention_bytes are 0.
+ *
+ * Since: 1.8
+ */
+void
+gst_h264_nal_parser_set_partial_slice_hdr (GstH264NalParser * nalparser,
+    gboolean partial)
+{
+  g_return_if_fail (nalparser != NULL);
+
+  nalparser->partial_slice_hdr = partial;
+}
+
 /**
  * gst_h264_nal_parser_free:
  * @nalparser: the #GstH264NalParser to free
@@ -1265,6 +1334,11 @@ gst_h264_nal_parser_free (GstH264NalParser * nalparser)
     gst_h264_sps_clear (&nalparser->sps[i]);
   for (i = 0; i < GST_H264_MAX_PPS_COUNT; i++)
     gst_h264_pps_clear (&nalparser->pps[i]);
+  gst_h264_parser_cache_drop (nalparser, nalparser->sps_raw,
+      GST_H264_MAX_SPS_COUNT);
+  gst_h264_parser_cache_drop (nalparser, nalparser->pps_raw,
+      GST_H264_MAX_PPS_COUNT);
+  g_hash_table_unref (nalparser->ps_cache);
   g_slice_free (GstH264NalParser, nalparser);
 
   nalparser = NULL;
@@ -1484,13 +1558,29 @@ gst_h264_parser_parse_nal (GstH264NalParser * nalparser, GstH264NalUnit * nalu)
  *
  * Parses @data, and fills the @sps structure.
  *
+ * If @nalu is identical to the SPS that is currently stored in @nalparser
+ * with the same id, @sps is filled from it without parsing @nalu again.
+ *
  * Returns: a #GstH264ParserResult
  */
 GstH264ParserResult
 gst_h264_parser_parse_sps (GstH264NalParser * nalparser, GstH264NalUnit * nalu,
     GstH264SPS * sps, gboolean parse_vui_params)
 {
-  GstH264ParserResult res = gst_h264_parse_sps (nalu, sps, parse_vui_params);
+  GstH264ParserResult res;
+  gint id;
+
+  id = gst_h264_parser_cache_lookup (nalparser, nalu);
+  if (id >= 0) {
+    GST_LOG ("sequence parameter set with id: %d unchanged", id);
+
+    /* only SPS without extension are cached, nothing to deep copy */
+    *sps = nalparser->sps[id];
+    nalparser->last_sps = &nalparser->sps[id];
+    return GST_H264_PARSER_OK;
+  }
+
+  res = gst_h264_parse_sps (nalu, sps, parse_vui_params);
 
   if (res == GST_H264_PARSER_OK) {
     GST_DEBUG ("adding sequence parameter set with id: %d to array", sps->id);
@@ -1498,6 +1588,16 @@ gst_h264_parser_parse_sps (GstH264NalParser * nalparser, GstH264NalUnit * nalu,
     if (!gst_h264_sps_copy (&nalparser->sps[sps->id], sps))
       return GST_H264_PARSER_ERROR;
     nalparser->last_sps = &nalparser->sps[sps->id];
+
+    /* PPS are parsed according to their SPS */
+    gst_h264_parser_cache_drop (nalparser, nalparser->pps_raw,
+        GST_H264_MAX_PPS_COUNT);
+    if (parse_vui_params)
+      gst_h264_parser_cache_store (nalparser, nalparser->sps_raw, sps->id,
+          nalu);
+    else
+      gst_h264_parser_cache_drop (nalparser, &nalparser->sps_raw[sps->id],
+          1);
   }
   return res;
 }
@@ -1850,6 +1950,10 @@ gst_h264_parser_parse_subset_sps (GstH264NalParser * nalparser,
       return GST_H264_PARSER_ERROR;
     }
     nalparser->last_sps = &nalparser->sps[sps->id];
+
+    gst_h264_parser_cache_drop (nalparser, &nalparser->sps_raw[sps->id], 1);
+    gst_h264_parser_cache_drop (nalparser, nalparser->pps_raw,
+        GST_H264_MAX_PPS_COUNT);
   }
   return res;
 }
@@ -2055,13 +2159,32 @@ error:
  * gst_h264_pps_clear() function when it is no longer needed, or prior
  * to parsing a new PPS NAL unit.
  *
+ * If @nalu is identical to the PPS that is currently stored in @nalparser
+ * with the same id, and its SPS did not change, @pps is filled from it
+ * without parsing @nalu again.
+ *
  * Returns: a #GstH264ParserResult
  */
 GstH264ParserResult
 gst_h264_parser_parse_pps (GstH264NalParser * nalparser,
     GstH264NalUnit * nalu, GstH264PPS * pps)
 {
-  GstH264ParserResult res = gst_h264_parse_pps (nalparser, nalu, pps);
+  GstH264ParserResult res;
+  gint id;
+
+  id = gst_h264_parser_cache_lookup (nalparser, nalu);
+  if (id >= 0) {
+    GST_LOG ("picture parameter set with id: %d unchanged", id);
+
+    *pps = nalparser->pps[id];
+    if (pps->slice_group_id)
+      pps->slice_group_id = g_memdup (pps->slice_group_id,
+          pps->pic_size_in_map_units_minus1 + 1);
+    nalparser->last_pps = &nalparser->pps[id];
+    return GST_H264_PARSER_OK;
+  }
+
+  res = gst_h264_parse_pps (nalparser, nalu, pps);
 
   if (res == GST_H264_PARSER_OK) {
     GST_DEBUG ("adding picture parameter set with id: %d to array", pps->id);
@@ -2069,6 +2192,9 @@ gst_h264_parser_parse_pps (GstH264NalParser * nalparser,
     if (!gst_h264_pps_copy (&nalparser->pps[pps->id], pps))
       return GST_H264_PARSER_ERROR;
     nalparser->last_pps = &nalparser->pps[pps->id];
+
+    gst_h264_parser_cache_store (nalparser, nalparser->pps_raw, pps->id,
+        nalu);
   }
 
   return res;
@@ -2099,7 +2225,8 @@ gst_h264_pps_clear (GstH264PPS * pps)
  * @parse_pred_weight_table: Whether to parse the pred_weight_table or not
  * @parse_dec_ref_pic_marking: Whether to parse the dec_ref_pic_marking or not
  *
- * Parses @data, and fills the @slice structure.
+ * Parses @data, and fills the @slice structure. See
+ * gst_h264_nal_parser_set_partial_slice_hdr() to only parse the start of it.
  *
  * Returns: a #GstH264ParserResult
  */
@@ -2202,6 +2329,12 @@ gst_h264_parser_parse_slice_hdr (GstH264NalParser * nalparser,
   if (pps->redundant_pic_cnt_present_flag)
     READ_UE_MAX (&nr, slice->redundant_pic_cnt, G_MAXINT8);
 
+  if (nalparser->partial_slice_hdr) {
+    slice->header_size = 0;
+    slice->n_emulation_prevention_bytes = 0;
+    return GST_H264_PARSER_OK;
+  }
+
   if (GST_H264_IS_B_SLICE (slice))
     READ_UINT8 (&nr, slice->direct_spatial_mv_pred_flag, 1);
 
@@ -1013,10 +1013,20 @@ struct _GstH264NalParser
   GstH264PPS pps[GST_H264_MAX_PPS_COUNT];
   GstH264SPS *last_sps;
   GstH264PPS *last_pps;
+  gboolean partial_slice_hdr;
+
+  /* raw NAL units of the stored parameter sets, mapped to their id, so
+   * that repeated identical ones are not parsed again */
+  GHashTable *ps_cache;
+  GBytes *sps_raw[GST_H264_MAX_SPS_COUNT];
+  GBytes *pps_raw[GST_H264_MAX_PPS_COUNT];
 };
 
 GstH264NalParser *gst_h264_nal_parser_new             (void);
 
+void gst_h264_nal_parser_set_partial_slice_hdr        (GstH264NalParser *nalparser,
+                                                       gboolean partial);
+
 GstH264ParserResult gst_h264_parser_identify_nalu     (GstH264NalParser *nalparser,
                                                        const guint8 *data, guint offset,
                                                        gsize size, GstH264NalUnit *nalu);
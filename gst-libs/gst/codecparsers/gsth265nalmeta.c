@@ -0,0 +1,139 @@
+/*
+ * GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gsth265nalmeta.h"
+
+GST_DEBUG_CATEGORY (h265_nal_meta_debug);
+#define GST_CAT_DEFAULT h265_nal_meta_debug
+
+static gboolean
+gst_h265_nal_meta_init (GstH265NalMeta * nal_meta, gpointer params,
+    GstBuffer * buffer)
+{
+  nal_meta->n_units = 0;
+  nal_meta->units = NULL;
+  nal_meta->keyframe = FALSE;
+
+  return TRUE;
+}
+
+static void
+gst_h265_nal_meta_free (GstH265NalMeta * nal_meta, GstBuffer * buffer)
+{
+  g_free (nal_meta->units);
+}
+
+static gboolean
+gst_h265_nal_meta_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  GstH265NalMeta *smeta, *dmeta;
+
+  smeta = (GstH265NalMeta *) meta;
+
+  if (GST_META_TRANSFORM_IS_COPY (type)) {
+    GstMetaTransformCopy *copy = data;
+
+    if (!copy->region) {
+      /* only copy if the complete data is copied as well */
+      dmeta = gst_buffer_add_h265_nal_meta (dest, smeta->units,
+          smeta->n_units);
+
+      if (!dmeta)
+        return FALSE;
+
+      dmeta->keyframe = smeta->keyframe;
+    }
+  } else {
+    /* return FALSE, if transform type is not supported */
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+GType
+gst_h265_nal_meta_api_get_type (void)
+{
+  static volatile GType type;
+  static const gchar *tags[] = { "memory", NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type = gst_meta_api_type_register ("GstH265NalMetaAPI", tags);
+    GST_DEBUG_CATEGORY_INIT (h265_nal_meta_debug, "h265nalmeta", 0,
+        "H.265 NAL units GstMeta");
+
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
+const GstMetaInfo *
+gst_h265_nal_meta_get_info (void)
+{
+  static const GstMetaInfo *h265_nal_meta_info = NULL;
+
+  if (g_once_init_enter (&h265_nal_meta_info)) {
+    const GstMetaInfo *meta = gst_meta_register (GST_H265_NAL_META_API_TYPE,
+        "GstH265NalMeta", sizeof (GstH265NalMeta),
+        (GstMetaInitFunction) gst_h265_nal_meta_init,
+        (GstMetaFreeFunction) gst_h265_nal_meta_free,
+        (GstMetaTransformFunction) gst_h265_nal_meta_transform);
+    g_once_init_leave (&h265_nal_meta_info, meta);
+  }
+
+  return h265_nal_meta_info;
+}
+
+/**
+ * gst_buffer_add_h265_nal_meta:
+ * @buffer: a #GstBuffer
+ * @units: (array length=n_units): the NAL units of @buffer
+ * @n_units: number of entries in @units
+ *
+ * Creates and adds a #GstH265NalMeta to a @buffer. @units is copied.
+ *
+ * Returns: (transfer none): a newly created #GstH265NalMeta
+ *
+ * Since: 1.8
+ */
+GstH265NalMeta *
+gst_buffer_add_h265_nal_meta (GstBuffer * buffer,
+    const GstH265NalMetaUnit * units, guint n_units)
+{
+  GstH265NalMeta *nal_meta;
+
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (units != NULL || n_units == 0, NULL);
+
+  nal_meta = (GstH265NalMeta *) gst_buffer_add_meta (buffer,
+      GST_H265_NAL_META_INFO, NULL);
+
+  GST_LOG ("adding %u NAL units to buffer %p", n_units, buffer);
+
+  nal_meta->n_units = n_units;
+  if (n_units)
+    nal_meta->units = g_memdup (units, n_units * sizeof (GstH265NalMetaUnit));
+
+  return nal_meta;
+}
@@ -79,6 +79,7 @@
 #endif
 
 #include "nalutils.h"
+#include "startcodeutils.h"
 #include "gsth265parser.h"
 
 #include <gst/base/gstbytereader.h>
@@ -257,6 +258,47 @@ gst_h265_parse_nalu_header (GstH265NalUnit * nalu)
   return TRUE;
 }
 
+/* Parameter set cache */
+static gint
+gst_h265_parser_cache_lookup (GstH265Parser * parser,
+    GstH265NalUnit * nalu)
+{
+  GBytes *key;
+  gpointer id;
+  gboolean found;
+
+  key = g_bytes_new_static (nalu->data + nalu->offset, nalu->size);
+  found = g_hash_table_lookup_extended (parser->ps_cache, key, NULL, &id);
+  g_bytes_unref (key);
+
+  return found ? GPOINTER_TO_INT (id) : -1;
+}
+
+static void
+gst_h265_parser_cache_drop (GstH265Parser * parser, GBytes ** raw,
+    guint n)
+{
+  guint i;
+
+  for (i = 0; i < n; i++) {
+    if (raw[i]) {
+      g_hash_table_remove (parser->ps_cache, raw[i]);
+      g_bytes_unref (raw[i]);
+      raw[i] = NULL;
+    }
+  }
+}
+
+static void
+gst_h265_parser_cache_store (GstH265Parser * parser, GBytes ** raw,
+    gint id, GstH265NalUnit * nalu)
+{
+  gst_h265_parser_cache_drop (parser, &raw[id], 1);
+
+  raw[id] = g_bytes_new (nalu->data + nalu->offset, nalu->size);
+  g_hash_table_insert (parser->ps_cache, raw[id], GINT_TO_POINTER (id));
+}
+
 /****** Parsing functions *****/
 
 static gboolean
@@ -1178,11 +1220,37 @@ gst_h265_parser_new (void)
   GstH265Parser *parser;
 
   parser = g_slice_new0 (GstH265Parser);
+  parser->ps_cache = g_hash_table_new (g_bytes_hash, g_bytes_equal);
   INITIALIZE_DEBUG_CATEGORY;
 
   return parser;
 }
 
+/**
+ * gst_h265_parser_set_partial_slice_hdr:
+ * @parser: a #GstH265Parser
+ * @partial: whether to only parse the start of slice headers
+ *
+ * In partial mode gst_h265_parser_parse_slice_hdr() stops once it has read
+ * the slice type and picture order count. This is all a parser needs to
+ * delimit access units and find keyframes, and avoids going through the
+ * reference picture sets, prediction weight tables and entry points of
+ * every slice segment.
+ *
+ * The remaining fields of the #GstH265SliceHdr are not set, and
+ * @header_size and @n_emulation_prevention_bytes are 0.
+ *
+ * Since: 1.8
+ */
+void
+gst_h265_parser_set_partial_slice_hdr (GstH265Parser * parser,
+    gboolean partial)
+{
+  g_return_if_fail (parser != NULL);
+
+  parser->partial_slice_hdr = partial;
+}
+
 /**
  * gst_h265_parser_free:
  * @parser: the #GstH265Parser to free
@@ -1192,6 +1260,10 @@ gst_h265_parser_new (void)
 void
 gst_h265_parser_free (GstH265Parser * parser)
 {
+  gst_h265_parser_cache_drop (parser, parser->vps_raw, GST_H265_MAX_VPS_COUNT);
+  gst_h265_parser_cache_drop (parser, parser->sps_raw, GST_H265_MAX_SPS_COUNT);
+  gst_h265_parser_cache_drop (parser, parser->pps_raw, GST_H265_MAX_PPS_COUNT);
+  g_hash_table_unref (parser->ps_cache);
   g_slice_free (GstH265Parser, parser);
   parser = NULL;
 }
@@ -1411,19 +1483,41 @@ gst_h265_parser_parse_nal (GstH265Parser * parser, GstH265NalUnit * nalu)
  *
  * Parses @data, and fills the @vps structure.
  *
+ * If @nalu is identical to the VPS that is currently stored in @parser
+ * with the same id, @vps is filled from it without parsing @nalu again.
+ *
  * Returns: a #GstH265ParserResult
  */
 GstH265ParserResult
 gst_h265_parser_parse_vps (GstH265Parser * parser, GstH265NalUnit * nalu,
     GstH265VPS * vps)
 {
-  GstH265ParserResult res = gst_h265_parse_vps (nalu, vps);
+  GstH265ParserResult res;
+  gint id;
+
+  id = gst_h265_parser_cache_lookup (parser, nalu);
+  if (id >= 0) {
+    GST_LOG ("video parameter set with id: %d unchanged", id);
+
+    *vps = parser->vps[id];
+    parser->last_vps = &parser->vps[id];
+    return GST_H265_PARSER_OK;
+  }
+
+  res = gst_h265_parse_vps (nalu, vps);
 
   if (res == GST_H265_PARSER_OK) {
     GST_DEBUG ("adding video parameter set with id: %d to array", vps->id);
 
     parser->vps[vps->id] = *vps;
     parser->last_vps = &parser->vps[vps->id];
+
+    /* SPS and PPS are parsed according to the VPS they refer to */
+    gst_h265_parser_cache_drop (parser, parser->sps_raw,
+        GST_H265_MAX_SPS_COUNT);
+    gst_h265_parser_cache_drop (parser, parser->pps_raw,
+        GST_H265_MAX_PPS_COUNT);
+    gst_h265_parser_cache_store (parser, parser->vps_raw, vps->id, nalu);
   }
 
   return res;
@@ -1546,20 +1640,42 @@ error:
  *
  * Parses @data, and fills the @sps structure.
  *
+ * If @nalu is identical to the SPS that is currently stored in @parser
+ * with the same id, and its VPS did not change, @sps is filled from it
+ * without parsing @nalu again.
+ *
  * Returns: a #GstH265ParserResult
  */
 GstH265ParserResult
 gst_h265_parser_parse_sps (GstH265Parser * parser, GstH265NalUnit * nalu,
     GstH265SPS * sps, gboolean parse_vui_params)
 {
-  GstH265ParserResult res =
-      gst_h265_parse_sps (parser, nalu, sps, parse_vui_params);
+  GstH265ParserResult res;
+  gint id;
+
+  id = gst_h265_parser_cache_lookup (parser, nalu);
+  if (id >= 0) {
+    GST_LOG ("sequence parameter set with id: %d unchanged", id);
+
+    *sps = parser->sps[id];
+    parser->last_sps = &parser->sps[id];
+    return GST_H265_PARSER_OK;
+  }
+
+  res = gst_h265_parse_sps (parser, nalu, sps, parse_vui_params);
 
   if (res == GST_H265_PARSER_OK) {
     GST_DEBUG ("adding sequence parameter set with id: %d to array", sps->id);
 
     parser->sps[sps->id] = *sps;
     parser->last_sps = &parser->sps[sps->id];
+
+    gst_h265_parser_cache_drop (parser, parser->pps_raw,
+        GST_H265_MAX_PPS_COUNT);
+    if (parse_vui_params)
+      gst_h265_parser_cache_store (parser, parser->sps_raw, sps->id, nalu);
+    else
+      gst_h265_parser_cache_drop (parser, &parser->sps_raw[sps->id], 1);
   }
 
   return res;
@@ -1947,18 +2063,36 @@ error:
  *
  * Parses @data, and fills the @pps structure.
  *
+ * If @nalu is identical to the PPS that is currently stored in @parser
+ * with the same id, and its SPS did not change, @pps is filled from it
+ * without parsing @nalu again.
+ *
  * Returns: a #GstH265ParserResult
  */
 GstH265ParserResult
 gst_h265_parser_parse_pps (GstH265Parser * parser,
     GstH265NalUnit * nalu, GstH265PPS * pps)
 {
-  GstH265ParserResult res = gst_h265_parse_pps (parser, nalu, pps);
+  GstH265ParserResult res;
+  gint id;
+
+  id = gst_h265_parser_cache_lookup (parser, nalu);
+  if (id >= 0) {
+    GST_LOG ("picture parameter set with id: %d unchanged", id);
+
+    *pps = parser->pps[id];
+    parser->last_pps = &parser->pps[id];
+    return GST_H265_PARSER_OK;
+  }
+
+  res = gst_h265_parse_pps (parser, nalu, pps);
   if (res == GST_H265_PARSER_OK) {
     GST_DEBUG ("adding picture parameter set with id: %d to array", pps->id);
 
     parser->pps[pps->id] = *pps;
     parser->last_pps = &parser->pps[pps->id];
+
+    gst_h265_parser_cache_store (parser, parser->pps_raw, pps->id, nalu);
   }
 
   return res;
@@ -1972,7 +2106,8 @@ gst_h265_parser_parse_pps (GstH265Parser * parser,
  *
  * Parses @data, and fills the @slice structure.
  * The resulting @slice_hdr structure shall be deallocated with
- * gst_h265_slice_hdr_free() when it is no longer needed
+ * gst_h265_slice_hdr_free() when it is no longer needed. See
+ * gst_h265_parser_set_partial_slice_hdr() to only parse the start of it.
  *
  * Returns: a #GstH265ParserResult
  */
@@ -2062,6 +2197,9 @@ gst_h265_parser_parse_slice_hdr (GstH265Parser * parser,
     READ_UINT32 (&nr, slice->segment_address, n);
   }
 
+  if (slice->dependent_slice_segment_flag && parser->partial_slice_hdr)
+    goto partial;
+
   if (!slice->dependent_slice_segment_flag) {
     for (i = 0; i < pps->num_extra_slice_header_bits; i++)
       nal_reader_skip (&nr, 1);
@@ -2073,6 +2211,14 @@ gst_h265_parser_parse_slice_hdr (GstH265Parser * parser,
     if (sps->separate_colour_plane_flag == 1)
       READ_UINT8 (&nr, slice->colour_plane_id, 2);
 
+    if (parser->partial_slice_hdr) {
+      if ((nalu->type != GST_H265_NAL_SLICE_IDR_W_RADL)
+          && (nalu->type != GST_H265_NAL_SLICE_IDR_N_LP))
+        READ_UINT16 (&nr, slice->pic_order_cnt_lsb,
+            (sps->log2_max_pic_order_cnt_lsb_minus4 + 4));
+      goto partial;
+    }
+
     if ((nalu->type != GST_H265_NAL_SLICE_IDR_W_RADL)
         && (nalu->type != GST_H265_NAL_SLICE_IDR_N_LP)) {
       READ_UINT16 (&nr, slice->pic_order_cnt_lsb,
@@ -2272,6 +2418,12 @@ gst_h265_parser_parse_slice_hdr (GstH265Parser * parser,
 
   return GST_H265_PARSER_OK;
 
+partial:
+  slice->header_size = 0;
+  slice->n_emulation_prevention_bytes = 0;
+
+  return GST_H265_PARSER_OK;
+
 error:
   GST_WARNING ("error parsing \"Slice header\"");
 
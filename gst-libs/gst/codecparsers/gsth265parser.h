@@ -995,10 +995,21 @@ struct _GstH265Parser
   GstH265VPS *last_vps;
   GstH265SPS *last_sps;
   GstH265PPS *last_pps;
+  gboolean partial_slice_hdr;
+
+  /* raw NAL units of the stored parameter sets, mapped to their id, so
+   * that repeated identical ones are not parsed again */
+  GHashTable *ps_cache;
+  GBytes *vps_raw[GST_H265_MAX_VPS_COUNT];
+  GBytes *sps_raw[GST_H265_MAX_SPS_COUNT];
+  GBytes *pps_raw[GST_H265_MAX_PPS_COUNT];
 };
 
 GstH265Parser *     gst_h265_parser_new               (void);
 
+void                gst_h265_parser_set_partial_slice_hdr (GstH265Parser * parser,
+                                                           gboolean        partial);
+
 GstH265ParserResult gst_h265_parser_identify_nalu      (GstH265Parser  * parser,
                                                         const guint8   * data,
                                                         guint            offset,
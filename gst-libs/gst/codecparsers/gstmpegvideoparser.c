@@ -41,6 +41,7 @@
 
 #include "gstmpegvideoparser.h"
 #include "parserutils.h"
+#include "startcodeutils.h"
 
 #include <string.h>
 #include <gst/base/gstbitreader.h>
@@ -178,40 +179,6 @@ set_fps_from_code (GstMpegVideoSequenceHdr * seqhdr, guint8 fps_code)
   }
 }
 
-/* @size and @offset are wrt current reader position */
-static inline gint
-scan_for_start_codes (const GstByteReader * reader, guint offset, guint size)
-{
-  const guint8 *data;
-  guint i = 0;
-
-  g_assert ((guint64) offset + size <= reader->size - reader->byte);
-
-  /* we can't find the pattern with less than 4 bytes */
-  if (G_UNLIKELY (size < 4))
-    return -1;
-
-  data = reader->data + reader->byte + offset;
-
-  while (i <= (size - 4)) {
-    if (data[i + 2] > 1) {
-      i += 3;
-    } else if (data[i + 1]) {
-      i += 2;
-    } else if (data[i] || data[i + 2] != 1) {
-      i++;
-    } else {
-      break;
-    }
-  }
-
-  if (i <= (size - 4))
-    return offset + i;
-
-  /* nothing found */
-  return -1;
-}
-
 /****** API *******/
 
 /**
@@ -245,7 +212,7 @@ gst_mpeg_video_parse (GstMpegVideoPacket * packet,
   size -= offset;
   gst_byte_reader_init (&br, &data[offset], size);
 
-  off = scan_for_start_codes (&br, 0, size);
+  off = scan_for_start_codes (&data[offset], size);
 
   if (off < 0) {
     GST_DEBUG ("No start code prefix in this buffer");
@@ -264,7 +231,7 @@ gst_mpeg_video_parse (GstMpegVideoPacket * packet,
 
   /* try to find end of packet */
   size -= off + 4;
-  off = scan_for_start_codes (&br, 0, size);
+  off = scan_for_start_codes (&data[packet->offset], size);
 
   if (off > 0)
     packet->size = off;
@@ -278,6 +245,49 @@ failed:
   }
 }
 
+/**
+ * gst_mpeg_video_parse_skip_slices:
+ * @packet: a #GstMpegVideoPacket to fill with the data and offset of the
+ *     next packet found
+ * @data: The data to parse
+ * @size: The size of @data
+ * @offset: The offset from which to start parsing
+ *
+ * Same as gst_mpeg_video_parse(), except that slice start codes are
+ * skipped: @packet is the first packet after @offset that is not a slice.
+ * This allows finding the end of a picture without going through each of
+ * its slices.
+ *
+ * Returns: TRUE if a start code other than a slice one was found,
+ *     otherwise FALSE.
+ *
+ * Since: 1.8
+ */
+gboolean
+gst_mpeg_video_parse_skip_slices (GstMpegVideoPacket * packet,
+    const guint8 * data, gsize size, guint offset)
+{
+  gint off;
+
+  INITIALIZE_DEBUG_CATEGORY;
+
+  while (offset < size) {
+    off = scan_for_start_codes (&data[offset], size - offset);
+    if (off < 0)
+      break;
+
+    offset += off;
+    /* a start code is always followed by at least its type here */
+    if (!GST_MPEG_VIDEO_PACKET_IS_SLICE (data[offset + 3]))
+      return gst_mpeg_video_parse (packet, data, size, offset);
+
+    offset += 4;
+  }
+
+  GST_DEBUG ("No start code other than slices in this buffer");
+  return FALSE;
+}
+
 /**
  * gst_mpeg_video_packet_parse_sequence_header:
  * @packet: The #GstMpegVideoPacket that carries the data
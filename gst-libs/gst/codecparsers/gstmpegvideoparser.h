@@ -487,6 +487,9 @@ struct _GstMpegVideoPacket
 gboolean gst_mpeg_video_parse                         (GstMpegVideoPacket * packet,
                                                        const guint8 * data, gsize size, guint offset);
 
+gboolean gst_mpeg_video_parse_skip_slices             (GstMpegVideoPacket * packet,
+                                                       const guint8 * data, gsize size, guint offset);
+
 gboolean gst_mpeg_video_packet_parse_sequence_header    (const GstMpegVideoPacket * packet,
                                                          GstMpegVideoSequenceHdr * seqhdr);
 
@@ -73,8 +73,40 @@ nal_reader_init (NalReader * nr, const guint8 * data, guint size)
   nr->byte = 0;
   nr->bits_in_cache = 0;
   /* fill with something other than 0 to detect emulation prevention bytes */
-  nr->first_byte = 0xff;
-  nr->cache = 0xff;
+  nr->cache = G_MAXUINT64;
+}
+
+/* Loads as many whole bytes as fit in the cache with a single 64-bit read.
+ * This is only done when none of them is 0x03, so that no emulation
+ * prevention byte is ever skipped here and the bytes are used as is. The
+ * emulation prevention bytes are handled by the byte by byte path, only
+ * when the following byte is needed, which keeps nal_reader_get_pos() and
+ * nal_reader_get_epb_count() consistent with what has been read so far */
+static inline gboolean
+nal_reader_refill (NalReader * nr)
+{
+  guint n = (64 - nr->bits_in_cache) / 8;
+  guint64 bytes, x;
+
+  if (n == 0 || nr->byte + 8 > nr->size)
+    return FALSE;
+
+  /* keep the shift below the width of the cache */
+  n = MIN (n, 7);
+
+  bytes = GST_READ_UINT64_BE (nr->data + nr->byte) >> (64 - n * 8);
+
+  /* bytes not loaded are 0 and become 0x03 here, they never match */
+  x = bytes ^ G_GUINT64_CONSTANT (0x0303030303030303);
+  if ((x - G_GUINT64_CONSTANT (0x0101010101010101)) & ~x &
+      G_GUINT64_CONSTANT (0x8080808080808080))
+    return FALSE;
+
+  nr->cache = (nr->cache << (n * 8)) | bytes;
+  nr->byte += n;
+  nr->bits_in_cache += n * 8;
+
+  return TRUE;
 }
 
 inline gboolean
@@ -90,6 +122,9 @@ nal_reader_read (NalReader * nr, guint nbits)
     guint8 byte;
     gboolean check_three_byte;
 
+    if (nal_reader_refill (nr))
+      continue;
+
     check_three_byte = TRUE;
   next_byte:
     if (G_UNLIKELY (nr->byte >= nr->size))
@@ -98,15 +133,13 @@ nal_reader_read (NalReader * nr, guint nbits)
     byte = nr->data[nr->byte++];
 
     /* check if the byte is a emulation_prevention_three_byte */
-    if (check_three_byte && byte == 0x03 && nr->first_byte == 0x00 &&
-        ((nr->cache & 0xff) == 0)) {
+    if (check_three_byte && byte == 0x03 && ((nr->cache & 0xffff) == 0)) {
       /* next byte goes unconditionally to the cache, even if it's 0x03 */
       check_three_byte = FALSE;
       nr->n_epb++;
       goto next_byte;
     }
-    nr->cache = (nr->cache << 8) | nr->first_byte;
-    nr->first_byte = byte;
+    nr->cache = (nr->cache << 8) | byte;
     nr->bits_in_cache += 8;
   }
 
@@ -120,6 +153,14 @@ nal_reader_skip (NalReader * nr, guint nbits)
 {
   g_assert (nbits <= 8 * sizeof (nr->cache));
 
+  /* the cache can't hold more than 64 bits, leftovers included */
+  if (nbits > 32) {
+    if (G_UNLIKELY (!nal_reader_read (nr, 32)))
+      return FALSE;
+    nr->bits_in_cache -= 32;
+    nbits -= 32;
+  }
+
   if (G_UNLIKELY (!nal_reader_read (nr, nbits)))
     return FALSE;
 
@@ -173,11 +214,15 @@ nal_reader_get_bits_uint##bits (NalReader *nr, guint##bits *val, guint nbits) \
   if (!nal_reader_read (nr, nbits)) \
     return FALSE; \
   \
+  if (G_UNLIKELY (nbits == 0)) { \
+    *val = 0; \
+    return TRUE; \
+  } \
+  \
   /* bring the required bits down and truncate */ \
   shift = nr->bits_in_cache - nbits; \
-  *val = nr->first_byte >> shift; \
+  *val = nr->cache >> shift; \
   \
-  *val |= nr->cache << (8 - shift); \
   /* mask out required bits */ \
   if (nbits < bits) \
     *val &= ((guint##bits)1 << nbits) - 1; \
@@ -210,6 +255,33 @@ nal_reader_get_ue (NalReader * nr, guint32 * val)
   guint8 bit;
   guint32 value;
 
+  /* Fast path: the whole code is in the cache, count the leading zeros
+   * at once */
+  if (nr->bits_in_cache < 32)
+    nal_reader_refill (nr);
+
+  if (G_LIKELY (nr->bits_in_cache > 0)) {
+    /* unread bits, left aligned */
+    guint64 window = nr->cache << (64 - nr->bits_in_cache);
+
+    if (window != 0) {
+#if defined (__GNUC__)
+      i = __builtin_clzll (window);
+#else
+      i = 63 - g_bit_nth_msf (window, -1);
+#endif
+
+      if (i < 32 && 2 * i + 1 <= nr->bits_in_cache) {
+        nr->bits_in_cache -= 2 * i + 1;
+        /* 1 followed by i bits, minus 1 */
+        *val = ((nr->cache >> nr->bits_in_cache) &
+            ((G_GUINT64_CONSTANT (1) << (i + 1)) - 1)) - 1;
+        return TRUE;
+      }
+      i = 0;
+    }
+  }
+
   if (G_UNLIKELY (!nal_reader_get_bits_uint8 (nr, &bit, 1)))
     return FALSE;
 
@@ -249,7 +321,8 @@ nal_reader_get_se (NalReader * nr, gint32 * val)
 gboolean
 nal_reader_is_byte_aligned (NalReader * nr)
 {
-  if (nr->bits_in_cache != 0)
+  /* only whole bytes are loaded in the cache */
+  if (nr->bits_in_cache % 8 != 0)
     return FALSE;
   return TRUE;
 }
@@ -296,14 +369,3 @@ nal_reader_has_more_data (NalReader * nr)
 }
 
 /***********  end of nal parser ***************/
-
-inline gint
-scan_for_start_codes (const guint8 * data, guint size)
-{
-  GstByteReader br;
-  gst_byte_reader_init (&br, data, size);
-
-  /* NALU not empty, so we can at least expect 1 (even 2) bytes following sc */
-  return gst_byte_reader_masked_scan_uint32 (&br, 0xffffff00, 0x00000100,
-      0, size);
-}
@@ -48,9 +48,8 @@ typedef struct
 
   guint n_epb;                  /* Number of emulation prevention bytes */
   guint byte;                   /* Byte position */
-  guint bits_in_cache;          /* bitpos in the cache of next bit */
-  guint8 first_byte;
-  guint64 cache;                /* cached bytes */
+  guint bits_in_cache;          /* number of unread bits in the cache */
+  guint64 cache;                /* cached bytes, the last read in the lowest bits */
 } NalReader;
 
 void nal_reader_init (NalReader * nr, const guint8 * data, guint size);
@@ -158,5 +157,3 @@ gboolean nal_reader_get_se (NalReader * nr, gint32 * val);
   CHECK_ALLOWED (tmp, min, max); \
   val = tmp; \
 }
-
-gint scan_for_start_codes (const guint8 * data, guint size);
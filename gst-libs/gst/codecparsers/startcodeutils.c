@@ -0,0 +1,108 @@
+/* Gstreamer
+ * Copyright (C) <2011> Intel Corporation
+ * Copyright (C) <2011> Collabora Ltd.
+ * Copyright (C) <2011> Thibault Saunier <thibault.saunier@collabora.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * Start code scanning shared by the NAL based and the MPEG-1/2, MPEG-4 and
+ * VC-1 parsers. It lives apart from nalutils and parserutils because their
+ * reading macros can't be used in the same file.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "startcodeutils.h"
+
+#if defined (__SSE2__)
+#include <emmintrin.h>
+#elif defined (__ARM_NEON) || defined (__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+/* Returns the offset of the first 00 00 01 start code prefix in @data that
+ * is followed by at least one more byte, or -1 if there is none. This gives
+ * the same result as gst_byte_reader_masked_scan_uint32 (br, 0xffffff00,
+ * 0x00000100, 0, size) but doesn't look at every byte: 16 positions are
+ * checked at once with SSE2 or NEON, and the scalar version skips ahead as
+ * soon as the third byte can't be part of a start code */
+gint
+scan_for_start_codes (const guint8 * data, guint size)
+{
+  guint i = 0;
+
+  /* NALU not empty, so we can at least expect 1 (even 2) bytes following sc */
+  if (G_UNLIKELY (size < 4))
+    return -1;
+
+#if defined (__SSE2__)
+  {
+    const __m128i zero = _mm_setzero_si128 ();
+    const __m128i one = _mm_set1_epi8 (1);
+
+    /* 16 candidate positions, each needing 3 more bytes after it */
+    for (; i + 19 <= size; i += 16) {
+      __m128i b0 = _mm_loadu_si128 ((const __m128i *) (data + i));
+      __m128i b1 = _mm_loadu_si128 ((const __m128i *) (data + i + 1));
+      __m128i b2 = _mm_loadu_si128 ((const __m128i *) (data + i + 2));
+      gint mask;
+
+      mask = _mm_movemask_epi8 (_mm_and_si128 (_mm_and_si128 (_mm_cmpeq_epi8
+                  (b0, zero), _mm_cmpeq_epi8 (b1, zero)), _mm_cmpeq_epi8 (b2,
+                  one)));
+      if (mask)
+        return i + g_bit_nth_lsf (mask, -1);
+    }
+  }
+#elif defined (__ARM_NEON) || defined (__ARM_NEON__)
+  {
+    const uint8x16_t zero = vdupq_n_u8 (0);
+    const uint8x16_t one = vdupq_n_u8 (1);
+
+    for (; i + 19 <= size; i += 16) {
+      uint8x16_t b0 = vld1q_u8 (data + i);
+      uint8x16_t b1 = vld1q_u8 (data + i + 1);
+      uint8x16_t b2 = vld1q_u8 (data + i + 2);
+      uint64x2_t m;
+
+      m = vreinterpretq_u64_u8 (vandq_u8 (vandq_u8 (vceqq_u8 (b0, zero),
+                  vceqq_u8 (b1, zero)), vceqq_u8 (b2, one)));
+      /* there is no movemask, the scalar loop finds the exact position */
+      if (vgetq_lane_u64 (m, 0) | vgetq_lane_u64 (m, 1))
+        break;
+    }
+  }
+#endif
+
+  while (i <= size - 4) {
+    if (data[i + 2] > 1) {
+      i += 3;
+    } else if (data[i + 1]) {
+      i += 2;
+    } else if (data[i] || data[i + 2] != 1) {
+      i++;
+    } else {
+      return i;
+    }
+  }
+
+  /* nothing found */
+  return -1;
+}
@@ -32,6 +32,8 @@
 
 static GstFlowReturn gst_rtp_onvif_parse_chain (GstPad * pad,
     GstObject * parent, GstBuffer * buf);
+static GstFlowReturn gst_rtp_onvif_parse_chain_list (GstPad * pad,
+    GstObject * parent, GstBufferList * list);
 
 static GstStaticPadTemplate sink_template_factory =
 GST_STATIC_PAD_TEMPLATE ("sink",
@@ -74,6 +76,8 @@ gst_rtp_onvif_parse_init (GstRtpOnvifParse * self)
   self->sinkpad =
       gst_pad_new_from_static_template (&sink_template_factory, "sink");
   gst_pad_set_chain_function (self->sinkpad, gst_rtp_onvif_parse_chain);
+  gst_pad_set_chain_list_function (self->sinkpad,
+      gst_rtp_onvif_parse_chain_list);
   gst_element_add_pad (GST_ELEMENT (self), self->sinkpad);
   GST_PAD_SET_PROXY_CAPS (self->sinkpad);
 
@@ -85,54 +89,69 @@ gst_rtp_onvif_parse_init (GstRtpOnvifParse * self)
 #define EXTENSION_ID 0xABAC
 #define EXTENSION_SIZE 3
 
+/* Reads the flags byte of the extension, reading only the RTP header and
+ * not mapping the payload. Returns FALSE if the packet has no ONVIF
+ * extension */
 static gboolean
-handle_buffer (GstRtpOnvifParse * self, GstBuffer * buf)
+read_flags (GstBuffer * buf, guint8 * flags)
 {
-  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
-  guint8 *data;
-  guint16 bits;
-  guint wordlen;
-  guint8 flags;
-  /*
-     guint64 timestamp;
-     guint8 cseq;
-   */
-
-  if (!gst_rtp_buffer_map (buf, GST_MAP_READ, &rtp)) {
-    GST_ELEMENT_ERROR (self, STREAM, FAILED,
-        ("Failed to map RTP buffer"), (NULL));
+  guint8 header[12];
+  guint8 ext[4 + EXTENSION_SIZE * 4];
+  gsize hdrlen;
+
+  if (gst_buffer_extract (buf, 0, header, 12) != 12 ||
+      (header[0] >> 6) != GST_RTP_VERSION || !(header[0] & 0x10))
+    return FALSE;
+
+  /* fixed header and CSRCs */
+  hdrlen = 12 + (header[0] & 0x0f) * 4;
+  if (gst_buffer_extract (buf, hdrlen, ext, sizeof (ext)) != sizeof (ext))
+    return FALSE;
+
+  if (GST_READ_UINT16_BE (ext) != EXTENSION_ID ||
+      GST_READ_UINT16_BE (ext + 2) != EXTENSION_SIZE)
     return FALSE;
-  }
 
-  /* Check if the ONVIF RTP extension is present in the packet */
-  if (!gst_rtp_buffer_get_extension_data (&rtp, &bits, (gpointer) & data,
-          &wordlen))
-    goto out;
+  /* timestamp = GST_READ_UINT64_BE (ext + 4);  TODO */
+  *flags = GST_READ_UINT8 (ext + 12);
+  /* cseq = GST_READ_UINT8 (ext + 13);  TODO */
 
-  if (bits != EXTENSION_ID || wordlen != EXTENSION_SIZE)
-    goto out;
+  return TRUE;
+}
 
-  /* timestamp = GST_READ_UINT64_BE (data);  TODO */
-  flags = GST_READ_UINT8 (data + 8);
-  /* cseq = GST_READ_UINT8 (data + 9);  TODO */
+/* Updates the flags of *@buf from the extension, making it writable only
+ * if they change */
+static gboolean
+handle_buffer (GstBuffer ** buf, guint idx, gpointer user_data)
+{
+  GstBufferFlags set = 0, unset = 0;
+  guint8 flags;
+
+  if (!read_flags (*buf, &flags))
+    return TRUE;
 
   /* C */
   if (flags & (1 << 7))
-    GST_BUFFER_FLAG_UNSET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
+    unset |= GST_BUFFER_FLAG_DELTA_UNIT;
   else
-    GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
+    set |= GST_BUFFER_FLAG_DELTA_UNIT;
 
   /* E */
   /* if (flags & (1 << 6));  TODO */
 
   /* D */
   if (flags & (1 << 5))
-    GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DISCONT);
+    set |= GST_BUFFER_FLAG_DISCONT;
   else
-    GST_BUFFER_FLAG_UNSET (buf, GST_BUFFER_FLAG_DISCONT);
+    unset |= GST_BUFFER_FLAG_DISCONT;
+
+  if ((GST_BUFFER_FLAGS (*buf) & (set | unset)) != set) {
+    /* only the metadata is copied, not the memory */
+    *buf = gst_buffer_make_writable (*buf);
+    GST_BUFFER_FLAG_SET (*buf, set);
+    GST_BUFFER_FLAG_UNSET (*buf, unset);
+  }
 
-out:
-  gst_rtp_buffer_unmap (&rtp);
   return TRUE;
 }
 
@@ -141,10 +160,19 @@ gst_rtp_onvif_parse_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
 {
   GstRtpOnvifParse *self = GST_RTP_ONVIF_PARSE (parent);
 
-  if (!handle_buffer (self, buf)) {
-    gst_buffer_unref (buf);
-    return GST_FLOW_ERROR;
-  }
+  handle_buffer (&buf, 0, self);
 
   return gst_pad_push (self->srcpad, buf);
 }
+
+static GstFlowReturn
+gst_rtp_onvif_parse_chain_list (GstPad * pad, GstObject * parent,
+    GstBufferList * list)
+{
+  GstRtpOnvifParse *self = GST_RTP_ONVIF_PARSE (parent);
+
+  list = gst_buffer_list_make_writable (list);
+  gst_buffer_list_foreach (list, handle_buffer, self);
+
+  return gst_pad_push_list (self->srcpad, list);
+}
@@ -287,14 +287,101 @@ gst_rtp_onvif_timestamp_init (GstRtpOnvifTimestamp * self)
 #define EXTENSION_ID 0xABAC
 #define EXTENSION_SIZE 3
 
+/* Writes the extension data: the NTP timestamp, the C E D mbz byte, the low
+ * byte of the CSeq and padding */
+static void
+write_extension (guint8 * data, guint64 time, guint8 field, guint8 cseq)
+{
+  GST_WRITE_UINT16_BE (data, EXTENSION_ID);
+  GST_WRITE_UINT16_BE (data + 2, EXTENSION_SIZE);
+  GST_WRITE_UINT64_BE (data + 4, time);
+  GST_WRITE_UINT8 (data + 12, field);
+  GST_WRITE_UINT8 (data + 13, cseq);
+  memset (data + 14, 0, 2);
+}
+
+/* Sets the extension of the RTP packet in @buf. Only the header is read
+ * and written: the extension is rewritten in place if the packet already
+ * has one of the right size in memory we own, else a new header is put in
+ * front of the payload memory */
 static gboolean
-handle_buffer (GstRtpOnvifTimestamp * self, GstBuffer * buf,
+set_extension (GstRtpOnvifTimestamp * self, GstBuffer ** buf, guint64 time,
+    guint8 field)
+{
+  guint8 header[12 + 15 * 4 + 4 + EXTENSION_SIZE * 4];
+  gsize size, hdrlen, old_ext_size = 0;
+  GstBuffer *out;
+  GstMemory *mem;
+  GstMapInfo map;
+
+  size = gst_buffer_get_size (*buf);
+  if (gst_buffer_extract (*buf, 0, header, 12) != 12 ||
+      (header[0] >> 6) != GST_RTP_VERSION)
+    goto invalid;
+
+  /* fixed header and CSRCs */
+  hdrlen = 12 + (header[0] & 0x0f) * 4;
+
+  if (header[0] & 0x10) {
+    guint8 ext[4];
+
+    if (gst_buffer_extract (*buf, hdrlen, ext, 4) != 4)
+      goto invalid;
+    old_ext_size = 4 + GST_READ_UINT16_BE (ext + 2) * 4;
+  }
+
+  if (hdrlen + old_ext_size > size)
+    goto invalid;
+
+  if (old_ext_size == 4 + EXTENSION_SIZE * 4 && gst_buffer_is_writable (*buf)) {
+    guint idx, len;
+    gsize skip;
+
+    if (gst_buffer_find_memory (*buf, hdrlen, old_ext_size, &idx, &len,
+            &skip) && len == 1
+        && gst_buffer_is_memory_range_writable (*buf, idx, 1)) {
+      if (gst_buffer_map_range (*buf, idx, 1, &map, GST_MAP_WRITE)) {
+        write_extension (map.data + skip, time, field, self->prop_cseq);
+        gst_buffer_unmap (*buf, &map);
+        return TRUE;
+      }
+    }
+  }
+
+  /* a new header with the extension, followed by the memory of the
+   * payload of the original packet */
+  gst_buffer_extract (*buf, 0, header, hdrlen);
+  header[0] |= 0x10;
+  write_extension (header + hdrlen, time, field, self->prop_cseq);
+
+  mem = gst_allocator_alloc (NULL, hdrlen + 4 + EXTENSION_SIZE * 4, NULL);
+  gst_memory_map (mem, &map, GST_MAP_WRITE);
+  memcpy (map.data, header, map.size);
+  gst_memory_unmap (mem, &map);
+
+  out = gst_buffer_new ();
+  gst_buffer_append_memory (out, mem);
+  gst_buffer_copy_into (out, *buf, GST_BUFFER_COPY_MEMORY,
+      hdrlen + old_ext_size, size - hdrlen - old_ext_size);
+  gst_buffer_copy_into (out, *buf, GST_BUFFER_COPY_METADATA, 0, -1);
+
+  gst_buffer_unref (*buf);
+  *buf = out;
+
+  return TRUE;
+
+invalid:
+  GST_ELEMENT_ERROR (self, STREAM, FAILED, ("Invalid RTP packet"),
+      ("packet of %" G_GSIZE_FORMAT " bytes", size));
+  return FALSE;
+}
+
+/* @buf: (inout) (transfer full): the buffer, replaced if its header had to
+ * be reallocated */
+static gboolean
+handle_buffer (GstRtpOnvifTimestamp * self, GstBuffer ** buf,
     gboolean end_contiguous)
 {
-  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
-  guint8 *data;
-  guint16 bits;
-  guint wordlen;
   guint64 time;
   guint8 field = 0;
 
@@ -330,43 +417,22 @@ handle_buffer (GstRtpOnvifTimestamp * self, GstBuffer * buf,
     return FALSE;
   }
 
-  if (!gst_rtp_buffer_map (buf, GST_MAP_READWRITE, &rtp)) {
-    GST_ELEMENT_ERROR (self, STREAM, FAILED,
-        ("Failed to map RTP buffer"), (NULL));
-    return FALSE;
-  }
-
-  if (!gst_rtp_buffer_set_extension_data (&rtp, EXTENSION_ID, EXTENSION_SIZE)) {
-    GST_ELEMENT_ERROR (self, STREAM, FAILED, ("Failed to set extension data"),
-        (NULL));
-    gst_rtp_buffer_unmap (&rtp);
-    return FALSE;
-  }
-
-  if (!gst_rtp_buffer_get_extension_data (&rtp, &bits, (gpointer) & data,
-          &wordlen)) {
-    GST_ELEMENT_ERROR (self, STREAM, FAILED, ("Failed to get extension data"),
-        (NULL));
-    gst_rtp_buffer_unmap (&rtp);
-    return FALSE;
-  }
-
   /* NTP timestamp */
-  if (GST_BUFFER_DTS_IS_VALID (buf)) {
+  if (GST_BUFFER_DTS_IS_VALID (*buf)) {
     time = gst_segment_to_running_time (&self->segment, GST_FORMAT_TIME,
-        GST_BUFFER_DTS (buf));
-  } else if (GST_BUFFER_PTS_IS_VALID (buf)) {
+        GST_BUFFER_DTS (*buf));
+  } else if (GST_BUFFER_PTS_IS_VALID (*buf)) {
     time = gst_segment_to_running_time (&self->segment, GST_FORMAT_TIME,
-        GST_BUFFER_PTS (buf));
+        GST_BUFFER_PTS (*buf));
   } else {
     GST_ERROR_OBJECT (self,
         "Buffer doesn't contain any valid DTS or PTS timestamp");
-    goto done;
+    return TRUE;
   }
 
   if (time == GST_CLOCK_TIME_NONE) {
     GST_ERROR_OBJECT (self, "Failed to get running time");
-    goto done;
+    return TRUE;
   }
 
   /* add the offset (in seconds) */
@@ -377,41 +443,30 @@ handle_buffer (GstRtpOnvifTimestamp * self, GstBuffer * buf,
   time = gst_util_uint64_scale (time, (G_GINT64_CONSTANT (1) << 32),
       GST_SECOND);
 
-  GST_DEBUG_OBJECT (self, "timestamp: %" G_GUINT64_FORMAT, time);
-
-  GST_WRITE_UINT64_BE (data, time);
+  GST_LOG_OBJECT (self, "timestamp: %" G_GUINT64_FORMAT, time);
 
   /* The next byte is composed of: C E D mbz (5 bits) */
 
   /* Set C if the buffer does *not* have the DELTA_UNIT flag as it means
    * that's a key frame (or 'clean point'). */
-  if (!GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT)) {
-    GST_DEBUG_OBJECT (self, "set C flag");
+  if (!GST_BUFFER_FLAG_IS_SET (*buf, GST_BUFFER_FLAG_DELTA_UNIT)) {
+    GST_LOG_OBJECT (self, "set C flag");
     field |= (1 << 7);
   }
 
   /* Set E if the next buffer has DISCONT */
   if (end_contiguous) {
-    GST_DEBUG_OBJECT (self, "set E flag");
+    GST_LOG_OBJECT (self, "set E flag");
     field |= (1 << 6);
   }
 
   /* Set D if the buffer has the DISCONT flag */
-  if (GST_BUFFER_IS_DISCONT (buf)) {
-    GST_DEBUG_OBJECT (self, "set D flag");
+  if (GST_BUFFER_IS_DISCONT (*buf)) {
+    GST_LOG_OBJECT (self, "set D flag");
     field |= (1 << 5);
   }
 
-  GST_WRITE_UINT8 (data + 8, field);
-
-  /* CSeq (low-order byte) */
-  GST_WRITE_UINT8 (data + 9, (guchar) self->prop_cseq);
-
-  memset (data + 10, 0, 3);
-
-done:
-  gst_rtp_buffer_unmap (&rtp);
-  return TRUE;
+  return set_extension (self, buf, time, field);
 }
 
 /* @buf: (transfer all) */
@@ -419,7 +474,7 @@ static GstFlowReturn
 handle_and_push_buffer (GstRtpOnvifTimestamp * self, GstBuffer * buf,
     gboolean end_contiguous)
 {
-  if (!handle_buffer (self, buf, end_contiguous)) {
+  if (!handle_buffer (self, &buf, end_contiguous)) {
     gst_buffer_unref (buf);
     return GST_FLOW_ERROR;
   }
@@ -459,13 +514,23 @@ handle_and_push_buffer_list (GstRtpOnvifTimestamp * self,
 {
   GstBuffer *buf;
 
-  /* Set the extension on the *first* buffer */
-  buf = gst_buffer_list_get (list, 0);
-  if (!handle_buffer (self, buf, end_contiguous)) {
+  if (gst_buffer_list_length (list) == 0)
+    return gst_pad_push_list (self->srcpad, list);
+
+  /* Set the extension on the *first* buffer. It is taken out of the list
+   * so that it can be rewritten in place if we hold the only reference */
+  list = gst_buffer_list_make_writable (list);
+  buf = gst_buffer_ref (gst_buffer_list_get (list, 0));
+  gst_buffer_list_remove (list, 0, 1);
+
+  if (!handle_buffer (self, &buf, end_contiguous)) {
+    gst_buffer_unref (buf);
     gst_buffer_list_unref (list);
     return GST_FLOW_ERROR;
   }
 
+  gst_buffer_list_insert (list, 0, buf);
+
   return gst_pad_push_list (self->srcpad, list);
 }
 
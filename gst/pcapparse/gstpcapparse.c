@@ -20,10 +20,21 @@
 /**
  * SECTION:element-pcapparse
  *
- * Extracts payloads from Ethernet-encapsulated IP packets.
+ * Extracts payloads from Ethernet-encapsulated IP packets, from pcap or
+ * pcapng captures.
  * Use #GstPcapParse:src-ip, #GstPcapParse:dst-ip,
  * #GstPcapParse:src-port and #GstPcapParse:dst-port to restrict which packets
- * should be included.
+ * should be included, or #GstPcapParse:filter for more complex selections.
+ *
+ * When upstream supports it, as filesrc does, the capture is read in big
+ * blocks in pull mode and the payloads are output as sub-buffers of those
+ * blocks.
+ *
+ * With #GstPcapParse:replay, the payloads are sent at the pace they were
+ * captured, optionally sped up with #GstPcapParse:replay-speed, in one
+ * buffer list per #GstPcapParse:batch-duration of capture time. This makes
+ * it possible to replay a capture at a high bitrate towards a sink with
+ * sync=false, like a load generator.
  *
  * <refsect2>
  * <title>Example pipelines</title>
@@ -32,6 +43,14 @@
  * ! ffdec_h264 ! fakesink
  * ]| Read from a pcap dump file using filesrc, extract the raw UDP packets,
  * depayload and decode them.
+ * |[
+ * gst-launch-1.0 filesrc location=multicast.pcapng ! pcapparse
+ * filter="udp and dst host 239.0.0.1 and dst port 5004" ! tsdemux ! fakesink
+ * ]| Extract one MPEG-TS multicast stream from a pcapng capture.
+ * |[
+ * gst-launch-1.0 filesrc location=multicast.pcap ! pcapparse replay=true
+ * replay-speed=4.0 ! udpsink host=127.0.0.1 port=5004 sync=false
+ * ]| Replay the UDP payloads of a capture four times faster than captured.
  * </refsect2>
  */
 
@@ -63,9 +82,67 @@ enum
   PROP_SRC_PORT,
   PROP_DST_PORT,
   PROP_CAPS,
-  PROP_TS_OFFSET
+  PROP_TS_OFFSET,
+  PROP_FILTER,
+  PROP_REPLAY,
+  PROP_REPLAY_SPEED,
+  PROP_BATCH_DURATION,
+  PROP_STATS
 };
 
+#define DEFAULT_REPLAY          FALSE
+#define DEFAULT_REPLAY_SPEED    1.0
+#define DEFAULT_BATCH_DURATION  GST_MSECOND
+
+/* Size of the blocks read in pull mode */
+#define PULL_BLOCK_SIZE (1024 * 1024)
+
+/* pcapng block types */
+#define PCAPNG_SECTION_HEADER_BLOCK   0x0A0D0D0A
+#define PCAPNG_INTERFACE_DESC_BLOCK   0x00000001
+#define PCAPNG_SIMPLE_PACKET_BLOCK    0x00000003
+#define PCAPNG_ENHANCED_PACKET_BLOCK  0x00000006
+
+#define PCAPNG_BYTE_ORDER_MAGIC       0x1A2B3C4D
+#define PCAPNG_OPTION_IF_TSRESOL      9
+
+typedef struct
+{
+  GstPcapParseLinktype linktype;
+  guint32 snaplen;
+  /* timestamp units per second */
+  guint64 ts_units;
+} GstPcapParseInterface;
+
+typedef enum
+{
+  FILTER_PROTO,
+  FILTER_HOST,
+  FILTER_NET,
+  FILTER_PORT
+} GstPcapParseFilterType;
+
+typedef enum
+{
+  FILTER_DIR_ANY,
+  FILTER_DIR_SRC,
+  FILTER_DIR_DST
+} GstPcapParseFilterDir;
+
+/* One primitive of the filter. The filter is an array of alternatives,
+ * each an array of primitives that must all match */
+typedef struct
+{
+  GstPcapParseFilterType type;
+  GstPcapParseFilterDir dir;
+  gboolean negate;
+  guint8 proto;
+  guint16 port;
+  /* network byte order */
+  guint32 addr;
+  guint32 mask;
+} GstPcapParseFilterTerm;
+
 GST_DEBUG_CATEGORY_STATIC (gst_pcap_parse_debug);
 #define GST_CAT_DEFAULT gst_pcap_parse_debug
 
@@ -88,9 +165,16 @@ static GstStateChangeReturn
 gst_pcap_parse_change_state (GstElement * element, GstStateChange transition);
 
 static void gst_pcap_parse_reset (GstPcapParse * self);
+static void gst_pcap_parse_set_flushing (GstPcapParse * self,
+    gboolean flushing);
 
 static GstFlowReturn gst_pcap_parse_chain (GstPad * pad,
     GstObject * parent, GstBuffer * buffer);
+static gboolean gst_pcap_parse_sink_activate (GstPad * pad,
+    GstObject * parent);
+static gboolean gst_pcap_parse_sink_activate_mode (GstPad * pad,
+    GstObject * parent, GstPadMode mode, gboolean active);
+static void gst_pcap_parse_loop (GstPad * pad);
 static gboolean gst_pcap_sink_event (GstPad * pad,
     GstObject * parent, GstEvent * event);
 
@@ -138,6 +222,82 @@ gst_pcap_parse_class_init (GstPcapParseClass * klass)
           "Relative timestamp offset (ns) to apply (-1 = use absolute packet time)",
           -1, G_MAXINT64, -1, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstPcapParse:filter:
+   *
+   * Only output the payload of the packets matching this expression, in a
+   * subset of the pcap-filter syntax: the primitives "udp", "tcp",
+   * "[src|dst] host ADDR", "[src|dst] net ADDR/LEN" and
+   * "[src|dst] port PORT", optionally negated with "not", combined with
+   * "and" and "or", "and" binding tighter. The packets are filtered before
+   * any buffer is created for them.
+   *
+   * Since: 1.8
+   */
+  g_object_class_install_property (gobject_class, PROP_FILTER,
+      g_param_spec_string ("filter", "Filter",
+          "Only output packets matching this expression "
+          "(e.g. \"udp and dst host 239.0.0.1 and dst port 5004\")", "",
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstPcapParse:replay:
+   *
+   * Push the payloads at the pace they were captured, against the system
+   * clock, in one buffer list per #GstPcapParse:batch-duration of capture
+   * time.
+   *
+   * Since: 1.8
+   */
+  g_object_class_install_property (gobject_class, PROP_REPLAY,
+      g_param_spec_boolean ("replay", "Replay",
+          "Push the payloads at the pace they were captured",
+          DEFAULT_REPLAY, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstPcapParse:replay-speed:
+   *
+   * How much faster than captured the payloads are replayed.
+   *
+   * Since: 1.8
+   */
+  g_object_class_install_property (gobject_class, PROP_REPLAY_SPEED,
+      g_param_spec_double ("replay-speed", "Replay speed",
+          "How much faster than captured to replay (2.0 = twice as fast)",
+          0.001, 1000.0, DEFAULT_REPLAY_SPEED,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstPcapParse:batch-duration:
+   *
+   * When replaying, the payloads captured within this duration of the first
+   * one of a batch are pushed together in one buffer list.
+   *
+   * Since: 1.8
+   */
+  g_object_class_install_property (gobject_class, PROP_BATCH_DURATION,
+      g_param_spec_uint64 ("batch-duration", "Batch duration",
+          "Capture time (ns) of the payloads pushed in one buffer list when "
+          "replaying", 0, G_MAXUINT64, DEFAULT_BATCH_DURATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstPcapParse:stats:
+   *
+   * Replay statistics, in a structure with the fields:
+   *
+   *   "batches": #guint64, the number of buffer lists pushed
+   *   "packets": #guint64, the number of payloads in them
+   *   "average-jitter": #guint64, the average delay (ns) of the batches
+   *       after their scheduled time
+   *   "max-jitter": #guint64, the maximum such delay (ns)
+   *
+   * Since: 1.8
+   */
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics", "Replay statistics",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_add_pad_template (element_class,
       gst_static_pad_template_get (&sink_template));
   gst_element_class_add_pad_template (element_class,
@@ -162,6 +322,10 @@ gst_pcap_parse_init (GstPcapParse * self)
   gst_pad_use_fixed_caps (self->sink_pad);
   gst_pad_set_event_function (self->sink_pad,
       GST_DEBUG_FUNCPTR (gst_pcap_sink_event));
+  gst_pad_set_activate_function (self->sink_pad,
+      GST_DEBUG_FUNCPTR (gst_pcap_parse_sink_activate));
+  gst_pad_set_activatemode_function (self->sink_pad,
+      GST_DEBUG_FUNCPTR (gst_pcap_parse_sink_activate_mode));
   gst_element_add_pad (GST_ELEMENT (self), self->sink_pad);
 
   self->src_pad = gst_pad_new_from_static_template (&src_template, "src");
@@ -173,8 +337,19 @@ gst_pcap_parse_init (GstPcapParse * self)
   self->src_port = -1;
   self->dst_port = -1;
   self->offset = -1;
+  self->filter_str = NULL;
+  self->filter = NULL;
+  self->replay = DEFAULT_REPLAY;
+  self->replay_speed = DEFAULT_REPLAY_SPEED;
+  self->batch_duration = DEFAULT_BATCH_DURATION;
+  self->replay_clock = gst_system_clock_obtain ();
+  self->clock_id = NULL;
+  self->flushing = FALSE;
+  self->batch = NULL;
 
   self->adapter = gst_adapter_new ();
+  self->interfaces =
+      g_array_new (FALSE, FALSE, sizeof (GstPcapParseInterface));
 
   gst_pcap_parse_reset (self);
 }
@@ -185,8 +360,13 @@ gst_pcap_parse_finalize (GObject * object)
   GstPcapParse *self = GST_PCAP_PARSE (object);
 
   g_object_unref (self->adapter);
+  g_array_free (self->interfaces, TRUE);
   if (self->caps)
     gst_caps_unref (self->caps);
+  if (self->filter)
+    g_ptr_array_unref (self->filter);
+  g_free (self->filter_str);
+  gst_object_unref (self->replay_clock);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -215,6 +395,195 @@ set_ip_address_from_string (gint64 * ip_addr, const gchar * ip_str)
   }
 }
 
+static gboolean
+parse_filter_term (gchar ** tokens, guint * i, GstPcapParseFilterTerm * term)
+{
+  const gchar *token;
+
+  memset (term, 0, sizeof (GstPcapParseFilterTerm));
+
+  if (tokens[*i] && !strcmp (tokens[*i], "not")) {
+    term->negate = TRUE;
+    (*i)++;
+  }
+
+  if (!tokens[*i])
+    return FALSE;
+
+  if (!strcmp (tokens[*i], "src")) {
+    term->dir = FILTER_DIR_SRC;
+    (*i)++;
+  } else if (!strcmp (tokens[*i], "dst")) {
+    term->dir = FILTER_DIR_DST;
+    (*i)++;
+  }
+
+  token = tokens[(*i)++];
+  if (!token)
+    return FALSE;
+
+  if (!strcmp (token, "udp") || !strcmp (token, "tcp")) {
+    if (term->dir != FILTER_DIR_ANY)
+      return FALSE;
+    term->type = FILTER_PROTO;
+    term->proto = !strcmp (token, "udp") ? 17 : 6;
+  } else if (!strcmp (token, "port")) {
+    gchar *end;
+    guint64 port;
+
+    if (!tokens[*i])
+      return FALSE;
+    port = g_ascii_strtoull (tokens[(*i)++], &end, 10);
+    if (*end != '\0' || port > G_MAXUINT16)
+      return FALSE;
+    term->type = FILTER_PORT;
+    term->port = port;
+  } else if (!strcmp (token, "host") || !strcmp (token, "net")) {
+    gchar **parts;
+    gulong addr;
+    guint64 prefix = 32;
+    gboolean ok = TRUE;
+
+    if (!tokens[*i])
+      return FALSE;
+
+    parts = g_strsplit (tokens[(*i)++], "/", 2);
+    addr = inet_addr (parts[0]);
+    if (addr == INADDR_NONE && strcmp (parts[0], "255.255.255.255"))
+      ok = FALSE;
+    if (parts[1]) {
+      gchar *end;
+
+      prefix = g_ascii_strtoull (parts[1], &end, 10);
+      if (*end != '\0' || prefix > 32 || !strcmp (token, "host"))
+        ok = FALSE;
+    }
+    g_strfreev (parts);
+    if (!ok)
+      return FALSE;
+
+    term->type = !strcmp (token, "host") ? FILTER_HOST : FILTER_NET;
+    term->mask = prefix ? g_htonl (G_MAXUINT32 << (32 - prefix)) : 0;
+    term->addr = addr & term->mask;
+  } else {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Returns an array of alternatives, each an array of terms, or NULL if
+ * @str is not a valid filter */
+static GPtrArray *
+parse_filter (const gchar * str)
+{
+  GPtrArray *filter;
+  GArray *terms;
+  gchar **tokens;
+  guint i = 0, n = 0;
+
+  tokens = g_strsplit_set (str, " \t", -1);
+  /* drop the empty tokens of repeated spaces */
+  while (tokens[i]) {
+    if (tokens[i][0] != '\0')
+      tokens[n++] = tokens[i];
+    else
+      g_free (tokens[i]);
+    i++;
+  }
+  tokens[n] = NULL;
+
+  filter = g_ptr_array_new_with_free_func ((GDestroyNotify) g_array_unref);
+  terms = g_array_new (FALSE, FALSE, sizeof (GstPcapParseFilterTerm));
+  g_ptr_array_add (filter, terms);
+
+  i = 0;
+  while (tokens[i]) {
+    GstPcapParseFilterTerm term;
+
+    if (!parse_filter_term (tokens, &i, &term))
+      goto error;
+    g_array_append_val (terms, term);
+
+    if (!tokens[i])
+      break;
+
+    if (!strcmp (tokens[i], "or")) {
+      terms = g_array_new (FALSE, FALSE, sizeof (GstPcapParseFilterTerm));
+      g_ptr_array_add (filter, terms);
+    } else if (strcmp (tokens[i], "and")) {
+      goto error;
+    }
+    /* a trailing operator */
+    if (!tokens[++i])
+      goto error;
+  }
+
+  g_strfreev (tokens);
+
+  return filter;
+
+error:
+  g_strfreev (tokens);
+  g_ptr_array_unref (filter);
+
+  return NULL;
+}
+
+static gboolean
+filter_term_matches (const GstPcapParseFilterTerm * term, guint8 proto,
+    guint32 src_addr, guint32 dst_addr, guint16 src_port, guint16 dst_port)
+{
+  gboolean src_match = FALSE, dst_match = FALSE;
+
+  switch (term->type) {
+    case FILTER_PROTO:
+      return proto == term->proto;
+    case FILTER_HOST:
+    case FILTER_NET:
+      src_match = (src_addr & term->mask) == term->addr;
+      dst_match = (dst_addr & term->mask) == term->addr;
+      break;
+    case FILTER_PORT:
+      src_match = src_port == term->port;
+      dst_match = dst_port == term->port;
+      break;
+  }
+
+  switch (term->dir) {
+    case FILTER_DIR_SRC:
+      return src_match;
+    case FILTER_DIR_DST:
+      return dst_match;
+    default:
+      return src_match || dst_match;
+  }
+}
+
+static gboolean
+filter_matches (GPtrArray * filter, guint8 proto, guint32 src_addr,
+    guint32 dst_addr, guint16 src_port, guint16 dst_port)
+{
+  guint i, j;
+
+  for (i = 0; i < filter->len; i++) {
+    GArray *terms = g_ptr_array_index (filter, i);
+
+    for (j = 0; j < terms->len; j++) {
+      const GstPcapParseFilterTerm *term =
+          &g_array_index (terms, GstPcapParseFilterTerm, j);
+
+      if (filter_term_matches (term, proto, src_addr, dst_addr, src_port,
+              dst_port) == term->negate)
+        break;
+    }
+    if (j == terms->len)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
 static void
 gst_pcap_parse_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec)
@@ -246,6 +615,36 @@ gst_pcap_parse_get_property (GObject * object, guint prop_id,
       g_value_set_int64 (value, self->offset);
       break;
 
+    case PROP_FILTER:
+      GST_OBJECT_LOCK (self);
+      g_value_set_string (value, self->filter_str ? self->filter_str : "");
+      GST_OBJECT_UNLOCK (self);
+      break;
+
+    case PROP_REPLAY:
+      g_value_set_boolean (value, self->replay);
+      break;
+
+    case PROP_REPLAY_SPEED:
+      g_value_set_double (value, self->replay_speed);
+      break;
+
+    case PROP_BATCH_DURATION:
+      g_value_set_uint64 (value, self->batch_duration);
+      break;
+
+    case PROP_STATS:
+      GST_OBJECT_LOCK (self);
+      g_value_take_boxed (value,
+          gst_structure_new ("application/x-pcap-parse-stats",
+              "batches", G_TYPE_UINT64, self->n_batches,
+              "packets", G_TYPE_UINT64, self->n_packets,
+              "average-jitter", G_TYPE_UINT64,
+              self->n_batches ? self->jitter_sum / self->n_batches : 0,
+              "max-jitter", G_TYPE_UINT64, self->jitter_max, NULL));
+      GST_OBJECT_UNLOCK (self);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -300,6 +699,47 @@ gst_pcap_parse_set_property (GObject * object, guint prop_id,
       self->offset = g_value_get_int64 (value);
       break;
 
+    case PROP_FILTER:
+    {
+      const gchar *str = g_value_get_string (value);
+      GPtrArray *filter = NULL, *old_filter;
+
+      if (str && str[0] != '\0') {
+        filter = parse_filter (str);
+        if (!filter) {
+          GST_WARNING_OBJECT (self, "invalid filter \"%s\"", str);
+          break;
+        }
+      }
+
+      GST_OBJECT_LOCK (self);
+      old_filter = self->filter;
+      self->filter = filter;
+      g_free (self->filter_str);
+      self->filter_str = filter ? g_strdup (str) : NULL;
+      GST_OBJECT_UNLOCK (self);
+
+      if (old_filter)
+        g_ptr_array_unref (old_filter);
+      break;
+    }
+
+    case PROP_REPLAY:
+      self->replay = g_value_get_boolean (value);
+      break;
+
+    case PROP_REPLAY_SPEED:
+      GST_OBJECT_LOCK (self);
+      self->replay_speed = g_value_get_double (value);
+      /* the next batch is scheduled from now at the new speed */
+      self->replay_base_ts = GST_CLOCK_TIME_NONE;
+      GST_OBJECT_UNLOCK (self);
+      break;
+
+    case PROP_BATCH_DURATION:
+      self->batch_duration = g_value_get_uint64 (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -314,11 +754,38 @@ gst_pcap_parse_reset (GstPcapParse * self)
   self->cur_packet_size = -1;
   self->cur_ts = GST_CLOCK_TIME_NONE;
   self->base_ts = GST_CLOCK_TIME_NONE;
+  self->nanosecond_ts = FALSE;
+  self->pcapng = FALSE;
+  self->pull_offset = 0;
   self->newsegment_sent = FALSE;
 
+  if (self->batch) {
+    gst_buffer_list_unref (self->batch);
+    self->batch = NULL;
+  }
+  self->batch_ts = GST_CLOCK_TIME_NONE;
+
+  GST_OBJECT_LOCK (self);
+  self->replay_base_ts = GST_CLOCK_TIME_NONE;
+  self->replay_base_time = GST_CLOCK_TIME_NONE;
+  GST_OBJECT_UNLOCK (self);
+
+  g_array_set_size (self->interfaces, 0);
   gst_adapter_clear (self->adapter);
 }
 
+/* Wakes up the replay wait and makes the next ones return
+ * GST_FLOW_FLUSHING while @flushing is set */
+static void
+gst_pcap_parse_set_flushing (GstPcapParse * self, gboolean flushing)
+{
+  GST_OBJECT_LOCK (self);
+  self->flushing = flushing;
+  if (flushing && self->clock_id)
+    gst_clock_id_unschedule (self->clock_id);
+  GST_OBJECT_UNLOCK (self);
+}
+
 static guint32
 gst_pcap_parse_read_uint32 (GstPcapParse * self, const guint8 * p)
 {
@@ -335,6 +802,17 @@ gst_pcap_parse_read_uint32 (GstPcapParse * self, const guint8 * p)
   }
 }
 
+static guint16
+gst_pcap_parse_read_uint16 (GstPcapParse * self, const guint8 * p)
+{
+  guint16 val = *((guint16 *) p);
+
+  if (self->swap_endian)
+    return GUINT16_SWAP_LE_BE (val);
+  else
+    return val;
+}
+
 #define ETH_HEADER_LEN    14
 #define SLL_HEADER_LEN    16
 #define IP_HEADER_MIN_LEN 20
@@ -345,7 +823,7 @@ gst_pcap_parse_read_uint32 (GstPcapParse * self, const guint8 * p)
 
 
 static gboolean
-gst_pcap_parse_scan_frame (GstPcapParse * self,
+gst_pcap_parse_scan_frame (GstPcapParse * self, GPtrArray * filter,
     const guint8 * buf,
     gint buf_size, const guint8 ** payload, gint * payload_size)
 {
@@ -431,7 +909,7 @@ gst_pcap_parse_scan_frame (GstPcapParse * self,
 
     /* all remaining data following tcp header is payload */
     *payload = buf_proto + len;
-    *payload_size = self->cur_packet_size - (buf_proto - buf) - len;
+    *payload_size = buf_size - (buf_proto - buf) - len;
   }
 
   /* but still filter as configured */
@@ -447,17 +925,417 @@ gst_pcap_parse_scan_frame (GstPcapParse * self,
   if (self->dst_port >= 0 && dst_port != self->dst_port)
     return FALSE;
 
+  if (filter && !filter_matches (filter, ip_protocol, ip_src_addr,
+          ip_dst_addr, src_port, dst_port))
+    return FALSE;
+
   return TRUE;
 }
 
 static GstFlowReturn
-gst_pcap_parse_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+gst_pcap_parse_push_list (GstPcapParse * self, GstBufferList * list)
+{
+  if (!self->newsegment_sent) {
+    GstSegment segment;
+
+    if (self->caps)
+      gst_pad_set_caps (self->src_pad, self->caps);
+    gst_segment_init (&segment, GST_FORMAT_TIME);
+    if (GST_CLOCK_TIME_IS_VALID (self->base_ts))
+      segment.start = self->base_ts;
+    gst_pad_push_event (self->src_pad, gst_event_new_segment (&segment));
+    self->newsegment_sent = TRUE;
+  }
+
+  return gst_pad_push_list (self->src_pad, list);
+}
+
+/* Waits until the time the batch captured at @ts is due and accounts for
+ * how late it is */
+static GstFlowReturn
+gst_pcap_parse_wait (GstPcapParse * self, GstClockTime ts, guint n_packets)
+{
+  GstClockTime now, target;
+  guint64 late;
+
+  now = gst_clock_get_time (self->replay_clock);
+
+  GST_OBJECT_LOCK (self);
+  if (self->flushing) {
+    GST_OBJECT_UNLOCK (self);
+    return GST_FLOW_FLUSHING;
+  }
+
+  /* payloads without capture time go with the previous batch */
+  if (!GST_CLOCK_TIME_IS_VALID (ts)) {
+    target = now;
+  } else if (!GST_CLOCK_TIME_IS_VALID (self->replay_base_ts)) {
+    self->replay_base_ts = ts;
+    self->replay_base_time = now;
+    target = now;
+  } else if (ts < self->replay_base_ts) {
+    target = self->replay_base_time;
+  } else {
+    target = self->replay_base_time +
+        (GstClockTime) ((ts - self->replay_base_ts) / self->replay_speed);
+  }
+
+  if (target > now) {
+    GstClockID id;
+    GstClockReturn cret;
+
+    id = gst_clock_new_single_shot_id (self->replay_clock, target);
+    self->clock_id = id;
+    GST_OBJECT_UNLOCK (self);
+
+    cret = gst_clock_id_wait (id, NULL);
+
+    GST_OBJECT_LOCK (self);
+    self->clock_id = NULL;
+    gst_clock_id_unref (id);
+    if (cret == GST_CLOCK_UNSCHEDULED || self->flushing) {
+      GST_OBJECT_UNLOCK (self);
+      return GST_FLOW_FLUSHING;
+    }
+    now = gst_clock_get_time (self->replay_clock);
+  }
+
+  late = now > target ? now - target : 0;
+  self->n_batches++;
+  self->n_packets += n_packets;
+  self->jitter_sum += late;
+  self->jitter_max = MAX (self->jitter_max, late);
+  GST_OBJECT_UNLOCK (self);
+
+  GST_LOG_OBJECT (self, "batch of %u payloads captured at %" GST_TIME_FORMAT
+      " sent %" G_GUINT64_FORMAT " ns late", n_packets, GST_TIME_ARGS (ts),
+      late);
+
+  return GST_FLOW_OK;
+}
+
+/* Pushes the pending replay batch when it is due */
+static GstFlowReturn
+gst_pcap_parse_push_batch (GstPcapParse * self)
+{
+  GstBufferList *batch = self->batch;
+  GstFlowReturn ret;
+
+  if (!batch)
+    return GST_FLOW_OK;
+  self->batch = NULL;
+
+  ret = gst_pcap_parse_wait (self, self->batch_ts,
+      gst_buffer_list_length (batch));
+  self->batch_ts = GST_CLOCK_TIME_NONE;
+  if (ret != GST_FLOW_OK) {
+    gst_buffer_list_unref (batch);
+    return ret;
+  }
+
+  return gst_pcap_parse_push_list (self, batch);
+}
+
+/* Adds @buf to @list, or when replaying, to the pending batch, pushing the
+ * batch first if @buf was captured after its window */
+static GstFlowReturn
+gst_pcap_parse_add_buffer (GstPcapParse * self, GstBuffer * buf,
+    GstBufferList ** list)
+{
+  GstClockTime ts = GST_BUFFER_TIMESTAMP (buf);
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  if (!self->replay) {
+    if (*list == NULL)
+      *list = gst_buffer_list_new ();
+    gst_buffer_list_add (*list, buf);
+    return GST_FLOW_OK;
+  }
+
+  if (self->batch && GST_CLOCK_TIME_IS_VALID (ts) &&
+      GST_CLOCK_TIME_IS_VALID (self->batch_ts) &&
+      ts >= self->batch_ts + self->batch_duration)
+    ret = gst_pcap_parse_push_batch (self);
+
+  if (ret != GST_FLOW_OK) {
+    gst_buffer_unref (buf);
+    return ret;
+  }
+
+  if (self->batch == NULL)
+    self->batch = gst_buffer_list_new ();
+  if (!GST_CLOCK_TIME_IS_VALID (self->batch_ts))
+    self->batch_ts = ts;
+  gst_buffer_list_add (self->batch, buf);
+
+  return GST_FLOW_OK;
+}
+
+/* Outputs the payload of the packet of @packet_size bytes found after
+ * @header_size bytes of the next @block_size bytes of the adapter if it
+ * matches, and flushes the block */
+static GstFlowReturn
+gst_pcap_parse_handle_packet (GstPcapParse * self, GPtrArray * filter,
+    gsize header_size, gsize packet_size, gsize block_size,
+    GstBufferList ** list)
+{
+  const guint8 *data;
+  const guint8 *payload_data;
+  gint payload_size;
+
+  data = gst_adapter_map (self->adapter, header_size + packet_size);
+
+  GST_LOG_OBJECT (self, "examining packet size %" G_GSIZE_FORMAT, packet_size);
+
+  if (gst_pcap_parse_scan_frame (self, filter, data + header_size,
+          packet_size, &payload_data, &payload_size)) {
+    GstBuffer *out_buf;
+    guintptr offset = payload_data - data;
+
+    gst_adapter_unmap (self->adapter);
+    gst_adapter_flush (self->adapter, offset);
+    /* we don't use _take_buffer_fast() on purpose here, we need a
+     * buffer with a single memory, since the RTP depayloaders expect
+     * the complete RTP header to be in the first memory if there are
+     * multiple ones and we can't guarantee that with _fast(). This is a
+     * sub-buffer of the input unless the payload spans two input buffers */
+    out_buf = gst_adapter_take_buffer (self->adapter, payload_size);
+    gst_adapter_flush (self->adapter, block_size - offset - payload_size);
+
+    if (GST_CLOCK_TIME_IS_VALID (self->cur_ts)) {
+      if (!GST_CLOCK_TIME_IS_VALID (self->base_ts))
+        self->base_ts = self->cur_ts;
+      if (self->offset >= 0) {
+        self->cur_ts -= self->base_ts;
+        self->cur_ts += self->offset;
+      }
+    }
+    GST_BUFFER_TIMESTAMP (out_buf) = self->cur_ts;
+
+    return gst_pcap_parse_add_buffer (self, out_buf, list);
+  }
+
+  gst_adapter_unmap (self->adapter);
+  gst_adapter_flush (self->adapter, block_size);
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_pcap_parse_read_header (GstPcapParse * self)
+{
+  const guint8 *data;
+  guint32 magic;
+  guint32 linktype;
+  guint16 major_version;
+
+  data = gst_adapter_map (self->adapter, 24);
+
+  magic = *((guint32 *) data);
+  major_version = *((guint16 *) (data + 4));
+  gst_adapter_unmap (self->adapter);
+
+  if (magic == 0xa1b2c3d4 || magic == 0xa1b23c4d) {
+    self->swap_endian = FALSE;
+  } else if (magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1) {
+    self->swap_endian = TRUE;
+    major_version = major_version << 8 | major_version >> 8;
+  } else {
+    GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
+        ("File is not a libpcap file, magic is %X", magic));
+    return GST_FLOW_ERROR;
+  }
+  self->nanosecond_ts = (magic == 0xa1b23c4d || magic == 0x4d3cb2a1);
+
+  if (major_version != 2) {
+    GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
+        ("File is not a libpcap major version 2, but %u", major_version));
+    return GST_FLOW_ERROR;
+  }
+
+  data = gst_adapter_map (self->adapter, 24);
+  linktype = gst_pcap_parse_read_uint32 (self, data + 20);
+  gst_adapter_unmap (self->adapter);
+
+  if (linktype != LINKTYPE_ETHER && linktype != LINKTYPE_SLL &&
+      linktype != LINKTYPE_RAW) {
+    GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
+        ("Only dumps of type Ethernet, raw IP or Linux Cooked (SLL) "
+            "understood; type %d unknown", linktype));
+    return GST_FLOW_ERROR;
+  }
+
+  GST_DEBUG_OBJECT (self, "linktype %u", linktype);
+  self->linktype = linktype;
+
+  gst_adapter_flush (self->adapter, 24);
+  self->initialized = TRUE;
+
+  return GST_FLOW_OK;
+}
+
+static void
+gst_pcap_parse_read_interface (GstPcapParse * self, const guint8 * data,
+    guint32 block_len)
+{
+  GstPcapParseInterface iface;
+  guint32 offset = 16;
+
+  iface.linktype = gst_pcap_parse_read_uint16 (self, data + 8);
+  iface.snaplen = gst_pcap_parse_read_uint32 (self, data + 12);
+  iface.ts_units = G_USEC_PER_SEC;
+
+  /* options, padded to 32 bits, up to the trailing block length */
+  while (offset + 4 <= block_len - 4) {
+    guint16 code = gst_pcap_parse_read_uint16 (self, data + offset);
+    guint16 len = gst_pcap_parse_read_uint16 (self, data + offset + 2);
+
+    if (code == 0 || offset + 4 + len > block_len - 4)
+      break;
+
+    if (code == PCAPNG_OPTION_IF_TSRESOL && len >= 1) {
+      guint8 resol = data[offset + 4];
+
+      /* a power of two if the most significant bit is set, else of ten */
+      if (resol & 0x80) {
+        iface.ts_units = G_GUINT64_CONSTANT (1) << MIN (resol & 0x7f, 63);
+      } else {
+        iface.ts_units = 1;
+        while (resol-- > 0 && iface.ts_units < G_MAXUINT64 / 10)
+          iface.ts_units *= 10;
+      }
+    }
+
+    offset += 4 + GST_ROUND_UP_4 (len);
+  }
+
+  GST_DEBUG_OBJECT (self, "interface %u: linktype %u, snaplen %u, "
+      "%" G_GUINT64_FORMAT " timestamp units per second",
+      self->interfaces->len, iface.linktype, iface.snaplen, iface.ts_units);
+
+  g_array_append_val (self->interfaces, iface);
+}
+
+/* Handles the next pcapng block, returns GST_FLOW_CUSTOM_SUCCESS if more
+ * data is needed */
+static GstFlowReturn
+gst_pcap_parse_read_block (GstPcapParse * self, GPtrArray * filter,
+    GstBufferList ** list)
+{
+  const guint8 *data;
+  guint32 block_type, block_len;
+  GstPcapParseInterface *iface;
+  guint32 packet_len;
+  guint64 ts;
+
+  if (gst_adapter_available (self->adapter) < 12)
+    return GST_FLOW_CUSTOM_SUCCESS;
+
+  data = gst_adapter_map (self->adapter, 12);
+  /* the section header defines the byte order of what follows, its type
+   * reads the same in both */
+  block_type = *((guint32 *) data);
+  if (block_type == PCAPNG_SECTION_HEADER_BLOCK) {
+    guint32 magic = *((guint32 *) (data + 8));
+
+    if (magic == PCAPNG_BYTE_ORDER_MAGIC) {
+      self->swap_endian = FALSE;
+    } else if (magic == GUINT32_SWAP_LE_BE (PCAPNG_BYTE_ORDER_MAGIC)) {
+      self->swap_endian = TRUE;
+    } else {
+      gst_adapter_unmap (self->adapter);
+      GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
+          ("Invalid pcapng byte order magic %X", magic));
+      return GST_FLOW_ERROR;
+    }
+  }
+  block_type = gst_pcap_parse_read_uint32 (self, data);
+  block_len = gst_pcap_parse_read_uint32 (self, data + 4);
+  gst_adapter_unmap (self->adapter);
+
+  if (block_len < 12 || block_len % 4) {
+    GST_ELEMENT_ERROR (self, STREAM, DECODE, (NULL),
+        ("Invalid pcapng block length %u", block_len));
+    return GST_FLOW_ERROR;
+  }
+
+  if (gst_adapter_available (self->adapter) < block_len)
+    return GST_FLOW_CUSTOM_SUCCESS;
+
+  switch (block_type) {
+    case PCAPNG_SECTION_HEADER_BLOCK:
+      GST_DEBUG_OBJECT (self, "new section");
+      g_array_set_size (self->interfaces, 0);
+      break;
+    case PCAPNG_INTERFACE_DESC_BLOCK:
+      if (block_len < 20)
+        break;
+      data = gst_adapter_map (self->adapter, block_len);
+      gst_pcap_parse_read_interface (self, data, block_len);
+      gst_adapter_unmap (self->adapter);
+      break;
+    case PCAPNG_ENHANCED_PACKET_BLOCK:{
+      guint32 iface_id;
+
+      if (block_len < 32)
+        break;
+      data = gst_adapter_map (self->adapter, 28);
+      iface_id = gst_pcap_parse_read_uint32 (self, data + 8);
+      ts = ((guint64) gst_pcap_parse_read_uint32 (self, data + 12) << 32) |
+          gst_pcap_parse_read_uint32 (self, data + 16);
+      packet_len = gst_pcap_parse_read_uint32 (self, data + 20);
+      gst_adapter_unmap (self->adapter);
+
+      if (iface_id >= self->interfaces->len || packet_len > block_len - 32) {
+        GST_WARNING_OBJECT (self, "skipping invalid packet");
+        break;
+      }
+      iface = &g_array_index (self->interfaces, GstPcapParseInterface,
+          iface_id);
+
+      self->linktype = iface->linktype;
+      self->cur_ts = gst_util_uint64_scale (ts, GST_SECOND, iface->ts_units);
+      return gst_pcap_parse_handle_packet (self, filter, 28, packet_len,
+          block_len, list);
+    }
+    case PCAPNG_SIMPLE_PACKET_BLOCK:
+      if (block_len < 16 || self->interfaces->len == 0)
+        break;
+      data = gst_adapter_map (self->adapter, 12);
+      packet_len = gst_pcap_parse_read_uint32 (self, data + 8);
+      gst_adapter_unmap (self->adapter);
+
+      /* the original length, the data is cut to the snapshot length */
+      iface = &g_array_index (self->interfaces, GstPcapParseInterface, 0);
+      packet_len = MIN (packet_len, block_len - 16);
+      if (iface->snaplen)
+        packet_len = MIN (packet_len, iface->snaplen);
+
+      self->linktype = iface->linktype;
+      self->cur_ts = GST_CLOCK_TIME_NONE;
+      return gst_pcap_parse_handle_packet (self, filter, 12, packet_len,
+          block_len, list);
+    default:
+      GST_LOG_OBJECT (self, "skipping block of type %u", block_type);
+      break;
+  }
+
+  gst_adapter_flush (self->adapter, block_len);
+
+  return GST_FLOW_OK;
+}
+
+/* Parses what is in the adapter and pushes the payloads found */
+static GstFlowReturn
+gst_pcap_parse_process (GstPcapParse * self)
 {
-  GstPcapParse *self = GST_PCAP_PARSE (parent);
   GstFlowReturn ret = GST_FLOW_OK;
   GstBufferList *list = NULL;
+  GPtrArray *filter;
 
-  gst_adapter_push (self->adapter, buffer);
+  GST_OBJECT_LOCK (self);
+  filter = self->filter ? g_ptr_array_ref (self->filter) : NULL;
+  GST_OBJECT_UNLOCK (self);
 
   while (ret == GST_FLOW_OK) {
     gint avail;
@@ -465,53 +1343,16 @@ gst_pcap_parse_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
 
     avail = gst_adapter_available (self->adapter);
 
-    if (self->initialized) {
+    if (self->pcapng) {
+      ret = gst_pcap_parse_read_block (self, filter, &list);
+    } else if (self->initialized) {
       if (self->cur_packet_size >= 0) {
         if (avail < self->cur_packet_size)
           break;
 
         if (self->cur_packet_size > 0) {
-          const guint8 *payload_data;
-          gint payload_size;
-
-          data = gst_adapter_map (self->adapter, self->cur_packet_size);
-
-          GST_LOG_OBJECT (self, "examining packet size %" G_GINT64_FORMAT,
-              self->cur_packet_size);
-
-          if (gst_pcap_parse_scan_frame (self, data, self->cur_packet_size,
-                  &payload_data, &payload_size)) {
-            GstBuffer *out_buf;
-            guintptr offset = payload_data - data;
-
-            gst_adapter_unmap (self->adapter);
-            gst_adapter_flush (self->adapter, offset);
-            /* we don't use _take_buffer_fast() on purpose here, we need a
-             * buffer with a single memory, since the RTP depayloaders expect
-             * the complete RTP header to be in the first memory if there are
-             * multiple ones and we can't guarantee that with _fast() */
-            out_buf = gst_adapter_take_buffer (self->adapter, payload_size);
-            gst_adapter_flush (self->adapter,
-                self->cur_packet_size - offset - payload_size);
-
-            if (GST_CLOCK_TIME_IS_VALID (self->cur_ts)) {
-              if (!GST_CLOCK_TIME_IS_VALID (self->base_ts))
-                self->base_ts = self->cur_ts;
-              if (self->offset >= 0) {
-                self->cur_ts -= self->base_ts;
-                self->cur_ts += self->offset;
-              }
-            }
-            GST_BUFFER_TIMESTAMP (out_buf) = self->cur_ts;
-
-
-            if (list == NULL)
-              list = gst_buffer_list_new ();
-            gst_buffer_list_add (list, out_buf);
-          } else {
-            gst_adapter_unmap (self->adapter);
-            gst_adapter_flush (self->adapter, self->cur_packet_size);
-          }
+          ret = gst_pcap_parse_handle_packet (self, filter, 0,
+              self->cur_packet_size, self->cur_packet_size, &list);
         }
 
         self->cur_packet_size = -1;
@@ -533,73 +1374,45 @@ gst_pcap_parse_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
         gst_adapter_unmap (self->adapter);
         gst_adapter_flush (self->adapter, 16);
 
-        self->cur_ts = ts_sec * GST_SECOND + ts_usec * GST_USECOND;
+        self->cur_ts = ts_sec * GST_SECOND;
+        if (self->nanosecond_ts)
+          self->cur_ts += ts_usec;
+        else
+          self->cur_ts += ts_usec * GST_USECOND;
         self->cur_packet_size = incl_len;
       }
     } else {
-      guint32 magic;
-      guint32 linktype;
-      guint16 major_version;
-
-      if (avail < 24)
+      if (avail < 4)
         break;
 
-      data = gst_adapter_map (self->adapter, 24);
-
-      magic = *((guint32 *) data);
-      major_version = *((guint16 *) (data + 4));
-      linktype = gst_pcap_parse_read_uint32 (self, data + 20);
+      data = gst_adapter_map (self->adapter, 4);
+      self->pcapng = (*((guint32 *) data) == PCAPNG_SECTION_HEADER_BLOCK);
       gst_adapter_unmap (self->adapter);
 
-      if (magic == 0xa1b2c3d4) {
-        self->swap_endian = FALSE;
-      } else if (magic == 0xd4c3b2a1) {
-        self->swap_endian = TRUE;
-        major_version = major_version << 8 | major_version >> 8;
-      } else {
-        GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
-            ("File is not a libpcap file, magic is %X", magic));
-        ret = GST_FLOW_ERROR;
-        goto out;
+      if (self->pcapng) {
+        GST_DEBUG_OBJECT (self, "pcapng capture");
+        self->initialized = TRUE;
+        continue;
       }
 
-      if (major_version != 2) {
-        GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
-            ("File is not a libpcap major version 2, but %u", major_version));
-        ret = GST_FLOW_ERROR;
-        goto out;
-      }
-
-      if (linktype != LINKTYPE_ETHER && linktype != LINKTYPE_SLL &&
-          linktype != LINKTYPE_RAW) {
-        GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
-            ("Only dumps of type Ethernet, raw IP or Linux Cooked (SLL) "
-                "understood; type %d unknown", linktype));
-        ret = GST_FLOW_ERROR;
-        goto out;
-      }
-
-      GST_DEBUG_OBJECT (self, "linktype %u", linktype);
-      self->linktype = linktype;
+      if (avail < 24)
+        break;
 
-      gst_adapter_flush (self->adapter, 24);
-      self->initialized = TRUE;
+      ret = gst_pcap_parse_read_header (self);
     }
   }
 
-  if (list) {
-    if (!self->newsegment_sent && GST_CLOCK_TIME_IS_VALID (self->cur_ts)) {
-      GstSegment segment;
+  if (ret == GST_FLOW_CUSTOM_SUCCESS)
+    ret = GST_FLOW_OK;
 
-      if (self->caps)
-        gst_pad_set_caps (self->src_pad, self->caps);
-      gst_segment_init (&segment, GST_FORMAT_TIME);
-      segment.start = self->base_ts;
-      gst_pad_push_event (self->src_pad, gst_event_new_segment (&segment));
-      self->newsegment_sent = TRUE;
-    }
+  if (filter)
+    g_ptr_array_unref (filter);
 
-    ret = gst_pad_push_list (self->src_pad, list);
+  if (ret != GST_FLOW_OK)
+    goto out;
+
+  if (list) {
+    ret = gst_pcap_parse_push_list (self, list);
     list = NULL;
   }
 
@@ -611,6 +1424,122 @@ out:
   return ret;
 }
 
+static GstFlowReturn
+gst_pcap_parse_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  GstPcapParse *self = GST_PCAP_PARSE (parent);
+
+  gst_adapter_push (self->adapter, buffer);
+
+  return gst_pcap_parse_process (self);
+}
+
+static void
+gst_pcap_parse_loop (GstPad * pad)
+{
+  GstPcapParse *self = GST_PCAP_PARSE (GST_PAD_PARENT (pad));
+  GstBuffer *buffer = NULL;
+  GstFlowReturn ret;
+
+  if (self->pull_offset == 0) {
+    gchar *stream_id;
+
+    stream_id = gst_pad_create_stream_id (self->src_pad, GST_ELEMENT (self),
+        NULL);
+    gst_pad_push_event (self->src_pad, gst_event_new_stream_start (stream_id));
+    g_free (stream_id);
+  }
+
+  /* big blocks, the payloads are sub-buffers of them */
+  ret = gst_pad_pull_range (pad, self->pull_offset, PULL_BLOCK_SIZE, &buffer);
+  if (ret != GST_FLOW_OK)
+    goto pause;
+
+  self->pull_offset += gst_buffer_get_size (buffer);
+  gst_adapter_push (self->adapter, buffer);
+
+  ret = gst_pcap_parse_process (self);
+  if (ret != GST_FLOW_OK)
+    goto pause;
+
+  return;
+
+pause:
+  {
+    const gchar *reason = gst_flow_get_name (ret);
+
+    GST_DEBUG_OBJECT (self, "pausing task, reason %s", reason);
+    gst_pad_pause_task (pad);
+    if (ret == GST_FLOW_EOS) {
+      gst_pcap_parse_push_batch (self);
+      gst_pad_push_event (self->src_pad, gst_event_new_eos ());
+    } else if (ret == GST_FLOW_NOT_LINKED || ret < GST_FLOW_EOS) {
+      GST_ELEMENT_ERROR (self, STREAM, FAILED,
+          ("Internal data flow error."),
+          ("streaming task paused, reason %s (%d)", reason, ret));
+      gst_pad_push_event (self->src_pad, gst_event_new_eos ());
+    }
+  }
+}
+
+static gboolean
+gst_pcap_parse_sink_activate (GstPad * pad, GstObject * parent)
+{
+  GstQuery *query;
+  gboolean pull_mode;
+
+  query = gst_query_new_scheduling ();
+
+  if (!gst_pad_peer_query (pad, query)) {
+    gst_query_unref (query);
+    goto activate_push;
+  }
+
+  pull_mode = gst_query_has_scheduling_mode_with_flags (query,
+      GST_PAD_MODE_PULL, GST_SCHEDULING_FLAG_SEEKABLE);
+  gst_query_unref (query);
+
+  if (!pull_mode)
+    goto activate_push;
+
+  GST_DEBUG_OBJECT (pad, "activating pull");
+  return gst_pad_activate_mode (pad, GST_PAD_MODE_PULL, TRUE);
+
+activate_push:
+  {
+    GST_DEBUG_OBJECT (pad, "activating push");
+    return gst_pad_activate_mode (pad, GST_PAD_MODE_PUSH, TRUE);
+  }
+}
+
+static gboolean
+gst_pcap_parse_sink_activate_mode (GstPad * pad, GstObject * parent,
+    GstPadMode mode, gboolean active)
+{
+  GstPcapParse *self = GST_PCAP_PARSE (parent);
+  gboolean res;
+
+  switch (mode) {
+    case GST_PAD_MODE_PUSH:
+      res = TRUE;
+      break;
+    case GST_PAD_MODE_PULL:
+      if (active) {
+        self->pull_offset = 0;
+        res = gst_pad_start_task (pad, (GstTaskFunction) gst_pcap_parse_loop,
+            pad, NULL);
+      } else {
+        res = gst_pad_stop_task (pad);
+      }
+      break;
+    default:
+      res = FALSE;
+      break;
+  }
+
+  return res;
+}
+
 static gboolean
 gst_pcap_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
 {
@@ -622,8 +1551,18 @@ gst_pcap_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
       /* Drop it, we'll replace it with our own */
       gst_event_unref (event);
       break;
+    case GST_EVENT_EOS:
+      /* the last replay batch */
+      gst_pcap_parse_push_batch (self);
+      ret = gst_pad_push_event (self->src_pad, event);
+      break;
+    case GST_EVENT_FLUSH_START:
+      gst_pcap_parse_set_flushing (self, TRUE);
+      ret = gst_pad_push_event (self->src_pad, event);
+      break;
     case GST_EVENT_FLUSH_STOP:
       gst_pcap_parse_reset (self);
+      gst_pcap_parse_set_flushing (self, FALSE);
       break;
     default:
       ret = gst_pad_push_event (self->src_pad, event);
@@ -639,6 +1578,25 @@ gst_pcap_parse_change_state (GstElement * element, GstStateChange transition)
   GstPcapParse *self = GST_PCAP_PARSE (element);
   GstStateChangeReturn ret;
 
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      gst_pcap_parse_set_flushing (self, FALSE);
+      /* the statistics of a replay stay readable once stopped */
+      GST_OBJECT_LOCK (self);
+      self->n_batches = 0;
+      self->n_packets = 0;
+      self->jitter_sum = 0;
+      self->jitter_max = 0;
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* wake up a replay wait before the streaming thread is stopped */
+      gst_pcap_parse_set_flushing (self, TRUE);
+      break;
+    default:
+      break;
+  }
+
   ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
 
   switch (transition) {
@@ -73,6 +73,11 @@ struct _GstPcapParse
   gint32 dst_port;
   GstCaps *caps;
   gint64 offset;
+  gchar *filter_str;
+  GPtrArray *filter;
+  gboolean replay;
+  gdouble replay_speed;
+  GstClockTime batch_duration;
 
   /* state */
   GstAdapter * adapter;
@@ -82,6 +87,30 @@ struct _GstPcapParse
   GstClockTime cur_ts;
   GstClockTime base_ts;
   GstPcapParseLinktype linktype;
+  gboolean nanosecond_ts;
+
+  /* pcapng: one GstPcapParseInterface per interface of the section */
+  gboolean pcapng;
+  GArray *interfaces;
+
+  /* pull mode */
+  guint64 pull_offset;
+
+  /* replay: the payloads of a batch-duration window of capture time are
+   * pushed in one list when the system clock reaches it */
+  GstClock *replay_clock;
+  GstClockID clock_id;
+  gboolean flushing;
+  GstBufferList *batch;
+  GstClockTime batch_ts;
+  GstClockTime replay_base_ts;
+  GstClockTime replay_base_time;
+
+  /* replay statistics, protected by the object lock */
+  guint64 n_batches;
+  guint64 n_packets;
+  guint64 jitter_sum;
+  guint64 jitter_max;
 
   gboolean newsegment_sent;
 };
@@ -159,9 +159,12 @@ static void
 gst_rtp_h265_depay_reset (GstRtpH265Depay * rtph265depay)
 {
   gst_adapter_clear (rtph265depay->adapter);
+  rtph265depay->fu_n_memory = 0;
   rtph265depay->wait_start = TRUE;
   gst_adapter_clear (rtph265depay->picture_adapter);
+  rtph265depay->picture_n_memory = 0;
   rtph265depay->picture_start = FALSE;
+  rtph265depay->picture_corrupted = FALSE;
   rtph265depay->last_keyframe = FALSE;
   rtph265depay->last_ts = 0;
   rtph265depay->current_fu_type = 0;
@@ -894,9 +897,44 @@ incomplete_caps:
   }
 }
 
+/* Takes @size bytes from @adapter holding buffers with @n_memory memories in
+ * total. When they fit in one buffer, the memories are referenced as they
+ * are, otherwise they are merged once: appending them one by one would
+ * merge them again every time the buffer is full */
+static GstBuffer *
+gst_rtp_h265_depay_take_buffer (GstAdapter * adapter, gsize size,
+    guint n_memory)
+{
+  if (n_memory <= gst_buffer_get_max_memory ())
+    return gst_adapter_take_buffer_fast (adapter, size);
+
+  return gst_adapter_take_buffer (adapter, size);
+}
+
+/* Returns a byte-stream NAL unit made of the start code and @size bytes of
+ * the RTP payload @buf from @offset. The payload is not copied */
+static GstBuffer *
+gst_rtp_h265_depay_wrap_nal (GstRtpH265Depay * rtph265depay, GstBuffer * buf,
+    guint offset, guint size)
+{
+  GstBuffer *outbuf;
+
+  outbuf = gst_buffer_new ();
+  gst_buffer_append_memory (outbuf,
+      gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY, (gpointer) sync_bytes,
+          sizeof (sync_bytes), 0, sizeof (sync_bytes), NULL, NULL));
+  gst_buffer_copy_into (outbuf, buf, GST_BUFFER_COPY_MEMORY, offset, size);
+
+  gst_rtp_copy_meta (GST_ELEMENT_CAST (rtph265depay), outbuf, buf,
+      g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
+
+  return outbuf;
+}
+
 static GstBuffer *
 gst_rtp_h265_complete_au (GstRtpH265Depay * rtph265depay,
-    GstClockTime * out_timestamp, gboolean * out_keyframe)
+    GstClockTime * out_timestamp, gboolean * out_keyframe,
+    gboolean * out_corrupted)
 {
   guint outsize;
   GstBuffer *outbuf;
@@ -904,13 +942,17 @@ gst_rtp_h265_complete_au (GstRtpH265Depay * rtph265depay,
   /* we had a picture in the adapter and we completed it */
   GST_DEBUG_OBJECT (rtph265depay, "taking completed AU");
   outsize = gst_adapter_available (rtph265depay->picture_adapter);
-  outbuf = gst_adapter_take_buffer (rtph265depay->picture_adapter, outsize);
+  outbuf = gst_rtp_h265_depay_take_buffer (rtph265depay->picture_adapter,
+      outsize, rtph265depay->picture_n_memory);
+  rtph265depay->picture_n_memory = 0;
 
   *out_timestamp = rtph265depay->last_ts;
   *out_keyframe = rtph265depay->last_keyframe;
+  *out_corrupted = rtph265depay->picture_corrupted;
 
   rtph265depay->last_keyframe = FALSE;
   rtph265depay->picture_start = FALSE;
+  rtph265depay->picture_corrupted = FALSE;
 
   return outbuf;
 }
@@ -999,16 +1041,17 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
 {
   GstRTPBaseDepayload *depayload = GST_RTP_BASE_DEPAYLOAD (rtph265depay);
   gint nal_type;
-  GstMapInfo map;
+  guint8 header[7] = { 0, };
   GstBuffer *outbuf = NULL;
   GstClockTime out_timestamp;
-  gboolean keyframe, out_keyframe;
+  gboolean keyframe, out_keyframe, out_corrupted = FALSE;
 
-  gst_buffer_map (nal, &map, GST_MAP_READ);
-  if (G_UNLIKELY (map.size < 5))
+  /* the NAL unit can be made of several memories, only read its header
+   * instead of mapping it, which would merge them */
+  if (G_UNLIKELY (gst_buffer_extract (nal, 0, header, sizeof (header)) < 5))
     goto short_nal;
 
-  nal_type = (map.data[4] >> 1) & 0x3f;
+  nal_type = (header[4] >> 1) & 0x3f;
   GST_DEBUG_OBJECT (rtph265depay, "handle NAL type %d (RTP marker bit %d)",
       nal_type, marker);
 
@@ -1022,7 +1065,6 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
       gst_rtp_h265_depay_add_vps_sps_pps (rtph265depay,
           gst_buffer_copy_region (nal, GST_BUFFER_COPY_ALL,
               4, gst_buffer_get_size (nal) - 4));
-      gst_buffer_unmap (nal, &map);
       gst_buffer_unref (nal);
       return NULL;
     } else if (rtph265depay->sps->len == 0 || rtph265depay->pps->len == 0) {
@@ -1033,7 +1075,6 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
           gst_event_new_custom (GST_EVENT_CUSTOM_UPSTREAM,
               gst_structure_new ("GstForceKeyUnit",
                   "all-headers", G_TYPE_BOOLEAN, TRUE, NULL)));
-      gst_buffer_unmap (nal, &map);
       gst_buffer_unref (nal);
       return NULL;
     }
@@ -1053,7 +1094,7 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
       if (NAL_TYPE_IS_CODED_SLICE_SEGMENT (nal_type)) {
         /* A NAL unit (X) ends an access unit if the next-occurring VCL NAL unit (Y) has the high-order bit of the first byte after its NAL unit header equal to 1 */
         start = TRUE;
-        if (((map.data[6] >> 7) & 0x01) == 1) {
+        if (((header[6] >> 7) & 0x01) == 1) {
           complete = TRUE;
         }
         complete = TRUE;
@@ -1067,12 +1108,11 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
 
       if (complete && rtph265depay->picture_start)
         outbuf = gst_rtp_h265_complete_au (rtph265depay, &out_timestamp,
-            &out_keyframe);
+            &out_keyframe, &out_corrupted);
     }
     /* add to adapter */
-    gst_buffer_unmap (nal, &map);
-
     GST_DEBUG_OBJECT (depayload, "adding NAL to picture adapter");
+    rtph265depay->picture_n_memory += gst_buffer_n_memory (nal);
     gst_adapter_push (rtph265depay->picture_adapter, nal);
     rtph265depay->last_ts = in_timestamp;
     rtph265depay->last_keyframe |= keyframe;
@@ -1080,12 +1120,11 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
 
     if (marker)
       outbuf = gst_rtp_h265_complete_au (rtph265depay, &out_timestamp,
-          &out_keyframe);
+          &out_keyframe, &out_corrupted);
   } else {
     /* no merge, output is input nal */
     GST_DEBUG_OBJECT (depayload, "using NAL as output");
     outbuf = nal;
-    gst_buffer_unmap (nal, &map);
   }
 
   if (outbuf) {
@@ -1109,6 +1148,10 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
       GST_BUFFER_FLAG_UNSET (outbuf, GST_BUFFER_FLAG_DELTA_UNIT);
     else
       GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DELTA_UNIT);
+
+    /* a slice of the AU was lost, the rest of it is still usable */
+    if (out_corrupted)
+      GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_CORRUPTED);
   }
 
   return outbuf;
@@ -1117,33 +1160,45 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
 short_nal:
   {
     GST_WARNING_OBJECT (depayload, "dropping short NAL");
-    gst_buffer_unmap (nal, &map);
     gst_buffer_unref (nal);
     return NULL;
   }
 }
 
+/* A fragment of the NAL unit being reassembled was lost, the slice can't be
+ * decoded and is dropped. The rest of the access unit is kept, flagged as
+ * corrupted */
+static void
+gst_rtp_h265_depay_drop_fragmentation_unit (GstRtpH265Depay * rtph265depay)
+{
+  GST_WARNING_OBJECT (rtph265depay, "lost fragments, dropping NAL unit of "
+      "type %d", rtph265depay->current_fu_type);
+
+  gst_adapter_clear (rtph265depay->adapter);
+  rtph265depay->fu_n_memory = 0;
+  rtph265depay->current_fu_type = 0;
+  rtph265depay->wait_start = TRUE;
+  rtph265depay->picture_corrupted = TRUE;
+}
+
 static GstBuffer *
 gst_rtp_h265_push_fragmentation_unit (GstRtpH265Depay * rtph265depay,
     gboolean send)
 {
   guint outsize;
-  GstMapInfo map;
   GstBuffer *outbuf;
 
+  if (!rtph265depay->byte_stream)
+    goto not_implemented;
+
+  /* the fragments already start with the start code and the NAL header */
   outsize = gst_adapter_available (rtph265depay->adapter);
-  outbuf = gst_adapter_take_buffer (rtph265depay->adapter, outsize);
+  outbuf = gst_rtp_h265_depay_take_buffer (rtph265depay->adapter, outsize,
+      rtph265depay->fu_n_memory);
+  rtph265depay->fu_n_memory = 0;
 
-  gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
   GST_DEBUG_OBJECT (rtph265depay, "output %d bytes", outsize);
 
-  if (rtph265depay->byte_stream) {
-    memcpy (map.data, sync_bytes, sizeof (sync_bytes));
-  } else {
-    goto not_implemented;
-  }
-  gst_buffer_unmap (outbuf, &map);
-
   rtph265depay->current_fu_type = 0;
 
   outbuf = gst_rtp_h265_depay_handle_nal (rtph265depay, outbuf,
@@ -1159,7 +1214,9 @@ not_implemented:
   {
     GST_ERROR_OBJECT (rtph265depay,
         ("Only bytestream format is currently supported."));
-    gst_buffer_unmap (outbuf, &map);
+    gst_adapter_clear (rtph265depay->adapter);
+    rtph265depay->fu_n_memory = 0;
+    rtph265depay->current_fu_type = 0;
     return NULL;
   }
 }
@@ -1174,24 +1231,29 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
 
   rtph265depay = GST_RTP_H265_DEPAY (depayload);
 
-  /* flush remaining data on discont */
+  /* flush remaining data on discont, packets were lost or reordered */
   if (GST_BUFFER_IS_DISCONT (rtp->buffer)) {
+    if (rtph265depay->current_fu_type != 0)
+      gst_rtp_h265_depay_drop_fragmentation_unit (rtph265depay);
     gst_adapter_clear (rtph265depay->adapter);
+    rtph265depay->fu_n_memory = 0;
     rtph265depay->wait_start = TRUE;
     rtph265depay->current_fu_type = 0;
   }
 
   {
     gint payload_len;
-    guint8 *payload;
-    guint header_len;
-    GstMapInfo map;
-    guint outsize, nalu_size;
+    guint8 payload_header[3] = { 0, };
+    const guint8 *payload;
+    guint header_len, offset;
+    guint outsize, nalu_size, n_memory;
+    guint16 seqnum;
     GstClockTime timestamp;
     gboolean marker;
     guint8 nuh_layer_id, nuh_temporal_id_plus1;
     guint8 S, E;
     guint16 nal_header;
+    guint8 nal_header_bytes[2];
 #if 0
     gboolean donl_present = FALSE;
 #endif
@@ -1199,10 +1261,14 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
     timestamp = GST_BUFFER_PTS (rtp->buffer);
 
     payload_len = gst_rtp_buffer_get_payload_len (rtp);
-    payload = gst_rtp_buffer_get_payload (rtp);
     buf = gst_rtp_buffer_get_payload_buffer (rtp);
     marker = gst_rtp_buffer_get_marker (rtp);
 
+    /* only the payload headers are read, mapping the payload would merge
+     * its memories */
+    gst_buffer_extract (buf, 0, payload_header, sizeof (payload_header));
+    payload = payload_header;
+
     GST_DEBUG_OBJECT (rtph265depay, "receiving %d bytes", payload_len);
 
     if (payload_len == 0)
@@ -1273,8 +1339,8 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
          */
 
         /* strip headers */
-        payload += header_len;
         payload_len -= header_len;
+        offset = header_len;
 
         rtph265depay->wait_start = FALSE;
 
@@ -1283,47 +1349,44 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
           goto not_implemented_donl_present;
 #endif
 
+        if (!rtph265depay->byte_stream)
+          goto not_implemented;
+
+        n_memory = 0;
         while (payload_len > 2) {
+          guint8 size_bytes[2];
 
-          nalu_size = (payload[0] << 8) | payload[1];
+          gst_buffer_extract (buf, offset, size_bytes, 2);
+          nalu_size = GST_READ_UINT16_BE (size_bytes);
 
           /* dont include nalu_size */
           if (nalu_size > (payload_len - 2))
             nalu_size = payload_len - 2;
 
-          outsize = nalu_size + sizeof (sync_bytes);
-          outbuf = gst_buffer_new_and_alloc (outsize);
-
-          gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
-          if (rtph265depay->byte_stream) {
-            memcpy (map.data, sync_bytes, sizeof (sync_bytes));
-          } else {
-            goto not_implemented;
-          }
-
           /* strip NALU size */
-          payload += 2;
           payload_len -= 2;
+          offset += 2;
 
-          memcpy (map.data + sizeof (sync_bytes), payload, nalu_size);
-          gst_buffer_unmap (outbuf, &map);
-
-          gst_rtp_copy_meta (GST_ELEMENT_CAST (rtph265depay), outbuf, buf,
-              g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
+          /* the NAL unit references the payload */
+          outbuf = gst_rtp_h265_depay_wrap_nal (rtph265depay, buf, offset,
+              nalu_size);
 
           outbuf =
               gst_rtp_h265_depay_handle_nal (rtph265depay, outbuf, timestamp,
               marker);
-          if (outbuf)
+          if (outbuf) {
+            n_memory += gst_buffer_n_memory (outbuf);
             gst_adapter_push (rtph265depay->adapter, outbuf);
+          }
 
-          payload += nalu_size;
           payload_len -= nalu_size;
+          offset += nalu_size;
         }
 
         outsize = gst_adapter_available (rtph265depay->adapter);
         if (outsize > 0) {
-          outbuf = gst_adapter_take_buffer (rtph265depay->adapter, outsize);
+          outbuf = gst_rtp_h265_depay_take_buffer (rtph265depay->adapter,
+              outsize, n_memory);
           outbuf =
               gst_rtp_h265_depay_handle_nal (rtph265depay, outbuf, timestamp,
               marker);
@@ -1368,6 +1431,16 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
         if (rtph265depay->wait_start && !S)
           goto waiting_start;
 
+        /* a fragment in the middle of the NAL unit is missing, don't pass
+         * on a slice with a hole in it */
+        seqnum = gst_rtp_buffer_get_seq (rtp);
+        if (!S && rtph265depay->current_fu_type != 0 &&
+            seqnum != (guint16) (rtph265depay->fu_seqnum + 1)) {
+          gst_rtp_h265_depay_drop_fragmentation_unit (rtph265depay);
+          goto waiting_start;
+        }
+        rtph265depay->fu_seqnum = seqnum;
+
 #if 0
         if (donl_present)
           goto not_implemented_donl_present;
@@ -1393,28 +1466,24 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
               ((payload[0] & 0x3f) << 9) | (nuh_layer_id << 3) |
               nuh_temporal_id_plus1;
 
-          /* go back one byte so we can copy the payload + two bytes more in the front which
-           * will be overwritten by the nal_header
-           */
-          payload -= 1;
-          payload_len += 1;
-
-          nalu_size = payload_len;
-          outsize = nalu_size + sizeof (sync_bytes);
-          outbuf = gst_buffer_new_and_alloc (outsize);
-
-          gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
-          memcpy (map.data + sizeof (sync_bytes), payload, nalu_size);
-          map.data[sizeof (sync_bytes)] = nal_header >> 8;
-          map.data[sizeof (sync_bytes) + 1] = nal_header & 0xff;
-          gst_buffer_unmap (outbuf, &map);
+          /* the start code and the reconstructed NAL header are the only
+           * bytes written, the FU payload is referenced */
+          outbuf = gst_buffer_new_allocate (NULL, sizeof (sync_bytes) + 2,
+              NULL);
+          gst_buffer_fill (outbuf, 0, sync_bytes, sizeof (sync_bytes));
+          GST_WRITE_UINT16_BE (nal_header_bytes, nal_header);
+          gst_buffer_fill (outbuf, sizeof (sync_bytes), nal_header_bytes, 2);
+          gst_buffer_copy_into (outbuf, buf, GST_BUFFER_COPY_MEMORY,
+              header_len + 1, payload_len - 1);
 
           gst_rtp_copy_meta (GST_ELEMENT_CAST (rtph265depay), outbuf, buf,
               g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
 
+          outsize = gst_buffer_get_size (outbuf);
           GST_DEBUG_OBJECT (rtph265depay, "queueing %d bytes", outsize);
 
           /* and assemble in the adapter */
+          rtph265depay->fu_n_memory = gst_buffer_n_memory (outbuf);
           gst_adapter_push (rtph265depay->adapter, outbuf);
         } else {
 
@@ -1422,12 +1491,11 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
               "Following part of Fragmentation Unit");
 
           /* strip off FU header byte */
-          payload += 1;
           payload_len -= 1;
 
           outsize = payload_len;
-          outbuf = gst_buffer_new_and_alloc (outsize);
-          gst_buffer_fill (outbuf, 0, payload, outsize);
+          outbuf = gst_buffer_copy_region (buf, GST_BUFFER_COPY_MEMORY,
+              header_len + 1, outsize);
 
           gst_rtp_copy_meta (GST_ELEMENT_CAST (rtph265depay), outbuf, buf,
               g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
@@ -1435,6 +1503,7 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
           GST_DEBUG_OBJECT (rtph265depay, "queueing %d bytes", outsize);
 
           /* and assemble in the adapter */
+          rtph265depay->fu_n_memory += gst_buffer_n_memory (outbuf);
           gst_adapter_push (rtph265depay->adapter, outbuf);
         }
 
@@ -1462,21 +1531,12 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
           goto not_implemented_donl_present;
 #endif
 
-        nalu_size = payload_len;
-        outsize = nalu_size + sizeof (sync_bytes);
-        outbuf = gst_buffer_new_and_alloc (outsize);
-
-        gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
-        if (rtph265depay->byte_stream) {
-          memcpy (map.data, sync_bytes, sizeof (sync_bytes));
-        } else {
+        if (!rtph265depay->byte_stream)
           goto not_implemented;
-        }
-        memcpy (map.data + sizeof (sync_bytes), payload, nalu_size);
-        gst_buffer_unmap (outbuf, &map);
 
-        gst_rtp_copy_meta (GST_ELEMENT_CAST (rtph265depay), outbuf, buf,
-            g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
+        /* the NAL unit references the payload */
+        nalu_size = payload_len;
+        outbuf = gst_rtp_h265_depay_wrap_nal (rtph265depay, buf, 0, nalu_size);
 
         outbuf = gst_rtp_h265_depay_handle_nal (rtph265depay, outbuf, timestamp,
             marker);
@@ -1498,7 +1558,9 @@ empty_packet:
   }
 waiting_start:
   {
+    /* the NAL unit this fragment belongs to was lost */
     GST_DEBUG_OBJECT (rtph265depay, "waiting for start");
+    rtph265depay->picture_corrupted = TRUE;
     gst_buffer_unref (buf);
     return NULL;
   }
@@ -66,7 +66,9 @@ struct _GstRtpH265Depay
   /* nal merging */
   gboolean merge;
   GstAdapter *picture_adapter;
+  guint picture_n_memory;
   gboolean picture_start;
+  gboolean picture_corrupted;
   GstClockTime last_ts;
   gboolean last_keyframe;
 
@@ -74,6 +76,8 @@ struct _GstRtpH265Depay
   guint8 current_fu_type;
   GstClockTime fu_timestamp;
   gboolean fu_marker;
+  guint16 fu_seqnum;
+  guint fu_n_memory;
 
   /* misc */
   GPtrArray *vps;
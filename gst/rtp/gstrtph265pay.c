@@ -34,6 +34,8 @@
 
 #include "gstrtph265pay.h"
 
+#include <gst/codecparsers/gsth265nalmeta.h>
+
 
 GST_DEBUG_CATEGORY_STATIC (rtph265pay_debug);
 #define GST_CAT_DEFAULT (rtph265pay_debug)
@@ -104,12 +106,14 @@ GST_STATIC_PAD_TEMPLATE ("src",
 
 #define DEFAULT_SPROP_PARAMETER_SETS    NULL
 #define DEFAULT_CONFIG_INTERVAL		      0
+#define DEFAULT_AGGREGATE             FALSE
 
 enum
 {
   PROP_0,
   PROP_SPROP_PARAMETER_SETS,
-  PROP_CONFIG_INTERVAL
+  PROP_CONFIG_INTERVAL,
+  PROP_AGGREGATE
 };
 
 #define IS_ACCESS_UNIT(x) (((x) > 0x00) && ((x) < 0x06))
@@ -167,6 +171,22 @@ gst_rtp_h265_pay_class_init (GstRtpH265PayClass * klass)
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
       );
 
+  /**
+   * GstRtpH265Pay:aggregate:
+   *
+   * Send the NAL units of an input buffer that fit in the MTU together in
+   * Aggregation Packets, instead of one packet each. This saves many small
+   * packets for the VPS, SPS, PPS, SEI and small slices of each frame. NAL
+   * units are never held back for the next input buffer.
+   *
+   * Since: 1.8
+   */
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_AGGREGATE,
+      g_param_spec_boolean ("aggregate", "Aggregate",
+          "Aggregate the small NAL units of a buffer in Aggregation Packets",
+          DEFAULT_AGGREGATE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gobject_class->finalize = gst_rtp_h265_pay_finalize;
 
   gst_element_class_add_pad_template (gstelement_class,
@@ -204,10 +224,21 @@ gst_rtp_h265_pay_init (GstRtpH265Pay * rtph265pay)
       (GDestroyNotify) gst_buffer_unref);
   rtph265pay->last_vps_sps_pps = -1;
   rtph265pay->vps_sps_pps_interval = DEFAULT_CONFIG_INTERVAL;
+  rtph265pay->aggregate = DEFAULT_AGGREGATE;
 
   rtph265pay->adapter = gst_adapter_new ();
 }
 
+static void
+gst_rtp_h265_pay_reset_bundle (GstRtpH265Pay * rtph265pay)
+{
+  if (rtph265pay->bundle) {
+    gst_buffer_list_unref (rtph265pay->bundle);
+    rtph265pay->bundle = NULL;
+  }
+  rtph265pay->bundle_size = 0;
+}
+
 static void
 gst_rtp_h265_pay_clear_vps_sps_pps (GstRtpH265Pay * rtph265pay)
 {
@@ -231,6 +262,7 @@ gst_rtp_h265_pay_finalize (GObject * object)
 
   g_free (rtph265pay->sprop_parameter_sets);
 
+  gst_rtp_h265_pay_reset_bundle (rtph265pay);
   g_object_unref (rtph265pay->adapter);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
@@ -769,41 +801,39 @@ gst_rtp_h265_pay_parse_sprop_parameter_sets (GstRtpH265Pay * rtph265pay)
   g_strfreev (params);
 }
 
-static guint
-next_start_code (const guint8 * data, guint size)
+static guint8
+adapter_peek_byte (GstAdapter * adapter, gsize offset)
 {
-  /* Boyer-Moore string matching algorithm, in a degenerative
-   * sense because our search 'alphabet' is binary - 0 & 1 only.
-   * This allow us to simplify the general BM algorithm to a very
-   * simple form. */
-  /* assume 1 is in the 3th byte */
-  guint offset = 2;
-
-  while (offset < size) {
-    if (1 == data[offset]) {
-      unsigned int shift = offset;
-
-      if (0 == data[--shift]) {
-        if (0 == data[--shift]) {
-          return shift;
-        }
-      }
-      /* The jump is always 3 because of the 1 previously matched.
-       * All the 0's must be after this '1' matched at offset */
-      offset += 3;
-    } else if (0 == data[offset]) {
-      /* maybe next byte is 1? */
-      offset++;
-    } else {
-      /* can jump 3 bytes forward */
-      offset += 3;
-    }
-    /* at each iteration, we rescan in a backward manner until
-     * we match 0.0.1 in reverse order. Since our search string
-     * has only 2 'alpabets' (i.e. 0 & 1), we know that any
-     * mismatch will force us to shift a fixed number of steps */
+  guint8 byte;
+
+  gst_adapter_copy (adapter, &byte, offset, 1);
+
+  return byte;
+}
+
+/* Returns the offset in the adapter of the next 0x000001 start code between
+ * @offset and @size, or @size if there is none. The adapter is scanned in
+ * place, its buffers are not merged */
+static gsize
+next_start_code (GstAdapter * adapter, gsize offset, gsize size)
+{
+  gssize pos;
+
+  if (size - offset >= 4) {
+    pos = gst_adapter_masked_scan_uint32 (adapter, 0xffffff00, 0x00000100,
+        offset, size - offset);
+    if (pos >= 0)
+      return pos;
   }
-  GST_DEBUG ("Cannot find next NAL start code. returning %u", size);
+
+  /* a start code ending the data is not followed by a 4th byte */
+  if (size - offset >= 3 && adapter_peek_byte (adapter, size - 3) == 0 &&
+      adapter_peek_byte (adapter, size - 2) == 0 &&
+      adapter_peek_byte (adapter, size - 1) == 1)
+    return size - 3;
+
+  GST_DEBUG ("Cannot find next NAL start code. returning %" G_GSIZE_FORMAT,
+      size);
 
   return size;
 }
@@ -821,7 +851,7 @@ gst_rtp_h265_pay_decode_nal (GstRtpH265Pay * payloader,
   GST_DEBUG ("NAL payload len=%u", size);
 
   header = data[0];
-  type = header & 0x3f;
+  type = (header >> 1) & 0x3f;
 
   /* We record the timestamp of the last SPS/PPS so
    * that we can insert them at regular intervals and when needed. */
@@ -852,6 +882,29 @@ gst_rtp_h265_pay_decode_nal (GstRtpH265Pay * payloader,
   return updated;
 }
 
+/* Parses the VPS, SPS and PPS in the adapter, the other NAL units are not
+ * read */
+static gboolean
+gst_rtp_h265_pay_decode_adapter_nal (GstRtpH265Pay * payloader, gsize offset,
+    guint size, GstClockTime dts, GstClockTime pts)
+{
+  GBytes *bytes;
+  guint8 type;
+  gboolean updated;
+
+  type = (adapter_peek_byte (payloader->adapter, offset) >> 1) & 0x3f;
+  if (type != GST_H265_NAL_VPS && type != GST_H265_NAL_SPS
+      && type != GST_H265_NAL_PPS)
+    return FALSE;
+
+  bytes = gst_adapter_copy_bytes (payloader->adapter, offset, size);
+  updated = gst_rtp_h265_pay_decode_nal (payloader,
+      g_bytes_get_data (bytes, NULL), size, dts, pts);
+  g_bytes_unref (bytes);
+
+  return updated;
+}
+
 static GstFlowReturn
 gst_rtp_h265_pay_payload_nal (GstRTPBasePayload * basepayload,
     GstBuffer * paybuf, GstClockTime dts, GstClockTime pts, gboolean end_of_au);
@@ -913,6 +966,13 @@ gst_rtp_h265_pay_send_vps_sps_pps (GstRTPBasePayload * basepayload,
   return ret;
 }
 
+static GstFlowReturn
+gst_rtp_h265_pay_payload_nal_fragment (GstRTPBasePayload * basepayload,
+    GstBuffer * paybuf, GstClockTime dts, GstClockTime pts, gboolean end_of_au);
+static GstFlowReturn
+gst_rtp_h265_pay_payload_nal_bundle (GstRTPBasePayload * basepayload,
+    GstBuffer * paybuf, GstClockTime dts, GstClockTime pts, gboolean end_of_au);
+
 static GstFlowReturn
 gst_rtp_h265_pay_payload_nal (GstRTPBasePayload * basepayload,
     GstBuffer * paybuf, GstClockTime dts, GstClockTime pts, gboolean end_of_au)
@@ -921,16 +981,9 @@ gst_rtp_h265_pay_payload_nal (GstRTPBasePayload * basepayload,
   GstFlowReturn ret;
   guint8 nalHeader[2];
   guint8 nalType;
-  guint packet_len, payload_len, mtu;
-  GstBuffer *outbuf;
-  guint8 *payload;
-  GstBufferList *list = NULL;
   gboolean send_vps_sps_pps;
-  GstRTPBuffer rtp = { NULL };
-  guint size = gst_buffer_get_size (paybuf);
 
   rtph265pay = GST_RTP_H265_PAY (basepayload);
-  mtu = GST_RTP_BASE_PAYLOAD_MTU (rtph265pay);
 
   gst_buffer_extract (paybuf, 0, nalHeader, 2);
   nalType = (nalHeader[0] >> 1) & 0x3f;
@@ -1002,9 +1055,38 @@ gst_rtp_h265_pay_payload_nal (GstRTPBasePayload * basepayload,
     }
   }
 
-  packet_len = gst_rtp_buffer_calc_packet_len (size, 0, 0);
+  if (rtph265pay->aggregate)
+    return gst_rtp_h265_pay_payload_nal_bundle (basepayload, paybuf, dts, pts,
+        end_of_au);
 
-  GST_FIXME_OBJECT (rtph265pay, "Set RTP marker bit appropriately");
+  return gst_rtp_h265_pay_payload_nal_fragment (basepayload, paybuf, dts, pts,
+      end_of_au);
+}
+
+/* Sends the NAL unit in @paybuf in a single NAL unit packet, or in
+ * fragmentation units if it does not fit in the MTU */
+static GstFlowReturn
+gst_rtp_h265_pay_payload_nal_fragment (GstRTPBasePayload * basepayload,
+    GstBuffer * paybuf, GstClockTime dts, GstClockTime pts, gboolean end_of_au)
+{
+  GstRtpH265Pay *rtph265pay;
+  GstFlowReturn ret;
+  guint8 nalHeader[2];
+  guint8 nalType;
+  guint packet_len, payload_len, mtu;
+  GstBuffer *outbuf;
+  guint8 *payload;
+  GstBufferList *list = NULL;
+  GstRTPBuffer rtp = { NULL };
+  guint size = gst_buffer_get_size (paybuf);
+
+  rtph265pay = GST_RTP_H265_PAY (basepayload);
+  mtu = GST_RTP_BASE_PAYLOAD_MTU (rtph265pay);
+
+  gst_buffer_extract (paybuf, 0, nalHeader, 2);
+  nalType = (nalHeader[0] >> 1) & 0x3f;
+
+  packet_len = gst_rtp_buffer_calc_packet_len (size, 0, 0);
 
   if (packet_len < mtu) {
     GST_DEBUG_OBJECT (rtph265pay,
@@ -1018,10 +1100,8 @@ gst_rtp_h265_pay_payload_nal (GstRTPBasePayload * basepayload,
 
     gst_rtp_buffer_map (outbuf, GST_MAP_WRITE, &rtp);
 
-    /* FIXME : only set the marker bit on packets containing access units */
-    /* if (IS_ACCESS_UNIT (nalType) && end_of_au) {
-       gst_rtp_buffer_set_marker (&rtp, 1);
-       } */
+    /* the last packet of an access unit carries the marker */
+    gst_rtp_buffer_set_marker (&rtp, end_of_au);
 
     /* timestamp the outbuffer */
     GST_BUFFER_PTS (outbuf) = pts;
@@ -1086,17 +1166,16 @@ gst_rtp_h265_pay_payload_nal (GstRTPBasePayload * basepayload,
       payload[0] = (nalHeader[0] & 0x81) | (49 << 1);
       payload[1] = nalHeader[1];
 
-      /* FIXME - set RTP marker bit appropriately */
-      /* if (IS_ACCESS_UNIT (nalType)) {
-         gst_rtp_buffer_set_marker (&rtp, end && end_of_au);
-         } */
+      /* only the last fragment of the access unit carries the marker */
+      gst_rtp_buffer_set_marker (&rtp, end && end_of_au);
 
       /* FU Header */
       payload[2] = (start << 7) | (end << 6) | (nalType & 0x3f);
 
       gst_rtp_buffer_unmap (&rtp);
 
-      /* insert payload memory block */
+      /* insert payload memory block, a reference to the memory of the NAL
+       * unit, not a copy */
       gst_rtp_copy_meta (GST_ELEMENT_CAST (rtph265pay), outbuf, paybuf,
           g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
       gst_buffer_copy_into (outbuf, paybuf, GST_BUFFER_COPY_MEMORY, pos,
@@ -1116,6 +1195,236 @@ gst_rtp_h265_pay_payload_nal (GstRTPBasePayload * basepayload,
   return ret;
 }
 
+/* Sends the NAL units bundled so far, in an aggregation packet if there is
+ * more than one */
+static GstFlowReturn
+gst_rtp_h265_pay_send_bundle (GstRtpH265Pay * rtph265pay, gboolean end_of_au)
+{
+  GstRTPBasePayload *basepayload = GST_RTP_BASE_PAYLOAD (rtph265pay);
+  GstBufferList *bundle, *list;
+  GstBuffer *outbuf;
+  GstRTPBuffer rtp = { NULL };
+  guint8 *payload;
+  guint i, n;
+
+  bundle = rtph265pay->bundle;
+  rtph265pay->bundle = NULL;
+
+  if (bundle == NULL)
+    return GST_FLOW_OK;
+
+  n = gst_buffer_list_length (bundle);
+  if (n == 1) {
+    GstBuffer *paybuf = gst_buffer_ref (gst_buffer_list_get (bundle, 0));
+
+    gst_buffer_list_unref (bundle);
+    return gst_rtp_h265_pay_payload_nal_fragment (basepayload, paybuf,
+        rtph265pay->bundle_dts, rtph265pay->bundle_pts, end_of_au);
+  }
+
+  GST_DEBUG_OBJECT (rtph265pay, "sending %u NAL units in an aggregation "
+      "packet of %u bytes", n, rtph265pay->bundle_size);
+
+  /* create buffer containing the RTP header and the PayloadHdr, the NAL
+   * units are referenced, not copied */
+  outbuf = gst_rtp_buffer_new_allocate (2, 0, 0);
+
+  gst_rtp_buffer_map (outbuf, GST_MAP_WRITE, &rtp);
+
+  /* the aggregation packet closes the access unit if its last NAL unit
+   * does */
+  gst_rtp_buffer_set_marker (&rtp, end_of_au);
+
+  GST_BUFFER_PTS (outbuf) = rtph265pay->bundle_pts;
+  GST_BUFFER_DTS (outbuf) = rtph265pay->bundle_dts;
+  payload = gst_rtp_buffer_get_payload (&rtp);
+
+  /* PayloadHdr (type = 48), with the lowest LayerId and TID of the NAL
+   * units */
+  payload[0] = (rtph265pay->bundle_f << 7) | (48 << 1) |
+      (rtph265pay->bundle_layer_id >> 5);
+  payload[1] = ((rtph265pay->bundle_layer_id & 0x1f) << 3) |
+      rtph265pay->bundle_tid;
+
+  gst_rtp_buffer_unmap (&rtp);
+
+  for (i = 0; i < n; i++) {
+    GstBuffer *paybuf = gst_buffer_list_get (bundle, i);
+    guint8 *size = g_malloc (2);
+
+    /* NALU size, followed by the NAL unit */
+    GST_WRITE_UINT16_BE (size, gst_buffer_get_size (paybuf));
+    gst_rtp_copy_meta (GST_ELEMENT_CAST (rtph265pay), outbuf, paybuf,
+        g_quark_from_static_string (GST_META_TAG_VIDEO_STR));
+    outbuf = gst_buffer_append (outbuf, gst_buffer_new_wrapped (size, 2));
+    outbuf = gst_buffer_append (outbuf, gst_buffer_ref (paybuf));
+  }
+  gst_buffer_list_unref (bundle);
+
+  list = gst_buffer_list_new ();
+  gst_buffer_list_add (list, outbuf);
+
+  return gst_rtp_base_payload_push_list (basepayload, list);
+}
+
+/* Adds the NAL unit in @paybuf to the aggregation packet being built,
+ * sending it first if the NAL unit does not fit anymore. The aggregation
+ * packet is also sent at the end of an access unit */
+static GstFlowReturn
+gst_rtp_h265_pay_payload_nal_bundle (GstRTPBasePayload * basepayload,
+    GstBuffer * paybuf, GstClockTime dts, GstClockTime pts, gboolean end_of_au)
+{
+  GstRtpH265Pay *rtph265pay;
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint8 nal_header[2];
+  guint8 layer_id, tid;
+  guint size, mtu;
+
+  rtph265pay = GST_RTP_H265_PAY (basepayload);
+  mtu = GST_RTP_BASE_PAYLOAD_MTU (rtph265pay);
+  size = gst_buffer_get_size (paybuf);
+
+  /* an aggregation packet has a 2 bytes PayloadHdr, and each NAL unit is
+   * preceded by its size on 2 bytes */
+  if (gst_rtp_buffer_calc_packet_len (2 + 2 + size, 0, 0) >= mtu) {
+    ret = gst_rtp_h265_pay_send_bundle (rtph265pay, FALSE);
+    if (ret != GST_FLOW_OK) {
+      gst_buffer_unref (paybuf);
+      return ret;
+    }
+
+    return gst_rtp_h265_pay_payload_nal_fragment (basepayload, paybuf, dts,
+        pts, end_of_au);
+  }
+
+  if (rtph265pay->bundle &&
+      gst_rtp_buffer_calc_packet_len (rtph265pay->bundle_size + 2 + size, 0,
+          0) >= mtu) {
+    ret = gst_rtp_h265_pay_send_bundle (rtph265pay, FALSE);
+    if (ret != GST_FLOW_OK) {
+      gst_buffer_unref (paybuf);
+      return ret;
+    }
+  }
+
+  gst_buffer_extract (paybuf, 0, nal_header, 2);
+  layer_id = ((nal_header[0] & 0x01) << 5) | (nal_header[1] >> 3);
+  tid = nal_header[1] & 0x07;
+
+  if (rtph265pay->bundle == NULL) {
+    rtph265pay->bundle = gst_buffer_list_new ();
+    rtph265pay->bundle_size = 2;
+    rtph265pay->bundle_f = 0;
+    rtph265pay->bundle_layer_id = layer_id;
+    rtph265pay->bundle_tid = tid;
+    rtph265pay->bundle_dts = dts;
+    rtph265pay->bundle_pts = pts;
+  } else {
+    rtph265pay->bundle_layer_id = MIN (rtph265pay->bundle_layer_id, layer_id);
+    rtph265pay->bundle_tid = MIN (rtph265pay->bundle_tid, tid);
+  }
+  rtph265pay->bundle_f |= nal_header[0] >> 7;
+
+  gst_buffer_list_add (rtph265pay->bundle, paybuf);
+  rtph265pay->bundle_size += 2 + size;
+
+  if (end_of_au)
+    ret = gst_rtp_h265_pay_send_bundle (rtph265pay, TRUE);
+
+  return ret;
+}
+
+/* NAL units are not bundled across input buffers, to not add latency */
+static GstFlowReturn
+gst_rtp_h265_pay_finish_bundle (GstRtpH265Pay * rtph265pay, GstFlowReturn ret)
+{
+  if (ret == GST_FLOW_OK)
+    return gst_rtp_h265_pay_send_bundle (rtph265pay, FALSE);
+
+  gst_rtp_h265_pay_reset_bundle (rtph265pay);
+
+  return ret;
+}
+
+/* payloads the NAL units listed in the GstH265NalMeta of a byte-stream
+ * @buffer, which saves scanning it for start codes. Returns FALSE if the
+ * meta does not match the buffer and it needs to be scanned anyway */
+static gboolean
+gst_rtp_h265_pay_handle_nal_meta (GstRTPBasePayload * basepayload,
+    GstBuffer * buffer, GstH265NalMeta * meta, GstFlowReturn * ret)
+{
+  GstRtpH265Pay *rtph265pay = GST_RTP_H265_PAY (basepayload);
+  GstClockTime dts, pts;
+  gboolean update = FALSE;
+  GstMapInfo map;
+  guint i;
+
+  gst_buffer_map (buffer, &map, GST_MAP_READ);
+  for (i = 0; i < meta->n_units; i++) {
+    if (meta->units[i].size == 0 ||
+        meta->units[i].offset + meta->units[i].size > map.size) {
+      GST_WARNING_OBJECT (basepayload, "NAL meta does not match buffer");
+      gst_buffer_unmap (buffer, &map);
+      return FALSE;
+    }
+  }
+
+  pts = GST_BUFFER_PTS (buffer);
+  dts = GST_BUFFER_DTS (buffer);
+  GST_DEBUG_OBJECT (basepayload, "got %" G_GSIZE_FORMAT " bytes, %u NALs",
+      map.size, meta->n_units);
+
+  if (rtph265pay->sprop_parameter_sets == NULL) {
+    for (i = 0; i < meta->n_units; i++) {
+      update = gst_rtp_h265_pay_decode_nal (rtph265pay,
+          map.data + meta->units[i].offset, meta->units[i].size, dts, pts)
+          || update;
+    }
+  }
+  gst_buffer_unmap (buffer, &map);
+
+  if (rtph265pay->sprop_parameter_sets != NULL && rtph265pay->update_caps) {
+    /* explicitly set profile and sprop, use those */
+    if (!gst_rtp_base_payload_set_outcaps (basepayload,
+            "sprop-parameter-sets", G_TYPE_STRING,
+            rtph265pay->sprop_parameter_sets, NULL))
+      goto caps_rejected;
+
+    gst_rtp_h265_pay_parse_sprop_parameter_sets (rtph265pay);
+    rtph265pay->update_caps = FALSE;
+  }
+
+  if (G_UNLIKELY (update))
+    if (!gst_rtp_h265_pay_set_vps_sps_pps (basepayload))
+      goto caps_rejected;
+
+  *ret = GST_FLOW_OK;
+  for (i = 0; i < meta->n_units && *ret == GST_FLOW_OK; i++) {
+    GstBuffer *paybuf;
+    gboolean end_of_au;
+
+    end_of_au = rtph265pay->alignment == GST_H265_ALIGNMENT_AU &&
+        i == meta->n_units - 1;
+    paybuf = gst_buffer_copy_region (buffer, GST_BUFFER_COPY_ALL,
+        meta->units[i].offset, meta->units[i].size);
+    *ret = gst_rtp_h265_pay_payload_nal (basepayload, paybuf, dts, pts,
+        end_of_au);
+  }
+  gst_buffer_unref (buffer);
+
+  *ret = gst_rtp_h265_pay_finish_bundle (rtph265pay, *ret);
+
+  return TRUE;
+
+caps_rejected:
+  {
+    GST_WARNING_OBJECT (basepayload, "Could not set outcaps");
+    gst_buffer_unref (buffer);
+    *ret = GST_FLOW_NOT_NEGOTIATED;
+    return TRUE;
+  }
+}
+
 static GstFlowReturn
 gst_rtp_h265_pay_handle_buffer (GstRTPBasePayload * basepayload,
     GstBuffer * buffer)
@@ -1125,7 +1434,7 @@ gst_rtp_h265_pay_handle_buffer (GstRTPBasePayload * basepayload,
   gsize size;
   guint nal_len, i;
   GstMapInfo map;
-  const guint8 *data;
+  const guint8 *data = NULL;
   GstClockTime dts, pts;
   GArray *nal_queue;
   gboolean hevc;
@@ -1150,6 +1459,15 @@ gst_rtp_h265_pay_handle_buffer (GstRTPBasePayload * basepayload,
     dts = GST_BUFFER_DTS (buffer);
     GST_DEBUG_OBJECT (basepayload, "got %" G_GSIZE_FORMAT " bytes", size);
   } else {
+    GstH265NalMeta *meta;
+
+    /* buffers from h265parse may already list their NALs; only usable when
+     * no partial NAL from a previous buffer is pending */
+    if (buffer && gst_adapter_available (rtph265pay->adapter) == 0 &&
+        (meta = gst_buffer_get_h265_nal_meta (buffer)) && meta->n_units > 0 &&
+        gst_rtp_h265_pay_handle_nal_meta (basepayload, buffer, meta, &ret))
+      return ret;
+
     dts = gst_adapter_prev_dts (rtph265pay->adapter, NULL);
     pts = gst_adapter_prev_pts (rtph265pay->adapter, NULL);
     if (buffer) {
@@ -1164,7 +1482,8 @@ gst_rtp_h265_pay_handle_buffer (GstRTPBasePayload * basepayload,
     /* Nothing to do here if the adapter is empty, e.g. on EOS */
     if (size == 0)
       return GST_FLOW_OK;
-    data = gst_adapter_map (rtph265pay->adapter, size);
+    /* the adapter is not mapped, that would merge the input buffers, it is
+     * scanned in place */
     GST_DEBUG_OBJECT (basepayload,
         "got %" G_GSIZE_FORMAT " bytes (%" G_GSIZE_FORMAT ")", size,
         buffer ? gst_buffer_get_size (buffer) : 0);
@@ -1172,10 +1491,8 @@ gst_rtp_h265_pay_handle_buffer (GstRTPBasePayload * basepayload,
 
   ret = GST_FLOW_OK;
 
-  /* now loop over all NAL units and put them in a packet
-   * FIXME, we should really try to pack multiple NAL units into one RTP packet
-   * if we can, especially for the config packets that wont't cause decoder
-   * latency. */
+  /* now loop over all NAL units and put them in a packet, or in aggregation
+   * packets if enabled */
   if (hevc) {
     guint nal_length_size;
     gsize offset = 0;
@@ -1226,16 +1543,16 @@ gst_rtp_h265_pay_handle_buffer (GstRTPBasePayload * basepayload,
       size -= nal_len;
     }
   } else {
-    guint next;
-    gboolean update = FALSE;
+    GstAdapter *adapter = rtph265pay->adapter;
+    gsize offset, next, scan_from, flushed = 0;
+    gboolean update = FALSE, pending = FALSE;
 
     /* get offset of first start code */
-    next = next_start_code (data, size);
+    next = next_start_code (adapter, 0, size);
 
     /* skip to start code, if no start code is found, next will be size and we
      * will not collect data. */
-    data += next;
-    size -= next;
+    offset = next;
     nal_queue = rtph265pay->queue;
     skip = next;
 
@@ -1243,34 +1560,40 @@ gst_rtp_h265_pay_handle_buffer (GstRTPBasePayload * basepayload,
     g_assert (nal_queue->len == 0);
 
     GST_DEBUG_OBJECT (basepayload,
-        "found first start at %u, bytes left %" G_GSIZE_FORMAT, next, size);
+        "found first start at %" G_GSIZE_FORMAT ", bytes left %"
+        G_GSIZE_FORMAT, next, size - next);
 
     /* first pass to locate NALs and parse SPS/PPS */
-    while (size > 4) {
+    while (size - offset > 4) {
       /* skip start code */
-      data += 3;
-      size -= 3;
-
-      /* use next_start_code() to scan buffer.
-       * next_start_code() returns the offset in data,
-       * starting from zero to the first byte of 0.0.0.1
-       * If no start code is found, it returns the value of the
-       * 'size' parameter.
-       * data is unchanged by the call to next_start_code()
-       */
-      next = next_start_code (data, size);
+      offset += 3;
+
+      /* the first NAL is the one left pending by the previous buffer, don't
+       * scan again what was already scanned of it */
+      scan_from = offset;
+      if (nal_queue->len == 0 && rtph265pay->scan_pos > offset)
+        scan_from = rtph265pay->scan_pos;
 
-      if (next == size && buffer != NULL) {
+      /* next_start_code() returns the offset in the adapter of the first byte
+       * of 0.0.1, or size if no start code is found */
+      next = next_start_code (adapter, scan_from, size);
+
+      if (next == size && buffer != NULL &&
+          rtph265pay->alignment != GST_H265_ALIGNMENT_AU) {
         /* Didn't find the start of next NAL and it's not EOS,
-         * handle it next time */
+         * handle it next time. A start code may be cut at the end of the
+         * data. With au alignment the buffer ends the last NAL, which must
+         * be sent now to carry the marker of the access unit */
+        rtph265pay->scan_pos = size - 3;
+        pending = TRUE;
         break;
       }
 
       /* nal length is distance to next start code */
-      nal_len = next;
+      nal_len = next - offset;
 
-      GST_DEBUG_OBJECT (basepayload, "found next start at %u of size %u", next,
-          nal_len);
+      GST_DEBUG_OBJECT (basepayload, "found next start at %" G_GSIZE_FORMAT
+          " of size %u", next, nal_len);
 
       if (rtph265pay->sprop_parameter_sets != NULL) {
         /* explicitly set profile and sprop, use those */
@@ -1293,15 +1616,16 @@ gst_rtp_h265_pay_handle_buffer (GstRTPBasePayload * basepayload,
          * go parse it for SPS/PPS to enrich the caps */
         /* order: make sure to check nal */
         update =
-            gst_rtp_h265_pay_decode_nal (rtph265pay, data, nal_len, dts, pts)
-            || update;
+            gst_rtp_h265_pay_decode_adapter_nal (rtph265pay, offset, nal_len,
+            dts, pts) || update;
       }
       /* move to next NAL packet */
-      data += nal_len;
-      size -= nal_len;
+      offset = next;
 
       g_array_append_val (nal_queue, nal_len);
     }
+    if (!pending)
+      rtph265pay->scan_pos = 0;
 
     /* if has new VPS, SPS & PPS, update the output caps */
     if (G_UNLIKELY (update))
@@ -1310,8 +1634,10 @@ gst_rtp_h265_pay_handle_buffer (GstRTPBasePayload * basepayload,
 
     /* second pass to payload and push */
 
-    if (nal_queue->len != 0)
-      gst_adapter_flush (rtph265pay->adapter, skip);
+    if (nal_queue->len != 0) {
+      gst_adapter_flush (adapter, skip);
+      flushed = skip;
+    }
 
     for (i = 0; i < nal_queue->len; i++) {
       guint size;
@@ -1319,16 +1645,16 @@ gst_rtp_h265_pay_handle_buffer (GstRTPBasePayload * basepayload,
 
       nal_len = g_array_index (nal_queue, guint, i);
       /* skip start code */
-      gst_adapter_flush (rtph265pay->adapter, 3);
+      gst_adapter_flush (adapter, 3);
 
       /* Trim the end unless we're the last NAL in the stream.
        * In case we're not at the end of the buffer we know the next block
        * starts with 0x000001 so all the 0x00 bytes at the end of this one are
        * trailing 0x0 that can be discarded */
       size = nal_len;
-      data = gst_adapter_map (rtph265pay->adapter, size);
       if (i + 1 != nal_queue->len || buffer != NULL)
-        for (; size > 1 && data[size - 1] == 0x0; size--)
+        for (; size > 1 && adapter_peek_byte (adapter, size - 1) == 0x0;
+            size--)
           /* skip */ ;
 
 
@@ -1342,7 +1668,11 @@ gst_rtp_h265_pay_handle_buffer (GstRTPBasePayload * basepayload,
       if ((rtph265pay->alignment == GST_H265_ALIGNMENT_AU || buffer == NULL) &&
           i == nal_queue->len - 1)
         end_of_au = TRUE;
-      paybuf = gst_adapter_take_buffer (rtph265pay->adapter, size);
+
+      /* the NAL unit references the memory of the input buffers, so that the
+       * packets built from it don't copy the data. Only a NAL unit spanning
+       * several input buffers gets several memories */
+      paybuf = gst_adapter_take_buffer_fast (adapter, size);
       g_assert (paybuf);
 
       /* put the data in one or more RTP packets */
@@ -1355,25 +1685,31 @@ gst_rtp_h265_pay_handle_buffer (GstRTPBasePayload * basepayload,
 
       /* move to next NAL packet */
       /* Skips the trailing zeros */
-      gst_adapter_flush (rtph265pay->adapter, nal_len - size);
+      gst_adapter_flush (adapter, nal_len - size);
+      flushed += 3 + nal_len;
     }
     g_array_set_size (nal_queue, 0);
+
+    /* the pending NAL is now at the start of the adapter */
+    if (ret == GST_FLOW_OK && rtph265pay->scan_pos >= flushed)
+      rtph265pay->scan_pos -= flushed;
+    else
+      rtph265pay->scan_pos = 0;
   }
 
 done:
   if (hevc) {
     gst_buffer_unmap (buffer, &map);
     gst_buffer_unref (buffer);
-  } else {
-    gst_adapter_unmap (rtph265pay->adapter);
   }
 
-  return ret;
+  return gst_rtp_h265_pay_finish_bundle (rtph265pay, ret);
 
 caps_rejected:
   {
     GST_WARNING_OBJECT (basepayload, "Could not set outcaps");
     g_array_set_size (nal_queue, 0);
+    rtph265pay->scan_pos = 0;
     ret = GST_FLOW_NOT_NEGOTIATED;
     goto done;
   }
@@ -1389,6 +1725,8 @@ gst_rtp_h265_pay_sink_event (GstRTPBasePayload * payload, GstEvent * event)
   switch (GST_EVENT_TYPE (event)) {
     case GST_EVENT_FLUSH_STOP:
       gst_adapter_clear (rtph265pay->adapter);
+      gst_rtp_h265_pay_reset_bundle (rtph265pay);
+      rtph265pay->scan_pos = 0;
       break;
     case GST_EVENT_CUSTOM_DOWNSTREAM:
       s = gst_event_get_structure (event);
@@ -1432,6 +1770,8 @@ gst_rtp_h265_pay_change_state (GstElement * element, GstStateChange transition)
     case GST_STATE_CHANGE_READY_TO_PAUSED:
       rtph265pay->send_vps_sps_pps = FALSE;
       gst_adapter_clear (rtph265pay->adapter);
+      gst_rtp_h265_pay_reset_bundle (rtph265pay);
+      rtph265pay->scan_pos = 0;
       break;
     default:
       break;
@@ -1468,6 +1808,9 @@ gst_rtp_h265_pay_set_property (GObject * object, guint prop_id,
     case PROP_CONFIG_INTERVAL:
       rtph265pay->vps_sps_pps_interval = g_value_get_uint (value);
       break;
+    case PROP_AGGREGATE:
+      rtph265pay->aggregate = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1489,6 +1832,9 @@ gst_rtp_h265_pay_get_property (GObject * object, guint prop_id,
     case PROP_CONFIG_INTERVAL:
       g_value_set_uint (value, rtph265pay->vps_sps_pps_interval);
       break;
+    case PROP_AGGREGATE:
+      g_value_set_boolean (value, rtph265pay->aggregate);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
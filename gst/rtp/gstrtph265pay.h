@@ -67,6 +67,18 @@ struct _GstRtpH265Pay
   guint vps_sps_pps_interval;
   gboolean send_vps_sps_pps;
   GstClockTime last_vps_sps_pps;
+
+  /* NAL units waiting to be sent in an aggregation packet */
+  gboolean aggregate;
+  GstBufferList *bundle;
+  guint bundle_size;
+  guint8 bundle_f;
+  guint8 bundle_layer_id;
+  guint8 bundle_tid;
+  GstClockTime bundle_dts, bundle_pts;
+
+  /* offset in the adapter up to which the pending NAL unit was scanned */
+  gsize scan_pos;
 };
 
 struct _GstRtpH265PayClass
@@ -38,6 +38,10 @@
  * gst-launch gnomevfssrc location=http://some.server/session.sdp ! sdpdemux ! fakesink
  * ]| Establish a connection to an HTTP server that contains an SDP session description
  * that gets parsed by sdpdemux and send the raw RTP packets to a fakesink.
+ * |[
+ * gst-launch-1.0 filesrc location=cameras.sdp ! sdpdemux udp-buffer-time=500 ! fakesink
+ * ]| Receive the streams of a local SDP file, with UDP receive buffers big
+ * enough for 500 ms of each stream according to its b= lines.
  * </refsect2>
  */
 
@@ -77,6 +81,13 @@ enum
 #define DEFAULT_TIMEOUT          10000000
 #define DEFAULT_LATENCY_MS       200
 #define DEFAULT_REDIRECT         TRUE
+#define DEFAULT_UDP_BUFFER_TIME  0
+
+/* sequence number jumps bigger than these, forwards or backwards, are
+ * restarts of the sender rather than losses or late packets, like in
+ * rtpsource */
+#define RTP_MAX_DROPOUT          3000
+#define RTP_MAX_MISORDER         100
 
 enum
 {
@@ -84,7 +95,9 @@ enum
   PROP_DEBUG,
   PROP_TIMEOUT,
   PROP_LATENCY,
-  PROP_REDIRECT
+  PROP_REDIRECT,
+  PROP_UDP_BUFFER_TIME,
+  PROP_STATS
 };
 
 static void gst_sdp_demux_finalize (GObject * object);
@@ -153,6 +166,43 @@ gst_sdp_demux_class_init (GstSDPDemuxClass * klass)
           DEFAULT_REDIRECT,
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstSDPDemux:udp-buffer-time:
+   *
+   * Size the kernel receive buffer of the UDP source of each stream to hold
+   * this many milliseconds of the bandwidth of its b=AS or b=TIAS line, so
+   * that bursts of many streams received on one host are not dropped. Streams
+   * without bandwidth keep the system default.
+   *
+   * Since: 1.8
+   */
+  g_object_class_install_property (gobject_class, PROP_UDP_BUFFER_TIME,
+      g_param_spec_uint ("udp-buffer-time", "UDP buffer time",
+          "Size the UDP receive buffers for this many ms of the SDP "
+          "bandwidth of the stream (0 = system default)", 0, G_MAXUINT,
+          DEFAULT_UDP_BUFFER_TIME,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstSDPDemux:stats:
+   *
+   * Statistics of the RTP received, in a structure with a "streams" array
+   * holding for each stream a structure with the fields:
+   *
+   *   "id": #gint, the stream id, as in the pad names
+   *   "bandwidth": #guint64, the SDP bandwidth in bits per second, or 0
+   *   "packets": #guint64, the number of RTP packets received
+   *   "bytes": #guint64, the number of bytes received
+   *   "lost": #guint64, the number of packets missing in the sequence
+   *       numbers, lost on the network or dropped by the receive buffer
+   *
+   * Since: 1.8
+   */
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Statistics of the RTP received per stream", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_add_pad_template (gstelement_class,
       gst_static_pad_template_get (&sinktemplate));
   gst_element_class_add_pad_template (gstelement_class,
@@ -223,12 +273,50 @@ gst_sdp_demux_set_property (GObject * object, guint prop_id,
     case PROP_REDIRECT:
       demux->redirect = g_value_get_boolean (value);
       break;
+    case PROP_UDP_BUFFER_TIME:
+      demux->udp_buffer_time = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
+static GstStructure *
+gst_sdp_demux_create_stats (GstSDPDemux * demux)
+{
+  GstStructure *s;
+  GValue streams = G_VALUE_INIT;
+  GList *walk;
+
+  g_value_init (&streams, GST_TYPE_ARRAY);
+
+  GST_SDP_STREAM_LOCK (demux);
+  GST_OBJECT_LOCK (demux);
+  for (walk = demux->streams; walk; walk = g_list_next (walk)) {
+    GstSDPStream *stream = (GstSDPStream *) walk->data;
+    GValue val = G_VALUE_INIT;
+
+    g_value_init (&val, GST_TYPE_STRUCTURE);
+    g_value_take_boxed (&val,
+        gst_structure_new ("application/x-sdp-demux-stream-stats",
+            "id", G_TYPE_INT, stream->id,
+            "bandwidth", G_TYPE_UINT64, stream->bandwidth,
+            "packets", G_TYPE_UINT64, stream->packets,
+            "bytes", G_TYPE_UINT64, stream->bytes,
+            "lost", G_TYPE_UINT64, stream->lost, NULL));
+    gst_value_array_append_value (&streams, &val);
+    g_value_unset (&val);
+  }
+  GST_OBJECT_UNLOCK (demux);
+  GST_SDP_STREAM_UNLOCK (demux);
+
+  s = gst_structure_new_empty ("application/x-sdp-demux-stats");
+  gst_structure_take_value (s, "streams", &streams);
+
+  return s;
+}
+
 static void
 gst_sdp_demux_get_property (GObject * object, guint prop_id, GValue * value,
     GParamSpec * pspec)
@@ -250,6 +338,12 @@ gst_sdp_demux_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_REDIRECT:
       g_value_set_boolean (value, demux->redirect);
       break;
+    case PROP_UDP_BUFFER_TIME:
+      g_value_set_uint (value, demux->udp_buffer_time);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_sdp_demux_create_stats (demux));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -370,6 +464,44 @@ out:
   return ret;
 }
 
+/* Returns the bandwidth of a b= line in bits per second, 0 for the types
+ * that don't apply to a single stream */
+static guint64
+gst_sdp_demux_parse_bandwidth (const GstSDPBandwidth * bw)
+{
+  if (!g_strcmp0 (bw->bwtype, GST_SDP_BWTYPE_TIAS))
+    return bw->bandwidth;
+  if (!g_strcmp0 (bw->bwtype, GST_SDP_BWTYPE_AS))
+    return (guint64) bw->bandwidth * 1000;
+
+  return 0;
+}
+
+/* The bandwidth of the media, or else of the session */
+static guint64
+gst_sdp_demux_media_bandwidth (const GstSDPMessage * sdp,
+    const GstSDPMedia * media)
+{
+  guint64 bandwidth;
+  guint i;
+
+  for (i = 0; i < gst_sdp_media_bandwidths_len (media); i++) {
+    bandwidth =
+        gst_sdp_demux_parse_bandwidth (gst_sdp_media_get_bandwidth (media, i));
+    if (bandwidth)
+      return bandwidth;
+  }
+
+  for (i = 0; i < gst_sdp_message_bandwidths_len (sdp); i++) {
+    bandwidth =
+        gst_sdp_demux_parse_bandwidth (gst_sdp_message_get_bandwidth (sdp, i));
+    if (bandwidth)
+      return bandwidth;
+  }
+
+  return 0;
+}
+
 static GstSDPStream *
 gst_sdp_demux_create_stream (GstSDPDemux * demux, GstSDPMessage * sdp, gint idx)
 {
@@ -421,6 +553,7 @@ gst_sdp_demux_create_stream (GstSDPDemux * demux, GstSDPMessage * sdp, gint idx)
   stream->destination = conn->address;
   stream->ttl = conn->ttl;
   stream->multicast = is_multicast_address (stream->destination);
+  stream->bandwidth = gst_sdp_demux_media_bandwidth (sdp, media);
 
   stream->rtp_port = gst_sdp_media_get_port (media);
   if (gst_sdp_media_get_attribute_val (media, "rtcp")) {
@@ -434,6 +567,7 @@ gst_sdp_demux_create_stream (GstSDPDemux * demux, GstSDPMessage * sdp, gint idx)
   GST_DEBUG_OBJECT (demux, " pt: %d", stream->pt);
   GST_DEBUG_OBJECT (demux, " container: %d", stream->container);
   GST_DEBUG_OBJECT (demux, " caps: %" GST_PTR_FORMAT, stream->caps);
+  GST_DEBUG_OBJECT (demux, " bandwidth: %" G_GUINT64_FORMAT, stream->bandwidth);
 
   /* we keep track of all streams */
   demux->streams = g_list_append (demux->streams, stream);
@@ -963,12 +1097,85 @@ rtspsrc_failed:
   }
 }
 
+/* called with the object lock */
+static void
+gst_sdp_demux_stream_count (GstSDPStream * stream, GstBuffer * buffer)
+{
+  guint8 header[4];
+  guint16 seq, gap;
+
+  stream->packets++;
+  stream->bytes += gst_buffer_get_size (buffer);
+
+  /* only the sequence number is read, the packet is not mapped */
+  if (gst_buffer_extract (buffer, 0, header, 4) != 4 || (header[0] >> 6) != 2)
+    return;
+
+  seq = GST_READ_UINT16_BE (header + 2);
+  if (stream->have_seq) {
+    gap = seq - stream->next_seq;
+    if (gap <= RTP_MAX_DROPOUT) {
+      stream->lost += gap;
+    } else if ((guint16) (stream->next_seq - seq) <= RTP_MAX_MISORDER) {
+      /* late or duplicate packet */
+      return;
+    }
+    /* else the sender restarted, start counting again from there */
+  }
+
+  stream->have_seq = TRUE;
+  stream->next_seq = seq + 1;
+}
+
+static gboolean
+count_list_buffer (GstBuffer ** buffer, guint idx, gpointer user_data)
+{
+  gst_sdp_demux_stream_count (user_data, *buffer);
+
+  return TRUE;
+}
+
+/* counts what the RTP source pushes, in single buffers or lists */
+static GstPadProbeReturn
+gst_sdp_demux_stream_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  GstSDPStream *stream = user_data;
+
+  GST_OBJECT_LOCK (stream->parent);
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER)
+    gst_sdp_demux_stream_count (stream, GST_PAD_PROBE_INFO_BUFFER (info));
+  else if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST)
+    gst_buffer_list_foreach (GST_PAD_PROBE_INFO_BUFFER_LIST (info),
+        count_list_buffer, stream);
+  GST_OBJECT_UNLOCK (stream->parent);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* The receive buffer that holds udp-buffer-time of the stream, 0 if
+ * unknown */
+static gint
+gst_sdp_demux_udp_buffer_size (GstSDPDemux * demux, GstSDPStream * stream)
+{
+  guint64 size;
+
+  if (!demux->udp_buffer_time || !stream->bandwidth)
+    return 0;
+
+  size = gst_util_uint64_scale (stream->bandwidth / 8, demux->udp_buffer_time,
+      1000);
+
+  return MIN (size, G_MAXINT);
+}
+
 static gboolean
 gst_sdp_demux_stream_configure_udp (GstSDPDemux * demux, GstSDPStream * stream)
 {
   gchar *uri, *name;
   const gchar *destination;
   GstPad *pad;
+  gint buffer_size;
 
   GST_DEBUG_OBJECT (demux, "creating UDP sources for multicast");
 
@@ -1003,8 +1210,20 @@ gst_sdp_demux_stream_configure_udp (GstSDPDemux * demux, GstSDPStream * stream)
     g_object_set (G_OBJECT (stream->udpsrc[0]), "timeout",
         demux->udp_timeout * 1000, NULL);
 
+    /* with many streams on a host, the default receive buffer overflows
+     * while the receiving threads are busy with the other streams */
+    buffer_size = gst_sdp_demux_udp_buffer_size (demux, stream);
+    if (buffer_size) {
+      GST_DEBUG_OBJECT (demux, "receive buffer of %d bytes", buffer_size);
+      g_object_set (G_OBJECT (stream->udpsrc[0]), "buffer-size", buffer_size,
+          NULL);
+    }
+
     /* get output pad of the UDP source. */
     pad = gst_element_get_static_pad (stream->udpsrc[0], "src");
+    gst_pad_add_probe (pad,
+        GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+        gst_sdp_demux_stream_probe, stream, NULL);
 
     name = g_strdup_printf ("recv_rtp_sink_%u", stream->id);
     stream->channelpad[0] = gst_element_get_request_pad (demux->session, name);
@@ -70,6 +70,15 @@ struct _GstSDPStream {
   gchar        *destination;
   guint         ttl;
   gboolean      multicast;
+  /* from the b= lines, in bits per second, 0 if unknown */
+  guint64       bandwidth;
+
+  /* what the RTP source received, protected by the object lock */
+  guint64       packets;
+  guint64       bytes;
+  guint64       lost;
+  gboolean      have_seq;
+  guint16       next_seq;
 
   /* our udp sink back to the server */
   GstElement   *udpsink;
@@ -99,6 +108,7 @@ struct _GstSDPDemux {
   guint64           udp_timeout;
   guint             latency;
   gboolean          redirect;
+  guint             udp_buffer_time;
 
   /* session management */
   GstElement      *session;
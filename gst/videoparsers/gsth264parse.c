@@ -30,6 +30,8 @@
 #include <gst/pbutils/pbutils.h>
 #include <gst/video/video.h>
 #include "gsth264parse.h"
+#include <gst/codecparsers/gsth264nalmeta.h>
+#include "gstvideoparsenal.h"
 
 #include <string.h>
 
@@ -37,11 +39,15 @@ GST_DEBUG_CATEGORY (h264_parse_debug);
 #define GST_CAT_DEFAULT h264_parse_debug
 
 #define DEFAULT_CONFIG_INTERVAL      (0)
+#define DEFAULT_NAL_META             FALSE
 
 enum
 {
   PROP_0,
-  PROP_CONFIG_INTERVAL
+  PROP_CONFIG_INTERVAL,
+  PROP_NAL_META,
+  PROP_KEYFRAME_INDEX,
+  PROP_KEYFRAME_INDEX_LOCATION
 };
 
 enum
@@ -112,6 +118,8 @@ static GstCaps *gst_h264_parse_get_caps (GstBaseParse * parse,
 static gboolean gst_h264_parse_event (GstBaseParse * parse, GstEvent * event);
 static gboolean gst_h264_parse_src_event (GstBaseParse * parse,
     GstEvent * event);
+static gboolean gst_h264_parse_src_query (GstBaseParse * parse,
+    GstQuery * query);
 static void gst_h264_parse_update_src_caps (GstH264Parse * h264parse,
     GstCaps * caps);
 
@@ -136,6 +144,14 @@ gst_h264_parse_class_init (GstH264ParseClass * klass)
           0, 3600, DEFAULT_CONFIG_INTERVAL,
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_NAL_META,
+      g_param_spec_boolean ("nal-meta", "NAL meta",
+          "Attach a GstH264NalMeta listing the NAL units to output buffers",
+          DEFAULT_NAL_META, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  gst_video_parse_index_install_properties (gobject_class,
+      PROP_KEYFRAME_INDEX);
+
   /* Override BaseParse vfuncs */
   parse_class->start = GST_DEBUG_FUNCPTR (gst_h264_parse_start);
   parse_class->stop = GST_DEBUG_FUNCPTR (gst_h264_parse_stop);
@@ -146,6 +162,7 @@ gst_h264_parse_class_init (GstH264ParseClass * klass)
   parse_class->get_sink_caps = GST_DEBUG_FUNCPTR (gst_h264_parse_get_caps);
   parse_class->sink_event = GST_DEBUG_FUNCPTR (gst_h264_parse_event);
   parse_class->src_event = GST_DEBUG_FUNCPTR (gst_h264_parse_src_event);
+  parse_class->src_query = GST_DEBUG_FUNCPTR (gst_h264_parse_src_query);
 
   gst_element_class_add_pad_template (gstelement_class,
       gst_static_pad_template_get (&srctemplate));
@@ -161,7 +178,11 @@ gst_h264_parse_class_init (GstH264ParseClass * klass)
 static void
 gst_h264_parse_init (GstH264Parse * h264parse)
 {
-  h264parse->frame_out = gst_adapter_new ();
+  h264parse->frame_out = g_byte_array_new ();
+  h264parse->nal_units =
+      g_array_new (FALSE, FALSE, sizeof (GstH264NalMetaUnit));
+  h264parse->nal_meta = DEFAULT_NAL_META;
+  gst_video_parse_index_init (&h264parse->index);
   gst_base_parse_set_pts_interpolation (GST_BASE_PARSE (h264parse), FALSE);
   GST_PAD_SET_ACCEPT_INTERSECT (GST_BASE_PARSE_SINK_PAD (h264parse));
   GST_PAD_SET_ACCEPT_TEMPLATE (GST_BASE_PARSE_SINK_PAD (h264parse));
@@ -173,7 +194,9 @@ gst_h264_parse_finalize (GObject * object)
 {
   GstH264Parse *h264parse = GST_H264_PARSE (object);
 
-  g_object_unref (h264parse->frame_out);
+  g_byte_array_unref (h264parse->frame_out);
+  g_array_free (h264parse->nal_units, TRUE);
+  gst_video_parse_index_clear (&h264parse->index);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -193,7 +216,8 @@ gst_h264_parse_reset_frame (GstH264Parse * h264parse)
   h264parse->keyframe = FALSE;
   h264parse->header = FALSE;
   h264parse->frame_start = FALSE;
-  gst_adapter_clear (h264parse->frame_out);
+  g_byte_array_set_size (h264parse->frame_out, 0);
+  g_array_set_size (h264parse->nal_units, 0);
 }
 
 static void
@@ -266,6 +290,8 @@ gst_h264_parse_start (GstBaseParse * parse)
   gst_h264_parse_reset (h264parse);
 
   h264parse->nalparser = gst_h264_nal_parser_new ();
+  /* only AU boundaries and keyframes are derived from slice headers */
+  gst_h264_nal_parser_set_partial_slice_hdr (h264parse->nalparser, TRUE);
 
   h264parse->dts = GST_CLOCK_TIME_NONE;
   h264parse->ts_trn_nb = GST_CLOCK_TIME_NONE;
@@ -275,6 +301,8 @@ gst_h264_parse_start (GstBaseParse * parse)
 
   gst_base_parse_set_min_frame_size (parse, 6);
 
+  gst_video_parse_index_start (&h264parse->index, parse);
+
   return TRUE;
 }
 
@@ -288,6 +316,8 @@ gst_h264_parse_stop (GstBaseParse * parse)
 
   gst_h264_nal_parser_free (h264parse->nalparser);
 
+  gst_video_parse_index_stop (&h264parse->index, parse);
+
   return TRUE;
 }
 
@@ -415,35 +445,52 @@ gst_h264_parse_negotiate (GstH264Parse * h264parse, gint in_format,
       align == GST_H264_PARSE_ALIGN_AU;
 }
 
+/* writes the start code or length prefix of a @size bytes NAL in @format
+ * to @prefix, returns the number of prefix bytes */
+static guint
+gst_h264_parse_nal_prefix (GstH264Parse * h264parse, guint format, guint size,
+    guint8 * prefix)
+{
+  gboolean packetized = format == GST_H264_PARSE_FORMAT_AVC
+      || format == GST_H264_PARSE_FORMAT_AVC3;
+
+  return gst_video_parse_nal_prefix (packetized, h264parse->nal_length_size,
+      size, prefix);
+}
+
 static GstBuffer *
 gst_h264_parse_wrap_nal (GstH264Parse * h264parse, guint format, guint8 * data,
     guint size)
 {
   GstBuffer *buf;
-  guint nl = h264parse->nal_length_size;
-  guint32 tmp;
+  GstMapInfo map;
+  guint nl;
 
   GST_DEBUG_OBJECT (h264parse, "nal length %d", size);
 
   buf = gst_buffer_new_allocate (NULL, 4 + size, NULL);
-  if (format == GST_H264_PARSE_FORMAT_AVC
-      || format == GST_H264_PARSE_FORMAT_AVC3) {
-    tmp = GUINT32_TO_BE (size << (32 - 8 * nl));
-  } else {
-    /* HACK: nl should always be 4 here, otherwise this won't work. 
-     * There are legit cases where nl in avc stream is 2, but byte-stream
-     * SC is still always 4 bytes. */
-    nl = 4;
-    tmp = GUINT32_TO_BE (1);
-  }
-
-  gst_buffer_fill (buf, 0, &tmp, sizeof (guint32));
-  gst_buffer_fill (buf, nl, data, size);
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  nl = gst_h264_parse_nal_prefix (h264parse, format, size, map.data);
+  memcpy (map.data + nl, data, size);
+  gst_buffer_unmap (buf, &map);
   gst_buffer_set_size (buf, size + nl);
 
   return buf;
 }
 
+/* records a NAL unit of @size bytes with its prefix, written at @pos */
+static void
+gst_h264_parse_insert_nal_unit (GstH264Parse * h264parse, guint idx,
+    guint pos, const guint8 * data, gsize size)
+{
+  guint nl;
+
+  nl = h264parse->format == GST_H264_PARSE_FORMAT_BYTE ? 4 :
+      h264parse->nal_length_size;
+  gst_video_parse_insert_nal_unit (h264parse->nal_units, idx, pos + nl,
+      size - nl, data[nl] & 0x1f);
+}
+
 static void
 gst_h264_parser_store_nal (GstH264Parse * h264parse, guint id,
     GstH264NalUnitType naltype, GstH264NalUnit * nalu)
@@ -701,6 +748,7 @@ static gboolean
 gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
 {
   guint nal_type;
+  gint slice_type = -1;
   GstH264PPS pps = { 0, };
   GstH264SPS sps = { 0, };
   GstH264NalParser *nalparser = h264parse->nalparser;
@@ -798,7 +846,7 @@ gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
       /* mark SEI pos */
       if (h264parse->sei_pos == -1) {
         if (h264parse->transform)
-          h264parse->sei_pos = gst_adapter_available (h264parse->frame_out);
+          h264parse->sei_pos = h264parse->frame_out->len;
         else
           h264parse->sei_pos = nalu->sc_offset;
         GST_DEBUG_OBJECT (h264parse, "marking SEI in frame at offset %d",
@@ -842,6 +890,7 @@ gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
 
           h264parse->state |= GST_H264_PARSE_STATE_GOT_SLICE;
           h264parse->field_pic_flag = slice.field_pic_flag;
+          slice_type = slice.type;
         }
       }
       if (G_LIKELY (nal_type != GST_H264_NAL_SLICE_IDR &&
@@ -854,7 +903,7 @@ gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
       /* mind replacement buffer if applicable */
       if (h264parse->idr_pos == -1) {
         if (h264parse->transform)
-          h264parse->idr_pos = gst_adapter_available (h264parse->frame_out);
+          h264parse->idr_pos = h264parse->frame_out->len;
         else
           h264parse->idr_pos = nalu->sc_offset;
         GST_DEBUG_OBJECT (h264parse, "marking IDR in frame at offset %d",
@@ -884,15 +933,34 @@ gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
       break;
   }
 
-  /* if AVC output needed, collect properly prefixed nal in adapter,
+  /* if AVC output needed, collect properly prefixed nal in frame_out,
    * and use that to replace outgoing buffer data later on */
   if (h264parse->transform) {
-    GstBuffer *buf;
+    guint8 prefix[4];
+    guint nl;
 
     GST_LOG_OBJECT (h264parse, "collecting NAL in AVC frame");
-    buf = gst_h264_parse_wrap_nal (h264parse, h264parse->format,
-        nalu->data + nalu->offset, nalu->size);
-    gst_adapter_push (h264parse->frame_out, buf);
+    nl = gst_h264_parse_nal_prefix (h264parse, h264parse->format,
+        nalu->size, prefix);
+    g_byte_array_append (h264parse->frame_out, prefix, nl);
+    g_byte_array_append (h264parse->frame_out, nalu->data + nalu->offset,
+        nalu->size);
+  }
+
+  if (h264parse->nal_meta) {
+    GstH264NalMetaUnit unit;
+
+    if (h264parse->transform)
+      unit.offset = h264parse->frame_out->len - nalu->size;
+    else if (h264parse->split_packetized)
+      /* each NAL is pushed as a frame of its own, after its length prefix */
+      unit.offset = nalu->offset - nalu->sc_offset;
+    else
+      unit.offset = nalu->offset;
+    unit.size = nalu->size;
+    unit.type = nal_type;
+    unit.slice_type = slice_type;
+    g_array_append_val (h264parse->nal_units, unit);
   }
   return TRUE;
 }
@@ -1251,6 +1319,9 @@ skip:
       !(h264parse->state & GST_H264_PARSE_STATE_VALID_PICTURE_HEADERS) ||
       (h264parse->state & GST_H264_PARSE_STATE_GOT_SLICE))
     gst_h264_parse_reset_frame (h264parse);
+  else if (!h264parse->transform)
+    /* the skipped data is not part of the output frame */
+    g_array_set_size (h264parse->nal_units, 0);
   goto out;
 
 invalid_stream:
@@ -2063,11 +2134,15 @@ gst_h264_parse_parse_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
   }
 
   /* replace with transformed AVC output if applicable */
-  av = gst_adapter_available (h264parse->frame_out);
+  av = h264parse->frame_out->len;
   if (av) {
     GstBuffer *buf;
 
-    buf = gst_adapter_take_buffer (h264parse->frame_out, av);
+    /* hand the collected data over as is, and start the next AU in an
+     * array of the same size, which usually avoids any reallocation */
+    buf = gst_buffer_new_wrapped (g_byte_array_free (h264parse->frame_out,
+            FALSE), av);
+    h264parse->frame_out = g_byte_array_sized_new (av);
     gst_buffer_copy_into (buf, buffer, GST_BUFFER_COPY_METADATA, 0, -1);
     gst_buffer_replace (&frame->out_buffer, buf);
     gst_buffer_unref (buf);
@@ -2187,6 +2262,31 @@ gst_h264_parse_prepare_key_unit (GstH264Parse * parse, GstEvent * event)
   parse->push_codec = TRUE;
 }
 
+/* attaches the NAL units collected for the current frame to its output */
+static void
+gst_h264_parse_attach_nal_meta (GstH264Parse * h264parse,
+    GstBaseParseFrame * frame)
+{
+  GstH264NalMeta *meta;
+  GstBuffer *buffer;
+
+  if (frame->out_buffer) {
+    buffer = frame->out_buffer;
+  } else {
+    frame->buffer = gst_buffer_make_writable (frame->buffer);
+    buffer = frame->buffer;
+  }
+
+  /* a meta copied over from the input does not match the output layout */
+  while ((meta = gst_buffer_get_h264_nal_meta (buffer)))
+    gst_buffer_remove_meta (buffer, (GstMeta *) meta);
+
+  meta = gst_buffer_add_h264_nal_meta (buffer,
+      (GstH264NalMetaUnit *) h264parse->nal_units->data,
+      h264parse->nal_units->len);
+  meta->keyframe = h264parse->keyframe;
+}
+
 static GstFlowReturn
 gst_h264_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
 {
@@ -2290,54 +2390,68 @@ gst_h264_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
             }
           }
         } else {
-          /* insert config NALs into AU */
-          GstByteWriter bw;
-          GstBuffer *new_buf;
-          const gboolean bs = h264parse->format == GST_H264_PARSE_FORMAT_BYTE;
-          const gint nls = 4 - h264parse->nal_length_size;
-          gboolean ok;
-
-          gst_byte_writer_init_with_size (&bw, gst_buffer_get_size (buffer),
-              FALSE);
-          ok = gst_byte_writer_put_buffer (&bw, buffer, 0, h264parse->idr_pos);
+          /* insert config NALs into AU; they are all written to a single
+           * new buffer and the AU data itself is only referenced */
+          GstBuffer *codec_buf, *new_buf;
+          GstMapInfo map;
+          gsize size = 0, offset = 0, written;
+          const guint nl = h264parse->format == GST_H264_PARSE_FORMAT_BYTE ?
+              4 : h264parse->nal_length_size;
+          const gboolean packetized =
+              h264parse->format != GST_H264_PARSE_FORMAT_BYTE;
+          guint unit_idx;
+
           GST_DEBUG_OBJECT (h264parse, "- inserting SPS/PPS");
+          for (i = 0; i < GST_H264_MAX_SPS_COUNT; i++) {
+            if ((codec_nal = h264parse->sps_nals[i]))
+              size += nl + gst_buffer_get_size (codec_nal);
+          }
+          for (i = 0; i < GST_H264_MAX_PPS_COUNT; i++) {
+            if ((codec_nal = h264parse->pps_nals[i]))
+              size += nl + gst_buffer_get_size (codec_nal);
+          }
+
+          codec_buf = gst_buffer_new_allocate (NULL, size, NULL);
+          gst_buffer_map (codec_buf, &map, GST_MAP_WRITE);
+          unit_idx = gst_video_parse_shift_nal_units (h264parse->nal_units,
+              h264parse->idr_pos, size);
           for (i = 0; i < GST_H264_MAX_SPS_COUNT; i++) {
             if ((codec_nal = h264parse->sps_nals[i])) {
-              gsize nal_size = gst_buffer_get_size (codec_nal);
               GST_DEBUG_OBJECT (h264parse, "inserting SPS nal");
-              if (bs) {
-                ok &= gst_byte_writer_put_uint32_be (&bw, 1);
-              } else {
-                ok &= gst_byte_writer_put_uint32_be (&bw,
-                    (nal_size << (nls * 8)));
-                ok &= gst_byte_writer_set_pos (&bw,
-                    gst_byte_writer_get_pos (&bw) - nls);
-              }
-
-              ok &= gst_byte_writer_put_buffer (&bw, codec_nal, 0, nal_size);
+              written = gst_video_parse_write_nal (packetized,
+                  h264parse->nal_length_size, codec_nal, map.data + offset);
+              if (h264parse->nal_meta)
+                gst_h264_parse_insert_nal_unit (h264parse, unit_idx++,
+                    h264parse->idr_pos + offset, map.data + offset, written);
+              offset += written;
               h264parse->last_report = new_ts;
             }
           }
           for (i = 0; i < GST_H264_MAX_PPS_COUNT; i++) {
             if ((codec_nal = h264parse->pps_nals[i])) {
-              gsize nal_size = gst_buffer_get_size (codec_nal);
               GST_DEBUG_OBJECT (h264parse, "inserting PPS nal");
-              if (bs) {
-                ok &= gst_byte_writer_put_uint32_be (&bw, 1);
-              } else {
-                ok &= gst_byte_writer_put_uint32_be (&bw,
-                    (nal_size << (nls * 8)));
-                ok &= gst_byte_writer_set_pos (&bw,
-                    gst_byte_writer_get_pos (&bw) - nls);
-              }
-              ok &= gst_byte_writer_put_buffer (&bw, codec_nal, 0, nal_size);
+              written = gst_video_parse_write_nal (packetized,
+                  h264parse->nal_length_size, codec_nal, map.data + offset);
+              if (h264parse->nal_meta)
+                gst_h264_parse_insert_nal_unit (h264parse, unit_idx++,
+                    h264parse->idr_pos + offset, map.data + offset, written);
+              offset += written;
               h264parse->last_report = new_ts;
             }
           }
-          ok &=
-              gst_byte_writer_put_buffer (&bw, buffer, h264parse->idr_pos, -1);
+          gst_buffer_unmap (codec_buf, &map);
+
           /* collect result and push */
-          new_buf = gst_byte_writer_reset_and_get_buffer (&bw);
+          if (h264parse->idr_pos > 0) {
+            new_buf = gst_buffer_copy_region (buffer, GST_BUFFER_COPY_MEMORY,
+                0, h264parse->idr_pos);
+            new_buf = gst_buffer_append (new_buf, codec_buf);
+          } else {
+            new_buf = codec_buf;
+          }
+          new_buf = gst_buffer_append (new_buf,
+              gst_buffer_copy_region (buffer, GST_BUFFER_COPY_MEMORY,
+                  MAX (h264parse->idr_pos, 0), -1));
           gst_buffer_copy_into (new_buf, buffer, GST_BUFFER_COPY_METADATA, 0,
               -1);
           /* should already be keyframe/IDR, but it may not have been,
@@ -2345,10 +2459,6 @@ gst_h264_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
           GST_BUFFER_FLAG_UNSET (new_buf, GST_BUFFER_FLAG_DELTA_UNIT);
           gst_buffer_replace (&frame->out_buffer, new_buf);
           gst_buffer_unref (new_buf);
-          /* some result checking seems to make some compilers happy */
-          if (G_UNLIKELY (!ok)) {
-            GST_ERROR_OBJECT (h264parse, "failed to insert SPS/PPS");
-          }
         }
       }
       /* we pushed whatever we had */
@@ -2359,12 +2469,18 @@ gst_h264_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
     }
   }
 
+  if (h264parse->nal_meta && h264parse->nal_units->len > 0)
+    gst_h264_parse_attach_nal_meta (h264parse, frame);
+
+  gst_video_parse_index_add_frame (&h264parse->index, parse, frame);
+
   /* If SPS/PPS and a keyframe have been parsed, and we're not converting,
    * we might switch to passthrough mode now on the basis that we've seen
    * the SEI packets and know optional caps params (such as multiview).
    * This is an efficiency optimisation that relies on stream properties
    * remaining uniform in practice. */
-  if (h264parse->can_passthrough) {
+  if (h264parse->can_passthrough && !h264parse->nal_meta
+      && !h264parse->index.enabled) {
     if (h264parse->keyframe && h264parse->have_sps && h264parse->have_pps) {
       GST_LOG_OBJECT (parse, "Switching to passthrough mode");
       gst_base_parse_set_passthrough (parse, TRUE);
@@ -2529,6 +2645,8 @@ gst_h264_parse_set_caps (GstBaseParse * parse, GstCaps * caps)
     }
 
     gst_buffer_unmap (codec_data, &map);
+    /* the codec_data NALs are not part of the first frame */
+    g_array_set_size (h264parse->nal_units, 0);
 
     gst_buffer_replace (&h264parse->codec_data_in, codec_data);
   } else if (format == GST_H264_PARSE_FORMAT_BYTE) {
@@ -2775,6 +2893,17 @@ gst_h264_parse_src_event (GstBaseParse * parse, GstEvent * event)
   return res;
 }
 
+static gboolean
+gst_h264_parse_src_query (GstBaseParse * parse, GstQuery * query)
+{
+  GstH264Parse *h264parse = GST_H264_PARSE (parse);
+
+  if (gst_video_parse_index_src_query (&h264parse->index, query))
+    return TRUE;
+
+  return GST_BASE_PARSE_CLASS (parent_class)->src_query (parse, query);
+}
+
 static void
 gst_h264_parse_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
@@ -2787,8 +2916,13 @@ gst_h264_parse_set_property (GObject * object, guint prop_id,
     case PROP_CONFIG_INTERVAL:
       parse->interval = g_value_get_uint (value);
       break;
+    case PROP_NAL_META:
+      parse->nal_meta = g_value_get_boolean (value);
+      break;
     default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      if (!gst_video_parse_index_set_property (&parse->index,
+              PROP_KEYFRAME_INDEX, prop_id, value))
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
@@ -2805,8 +2939,13 @@ gst_h264_parse_get_property (GObject * object, guint prop_id,
     case PROP_CONFIG_INTERVAL:
       g_value_set_uint (value, parse->interval);
       break;
+    case PROP_NAL_META:
+      g_value_set_boolean (value, parse->nal_meta);
+      break;
     default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      if (!gst_video_parse_index_get_property (&parse->index,
+              PROP_KEYFRAME_INDEX, prop_id, value))
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
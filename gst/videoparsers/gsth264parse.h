@@ -28,6 +28,7 @@
 #include <gst/gst.h>
 #include <gst/base/gstbaseparse.h>
 #include <gst/codecparsers/gsth264parser.h>
+#include "gstvideoparseindex.h"
 #include <gst/video/video.h>
 
 G_BEGIN_DECLS
@@ -110,7 +111,9 @@ struct _GstH264Parse
   /*guint next_sc_pos;*/
   gint idr_pos, sei_pos;
   gboolean update_caps;
-  GstAdapter *frame_out;
+  GByteArray *frame_out;
+  /* GstH264NalMetaUnit of the NALs in the output frame */
+  GArray *nal_units;
   gboolean keyframe;
   gboolean header;
   gboolean frame_start;
@@ -119,6 +122,8 @@ struct _GstH264Parse
 
   /* props */
   guint interval;
+  gboolean nal_meta;
+  GstVideoParseIndex index;
 
   GstClockTime pending_key_unit_ts;
   GstEvent *force_key_unit_event;
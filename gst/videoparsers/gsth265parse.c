@@ -26,6 +26,8 @@
 #include <gst/pbutils/pbutils.h>
 #include <gst/video/video.h>
 #include "gsth265parse.h"
+#include <gst/codecparsers/gsth265nalmeta.h>
+#include "gstvideoparsenal.h"
 
 #include <string.h>
 
@@ -33,11 +35,21 @@ GST_DEBUG_CATEGORY (h265_parse_debug);
 #define GST_CAT_DEFAULT h265_parse_debug
 
 #define DEFAULT_CONFIG_INTERVAL      (0)
+#define DEFAULT_NAL_META             FALSE
+#define DEFAULT_SLICE_THREADS        0
+
+/* below this, spreading the slice headers over threads costs more than
+ * it saves */
+#define SLICES_PER_CHUNK             4
 
 enum
 {
   PROP_0,
-  PROP_CONFIG_INTERVAL
+  PROP_CONFIG_INTERVAL,
+  PROP_NAL_META,
+  PROP_SLICE_THREADS,
+  PROP_KEYFRAME_INDEX,
+  PROP_KEYFRAME_INDEX_LOCATION
 };
 
 enum
@@ -55,6 +67,16 @@ enum
   GST_H265_PARSE_ALIGN_AU
 };
 
+/* slice whose header parsing is deferred until the AU is complete */
+typedef struct
+{
+  GstH265NalUnit nalu;
+  /* index in nal_units, or -1 */
+  gint unit;
+  GstH265ParserResult pres;
+  guint type;
+} GstH265ParseSlice;
+
 static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
@@ -92,6 +114,8 @@ static GstCaps *gst_h265_parse_get_caps (GstBaseParse * parse,
 static gboolean gst_h265_parse_event (GstBaseParse * parse, GstEvent * event);
 static gboolean gst_h265_parse_src_event (GstBaseParse * parse,
     GstEvent * event);
+static gboolean gst_h265_parse_src_query (GstBaseParse * parse,
+    GstQuery * query);
 
 static void
 gst_h265_parse_class_init (GstH265ParseClass * klass)
@@ -113,6 +137,24 @@ gst_h265_parse_class_init (GstH265ParseClass * klass)
           "will be multiplexed in the data stream when detected.) (0 = disabled)",
           0, 3600, DEFAULT_CONFIG_INTERVAL,
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_NAL_META,
+      g_param_spec_boolean ("nal-meta", "NAL meta",
+          "Attach a GstH265NalMeta listing the NAL units to output buffers",
+          DEFAULT_NAL_META, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SLICE_THREADS,
+      g_param_spec_uint ("slice-threads", "Slice threads",
+          "Number of extra threads parsing the slice headers of an access "
+          "unit in parallel, once the access unit is complete "
+          "(0 = parse them in the streaming thread as they come)",
+          0, 64, DEFAULT_SLICE_THREADS,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
+
+  gst_video_parse_index_install_properties (gobject_class,
+      PROP_KEYFRAME_INDEX);
+
   /* Override BaseParse vfuncs */
   parse_class->start = GST_DEBUG_FUNCPTR (gst_h265_parse_start);
   parse_class->stop = GST_DEBUG_FUNCPTR (gst_h265_parse_stop);
@@ -123,6 +165,7 @@ gst_h265_parse_class_init (GstH265ParseClass * klass)
   parse_class->get_sink_caps = GST_DEBUG_FUNCPTR (gst_h265_parse_get_caps);
   parse_class->sink_event = GST_DEBUG_FUNCPTR (gst_h265_parse_event);
   parse_class->src_event = GST_DEBUG_FUNCPTR (gst_h265_parse_src_event);
+  parse_class->src_query = GST_DEBUG_FUNCPTR (gst_h265_parse_src_query);
 
   gst_element_class_add_pad_template (gstelement_class,
       gst_static_pad_template_get (&srctemplate));
@@ -138,7 +181,15 @@ gst_h265_parse_class_init (GstH265ParseClass * klass)
 static void
 gst_h265_parse_init (GstH265Parse * h265parse)
 {
-  h265parse->frame_out = gst_adapter_new ();
+  h265parse->frame_out = g_byte_array_new ();
+  h265parse->nal_units =
+      g_array_new (FALSE, FALSE, sizeof (GstH265NalMetaUnit));
+  h265parse->nal_meta = DEFAULT_NAL_META;
+  gst_video_parse_index_init (&h265parse->index);
+  h265parse->slices = g_array_new (FALSE, FALSE, sizeof (GstH265ParseSlice));
+  g_mutex_init (&h265parse->slice_lock);
+  g_cond_init (&h265parse->slice_cond);
+  h265parse->slice_threads = DEFAULT_SLICE_THREADS;
   gst_base_parse_set_pts_interpolation (GST_BASE_PARSE (h265parse), FALSE);
   GST_PAD_SET_ACCEPT_INTERSECT (GST_BASE_PARSE_SINK_PAD (h265parse));
   GST_PAD_SET_ACCEPT_TEMPLATE (GST_BASE_PARSE_SINK_PAD (h265parse));
@@ -150,7 +201,12 @@ gst_h265_parse_finalize (GObject * object)
 {
   GstH265Parse *h265parse = GST_H265_PARSE (object);
 
-  g_object_unref (h265parse->frame_out);
+  g_byte_array_unref (h265parse->frame_out);
+  g_array_free (h265parse->nal_units, TRUE);
+  gst_video_parse_index_clear (&h265parse->index);
+  g_array_free (h265parse->slices, TRUE);
+  g_mutex_clear (&h265parse->slice_lock);
+  g_cond_clear (&h265parse->slice_cond);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -169,7 +225,9 @@ gst_h265_parse_reset_frame (GstH265Parse * h265parse)
   h265parse->sei_pos = -1;
   h265parse->keyframe = FALSE;
   h265parse->header = FALSE;
-  gst_adapter_clear (h265parse->frame_out);
+  g_byte_array_set_size (h265parse->frame_out, 0);
+  g_array_set_size (h265parse->nal_units, 0);
+  g_array_set_size (h265parse->slices, 0);
 }
 
 static void
@@ -206,6 +264,141 @@ gst_h265_parse_reset (GstH265Parse * h265parse)
   gst_h265_parse_reset_frame (h265parse);
 }
 
+static void
+gst_h265_parse_queue_slice (GstH265Parse * h265parse, GstH265NalUnit * nalu)
+{
+  GstH265ParseSlice slice;
+
+  slice.nalu = *nalu;
+  /* only valid until the frame is unmapped, set again when parsing */
+  slice.nalu.data = NULL;
+  slice.unit = h265parse->nal_meta ? h265parse->nal_units->len : -1;
+  slice.pres = GST_H265_PARSER_ERROR;
+  slice.type = 0;
+
+  g_array_append_val (h265parse->slices, slice);
+}
+
+/* parses the @chunk-th part of the queued slice headers, the parser state
+ * is only read meanwhile */
+static void
+gst_h265_parse_parse_slices (GstH265Parse * h265parse, guint chunk)
+{
+  GstH265ParseSlice *slices = (GstH265ParseSlice *) h265parse->slices->data;
+  guint n = h265parse->slices->len;
+  guint i, end;
+
+  end = (chunk + 1) * n / h265parse->slice_chunks;
+  for (i = chunk * n / h265parse->slice_chunks; i < end; i++) {
+    GstH265SliceHdr slice;
+
+    slices[i].pres = gst_h265_parser_parse_slice_hdr (h265parse->nalparser,
+        &slices[i].nalu, &slice);
+    if (slices[i].pres == GST_H265_PARSER_OK)
+      slices[i].type = slice.type;
+    gst_h265_slice_hdr_free (&slice);
+  }
+}
+
+static void
+gst_h265_parse_slice_func (gpointer data, gpointer user_data)
+{
+  GstH265Parse *h265parse = user_data;
+
+  gst_h265_parse_parse_slices (h265parse, GPOINTER_TO_UINT (data));
+
+  g_mutex_lock (&h265parse->slice_lock);
+  if (--h265parse->slices_left == 0)
+    g_cond_signal (&h265parse->slice_cond);
+  g_mutex_unlock (&h265parse->slice_lock);
+}
+
+/* creates, resizes or frees the slice pool after a change of the
+ * slice-threads property. Only called from the streaming thread, in
+ * between two frames, so that the pool is not in use meanwhile */
+static void
+gst_h265_parse_update_slice_pool (GstH265Parse * h265parse)
+{
+  guint slice_threads;
+
+  GST_OBJECT_LOCK (h265parse);
+  slice_threads = h265parse->slice_threads;
+  GST_OBJECT_UNLOCK (h265parse);
+
+  if (slice_threads == 0) {
+    if (h265parse->slice_pool) {
+      GST_DEBUG_OBJECT (h265parse, "parsing slices in the streaming thread");
+      g_thread_pool_free (h265parse->slice_pool, FALSE, TRUE);
+      h265parse->slice_pool = NULL;
+    }
+  } else if (!h265parse->slice_pool) {
+    GST_DEBUG_OBJECT (h265parse, "parsing slices with %u extra threads",
+        slice_threads);
+    h265parse->slice_pool = g_thread_pool_new (gst_h265_parse_slice_func,
+        h265parse, slice_threads, FALSE, NULL);
+  } else if (g_thread_pool_get_max_threads (h265parse->slice_pool) !=
+      slice_threads) {
+    GST_DEBUG_OBJECT (h265parse, "parsing slices with %u extra threads",
+        slice_threads);
+    g_thread_pool_set_max_threads (h265parse->slice_pool, slice_threads,
+        NULL);
+  }
+}
+
+/* parses the slice headers queued for the AU that ends in @data, in
+ * parallel if there are enough of them, and accounts them in order */
+static void
+gst_h265_parse_process_slices (GstH265Parse * h265parse, guint8 * data)
+{
+  GstH265ParseSlice *slices = (GstH265ParseSlice *) h265parse->slices->data;
+  guint n = h265parse->slices->len;
+  guint i, threads;
+
+  if (n == 0)
+    return;
+
+  for (i = 0; i < n; i++)
+    slices[i].nalu.data = data;
+
+  /* the pool can be gone since the slices were queued */
+  threads = h265parse->slice_pool ?
+      g_thread_pool_get_max_threads (h265parse->slice_pool) : 0;
+  h265parse->slice_chunks = CLAMP (n / SLICES_PER_CHUNK, 1, threads + 1);
+  GST_LOG_OBJECT (h265parse, "parsing %u slice headers in %u chunks", n,
+      h265parse->slice_chunks);
+
+  if (h265parse->slice_chunks > 1) {
+    h265parse->slices_left = h265parse->slice_chunks - 1;
+    for (i = 1; i < h265parse->slice_chunks; i++)
+      g_thread_pool_push (h265parse->slice_pool, GUINT_TO_POINTER (i), NULL);
+  }
+
+  /* take the first chunk ourselves */
+  gst_h265_parse_parse_slices (h265parse, 0);
+
+  if (h265parse->slice_chunks > 1) {
+    g_mutex_lock (&h265parse->slice_lock);
+    while (h265parse->slices_left > 0)
+      g_cond_wait (&h265parse->slice_cond, &h265parse->slice_lock);
+    g_mutex_unlock (&h265parse->slice_lock);
+  }
+
+  for (i = 0; i < n; i++) {
+    GST_DEBUG_OBJECT (h265parse, "parse result %d, slice type: %u",
+        slices[i].pres, slices[i].type);
+
+    if (slices[i].pres != GST_H265_PARSER_OK)
+      continue;
+    if (slices[i].type == GST_H265_I_SLICE)
+      h265parse->keyframe |= TRUE;
+    if (slices[i].unit >= 0)
+      g_array_index (h265parse->nal_units, GstH265NalMetaUnit,
+          slices[i].unit).slice_type = slices[i].type;
+  }
+
+  g_array_set_size (h265parse->slices, 0);
+}
+
 static gboolean
 gst_h265_parse_start (GstBaseParse * parse)
 {
@@ -215,9 +408,15 @@ gst_h265_parse_start (GstBaseParse * parse)
   gst_h265_parse_reset (h265parse);
 
   h265parse->nalparser = gst_h265_parser_new ();
+  /* only AU boundaries and keyframes are derived from slice headers */
+  gst_h265_parser_set_partial_slice_hdr (h265parse->nalparser, TRUE);
+
+  gst_h265_parse_update_slice_pool (h265parse);
 
   gst_base_parse_set_min_frame_size (parse, 7);
 
+  gst_video_parse_index_start (&h265parse->index, parse);
+
   return TRUE;
 }
 
@@ -237,8 +436,15 @@ gst_h265_parse_stop (GstBaseParse * parse)
   for (i = 0; i < GST_H265_MAX_PPS_COUNT; i++)
     gst_buffer_replace (&h265parse->pps_nals[i], NULL);
 
+  if (h265parse->slice_pool) {
+    g_thread_pool_free (h265parse->slice_pool, FALSE, TRUE);
+    h265parse->slice_pool = NULL;
+  }
+
   gst_h265_parser_free (h265parse->nalparser);
 
+  gst_video_parse_index_stop (&h265parse->index, parse);
+
   return TRUE;
 }
 
@@ -362,35 +568,52 @@ gst_h265_parse_negotiate (GstH265Parse * h265parse, gint in_format,
   h265parse->transform = (in_format != h265parse->format);
 }
 
+/* writes the start code or length prefix of a @size bytes NAL in @format
+ * to @prefix, returns the number of prefix bytes */
+static guint
+gst_h265_parse_nal_prefix (GstH265Parse * h265parse, guint format, guint size,
+    guint8 * prefix)
+{
+  gboolean packetized = format == GST_H265_PARSE_FORMAT_HVC1
+      || format == GST_H265_PARSE_FORMAT_HEV1;
+
+  return gst_video_parse_nal_prefix (packetized, h265parse->nal_length_size,
+      size, prefix);
+}
+
 static GstBuffer *
 gst_h265_parse_wrap_nal (GstH265Parse * h265parse, guint format, guint8 * data,
     guint size)
 {
   GstBuffer *buf;
-  guint nl = h265parse->nal_length_size;
-  guint32 tmp;
+  GstMapInfo map;
+  guint nl;
 
   GST_DEBUG_OBJECT (h265parse, "nal length %d", size);
 
   buf = gst_buffer_new_allocate (NULL, 4 + size, NULL);
-  if (format == GST_H265_PARSE_FORMAT_HVC1
-      || format == GST_H265_PARSE_FORMAT_HEV1) {
-    tmp = GUINT32_TO_BE (size << (32 - 8 * nl));
-  } else {
-    /* HACK: nl should always be 4 here, otherwise this won't work.
-     * There are legit cases where nl in hevc stream is 2, but byte-stream
-     * SC is still always 4 bytes. */
-    nl = 4;
-    tmp = GUINT32_TO_BE (1);
-  }
-
-  gst_buffer_fill (buf, 0, &tmp, sizeof (guint32));
-  gst_buffer_fill (buf, nl, data, size);
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  nl = gst_h265_parse_nal_prefix (h265parse, format, size, map.data);
+  memcpy (map.data + nl, data, size);
+  gst_buffer_unmap (buf, &map);
   gst_buffer_set_size (buf, size + nl);
 
   return buf;
 }
 
+/* records a NAL unit of @size bytes with its prefix, written at @pos */
+static void
+gst_h265_parse_insert_nal_unit (GstH265Parse * h265parse, guint idx,
+    guint pos, const guint8 * data, gsize size)
+{
+  guint nl;
+
+  nl = h265parse->format == GST_H265_PARSE_FORMAT_BYTE ? 4 :
+      h265parse->nal_length_size;
+  gst_video_parse_insert_nal_unit (h265parse->nal_units, idx, pos + nl,
+      size - nl, (data[nl] >> 1) & 0x3f);
+}
+
 static void
 gst_h265_parser_store_nal (GstH265Parse * h265parse, guint id,
     GstH265NalUnitType naltype, GstH265NalUnit * nalu)
@@ -494,6 +717,7 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
   GstH265VPS vps = { 0, };
   gboolean is_irap;
   guint nal_type;
+  gint slice_type = -1;
   GstH265Parser *nalparser = h265parse->nalparser;
   GstH265ParserResult pres = GST_H265_PARSER_ERROR;
 
@@ -587,7 +811,7 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
       /* mark SEI pos */
       if (h265parse->sei_pos == -1) {
         if (h265parse->transform)
-          h265parse->sei_pos = gst_adapter_available (h265parse->frame_out);
+          h265parse->sei_pos = h265parse->frame_out->len;
         else
           h265parse->sei_pos = nalu->sc_offset;
         GST_DEBUG_OBJECT (h265parse, "marking SEI in frame at offset %d",
@@ -614,21 +838,27 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
     {
       GstH265SliceHdr slice;
 
-      pres = gst_h265_parser_parse_slice_hdr (nalparser, nalu, &slice);
+      if (h265parse->slice_pool && !(h265parse->packetized
+              && h265parse->split_packetized)) {
+        gst_h265_parse_queue_slice (h265parse, nalu);
+      } else {
+        pres = gst_h265_parser_parse_slice_hdr (nalparser, nalu, &slice);
 
-      if (pres == GST_H265_PARSER_OK) {
-        if (GST_H265_IS_I_SLICE (&slice))
-          h265parse->keyframe |= TRUE;
-      }
-      if (slice.first_slice_segment_in_pic_flag == 1)
-        GST_DEBUG_OBJECT (h265parse,
-            "frame start, first_slice_segment_in_pic_flag = 1");
+        if (pres == GST_H265_PARSER_OK) {
+          if (GST_H265_IS_I_SLICE (&slice))
+            h265parse->keyframe |= TRUE;
+          slice_type = slice.type;
+        }
+        if (slice.first_slice_segment_in_pic_flag == 1)
+          GST_DEBUG_OBJECT (h265parse,
+              "frame start, first_slice_segment_in_pic_flag = 1");
 
-      GST_DEBUG_OBJECT (h265parse,
-          "parse result %d, first slice_segment: %u, slice type: %u",
-          pres, slice.first_slice_segment_in_pic_flag, slice.type);
+        GST_DEBUG_OBJECT (h265parse,
+            "parse result %d, first slice_segment: %u, slice type: %u",
+            pres, slice.first_slice_segment_in_pic_flag, slice.type);
 
-      gst_h265_slice_hdr_free (&slice);
+        gst_h265_slice_hdr_free (&slice);
+      }
     }
 
       is_irap = ((nal_type >= GST_H265_NAL_SLICE_BLA_W_LP)
@@ -643,7 +873,7 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
       /* mind replacement buffer if applicable */
       if (h265parse->idr_pos == -1) {
         if (h265parse->transform)
-          h265parse->idr_pos = gst_adapter_available (h265parse->frame_out);
+          h265parse->idr_pos = h265parse->frame_out->len;
         else
           h265parse->idr_pos = nalu->sc_offset;
         GST_DEBUG_OBJECT (h265parse, "marking IDR in frame at offset %d",
@@ -660,15 +890,34 @@ gst_h265_parse_process_nal (GstH265Parse * h265parse, GstH265NalUnit * nalu)
       gst_h265_parser_parse_nal (nalparser, nalu);
   }
 
-  /* if HEVC output needed, collect properly prefixed nal in adapter,
+  /* if HEVC output needed, collect properly prefixed nal in frame_out,
    * and use that to replace outgoing buffer data later on */
   if (h265parse->transform) {
-    GstBuffer *buf;
+    guint8 prefix[4];
+    guint nl;
 
     GST_LOG_OBJECT (h265parse, "collecting NAL in HEVC frame");
-    buf = gst_h265_parse_wrap_nal (h265parse, h265parse->format,
-        nalu->data + nalu->offset, nalu->size);
-    gst_adapter_push (h265parse->frame_out, buf);
+    nl = gst_h265_parse_nal_prefix (h265parse, h265parse->format,
+        nalu->size, prefix);
+    g_byte_array_append (h265parse->frame_out, prefix, nl);
+    g_byte_array_append (h265parse->frame_out, nalu->data + nalu->offset,
+        nalu->size);
+  }
+
+  if (h265parse->nal_meta) {
+    GstH265NalMetaUnit unit;
+
+    if (h265parse->transform)
+      unit.offset = h265parse->frame_out->len - nalu->size;
+    else if (h265parse->split_packetized)
+      /* each NAL is pushed as a frame of its own, after its length prefix */
+      unit.offset = nalu->offset - nalu->sc_offset;
+    else
+      unit.offset = nalu->offset;
+    unit.size = nalu->size;
+    unit.type = nal_type;
+    unit.slice_type = slice_type;
+    g_array_append_val (h265parse->nal_units, unit);
   }
 }
 
@@ -775,6 +1024,8 @@ gst_h265_parse_handle_frame_packetized (GstBaseParse * parse,
         map.data, nalu.offset + nalu.size, map.size, nl, &nalu);
   }
 
+  gst_h265_parse_process_slices (h265parse, map.data);
+
   gst_buffer_unmap (buffer, &map);
 
   if (!h265parse->split_packetized) {
@@ -824,6 +1075,8 @@ gst_h265_parse_handle_frame (GstBaseParse * parse,
   GstH265ParserResult pres;
   gint framesize;
 
+  gst_h265_parse_update_slice_pool (h265parse);
+
   /* delegate in packetized case, no skipping should be needed */
   if (h265parse->packetized)
     return gst_h265_parse_handle_frame_packetized (parse, frame);
@@ -988,6 +1241,8 @@ gst_h265_parse_handle_frame (GstBaseParse * parse,
 end:
   framesize = nalu.offset + nalu.size;
 
+  gst_h265_parse_process_slices (h265parse, data);
+
   gst_buffer_unmap (buffer, &map);
 
   gst_h265_parse_parse_frame (parse, frame);
@@ -1622,11 +1877,15 @@ gst_h265_parse_parse_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
     GST_BUFFER_FLAG_UNSET (buffer, GST_BUFFER_FLAG_HEADER);
 
   /* replace with transformed HEVC output if applicable */
-  av = gst_adapter_available (h265parse->frame_out);
+  av = h265parse->frame_out->len;
   if (av) {
     GstBuffer *buf;
 
-    buf = gst_adapter_take_buffer (h265parse->frame_out, av);
+    /* hand the collected data over as is, and start the next AU in an
+     * array of the same size, which usually avoids any reallocation */
+    buf = gst_buffer_new_wrapped (g_byte_array_free (h265parse->frame_out,
+            FALSE), av);
+    h265parse->frame_out = g_byte_array_sized_new (av);
     gst_buffer_copy_into (buf, buffer, GST_BUFFER_COPY_METADATA, 0, -1);
     gst_buffer_replace (&frame->out_buffer, buf);
     gst_buffer_unref (buf);
@@ -1752,6 +2011,31 @@ gst_h265_parse_prepare_key_unit (GstH265Parse * parse, GstEvent * event)
   parse->push_codec = TRUE;
 }
 
+/* attaches the NAL units collected for the current frame to its output */
+static void
+gst_h265_parse_attach_nal_meta (GstH265Parse * h265parse,
+    GstBaseParseFrame * frame)
+{
+  GstH265NalMeta *meta;
+  GstBuffer *buffer;
+
+  if (frame->out_buffer) {
+    buffer = frame->out_buffer;
+  } else {
+    frame->buffer = gst_buffer_make_writable (frame->buffer);
+    buffer = frame->buffer;
+  }
+
+  /* a meta copied over from the input does not match the output layout */
+  while ((meta = gst_buffer_get_h265_nal_meta (buffer)))
+    gst_buffer_remove_meta (buffer, (GstMeta *) meta);
+
+  meta = gst_buffer_add_h265_nal_meta (buffer,
+      (GstH265NalMetaUnit *) h265parse->nal_units->data,
+      h265parse->nal_units->len);
+  meta->keyframe = h265parse->keyframe;
+}
+
 static GstFlowReturn
 gst_h265_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
 {
@@ -1852,71 +2136,84 @@ gst_h265_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
             }
           }
         } else {
-          /* insert config NALs into AU */
-          GstByteWriter bw;
-          GstBuffer *new_buf;
-          const gboolean bs = h265parse->format == GST_H265_PARSE_FORMAT_BYTE;
-          const gint nls = 4 - h265parse->nal_length_size;
-          gboolean ok;
-
-          gst_byte_writer_init_with_size (&bw, gst_buffer_get_size (buffer),
-              FALSE);
-          ok = gst_byte_writer_put_buffer (&bw, buffer, 0, h265parse->idr_pos);
+          /* insert config NALs into AU; they are all written to a single
+           * new buffer and the AU data itself is only referenced */
+          GstBuffer *codec_buf, *new_buf;
+          GstMapInfo map;
+          gsize size = 0, offset = 0, written;
+          const guint nl = h265parse->format == GST_H265_PARSE_FORMAT_BYTE ?
+              4 : h265parse->nal_length_size;
+          const gboolean packetized =
+              h265parse->format != GST_H265_PARSE_FORMAT_BYTE;
+          guint unit_idx;
+
           GST_DEBUG_OBJECT (h265parse, "- inserting VPS/SPS/PPS");
+          for (i = 0; i < GST_H265_MAX_VPS_COUNT; i++) {
+            if ((codec_nal = h265parse->vps_nals[i]))
+              size += nl + gst_buffer_get_size (codec_nal);
+          }
+          for (i = 0; i < GST_H265_MAX_SPS_COUNT; i++) {
+            if ((codec_nal = h265parse->sps_nals[i]))
+              size += nl + gst_buffer_get_size (codec_nal);
+          }
+          for (i = 0; i < GST_H265_MAX_PPS_COUNT; i++) {
+            if ((codec_nal = h265parse->pps_nals[i]))
+              size += nl + gst_buffer_get_size (codec_nal);
+          }
+
+          codec_buf = gst_buffer_new_allocate (NULL, size, NULL);
+          gst_buffer_map (codec_buf, &map, GST_MAP_WRITE);
+          unit_idx = gst_video_parse_shift_nal_units (h265parse->nal_units,
+              h265parse->idr_pos, size);
           for (i = 0; i < GST_H265_MAX_VPS_COUNT; i++) {
             if ((codec_nal = h265parse->vps_nals[i])) {
-              gsize nal_size = gst_buffer_get_size (codec_nal);
               GST_DEBUG_OBJECT (h265parse, "inserting VPS nal");
-              if (bs) {
-                ok &= gst_byte_writer_put_uint32_be (&bw, 1);
-              } else {
-                ok &= gst_byte_writer_put_uint32_be (&bw,
-                    (nal_size << (nls * 8)));
-                ok &= gst_byte_writer_set_pos (&bw,
-                    gst_byte_writer_get_pos (&bw) - nls);
-              }
-
-              ok &= gst_byte_writer_put_buffer (&bw, codec_nal, 0, nal_size);
+              written = gst_video_parse_write_nal (packetized,
+                  h265parse->nal_length_size, codec_nal, map.data + offset);
+              if (h265parse->nal_meta)
+                gst_h265_parse_insert_nal_unit (h265parse, unit_idx++,
+                    h265parse->idr_pos + offset, map.data + offset, written);
+              offset += written;
               h265parse->last_report = new_ts;
             }
           }
           for (i = 0; i < GST_H265_MAX_SPS_COUNT; i++) {
             if ((codec_nal = h265parse->sps_nals[i])) {
-              gsize nal_size = gst_buffer_get_size (codec_nal);
               GST_DEBUG_OBJECT (h265parse, "inserting SPS nal");
-              if (bs) {
-                ok &= gst_byte_writer_put_uint32_be (&bw, 1);
-              } else {
-                ok &= gst_byte_writer_put_uint32_be (&bw,
-                    (nal_size << (nls * 8)));
-                ok &= gst_byte_writer_set_pos (&bw,
-                    gst_byte_writer_get_pos (&bw) - nls);
-              }
-
-              ok &= gst_byte_writer_put_buffer (&bw, codec_nal, 0, nal_size);
+              written = gst_video_parse_write_nal (packetized,
+                  h265parse->nal_length_size, codec_nal, map.data + offset);
+              if (h265parse->nal_meta)
+                gst_h265_parse_insert_nal_unit (h265parse, unit_idx++,
+                    h265parse->idr_pos + offset, map.data + offset, written);
+              offset += written;
               h265parse->last_report = new_ts;
             }
           }
           for (i = 0; i < GST_H265_MAX_PPS_COUNT; i++) {
             if ((codec_nal = h265parse->pps_nals[i])) {
-              gsize nal_size = gst_buffer_get_size (codec_nal);
               GST_DEBUG_OBJECT (h265parse, "inserting PPS nal");
-              if (bs) {
-                ok &= gst_byte_writer_put_uint32_be (&bw, 1);
-              } else {
-                ok &= gst_byte_writer_put_uint32_be (&bw,
-                    (nal_size << (nls * 8)));
-                ok &= gst_byte_writer_set_pos (&bw,
-                    gst_byte_writer_get_pos (&bw) - nls);
-              }
-              ok &= gst_byte_writer_put_buffer (&bw, codec_nal, 0, nal_size);
+              written = gst_video_parse_write_nal (packetized,
+                  h265parse->nal_length_size, codec_nal, map.data + offset);
+              if (h265parse->nal_meta)
+                gst_h265_parse_insert_nal_unit (h265parse, unit_idx++,
+                    h265parse->idr_pos + offset, map.data + offset, written);
+              offset += written;
               h265parse->last_report = new_ts;
             }
           }
-          ok &=
-              gst_byte_writer_put_buffer (&bw, buffer, h265parse->idr_pos, -1);
+          gst_buffer_unmap (codec_buf, &map);
+
           /* collect result and push */
-          new_buf = gst_byte_writer_reset_and_get_buffer (&bw);
+          if (h265parse->idr_pos > 0) {
+            new_buf = gst_buffer_copy_region (buffer, GST_BUFFER_COPY_MEMORY,
+                0, h265parse->idr_pos);
+            new_buf = gst_buffer_append (new_buf, codec_buf);
+          } else {
+            new_buf = codec_buf;
+          }
+          new_buf = gst_buffer_append (new_buf,
+              gst_buffer_copy_region (buffer, GST_BUFFER_COPY_MEMORY,
+                  MAX (h265parse->idr_pos, 0), -1));
           gst_buffer_copy_into (new_buf, buffer, GST_BUFFER_COPY_METADATA, 0,
               -1);
           /* should already be keyframe/IDR, but it may not have been,
@@ -1924,10 +2221,6 @@ gst_h265_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
           GST_BUFFER_FLAG_UNSET (new_buf, GST_BUFFER_FLAG_DELTA_UNIT);
           gst_buffer_replace (&frame->out_buffer, new_buf);
           gst_buffer_unref (new_buf);
-          /* some result checking seems to make some compilers happy */
-          if (G_UNLIKELY (!ok)) {
-            GST_ERROR_OBJECT (h265parse, "failed to insert SPS/PPS");
-          }
         }
       }
       /* we pushed whatever we had */
@@ -1938,6 +2231,11 @@ gst_h265_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
     }
   }
 
+  if (h265parse->nal_meta && h265parse->nal_units->len > 0)
+    gst_h265_parse_attach_nal_meta (h265parse, frame);
+
+  gst_video_parse_index_add_frame (&h265parse->index, parse, frame);
+
   gst_h265_parse_reset_frame (h265parse);
 
   return GST_FLOW_OK;
@@ -2023,6 +2321,9 @@ gst_h265_parse_set_caps (GstBaseParse * parse, GstCaps * caps)
         off = nalu.offset + nalu.size;
       }
     }
+    gst_buffer_unmap (codec_data, &map);
+    /* the codec_data NALs are not part of the first frame */
+    g_array_set_size (h265parse->nal_units, 0);
 
   } else {
     GST_DEBUG_OBJECT (h265parse, "have bytestream h265");
@@ -2241,6 +2542,17 @@ gst_h265_parse_src_event (GstBaseParse * parse, GstEvent * event)
   return res;
 }
 
+static gboolean
+gst_h265_parse_src_query (GstBaseParse * parse, GstQuery * query)
+{
+  GstH265Parse *h265parse = GST_H265_PARSE (parse);
+
+  if (gst_video_parse_index_src_query (&h265parse->index, query))
+    return TRUE;
+
+  return GST_BASE_PARSE_CLASS (parent_class)->src_query (parse, query);
+}
+
 static void
 gst_h265_parse_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
@@ -2252,8 +2564,19 @@ gst_h265_parse_set_property (GObject * object, guint prop_id,
     case PROP_CONFIG_INTERVAL:
       parse->interval = g_value_get_uint (value);
       break;
+    case PROP_NAL_META:
+      parse->nal_meta = g_value_get_boolean (value);
+      break;
+    case PROP_SLICE_THREADS:
+      /* applied by the streaming thread on the next frame */
+      GST_OBJECT_LOCK (parse);
+      parse->slice_threads = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (parse);
+      break;
     default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      if (!gst_video_parse_index_set_property (&parse->index,
+              PROP_KEYFRAME_INDEX, prop_id, value))
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
@@ -2269,8 +2592,18 @@ gst_h265_parse_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_CONFIG_INTERVAL:
       g_value_set_uint (value, parse->interval);
       break;
+    case PROP_NAL_META:
+      g_value_set_boolean (value, parse->nal_meta);
+      break;
+    case PROP_SLICE_THREADS:
+      GST_OBJECT_LOCK (parse);
+      g_value_set_uint (value, parse->slice_threads);
+      GST_OBJECT_UNLOCK (parse);
+      break;
     default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      if (!gst_video_parse_index_get_property (&parse->index,
+              PROP_KEYFRAME_INDEX, prop_id, value))
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
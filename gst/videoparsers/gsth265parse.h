@@ -24,6 +24,7 @@
 #include <gst/gst.h>
 #include <gst/base/gstbaseparse.h>
 #include <gst/codecparsers/gsth265parser.h>
+#include "gstvideoparseindex.h"
 
 G_BEGIN_DECLS
 
@@ -81,14 +82,29 @@ struct _GstH265Parse
   /* frame parsing */
   gint idr_pos, sei_pos;
   gboolean update_caps;
-  GstAdapter *frame_out;
+  GByteArray *frame_out;
+  /* GstH265NalMetaUnit of the NALs in the output frame */
+  GArray *nal_units;
   gboolean keyframe;
   gboolean header;
   /* AU state */
   gboolean picture_start;
 
+  /* slices whose header is parsed once the AU is complete, possibly
+   * spread over slice_pool */
+  GArray *slices;
+  GThreadPool *slice_pool;
+  guint slice_chunks;
+  guint slices_left;
+  GMutex slice_lock;
+  GCond slice_cond;
+
   /* props */
   guint interval;
+  gboolean nal_meta;
+  GstVideoParseIndex index;
+  /* protected by the object lock, slice_pool follows it */
+  guint slice_threads;
 
   gboolean sent_codec_tag;
 
@@ -54,14 +54,22 @@ GST_STATIC_PAD_TEMPLATE ("sink", GST_PAD_SINK,
 /* Properties */
 #define DEFAULT_PROP_DROP       TRUE
 #define DEFAULT_PROP_GOP_SPLIT  FALSE
+#define DEFAULT_PROP_FAST_PARSE FALSE
 
 enum
 {
   PROP_0,
   PROP_DROP,
-  PROP_GOP_SPLIT
+  PROP_GOP_SPLIT,
+  PROP_KEYFRAME_INDEX,
+  PROP_KEYFRAME_INDEX_LOCATION,
+  PROP_FAST_PARSE
 };
 
+/* a picture coding extension without composite display data fits in
+ * this many bytes */
+#define PICEXT_CACHE_SIZE 5
+
 #define parent_class gst_mpegv_parse_parent_class
 G_DEFINE_TYPE (GstMpegvParse, gst_mpegv_parse, GST_TYPE_BASE_PARSE);
 
@@ -78,6 +86,9 @@ static GstFlowReturn gst_mpegv_parse_pre_push_frame (GstBaseParse * parse,
     GstBaseParseFrame * frame);
 static gboolean gst_mpegv_parse_sink_query (GstBaseParse * parse,
     GstQuery * query);
+static gboolean gst_mpegv_parse_src_query (GstBaseParse * parse,
+    GstQuery * query);
+static void gst_mpegv_parse_finalize (GObject * object);
 
 static void gst_mpegv_parse_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
@@ -97,8 +108,13 @@ gst_mpegv_parse_set_property (GObject * object, guint property_id,
     case PROP_GOP_SPLIT:
       parse->gop_split = g_value_get_boolean (value);
       break;
+    case PROP_FAST_PARSE:
+      parse->fast_parse = g_value_get_boolean (value);
+      break;
     default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      if (!gst_video_parse_index_set_property (&parse->index,
+              PROP_KEYFRAME_INDEX, property_id, value))
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
   }
 }
 
@@ -115,8 +131,13 @@ gst_mpegv_parse_get_property (GObject * object, guint property_id,
     case PROP_GOP_SPLIT:
       g_value_set_boolean (value, parse->gop_split);
       break;
+    case PROP_FAST_PARSE:
+      g_value_set_boolean (value, parse->fast_parse);
+      break;
     default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      if (!gst_video_parse_index_get_property (&parse->index,
+              PROP_KEYFRAME_INDEX, property_id, value))
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
   }
 }
 
@@ -134,6 +155,7 @@ gst_mpegv_parse_class_init (GstMpegvParseClass * klass)
 
   gobject_class->set_property = gst_mpegv_parse_set_property;
   gobject_class->get_property = gst_mpegv_parse_get_property;
+  gobject_class->finalize = gst_mpegv_parse_finalize;
 
   g_object_class_install_property (gobject_class, PROP_DROP,
       g_param_spec_boolean ("drop", "drop",
@@ -146,6 +168,17 @@ gst_mpegv_parse_class_init (GstMpegvParseClass * klass)
           "Split frame when encountering GOP", DEFAULT_PROP_GOP_SPLIT,
           G_PARAM_CONSTRUCT | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  gst_video_parse_index_install_properties (gobject_class,
+      PROP_KEYFRAME_INDEX);
+
+  g_object_class_install_property (gobject_class, PROP_FAST_PARSE,
+      g_param_spec_boolean ("fast-parse", "Fast parse",
+          "Skip over the slices of a picture and only parse the picture "
+          "headers that changed. GstMpegVideoMeta is then only added if "
+          "downstream asks for it",
+          DEFAULT_PROP_FAST_PARSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_add_pad_template (element_class,
       gst_static_pad_template_get (&src_template));
   gst_element_class_add_pad_template (element_class,
@@ -168,6 +201,7 @@ gst_mpegv_parse_class_init (GstMpegvParseClass * klass)
   parse_class->pre_push_frame =
       GST_DEBUG_FUNCPTR (gst_mpegv_parse_pre_push_frame);
   parse_class->sink_query = GST_DEBUG_FUNCPTR (gst_mpegv_parse_sink_query);
+  parse_class->src_query = GST_DEBUG_FUNCPTR (gst_mpegv_parse_src_query);
 }
 
 static void
@@ -178,6 +212,18 @@ gst_mpegv_parse_init (GstMpegvParse * parse)
   gst_base_parse_set_pts_interpolation (GST_BASE_PARSE (parse), FALSE);
   GST_PAD_SET_ACCEPT_INTERSECT (GST_BASE_PARSE_SINK_PAD (parse));
   GST_PAD_SET_ACCEPT_TEMPLATE (GST_BASE_PARSE_SINK_PAD (parse));
+
+  gst_video_parse_index_init (&parse->index);
+}
+
+static void
+gst_mpegv_parse_finalize (GObject * object)
+{
+  GstMpegvParse *mpvparse = GST_MPEGVIDEO_PARSE (object);
+
+  gst_video_parse_index_clear (&mpvparse->index);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 static void
@@ -202,7 +248,9 @@ gst_mpegv_parse_reset (GstMpegvParse * mpvparse)
   mpvparse->profile = 0;
   mpvparse->update_caps = TRUE;
   mpvparse->send_codec_tag = TRUE;
-  mpvparse->send_mpeg_meta = TRUE;
+  /* in fast-parse mode, the meta is only added if downstream asked for it
+   * in an allocation query */
+  mpvparse->send_mpeg_meta = !mpvparse->fast_parse;
 
   gst_buffer_replace (&mpvparse->config, NULL);
   memset (&mpvparse->sequencehdr, 0, sizeof (mpvparse->sequencehdr));
@@ -216,6 +264,8 @@ gst_mpegv_parse_reset (GstMpegvParse * mpvparse)
   mpvparse->seqdispext_updated = FALSE;
   mpvparse->picext_updated = FALSE;
   mpvparse->quantmatrext_updated = FALSE;
+
+  mpvparse->picext_cached = FALSE;
 }
 
 static gboolean
@@ -238,6 +288,17 @@ gst_mpegv_parse_sink_query (GstBaseParse * parse, GstQuery * query)
   return res;
 }
 
+static gboolean
+gst_mpegv_parse_src_query (GstBaseParse * parse, GstQuery * query)
+{
+  GstMpegvParse *mpvparse = GST_MPEGVIDEO_PARSE (parse);
+
+  if (gst_video_parse_index_src_query (&mpvparse->index, query))
+    return TRUE;
+
+  return GST_BASE_PARSE_CLASS (parent_class)->src_query (parse, query);
+}
+
 static gboolean
 gst_mpegv_parse_start (GstBaseParse * parse)
 {
@@ -249,6 +310,8 @@ gst_mpegv_parse_start (GstBaseParse * parse)
   /* at least this much for a valid frame */
   gst_base_parse_set_min_frame_size (parse, 6);
 
+  gst_video_parse_index_start (&mpvparse->index, parse);
+
   return TRUE;
 }
 
@@ -260,6 +323,7 @@ gst_mpegv_parse_stop (GstBaseParse * parse)
   GST_DEBUG_OBJECT (parse, "stop");
 
   gst_mpegv_parse_reset (mpvparse);
+  gst_video_parse_index_stop (&mpvparse->index, parse);
 
   return TRUE;
 }
@@ -444,23 +508,37 @@ parse_packet_extension (GstMpegvParse * mpvparse, GstMapInfo * info, guint off)
   packet.offset = off;
   packet.size = info->size - off;
 
-  /* FIXME : WE ARE ASSUMING IT IS A *PICTURE* EXTENSION */
-  if (gst_mpeg_video_packet_parse_picture_extension (&packet,
+  /* most streams repeat the same extension for every picture, in which
+   * case the previous result is still valid */
+  if (mpvparse->fast_parse && mpvparse->picext_cached &&
+      packet.size >= PICEXT_CACHE_SIZE &&
+      memcmp (packet.data + off, mpvparse->picext_raw,
+          PICEXT_CACHE_SIZE) == 0) {
+    GST_LOG_OBJECT (mpvparse, "picture extension unchanged");
+  } else if (gst_mpeg_video_packet_parse_picture_extension (&packet,
           &mpvparse->picext)) {
-    mpvparse->frame_repeat_count = 1;
-
-    if (mpvparse->picext.repeat_first_field) {
-      if (mpvparse->sequenceext.progressive) {
-        if (mpvparse->picext.top_field_first)
-          mpvparse->frame_repeat_count = 5;
-        else
-          mpvparse->frame_repeat_count = 3;
-      } else if (mpvparse->picext.progressive_frame) {
-        mpvparse->frame_repeat_count = 2;
-      }
+    /* FIXME : WE ARE ASSUMING IT IS A *PICTURE* EXTENSION */
+    mpvparse->picext_cached = mpvparse->fast_parse &&
+        !mpvparse->picext.composite_display;
+    if (mpvparse->picext_cached)
+      memcpy (mpvparse->picext_raw, packet.data + off, PICEXT_CACHE_SIZE);
+  } else {
+    return;
+  }
+
+  mpvparse->frame_repeat_count = 1;
+
+  if (mpvparse->picext.repeat_first_field) {
+    if (mpvparse->sequenceext.progressive) {
+      if (mpvparse->picext.top_field_first)
+        mpvparse->frame_repeat_count = 5;
+      else
+        mpvparse->frame_repeat_count = 3;
+    } else if (mpvparse->picext.progressive_frame) {
+      mpvparse->frame_repeat_count = 2;
     }
-    mpvparse->picext_updated = TRUE;
   }
+  mpvparse->picext_updated = TRUE;
 }
 
 /* caller guarantees at least start code in @buf at @off ( - 4)*/
@@ -539,12 +617,29 @@ gst_mpegv_parse_process_sc (GstMpegvParse * mpvparse,
   /* extract some picture info if there is any in the frame being terminated */
   if (ret && mpvparse->pic_offset >= 0 && mpvparse->pic_offset < off) {
     GstMpegVideoPacket header;
+    gboolean parsed = FALSE;
 
     header.data = info->data;
     header.type = GST_MPEG_VIDEO_PACKET_PICTURE;
     header.offset = mpvparse->pic_offset;
     header.size = info->size - mpvparse->pic_offset;
-    if (gst_mpeg_video_packet_parse_picture_header (&header, &mpvparse->pichdr))
+    if (mpvparse->fast_parse && !mpvparse->send_mpeg_meta && header.size >= 2) {
+      const guint8 *data = header.data + header.offset;
+      guint8 pic_type = (data[1] >> 3) & 0x07;
+
+      /* only what parse_frame needs, the rest only goes to the meta. Reject
+       * the same picture types as the full parser does */
+      if (pic_type != 0 && pic_type <= GST_MPEG_VIDEO_PICTURE_TYPE_D) {
+        mpvparse->pichdr.tsn = (data[0] << 2) | (data[1] >> 6);
+        mpvparse->pichdr.pic_type = pic_type;
+        parsed = TRUE;
+      }
+    } else {
+      parsed = gst_mpeg_video_packet_parse_picture_header (&header,
+          &mpvparse->pichdr);
+    }
+
+    if (parsed)
       GST_LOG_OBJECT (mpvparse, "picture_coding_type %d (%s), ending"
           "frame of size %d", mpvparse->pichdr.pic_type,
           picture_type_name (mpvparse->pichdr.pic_type), off - 4);
@@ -659,9 +754,18 @@ next:
   *skipsize = 0;
   /* terminating start code may have been found in prev scan already */
   if (((gint) packet.size) >= 0) {
+    gboolean found;
+
     off = packet.offset + packet.size;
-    /* so now we have start code at start of data; locate next start code */
-    if (!gst_mpeg_video_parse (&packet, data, size, off)) {
+    /* so now we have start code at start of data; locate next start code.
+     * Past the first slice, only the end of the picture matters */
+    if (mpvparse->fast_parse && mpvparse->slice_offset > 0 &&
+        !mpvparse->send_mpeg_meta)
+      found = gst_mpeg_video_parse_skip_slices (&packet, data, size, off);
+    else
+      found = gst_mpeg_video_parse (&packet, data, size, off);
+
+    if (!found) {
       off = -1;
     } else {
       g_assert (packet.offset >= 4);
@@ -994,6 +1098,9 @@ gst_mpegv_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
     meta->num_slices = mpvparse->slice_count;
     meta->slice_offset = mpvparse->slice_offset;
   }
+
+  gst_video_parse_index_add_frame (&mpvparse->index, parse, frame);
+
   return GST_FLOW_OK;
 }
 
@@ -30,6 +30,8 @@
 
 #include <gst/codecparsers/gstmpegvideoparser.h>
 
+#include "gstvideoparseindex.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_MPEGVIDEO_PARSE            (gst_mpegv_parse_get_type())
@@ -90,6 +92,12 @@ struct _GstMpegvParse {
   /* properties */
   gboolean drop;
   gboolean gop_split;
+  gboolean fast_parse;
+  GstVideoParseIndex index;
+
+  /* fast-parse: start of the last parsed picture coding extension */
+  guint8 picext_raw[5];
+  gboolean picext_cached;
 
   int fps_num;
   int fps_den;
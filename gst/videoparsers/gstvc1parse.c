@@ -184,10 +184,21 @@ static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
         "header-format=(string) {none, asf, sequence-layer}"));
 
 
+enum
+{
+  PROP_0,
+  PROP_KEYFRAME_INDEX,
+  PROP_KEYFRAME_INDEX_LOCATION
+};
+
 #define parent_class gst_vc1_parse_parent_class
 G_DEFINE_TYPE (GstVC1Parse, gst_vc1_parse, GST_TYPE_BASE_PARSE);
 
 static void gst_vc1_parse_finalize (GObject * object);
+static void gst_vc1_parse_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_vc1_parse_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
 
 static gboolean gst_vc1_parse_start (GstBaseParse * parse);
 static gboolean gst_vc1_parse_stop (GstBaseParse * parse);
@@ -200,6 +211,8 @@ static GstCaps *gst_vc1_parse_get_sink_caps (GstBaseParse * parse,
     GstCaps * filter);
 static GstFlowReturn gst_vc1_parse_detect (GstBaseParse * parse,
     GstBuffer * buffer);
+static gboolean gst_vc1_parse_src_query (GstBaseParse * parse,
+    GstQuery * query);
 
 static void gst_vc1_parse_reset (GstVC1Parse * vc1parse);
 static gboolean gst_vc1_parse_handle_seq_layer (GstVC1Parse * vc1parse,
@@ -221,6 +234,11 @@ gst_vc1_parse_class_init (GstVC1ParseClass * klass)
   GST_DEBUG_CATEGORY_INIT (vc1_parse_debug, "vc1parse", 0, "vc1 parser");
 
   gobject_class->finalize = gst_vc1_parse_finalize;
+  gobject_class->set_property = gst_vc1_parse_set_property;
+  gobject_class->get_property = gst_vc1_parse_get_property;
+
+  gst_video_parse_index_install_properties (gobject_class,
+      PROP_KEYFRAME_INDEX);
 
   gst_element_class_add_pad_template (element_class,
       gst_static_pad_template_get (&srctemplate));
@@ -240,6 +258,7 @@ gst_vc1_parse_class_init (GstVC1ParseClass * klass)
   parse_class->set_sink_caps = GST_DEBUG_FUNCPTR (gst_vc1_parse_set_caps);
   parse_class->get_sink_caps = GST_DEBUG_FUNCPTR (gst_vc1_parse_get_sink_caps);
   parse_class->detect = GST_DEBUG_FUNCPTR (gst_vc1_parse_detect);
+  parse_class->src_query = GST_DEBUG_FUNCPTR (gst_vc1_parse_src_query);
 }
 
 static void
@@ -251,6 +270,7 @@ gst_vc1_parse_init (GstVC1Parse * vc1parse)
   gst_base_parse_set_has_timing_info (GST_BASE_PARSE (vc1parse), FALSE);
 
   gst_vc1_parse_reset (vc1parse);
+  gst_video_parse_index_init (&vc1parse->index);
   GST_PAD_SET_ACCEPT_INTERSECT (GST_BASE_PARSE_SINK_PAD (vc1parse));
   GST_PAD_SET_ACCEPT_TEMPLATE (GST_BASE_PARSE_SINK_PAD (vc1parse));
 }
@@ -258,11 +278,35 @@ gst_vc1_parse_init (GstVC1Parse * vc1parse)
 static void
 gst_vc1_parse_finalize (GObject * object)
 {
-  /*GstVC1Parse *vc1parse = GST_VC1_PARSE (object); */
+  GstVC1Parse *vc1parse = GST_VC1_PARSE (object);
+
+  gst_video_parse_index_clear (&vc1parse->index);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static void
+gst_vc1_parse_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVC1Parse *vc1parse = GST_VC1_PARSE (object);
+
+  if (!gst_video_parse_index_set_property (&vc1parse->index,
+          PROP_KEYFRAME_INDEX, prop_id, value))
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+}
+
+static void
+gst_vc1_parse_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstVC1Parse *vc1parse = GST_VC1_PARSE (object);
+
+  if (!gst_video_parse_index_get_property (&vc1parse->index,
+          PROP_KEYFRAME_INDEX, prop_id, value))
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+}
+
 static void
 gst_vc1_parse_reset (GstVC1Parse * vc1parse)
 {
@@ -291,6 +335,8 @@ gst_vc1_parse_reset (GstVC1Parse * vc1parse)
 
   vc1parse->seq_layer_sent = FALSE;
   vc1parse->frame_layer_first_frame_sent = FALSE;
+
+  vc1parse->bdu_scan_off = -1;
 }
 
 static gboolean
@@ -303,6 +349,8 @@ gst_vc1_parse_start (GstBaseParse * parse)
 
   vc1parse->detecting_stream_format = TRUE;
 
+  gst_video_parse_index_start (&vc1parse->index, parse);
+
   return TRUE;
 }
 
@@ -313,10 +361,22 @@ gst_vc1_parse_stop (GstBaseParse * parse)
 
   GST_DEBUG_OBJECT (parse, "stop");
   gst_vc1_parse_reset (vc1parse);
+  gst_video_parse_index_stop (&vc1parse->index, parse);
 
   return TRUE;
 }
 
+static gboolean
+gst_vc1_parse_src_query (GstBaseParse * parse, GstQuery * query)
+{
+  GstVC1Parse *vc1parse = GST_VC1_PARSE (parse);
+
+  if (gst_video_parse_index_src_query (&vc1parse->index, query))
+    return TRUE;
+
+  return GST_BASE_PARSE_CLASS (parent_class)->src_query (parse, query);
+}
+
 static gboolean
 gst_vc1_parse_is_format_allowed (GstVC1Parse * vc1parse)
 {
@@ -1157,6 +1217,55 @@ gst_vc1_parse_handle_bdus (GstVC1Parse * vc1parse, GstBuffer * buffer,
   return TRUE;
 }
 
+/* Same as gst_vc1_identify_next_bdu(), except that when the end of the
+ * BDU was not found yet, the next call for the same frame only looks for
+ * it in the data added since instead of going through the whole BDU
+ * again */
+static GstVC1ParserResult
+gst_vc1_parse_identify_bdu (GstVC1Parse * vc1parse, GstBaseParseFrame * frame,
+    const guint8 * data, gsize size, GstVC1BDU * bdu)
+{
+  GstVC1ParserResult pres;
+  GstByteReader br;
+  gint off;
+
+  if ((frame->flags & GST_BASE_PARSE_FRAME_FLAG_NEW_FRAME) ||
+      vc1parse->bdu_scan_off < 0 || vc1parse->bdu_scan_off > size) {
+    pres = gst_vc1_identify_next_bdu (data, size, bdu);
+    if (pres == GST_VC1_PARSER_NO_BDU_END && bdu->sc_offset <= 4) {
+      vc1parse->bdu = *bdu;
+      /* a start code can't begin before the last 3 bytes */
+      vc1parse->bdu_scan_off = MAX (size - 3, bdu->offset);
+    } else {
+      vc1parse->bdu_scan_off = -1;
+    }
+    return pres;
+  }
+
+  *bdu = vc1parse->bdu;
+  bdu->data = (guint8 *) data;
+
+  GST_LOG_OBJECT (vc1parse, "resuming BDU end scan at offset %d",
+      vc1parse->bdu_scan_off);
+
+  gst_byte_reader_init (&br, data, size);
+  off = gst_byte_reader_masked_scan_uint32 (&br, 0xffffff00, 0x00000100,
+      vc1parse->bdu_scan_off, size - vc1parse->bdu_scan_off);
+  if (off < 0) {
+    vc1parse->bdu_scan_off = MAX (size - 3, vc1parse->bdu_scan_off);
+    return GST_VC1_PARSER_NO_BDU_END;
+  }
+
+  /* 4 bytes start code, as in gst_vc1_identify_next_bdu() */
+  if (off > bdu->offset && data[off - 1] == 0x00)
+    off--;
+
+  bdu->size = off - bdu->offset;
+  vc1parse->bdu_scan_off = -1;
+
+  return GST_VC1_PARSER_OK;
+}
+
 static GstFlowReturn
 gst_vc1_parse_handle_frame (GstBaseParse * parse, GstBaseParseFrame * frame,
     gint * skipsize)
@@ -1224,7 +1333,7 @@ gst_vc1_parse_handle_frame (GstBaseParse * parse, GstBaseParseFrame * frame,
     /* XXX: when a buffer contains multiple BDUs, does the first one start with
      * a startcode?
      */
-    pres = gst_vc1_identify_next_bdu (data, size, &bdu);
+    pres = gst_vc1_parse_identify_bdu (vc1parse, frame, data, size, &bdu);
     switch (pres) {
       case GST_VC1_PARSER_OK:
         GST_DEBUG_OBJECT (vc1parse, "Have complete BDU");
@@ -1715,6 +1824,10 @@ gst_vc1_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
     vc1parse->sent_codec_tag = TRUE;
   }
 
+  /* offsets and keyframe flags are those of the input, whatever the
+   * conversion below */
+  gst_video_parse_index_add_frame (&vc1parse->index, parse, frame);
+
   /* Nothing to do here */
   if (vc1parse->input_stream_format == vc1parse->output_stream_format)
     return GST_FLOW_OK;
@@ -2047,10 +2160,23 @@ gst_vc1_parse_handle_seq_hdr (GstVC1Parse * vc1parse,
   GstMapInfo minfo;
 
   g_assert (gst_buffer_get_size (buf) >= offset + size);
+
+  gst_buffer_map (buf, &minfo, GST_MAP_READ);
+
+  /* usually repeated as is at each entry point, in which case everything
+   * derived from it is still valid */
+  if (vc1parse->seq_hdr_buffer &&
+      gst_buffer_get_size (vc1parse->seq_hdr_buffer) == size &&
+      gst_buffer_memcmp (vc1parse->seq_hdr_buffer, 0, minfo.data + offset,
+          size) == 0) {
+    GST_LOG_OBJECT (vc1parse, "sequence header unchanged");
+    gst_buffer_unmap (buf, &minfo);
+    return TRUE;
+  }
+
   gst_buffer_replace (&vc1parse->seq_hdr_buffer, NULL);
   memset (&vc1parse->seq_hdr, 0, sizeof (vc1parse->seq_hdr));
 
-  gst_buffer_map (buf, &minfo, GST_MAP_READ);
   pres =
       gst_vc1_parse_sequence_header (minfo.data + offset,
       size, &vc1parse->seq_hdr);
@@ -2240,8 +2366,24 @@ static gboolean
 gst_vc1_parse_handle_entrypoint (GstVC1Parse * vc1parse,
     GstBuffer * buf, guint offset, guint size)
 {
+  GstMapInfo minfo;
+  gboolean unchanged = FALSE;
+
   g_assert (gst_buffer_get_size (buf) >= offset + size);
 
+  if (vc1parse->entrypoint_buffer &&
+      gst_buffer_get_size (vc1parse->entrypoint_buffer) == size) {
+    gst_buffer_map (buf, &minfo, GST_MAP_READ);
+    unchanged = gst_buffer_memcmp (vc1parse->entrypoint_buffer, 0,
+        minfo.data + offset, size) == 0;
+    gst_buffer_unmap (buf, &minfo);
+  }
+
+  if (unchanged) {
+    GST_LOG_OBJECT (vc1parse, "entrypoint unchanged");
+    return TRUE;
+  }
+
   gst_buffer_replace (&vc1parse->entrypoint_buffer, NULL);
   vc1parse->entrypoint_buffer =
       gst_buffer_copy_region (buf, GST_BUFFER_COPY_ALL, offset, size);
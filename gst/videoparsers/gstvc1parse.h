@@ -25,6 +25,8 @@
 #include <gst/base/gstbaseparse.h>
 #include <gst/codecparsers/gstvc1parser.h>
 
+#include "gstvideoparseindex.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_VC1_PARSE \
@@ -115,6 +117,13 @@ struct _GstVC1Parse
   /* TRUE if we have already sent the frame-layer first frame,
    * use for stream-format conversion */
   gboolean frame_layer_first_frame_sent;
+
+  /* offset from which to resume looking for the end of the BDU being
+   * parsed, -1 if none */
+  gint bdu_scan_off;
+  GstVC1BDU bdu;
+
+  GstVideoParseIndex index;
 };
 
 struct _GstVC1ParseClass
@@ -0,0 +1,365 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Keyframe index shared by the video parsers.
+ *
+ * When enabled, every keyframe pushed by the parser is recorded with its
+ * position in the input stream and added to the GstBaseParse seek index,
+ * so that seeking in an elementary stream does not need to scan it.
+ *
+ * The index can be read at any time with a custom query, whose structure
+ * is named "keyframe-index", on the source pad. The "entries" (guint) and
+ * "index" (GstBuffer) fields are set in the answer. On EOS, the index is
+ * posted in an element message with the same structure and written to
+ * the sidecar file, before the EOS goes downstream.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "gstvideoparseindex.h"
+
+GST_DEBUG_CATEGORY_STATIC (videoparseindex_debug);
+#define GST_CAT_DEFAULT videoparseindex_debug
+
+typedef struct
+{
+  GstClockTime pts;
+  GstClockTime dts;
+  guint64 offset;
+  guint32 size;
+} GstVideoParseIndexEntry;
+
+static void
+gst_video_parse_index_write_header (guint8 * data)
+{
+  memcpy (data, "GVPI", 4);
+  GST_WRITE_UINT32_BE (data + 4, 1);
+}
+
+static void
+gst_video_parse_index_write_entry (guint8 * data,
+    const GstVideoParseIndexEntry * entry)
+{
+  GST_WRITE_UINT64_BE (data, entry->pts);
+  GST_WRITE_UINT64_BE (data + 8, entry->dts);
+  GST_WRITE_UINT64_BE (data + 16, entry->offset);
+  GST_WRITE_UINT32_BE (data + 24, entry->size);
+}
+
+static GstBuffer *
+gst_video_parse_index_to_buffer_unlocked (GstVideoParseIndex * index)
+{
+  GstBuffer *buffer;
+  GstMapInfo map;
+  guint i;
+
+  buffer = gst_buffer_new_allocate (NULL, GST_VIDEO_PARSE_INDEX_HEADER_SIZE +
+      index->entries->len * GST_VIDEO_PARSE_INDEX_ENTRY_SIZE, NULL);
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+
+  gst_video_parse_index_write_header (map.data);
+  for (i = 0; i < index->entries->len; i++)
+    gst_video_parse_index_write_entry (map.data +
+        GST_VIDEO_PARSE_INDEX_HEADER_SIZE +
+        i * GST_VIDEO_PARSE_INDEX_ENTRY_SIZE,
+        &g_array_index (index->entries, GstVideoParseIndexEntry, i));
+
+  gst_buffer_unmap (buffer, &map);
+
+  return buffer;
+}
+
+void
+gst_video_parse_index_install_properties (GObjectClass * gobject_class,
+    guint first_prop_id)
+{
+  g_object_class_install_property (gobject_class, first_prop_id,
+      g_param_spec_boolean ("keyframe-index", "Keyframe index",
+          "Record the position of every keyframe, use it for seeking and "
+          "post it in a keyframe-index element message on EOS",
+          FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, first_prop_id + 1,
+      g_param_spec_string ("keyframe-index-location",
+          "Keyframe index location",
+          "File the keyframe index is written to on EOS, if keyframe-index "
+          "is enabled (NULL = none)", NULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+/* Returns FALSE if @prop_id is not one of the index properties */
+gboolean
+gst_video_parse_index_set_property (GstVideoParseIndex * index,
+    guint first_prop_id, guint prop_id, const GValue * value)
+{
+  if (prop_id == first_prop_id) {
+    index->enabled = g_value_get_boolean (value);
+  } else if (prop_id == first_prop_id + 1) {
+    g_free (index->location);
+    index->location = g_value_dup_string (value);
+  } else {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+gboolean
+gst_video_parse_index_get_property (GstVideoParseIndex * index,
+    guint first_prop_id, guint prop_id, GValue * value)
+{
+  if (prop_id == first_prop_id)
+    g_value_set_boolean (value, index->enabled);
+  else if (prop_id == first_prop_id + 1)
+    g_value_set_string (value, index->location);
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
+void
+gst_video_parse_index_init (GstVideoParseIndex * index)
+{
+  GST_DEBUG_CATEGORY_INIT (videoparseindex_debug, "videoparseindex", 0,
+      "Video parsers keyframe index");
+
+  index->enabled = FALSE;
+  index->location = NULL;
+  g_mutex_init (&index->lock);
+  index->entries =
+      g_array_new (FALSE, FALSE, sizeof (GstVideoParseIndexEntry));
+  index->eos_probe = 0;
+}
+
+void
+gst_video_parse_index_clear (GstVideoParseIndex * index)
+{
+  g_free (index->location);
+  index->location = NULL;
+  g_array_free (index->entries, TRUE);
+  index->entries = NULL;
+  g_mutex_clear (&index->lock);
+}
+
+/* Sets the entries and index fields of @s */
+static void
+gst_video_parse_index_fill_structure (GstVideoParseIndex * index,
+    GstStructure * s)
+{
+  GstBuffer *buffer;
+  guint n_entries;
+
+  g_mutex_lock (&index->lock);
+  buffer = gst_video_parse_index_to_buffer_unlocked (index);
+  n_entries = index->entries->len;
+  g_mutex_unlock (&index->lock);
+
+  gst_structure_set (s, "entries", G_TYPE_UINT, n_entries,
+      "index", GST_TYPE_BUFFER, buffer, NULL);
+  gst_buffer_unref (buffer);
+}
+
+/* Failing to write the sidecar file is not fatal, parsing goes on */
+static void
+gst_video_parse_index_write_file (GstVideoParseIndex * index,
+    GstBaseParse * parse)
+{
+  GstBuffer *buffer;
+  GstMapInfo map;
+  FILE *file;
+  gboolean written;
+  gint err = 0;
+
+  file = g_fopen (index->location, "wb");
+  if (!file) {
+    GST_ELEMENT_WARNING (parse, RESOURCE, OPEN_WRITE, (NULL),
+        ("Could not open keyframe index file \"%s\": %s", index->location,
+            g_strerror (errno)));
+    return;
+  }
+
+  GST_DEBUG_OBJECT (parse, "writing keyframe index to %s", index->location);
+
+  buffer = gst_video_parse_index_to_buffer (index);
+  gst_buffer_map (buffer, &map, GST_MAP_READ);
+  written = fwrite (map.data, map.size, 1, file) == 1;
+  if (!written)
+    err = errno;
+  gst_buffer_unmap (buffer, &map);
+  gst_buffer_unref (buffer);
+
+  /* the file is closed in any case, and buffered data can still fail to be
+   * written there */
+  if (fclose (file) != 0 && written) {
+    written = FALSE;
+    err = errno;
+  }
+
+  if (!written) {
+    GST_ELEMENT_WARNING (parse, RESOURCE, WRITE, (NULL),
+        ("Could not write keyframe index file \"%s\": %s", index->location,
+            g_strerror (err)));
+  }
+}
+
+/* The EOS is seen on the source pad once the base class drained the
+ * pending frames, and before it reaches the sink, so that the application
+ * gets the index before the EOS message */
+static GstPadProbeReturn
+gst_video_parse_index_eos_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  GstVideoParseIndex *index = user_data;
+  GstBaseParse *parse;
+  GstStructure *s;
+
+  if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) != GST_EVENT_EOS ||
+      !index->enabled)
+    return GST_PAD_PROBE_OK;
+
+  parse = GST_BASE_PARSE (GST_PAD_PARENT (pad));
+
+  if (index->location)
+    gst_video_parse_index_write_file (index, parse);
+
+  s = gst_structure_new_empty (GST_VIDEO_PARSE_INDEX_QUERY);
+  gst_video_parse_index_fill_structure (index, s);
+  gst_element_post_message (GST_ELEMENT_CAST (parse),
+      gst_message_new_element (GST_OBJECT_CAST (parse), s));
+
+  return GST_PAD_PROBE_OK;
+}
+
+void
+gst_video_parse_index_start (GstVideoParseIndex * index, GstBaseParse * parse)
+{
+  g_mutex_lock (&index->lock);
+  g_array_set_size (index->entries, 0);
+  g_mutex_unlock (&index->lock);
+
+  if (!index->eos_probe)
+    index->eos_probe = gst_pad_add_probe (GST_BASE_PARSE_SRC_PAD (parse),
+        GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, gst_video_parse_index_eos_probe,
+        index, NULL);
+}
+
+void
+gst_video_parse_index_stop (GstVideoParseIndex * index, GstBaseParse * parse)
+{
+  if (index->eos_probe) {
+    gst_pad_remove_probe (GST_BASE_PARSE_SRC_PAD (parse), index->eos_probe);
+    index->eos_probe = 0;
+  }
+}
+
+/* To be called from pre_push_frame, once the timestamps and flags of the
+ * frame are final */
+void
+gst_video_parse_index_add_frame (GstVideoParseIndex * index,
+    GstBaseParse * parse, GstBaseParseFrame * frame)
+{
+  GstBuffer *buffer = frame->out_buffer ? frame->out_buffer : frame->buffer;
+  GstVideoParseIndexEntry entry, *entries;
+  guint lo, hi;
+
+  if (!index->enabled)
+    return;
+
+  if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT) ||
+      (frame->flags & GST_BASE_PARSE_FRAME_FLAG_NO_FRAME))
+    return;
+
+  entry.pts = GST_BUFFER_PTS (buffer);
+  entry.dts = GST_BUFFER_DTS (buffer);
+  entry.offset = frame->offset;
+  /* what needs to be read from the input, whatever the output format */
+  entry.size = gst_buffer_get_size (frame->buffer);
+
+  /* frames are seen again after seeking, keep the entries sorted and
+   * unique */
+  g_mutex_lock (&index->lock);
+  entries = (GstVideoParseIndexEntry *) index->entries->data;
+  lo = 0;
+  hi = index->entries->len;
+  while (lo < hi) {
+    guint mid = (lo + hi) / 2;
+
+    if (entries[mid].offset < entry.offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo < index->entries->len && entries[lo].offset == entry.offset) {
+    g_mutex_unlock (&index->lock);
+    return;
+  }
+
+  GST_LOG_OBJECT (parse, "keyframe at offset %" G_GUINT64_FORMAT ", pts %"
+      GST_TIME_FORMAT ", dts %" GST_TIME_FORMAT, entry.offset,
+      GST_TIME_ARGS (entry.pts), GST_TIME_ARGS (entry.dts));
+
+  g_array_insert_val (index->entries, lo, entry);
+  g_mutex_unlock (&index->lock);
+
+  if (GST_CLOCK_TIME_IS_VALID (entry.pts))
+    gst_base_parse_add_index_entry (parse, entry.offset, entry.pts, TRUE,
+        TRUE);
+  else if (GST_CLOCK_TIME_IS_VALID (entry.dts))
+    gst_base_parse_add_index_entry (parse, entry.offset, entry.dts, TRUE,
+        TRUE);
+}
+
+/* Answers the custom keyframe-index query, returns FALSE for the other
+ * queries */
+gboolean
+gst_video_parse_index_src_query (GstVideoParseIndex * index, GstQuery * query)
+{
+  GstStructure *s;
+
+  if (GST_QUERY_TYPE (query) != GST_QUERY_CUSTOM || !index->enabled)
+    return FALSE;
+
+  s = gst_query_writable_structure (query);
+  if (!s || !gst_structure_has_name (s, GST_VIDEO_PARSE_INDEX_QUERY))
+    return FALSE;
+
+  gst_video_parse_index_fill_structure (index, s);
+
+  return TRUE;
+}
+
+GstBuffer *
+gst_video_parse_index_to_buffer (GstVideoParseIndex * index)
+{
+  GstBuffer *buffer;
+
+  g_mutex_lock (&index->lock);
+  buffer = gst_video_parse_index_to_buffer_unlocked (index);
+  g_mutex_unlock (&index->lock);
+
+  return buffer;
+}
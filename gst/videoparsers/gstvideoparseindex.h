@@ -0,0 +1,82 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_VIDEO_PARSE_INDEX_H__
+#define __GST_VIDEO_PARSE_INDEX_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstbaseparse.h>
+
+G_BEGIN_DECLS
+
+/* The index is exported as a buffer, and written to the sidecar file, as
+ * a "GVPI" tag and a 32 bits version followed by one entry per keyframe:
+ * PTS, DTS, byte offset in the input stream (64 bits each) and size of
+ * the frame in the input stream (32 bits), all big endian */
+#define GST_VIDEO_PARSE_INDEX_HEADER_SIZE 8
+#define GST_VIDEO_PARSE_INDEX_ENTRY_SIZE 28
+
+/* name of the structure of the custom query answered with the index */
+#define GST_VIDEO_PARSE_INDEX_QUERY "keyframe-index"
+
+typedef struct _GstVideoParseIndex GstVideoParseIndex;
+
+struct _GstVideoParseIndex
+{
+  /* props */
+  gboolean enabled;
+  gchar *location;
+
+  /* GstVideoParseIndexEntry sorted by offset, protected by lock as the
+   * query can come from any thread */
+  GMutex lock;
+  GArray *entries;
+  gulong eos_probe;
+};
+
+/* The properties use two consecutive ids of the parser, from first_prop_id */
+void gst_video_parse_index_install_properties (GObjectClass * gobject_class,
+                                               guint first_prop_id);
+gboolean gst_video_parse_index_set_property (GstVideoParseIndex * index,
+                                             guint first_prop_id,
+                                             guint prop_id,
+                                             const GValue * value);
+gboolean gst_video_parse_index_get_property (GstVideoParseIndex * index,
+                                             guint first_prop_id,
+                                             guint prop_id,
+                                             GValue * value);
+
+void gst_video_parse_index_init (GstVideoParseIndex * index);
+void gst_video_parse_index_clear (GstVideoParseIndex * index);
+
+void gst_video_parse_index_start (GstVideoParseIndex * index,
+                                  GstBaseParse * parse);
+void gst_video_parse_index_stop (GstVideoParseIndex * index,
+                                 GstBaseParse * parse);
+
+void gst_video_parse_index_add_frame (GstVideoParseIndex * index,
+                                      GstBaseParse * parse,
+                                      GstBaseParseFrame * frame);
+gboolean gst_video_parse_index_src_query (GstVideoParseIndex * index,
+                                          GstQuery * query);
+
+GstBuffer * gst_video_parse_index_to_buffer (GstVideoParseIndex * index);
+
+G_END_DECLS
+
+#endif /* __GST_VIDEO_PARSE_INDEX_H__ */
@@ -0,0 +1,106 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/codecparsers/gsth264nalmeta.h>
+#include <gst/codecparsers/gsth265nalmeta.h>
+
+#include "gstvideoparsenal.h"
+
+/* the unit arrays are handled the same for both codecs */
+G_STATIC_ASSERT (sizeof (GstH264NalMetaUnit) == sizeof (GstH265NalMetaUnit));
+G_STATIC_ASSERT (G_STRUCT_OFFSET (GstH264NalMetaUnit, offset) ==
+    G_STRUCT_OFFSET (GstH265NalMetaUnit, offset));
+G_STATIC_ASSERT (G_STRUCT_OFFSET (GstH264NalMetaUnit, size) ==
+    G_STRUCT_OFFSET (GstH265NalMetaUnit, size));
+G_STATIC_ASSERT (G_STRUCT_OFFSET (GstH264NalMetaUnit, type) ==
+    G_STRUCT_OFFSET (GstH265NalMetaUnit, type));
+G_STATIC_ASSERT (G_STRUCT_OFFSET (GstH264NalMetaUnit, slice_type) ==
+    G_STRUCT_OFFSET (GstH265NalMetaUnit, slice_type));
+
+/* Writes the @nal_length_size bytes length prefix of a @size bytes NAL to
+ * @prefix if @packetized, a 4 bytes start code otherwise. Returns the number
+ * of bytes written */
+guint
+gst_video_parse_nal_prefix (gboolean packetized, guint nal_length_size,
+    guint size, guint8 * prefix)
+{
+  guint i;
+
+  if (!packetized) {
+    /* HACK: nl should always be 4 here, otherwise this won't work.
+     * There are legit cases where nl in a packetized stream is 2, but
+     * byte-stream SC is still always 4 bytes. */
+    GST_WRITE_UINT32_BE (prefix, 1);
+    return 4;
+  }
+
+  for (i = 0; i < nal_length_size; i++)
+    prefix[i] = size >> (8 * (nal_length_size - 1 - i));
+
+  return nal_length_size;
+}
+
+/* Writes @nal with its prefix to @dest, which must have room for the
+ * prefix and @nal. Returns the number of bytes written */
+gsize
+gst_video_parse_write_nal (gboolean packetized, guint nal_length_size,
+    GstBuffer * nal, guint8 * dest)
+{
+  gsize size = gst_buffer_get_size (nal);
+  guint nl;
+
+  nl = gst_video_parse_nal_prefix (packetized, nal_length_size, size, dest);
+  gst_buffer_extract (nal, 0, dest + nl, size);
+
+  return nl + size;
+}
+
+/* Shifts the units at or after @pos by @size bytes to make room for
+ * inserted ones, returns the index of the first shifted unit */
+guint
+gst_video_parse_shift_nal_units (GArray * units, guint pos, gsize size)
+{
+  guint i, idx;
+
+  for (idx = 0; idx < units->len; idx++) {
+    if (g_array_index (units, GstH264NalMetaUnit, idx).offset >= pos)
+      break;
+  }
+  for (i = idx; i < units->len; i++)
+    g_array_index (units, GstH264NalMetaUnit, i).offset += size;
+
+  return idx;
+}
+
+/* Records an inserted NAL unit, @offset is the one of its header */
+void
+gst_video_parse_insert_nal_unit (GArray * units, guint idx, guint offset,
+    guint size, guint8 type)
+{
+  GstH264NalMetaUnit unit;
+
+  unit.offset = offset;
+  unit.size = size;
+  unit.type = type;
+  unit.slice_type = -1;
+  g_array_insert_val (units, idx, unit);
+}
@@ -0,0 +1,50 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_VIDEO_PARSE_NAL_H__
+#define __GST_VIDEO_PARSE_NAL_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Writing of NAL units and of their NAL meta units, shared by h264parse
+ * and h265parse. The GArray of units holds GstH264NalMetaUnit or
+ * GstH265NalMetaUnit, which have the same layout */
+
+guint gst_video_parse_nal_prefix (gboolean packetized,
+                                  guint nal_length_size,
+                                  guint size,
+                                  guint8 * prefix);
+gsize gst_video_parse_write_nal (gboolean packetized,
+                                 guint nal_length_size,
+                                 GstBuffer * nal,
+                                 guint8 * dest);
+
+guint gst_video_parse_shift_nal_units (GArray * units,
+                                       guint pos,
+                                       gsize size);
+void gst_video_parse_insert_nal_unit (GArray * units,
+                                      guint idx,
+                                      guint offset,
+                                      guint size,
+                                      guint8 type);
+
+G_END_DECLS
+
+#endif /* __GST_VIDEO_PARSE_NAL_H__ */
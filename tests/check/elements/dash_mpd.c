@@ -4154,6 +4154,109 @@ GST_START_TEST (dash_mpdparser_segment_template)
 
 GST_END_TEST;
 
+/*
+ * Test availability times of live segments from a segment template
+ *
+ */
+GST_START_TEST (dash_mpdparser_segment_template_availability)
+{
+  GList *adaptationSets;
+  GstAdaptationSetNode *adapt_set;
+  GstActiveStream *activeStream;
+  GstDateTime *segmentStartTime;
+  GstDateTime *segmentEndTime;
+  GstFlowReturn flow;
+  const gchar *xml =
+      "<?xml version=\"1.0\"?>"
+      "<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\""
+      "     type=\"dynamic\""
+      "     profiles=\"urn:mpeg:dash:profile:isoff-live:2011\""
+      "     availabilityStartTime=\"2015-03-24T0:0:0\""
+      "     minimumUpdatePeriod=\"PT2S\">"
+      "  <Period start=\"P0Y0M0DT0H0M10S\">"
+      "    <AdaptationSet mimeType=\"video/mp4\">"
+      "      <Representation id=\"repId\" bandwidth=\"250000\">"
+      "        <SegmentTemplate timescale=\"1000\" duration=\"2000\""
+      "                         media=\"TestMedia$Number$\">"
+      "        </SegmentTemplate>"
+      "      </Representation></AdaptationSet></Period></MPD>";
+
+  gboolean ret;
+  GstMpdClient *mpdclient = gst_mpd_client_new ();
+
+  ret = gst_mpd_parse (mpdclient, xml, (gint) strlen (xml));
+  assert_equals_int (ret, TRUE);
+
+  /* process the xml data */
+  ret =
+      gst_mpd_client_setup_media_presentation (mpdclient, GST_CLOCK_TIME_NONE,
+      -1, NULL);
+  assert_equals_int (ret, TRUE);
+
+  /* get the list of adaptation sets of the first period */
+  adaptationSets = gst_mpd_client_get_adaptation_sets (mpdclient);
+  fail_if (adaptationSets == NULL);
+
+  /* setup streaming from the first adaptation set */
+  adapt_set = (GstAdaptationSetNode *) g_list_nth_data (adaptationSets, 0);
+  fail_if (adapt_set == NULL);
+  ret = gst_mpd_client_setup_streaming (mpdclient, adapt_set);
+  assert_equals_int (ret, TRUE);
+
+  activeStream = gst_mpdparser_get_active_stream_by_index (mpdclient, 0);
+  fail_if (activeStream == NULL);
+
+  /* segments last 2 seconds and the period starts 10 seconds after the
+   * availability start time. The first segment starts being available
+   * when the period starts, and is complete 2 seconds later
+   */
+  segmentStartTime =
+      gst_mpd_client_get_next_segment_availability_start_time (mpdclient,
+      activeStream);
+  fail_if (segmentStartTime == NULL);
+  assert_equals_int (gst_date_time_get_year (segmentStartTime), 2015);
+  assert_equals_int (gst_date_time_get_month (segmentStartTime), 3);
+  assert_equals_int (gst_date_time_get_day (segmentStartTime), 24);
+  assert_equals_int (gst_date_time_get_hour (segmentStartTime), 0);
+  assert_equals_int (gst_date_time_get_minute (segmentStartTime), 0);
+  assert_equals_int (gst_date_time_get_second (segmentStartTime), 10);
+  gst_date_time_unref (segmentStartTime);
+
+  segmentEndTime =
+      gst_mpd_client_get_next_segment_availability_end_time (mpdclient,
+      activeStream);
+  fail_if (segmentEndTime == NULL);
+  assert_equals_int (gst_date_time_get_minute (segmentEndTime), 0);
+  assert_equals_int (gst_date_time_get_second (segmentEndTime), 12);
+  gst_date_time_unref (segmentEndTime);
+
+  /* segment_index 2: its production starts when segment 1 is complete */
+  flow = gst_mpd_client_advance_segment (mpdclient, activeStream, TRUE);
+  assert_equals_int (flow, GST_FLOW_OK);
+  flow = gst_mpd_client_advance_segment (mpdclient, activeStream, TRUE);
+  assert_equals_int (flow, GST_FLOW_OK);
+
+  segmentStartTime =
+      gst_mpd_client_get_next_segment_availability_start_time (mpdclient,
+      activeStream);
+  fail_if (segmentStartTime == NULL);
+  assert_equals_int (gst_date_time_get_hour (segmentStartTime), 0);
+  assert_equals_int (gst_date_time_get_minute (segmentStartTime), 0);
+  assert_equals_int (gst_date_time_get_second (segmentStartTime), 14);
+  gst_date_time_unref (segmentStartTime);
+
+  segmentEndTime =
+      gst_mpd_client_get_next_segment_availability_end_time (mpdclient,
+      activeStream);
+  fail_if (segmentEndTime == NULL);
+  assert_equals_int (gst_date_time_get_second (segmentEndTime), 16);
+  gst_date_time_unref (segmentEndTime);
+
+  gst_mpd_client_free (mpdclient);
+}
+
+GST_END_TEST;
+
 /*
  * Test segment timeline
  *
@@ -4584,6 +4687,7 @@ dash_suite (void)
   tcase_add_test (tc_complexMPD, dash_mpdparser_inherited_segmentURL);
   tcase_add_test (tc_complexMPD, dash_mpdparser_segment_list);
   tcase_add_test (tc_complexMPD, dash_mpdparser_segment_template);
+  tcase_add_test (tc_complexMPD, dash_mpdparser_segment_template_availability);
   tcase_add_test (tc_complexMPD, dash_mpdparser_segment_timeline);
 
   /* tests checking the parsing of missing/incomplete attributes of xml */
@@ -0,0 +1,193 @@
+/*
+ * GStreamer
+ *
+ * unit test for dtlsenc and dtlsdec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#define N_PEERS 8
+
+/* Both ends of a connection, connected back to back: what a client dtlsenc
+ * sends goes to the server dtlsdec and the other way around */
+typedef struct
+{
+  GstElement *client_enc, *client_dec, *server_enc, *server_dec;
+  GstHarness *client_enc_h, *client_dec_h, *server_enc_h, *server_dec_h;
+  gint keys_received;
+} Peer;
+
+static void
+on_key_received (GstElement * dtlsdec, Peer * peer)
+{
+  g_atomic_int_inc (&peer->keys_received);
+}
+
+static void
+setup_end (Peer * peer, const gchar * role, guint id, guint handshake_threads,
+    gboolean is_client, GstElement ** enc, GstHarness ** enc_h,
+    GstElement ** dec, GstHarness ** dec_h)
+{
+  /* connection ids are process wide, keep them unique across runs */
+  static gint n_connections = 0;
+  gchar *connection_id;
+
+  connection_id = g_strdup_printf ("%s-%u-%d", role, id,
+      g_atomic_int_add (&n_connections, 1));
+
+  *dec = gst_element_factory_make ("dtlsdec", NULL);
+  g_object_set (*dec, "connection-id", connection_id, "handshake-threads",
+      handshake_threads, NULL);
+  g_signal_connect (*dec, "on-key-received", G_CALLBACK (on_key_received),
+      peer);
+  *dec_h = gst_harness_new_with_element (*dec, "sink", NULL);
+  gst_harness_set_src_caps_str (*dec_h, "application/x-dtls");
+
+  /* the encoder finds the connection of the decoder by id */
+  *enc = gst_element_factory_make ("dtlsenc", NULL);
+  g_object_set (*enc, "connection-id", connection_id, "is-client", is_client,
+      NULL);
+  *enc_h = gst_harness_new_with_element (*enc, NULL, "src");
+
+  g_free (connection_id);
+}
+
+static void
+setup_peer (Peer * peer, guint id, guint handshake_threads)
+{
+  peer->keys_received = 0;
+  setup_end (peer, "server", id, handshake_threads, FALSE, &peer->server_enc,
+      &peer->server_enc_h, &peer->server_dec, &peer->server_dec_h);
+  setup_end (peer, "client", id, handshake_threads, TRUE, &peer->client_enc,
+      &peer->client_enc_h, &peer->client_dec, &peer->client_dec_h);
+}
+
+static void
+teardown_peer (Peer * peer)
+{
+  gst_harness_teardown (peer->client_enc_h);
+  gst_harness_teardown (peer->server_enc_h);
+  gst_harness_teardown (peer->client_dec_h);
+  gst_harness_teardown (peer->server_dec_h);
+  gst_object_unref (peer->client_enc);
+  gst_object_unref (peer->server_enc);
+  gst_object_unref (peer->client_dec);
+  gst_object_unref (peer->server_dec);
+}
+
+/* Moves what was sent so far to the other end, returns the number of
+ * buffers moved */
+static guint
+forward (GstHarness * from, GstHarness * to)
+{
+  GstBuffer *buf;
+  guint n = 0;
+
+  while ((buf = gst_harness_try_pull (from))) {
+    fail_unless_equals_int (gst_harness_push (to, buf), GST_FLOW_OK);
+    n++;
+  }
+
+  return n;
+}
+
+/* Runs the handshakes of @n_peers connections at once from one thread, like
+ * a server receiving from all its peers on one socket, and checks that
+ * every connection ends up with its keys */
+static void
+run_handshakes (guint handshake_threads, guint n_peers)
+{
+  Peer *peers;
+  gint64 start;
+  guint i, n_done = 0;
+
+  peers = g_new0 (Peer, n_peers);
+  for (i = 0; i < n_peers; i++)
+    setup_peer (&peers[i], i, handshake_threads);
+
+  start = g_get_monotonic_time ();
+  while (n_done < n_peers) {
+    guint n_moved = 0;
+
+    n_done = 0;
+    for (i = 0; i < n_peers; i++) {
+      n_moved += forward (peers[i].client_enc_h, peers[i].server_dec_h);
+      n_moved += forward (peers[i].server_enc_h, peers[i].client_dec_h);
+
+      /* both decoders got their key */
+      if (g_atomic_int_get (&peers[i].keys_received) == 2)
+        n_done++;
+    }
+
+    /* the handshake threads or the encoder tasks are busy */
+    if (!n_moved)
+      g_usleep (100);
+
+    fail_unless (g_get_monotonic_time () - start < 60 * G_USEC_PER_SEC);
+  }
+
+  for (i = 0; i < n_peers; i++) {
+    GstBuffer *client_key, *server_key;
+    GstMapInfo map;
+
+    /* each end encodes with its own key */
+    g_object_get (peers[i].client_enc, "encoder-key", &client_key, NULL);
+    g_object_get (peers[i].server_enc, "encoder-key", &server_key, NULL);
+    fail_unless (client_key != NULL);
+    fail_unless (server_key != NULL);
+    fail_unless (gst_buffer_map (server_key, &map, GST_MAP_READ));
+    fail_unless_equals_int (gst_buffer_get_size (client_key), map.size);
+    fail_if (gst_buffer_memcmp (client_key, 0, map.data, map.size) == 0);
+    gst_buffer_unmap (server_key, &map);
+    gst_buffer_unref (client_key);
+    gst_buffer_unref (server_key);
+
+    teardown_peer (&peers[i]);
+  }
+  g_free (peers);
+}
+
+GST_START_TEST (test_handshake)
+{
+  run_handshakes (0, 1);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_handshake_threads)
+{
+  run_handshakes (4, N_PEERS);
+}
+
+GST_END_TEST;
+
+static Suite *
+dtls_suite (void)
+{
+  Suite *s = suite_create ("dtls");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_handshake);
+  tcase_add_test (tc_chain, test_handshake_threads);
+
+  return s;
+}
+
+GST_CHECK_MAIN (dtls);
@@ -0,0 +1,520 @@
+/*
+ * GStreamer
+ *
+ * unit test for h265parse
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/codecparsers/gsth265parser.h>
+#include <gst/codecparsers/gsth265nalmeta.h>
+
+/* Main profile, level 6.1, 7680x4320, 64x64 CTBs */
+static const guint8 h265_vps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x40, 0x01, 0x0c, 0x01, 0xff, 0xff, 0x01, 0x60,
+  0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00,
+  0xb7, 0xf0, 0x24
+};
+
+static const guint8 h265_sps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03,
+  0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0xb7, 0xa0, 0x00,
+  0xf0, 0x08, 0x00, 0x43, 0x85, 0x97, 0xe4, 0x93, 0x08, 0x20
+};
+
+static const guint8 h265_pps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x44, 0x01, 0xc0, 0x71, 0x81, 0x12
+};
+
+#define PIC_SIZE_IN_CTBS (120 * 68)
+#define SLICES_PER_PICTURE 64
+#define SLICE_DATA_SIZE 256
+
+#define N_PICTURES 10
+
+/* Byte-stream with @n_pictures IDR pictures made of SLICES_PER_PICTURE I
+ * slices each. Only the start of the slice headers is valid, the slice
+ * data is filler */
+static GstBuffer *
+make_many_slices_stream (guint n_pictures)
+{
+  GByteArray *stream = g_byte_array_new ();
+  guint8 slice_data[SLICE_DATA_SIZE];
+  guint i, j;
+  gsize size;
+
+  memset (slice_data, 0x55, sizeof (slice_data));
+  slice_data[SLICE_DATA_SIZE - 1] = 0x80;
+
+  g_byte_array_append (stream, h265_vps, sizeof (h265_vps));
+  g_byte_array_append (stream, h265_sps, sizeof (h265_sps));
+  g_byte_array_append (stream, h265_pps, sizeof (h265_pps));
+
+  for (i = 0; i < n_pictures; i++) {
+    for (j = 0; j < SLICES_PER_PICTURE; j++) {
+      guint8 slice_hdr[9] = { 0x00, 0x00, 0x00, 0x01,
+        GST_H265_NAL_SLICE_IDR_W_RADL << 1, 0x01
+      };
+
+      if (j == 0) {
+        /* first_slice_segment_in_pic_flag 1, no_output_of_prior_pics_flag 0,
+         * slice_pic_parameter_set_id 0, slice_type I */
+        slice_hdr[6] = 0xae;
+        slice_hdr[7] = 0xaa;
+        slice_hdr[8] = 0xaa;
+      } else {
+        /* same with first_slice_segment_in_pic_flag 0 and a 13 bits
+         * slice_segment_address */
+        guint32 bits = (1 << 16) | ((j * PIC_SIZE_IN_CTBS /
+                SLICES_PER_PICTURE) << 3) | 3;
+
+        bits = (bits << 5) | 0x15;
+        slice_hdr[6] = bits >> 16;
+        slice_hdr[7] = bits >> 8;
+        slice_hdr[8] = bits;
+      }
+
+      g_byte_array_append (stream, slice_hdr, sizeof (slice_hdr));
+      g_byte_array_append (stream, slice_data, sizeof (slice_data));
+    }
+  }
+
+  size = stream->len;
+  return gst_buffer_new_wrapped (g_byte_array_free (stream, FALSE), size);
+}
+
+/* Returns the slice types of all output NAL units */
+static GArray *
+run_h265parse (guint slice_threads, guint n_pictures)
+{
+  GstElement *h265parse;
+  GstHarness *h;
+  GstBuffer *buf;
+  GArray *slice_types;
+  guint n_frames = 0;
+
+  h265parse = gst_element_factory_make ("h265parse", NULL);
+  g_object_set (h265parse, "slice-threads", slice_threads, "nal-meta", TRUE,
+      NULL);
+
+  h = gst_harness_new_with_element (h265parse, "sink", "src");
+  gst_harness_set_src_caps_str (h,
+      "video/x-h265, stream-format=(string)byte-stream");
+  gst_harness_set_sink_caps_str (h, "video/x-h265, "
+      "stream-format=(string)byte-stream, alignment=(string)au");
+
+  buf = make_many_slices_stream (n_pictures);
+
+  fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  slice_types = g_array_new (FALSE, FALSE, sizeof (gint8));
+  while ((buf = gst_harness_try_pull (h))) {
+    GstH265NalMeta *meta = gst_buffer_get_h265_nal_meta (buf);
+    guint i;
+
+    fail_unless (meta != NULL);
+    fail_if (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT));
+    for (i = 0; i < meta->n_units; i++)
+      g_array_append_val (slice_types, meta->units[i].slice_type);
+
+    n_frames++;
+    gst_buffer_unref (buf);
+  }
+  fail_unless_equals_int (n_frames, n_pictures);
+
+  gst_harness_teardown (h);
+  gst_object_unref (h265parse);
+
+  return slice_types;
+}
+
+GST_START_TEST (test_parse_slice_threads)
+{
+  GArray *sequential, *threaded;
+  guint i, n_slices = 0;
+
+  sequential = run_h265parse (0, N_PICTURES);
+  threaded = run_h265parse (3, N_PICTURES);
+
+  /* Same slice types reported for the same NAL units, in the same order */
+  fail_unless_equals_int (threaded->len, sequential->len);
+  for (i = 0; i < sequential->len; i++) {
+    gint8 type = g_array_index (sequential, gint8, i);
+
+    fail_unless_equals_int (g_array_index (threaded, gint8, i), type);
+    if (type == GST_H265_I_SLICE)
+      n_slices++;
+  }
+  fail_unless_equals_int (n_slices, N_PICTURES * SLICES_PER_PICTURE);
+
+  g_array_free (sequential, TRUE);
+  g_array_free (threaded, TRUE);
+}
+
+GST_END_TEST;
+
+/* slice-threads can be changed while parsing, the pool follows */
+GST_START_TEST (test_parse_slice_threads_change)
+{
+  const guint threads[] = { 3, 0, 1, 4 };
+  GstElement *h265parse;
+  GstHarness *h;
+  GstBuffer *stream, *buf;
+  GArray *sequential;
+  gsize picture_size, offset;
+  guint i, n_units = 0;
+
+  sequential = run_h265parse (0, N_PICTURES);
+
+  h265parse = gst_element_factory_make ("h265parse", NULL);
+  g_object_set (h265parse, "nal-meta", TRUE, NULL);
+  h = gst_harness_new_with_element (h265parse, "sink", "src");
+  gst_harness_set_src_caps_str (h,
+      "video/x-h265, stream-format=(string)byte-stream");
+  gst_harness_set_sink_caps_str (h, "video/x-h265, "
+      "stream-format=(string)byte-stream, alignment=(string)au");
+
+  /* push the stream one picture at a time */
+  stream = make_many_slices_stream (N_PICTURES);
+  picture_size = SLICES_PER_PICTURE * (9 + SLICE_DATA_SIZE);
+  offset = sizeof (h265_vps) + sizeof (h265_sps) + sizeof (h265_pps);
+  for (i = 0; i < N_PICTURES; i++) {
+    guint slice_threads = threads[i % G_N_ELEMENTS (threads)];
+    gsize start = i == 0 ? 0 : offset;
+
+    g_object_set (h265parse, "slice-threads", slice_threads, NULL);
+    offset += picture_size;
+    buf = gst_buffer_copy_region (stream, GST_BUFFER_COPY_ALL, start,
+        offset - start);
+    fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+  }
+  gst_buffer_unref (stream);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  /* same slice types as when parsing sequentially */
+  while ((buf = gst_harness_try_pull (h))) {
+    GstH265NalMeta *meta = gst_buffer_get_h265_nal_meta (buf);
+
+    fail_unless (meta != NULL);
+    fail_if (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT));
+    for (i = 0; i < meta->n_units; i++) {
+      fail_unless (n_units < sequential->len);
+      fail_unless_equals_int (meta->units[i].slice_type,
+          g_array_index (sequential, gint8, n_units));
+      n_units++;
+    }
+    gst_buffer_unref (buf);
+  }
+  fail_unless_equals_int (n_units, sequential->len);
+
+  g_array_free (sequential, TRUE);
+  gst_harness_teardown (h);
+  gst_object_unref (h265parse);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parse_keyframe_index)
+{
+  GstElement *h265parse;
+  GstHarness *h;
+  GstBus *bus;
+  GstMessage *msg;
+  GstQuery *query;
+  const GstStructure *s;
+  GstBuffer *index;
+  GstMapInfo map;
+  guint entries, i;
+  guint64 offset, picture_size;
+
+  h265parse = gst_element_factory_make ("h265parse", NULL);
+  g_object_set (h265parse, "keyframe-index", TRUE, NULL);
+  bus = gst_bus_new ();
+  gst_element_set_bus (h265parse, bus);
+
+  h = gst_harness_new_with_element (h265parse, "sink", "src");
+  gst_harness_set_src_caps_str (h,
+      "video/x-h265, stream-format=(string)byte-stream");
+  gst_harness_set_sink_caps_str (h, "video/x-h265, "
+      "stream-format=(string)byte-stream, alignment=(string)au");
+
+  fail_unless_equals_int (gst_harness_push (h,
+          make_many_slices_stream (N_PICTURES)), GST_FLOW_OK);
+
+  /* the index can be queried while parsing, the last picture is only
+   * pushed on EOS */
+  query = gst_query_new_custom (GST_QUERY_CUSTOM,
+      gst_structure_new_empty ("keyframe-index"));
+  fail_unless (gst_pad_peer_query (h->sinkpad, query));
+  fail_unless (gst_structure_get_uint (gst_query_get_structure (query),
+          "entries", &entries));
+  fail_unless_equals_int (entries, N_PICTURES - 1);
+  gst_query_unref (query);
+
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ELEMENT);
+  fail_unless (msg != NULL);
+  s = gst_message_get_structure (msg);
+  fail_unless (gst_structure_has_name (s, "keyframe-index"));
+  fail_unless (gst_structure_get_uint (s, "entries", &entries));
+  fail_unless_equals_int (entries, N_PICTURES);
+  fail_unless (gst_structure_get (s, "index", GST_TYPE_BUFFER, &index, NULL));
+
+  /* every picture is an IDR, one entry per picture, sorted by offset */
+  fail_unless (gst_buffer_map (index, &map, GST_MAP_READ));
+  fail_unless_equals_int (map.size, 8 + N_PICTURES * 28);
+  fail_unless (memcmp (map.data, "GVPI", 4) == 0);
+  picture_size = SLICES_PER_PICTURE * (9 + SLICE_DATA_SIZE);
+  for (i = 0; i < N_PICTURES; i++) {
+    offset = GST_READ_UINT64_BE (map.data + 8 + i * 28 + 16);
+    if (i == 0)
+      fail_unless_equals_uint64 (offset, 0);
+    else
+      fail_unless_equals_uint64 (offset, sizeof (h265_vps) +
+          sizeof (h265_sps) + sizeof (h265_pps) + i * picture_size);
+  }
+  gst_buffer_unmap (index, &map);
+
+  gst_buffer_unref (index);
+  gst_message_unref (msg);
+  gst_harness_teardown (h);
+  gst_element_set_bus (h265parse, NULL);
+  gst_object_unref (bus);
+  gst_object_unref (h265parse);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parse_keyframe_index_file)
+{
+  GstElement *h265parse;
+  GstHarness *h;
+  GstBus *bus;
+  GstMessage *msg;
+  GstSegment segment;
+  GstBuffer *stream, *index;
+  GstMapInfo map;
+  gchar *location, *contents;
+  gsize length;
+  guint entries, i;
+  guint64 offset, prev_offset = 0;
+  gint fd;
+
+  fd = g_file_open_tmp ("h265parse-index-XXXXXX", &location, NULL);
+  fail_unless (fd >= 0);
+  g_close (fd, NULL);
+
+  h265parse = gst_element_factory_make ("h265parse", NULL);
+  g_object_set (h265parse, "keyframe-index", TRUE,
+      "keyframe-index-location", location, NULL);
+  bus = gst_bus_new ();
+  gst_element_set_bus (h265parse, bus);
+
+  h = gst_harness_new_with_element (h265parse, "sink", "src");
+  gst_harness_set_src_caps_str (h,
+      "video/x-h265, stream-format=(string)byte-stream");
+  gst_harness_set_sink_caps_str (h, "video/x-h265, "
+      "stream-format=(string)byte-stream, alignment=(string)au");
+
+  stream = make_many_slices_stream (N_PICTURES);
+
+  /* parse the stream, seek back to its start and parse it again: the
+   * pictures seen twice must not be indexed twice */
+  fail_unless_equals_int (gst_harness_push (h, gst_buffer_ref (stream)),
+      GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_start ()));
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_stop (TRUE)));
+  gst_segment_init (&segment, GST_FORMAT_BYTES);
+  fail_unless (gst_harness_push_event (h, gst_event_new_segment (&segment)));
+  fail_unless_equals_int (gst_harness_push (h, stream), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  /* the file is written before the message is posted */
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ELEMENT);
+  fail_unless (msg != NULL);
+  fail_unless (gst_structure_get_uint (gst_message_get_structure (msg),
+          "entries", &entries));
+  fail_unless_equals_int (entries, N_PICTURES);
+  fail_unless (gst_structure_get (gst_message_get_structure (msg), "index",
+          GST_TYPE_BUFFER, &index, NULL));
+  fail_if (gst_bus_have_pending (bus));
+
+  fail_unless (g_file_get_contents (location, &contents, &length, NULL));
+  fail_unless_equals_int (length, 8 + N_PICTURES * 28);
+  fail_unless (memcmp (contents, "GVPI", 4) == 0);
+  fail_unless_equals_int (GST_READ_UINT32_BE (contents + 4), 1);
+
+  /* sorted by offset and without duplicates */
+  for (i = 0; i < N_PICTURES; i++) {
+    offset = GST_READ_UINT64_BE (contents + 8 + i * 28 + 16);
+    if (i > 0)
+      fail_unless (offset > prev_offset);
+    prev_offset = offset;
+  }
+
+  /* and the same as posted on the bus */
+  fail_unless (gst_buffer_map (index, &map, GST_MAP_READ));
+  fail_unless_equals_int (map.size, length);
+  fail_unless (memcmp (map.data, contents, length) == 0);
+  gst_buffer_unmap (index, &map);
+
+  g_free (contents);
+  gst_buffer_unref (index);
+  gst_message_unref (msg);
+  gst_harness_teardown (h);
+  gst_element_set_bus (h265parse, NULL);
+  gst_object_unref (bus);
+  gst_object_unref (h265parse);
+
+  g_unlink (location);
+  g_free (location);
+}
+
+GST_END_TEST;
+
+/* hvcC with the VPS, SPS and PPS, and 4 bytes NAL length prefixes */
+static GstBuffer *
+make_hvcc (void)
+{
+  const guint8 *nals[] = { h265_vps, h265_sps, h265_pps };
+  const gsize sizes[] = { sizeof (h265_vps), sizeof (h265_sps),
+    sizeof (h265_pps)
+  };
+  GByteArray *hvcc = g_byte_array_new ();
+  guint8 header[23] = { 0x01, };
+  gsize size;
+  guint i;
+
+  header[21] = 0xfc | 0x03;
+  header[22] = G_N_ELEMENTS (nals);
+  g_byte_array_append (hvcc, header, sizeof (header));
+
+  for (i = 0; i < G_N_ELEMENTS (nals); i++) {
+    guint8 array[5];
+
+    /* array_completeness, NAL unit type, one NAL of 2 bytes length */
+    array[0] = 0x80 | (nals[i][4] >> 1);
+    GST_WRITE_UINT16_BE (array + 1, 1);
+    GST_WRITE_UINT16_BE (array + 3, sizes[i] - 4);
+    g_byte_array_append (hvcc, array, sizeof (array));
+    g_byte_array_append (hvcc, nals[i] + 4, sizes[i] - 4);
+  }
+
+  size = hvcc->len;
+  return gst_buffer_new_wrapped (g_byte_array_free (hvcc, FALSE), size);
+}
+
+GST_START_TEST (test_parse_split_packetized_nal_meta)
+{
+  GstElement *h265parse;
+  GstHarness *h;
+  GstBuffer *stream, *au, *hvcc, *buf;
+  GstCaps *caps;
+  GstMapInfo map;
+  const gsize headers_size = sizeof (h265_vps) + sizeof (h265_sps) +
+      sizeof (h265_pps);
+  const guint slice_size = 5 + SLICE_DATA_SIZE;
+  guint i, n_slices = 0;
+
+  h265parse = gst_element_factory_make ("h265parse", NULL);
+  g_object_set (h265parse, "nal-meta", TRUE, NULL);
+
+  h = gst_harness_new_with_element (h265parse, "sink", "src");
+  hvcc = make_hvcc ();
+  caps = gst_caps_new_simple ("video/x-h265",
+      "stream-format", G_TYPE_STRING, "hvc1",
+      "alignment", G_TYPE_STRING, "au",
+      "codec_data", GST_TYPE_BUFFER, hvcc, NULL);
+  gst_buffer_unref (hvcc);
+  gst_harness_set_src_caps (h, caps);
+  gst_harness_set_sink_caps_str (h, "video/x-h265, "
+      "stream-format=(string)hvc1, alignment=(string)nal");
+
+  /* one picture as an hvc1 AU, the start codes of the byte-stream slices
+   * are replaced by their length */
+  stream = make_many_slices_stream (1);
+  au = gst_buffer_copy_region (stream, GST_BUFFER_COPY_ALL, headers_size, -1);
+  gst_buffer_unref (stream);
+  fail_unless (gst_buffer_map (au, &map, GST_MAP_WRITE));
+  fail_unless_equals_int (map.size, SLICES_PER_PICTURE * (4 + slice_size));
+  for (i = 0; i < SLICES_PER_PICTURE; i++)
+    GST_WRITE_UINT32_BE (map.data + i * (4 + slice_size), slice_size);
+  gst_buffer_unmap (au, &map);
+
+  fail_unless_equals_int (gst_harness_push (h, au), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  /* every slice is pushed on its own, after the VPS, SPS and PPS which
+   * have no meta. The offsets are relative to the output buffer, not to
+   * the input AU */
+  while ((buf = gst_harness_try_pull (h))) {
+    GstH265NalMeta *meta = gst_buffer_get_h265_nal_meta (buf);
+
+    if (meta == NULL) {
+      fail_unless_equals_int (n_slices, 0);
+      gst_buffer_unref (buf);
+      continue;
+    }
+
+    fail_unless_equals_int (meta->n_units, 1);
+    fail_unless_equals_int (meta->units[0].offset, 4);
+    fail_unless_equals_int (meta->units[0].size, slice_size);
+    fail_unless_equals_int (meta->units[0].type,
+        GST_H265_NAL_SLICE_IDR_W_RADL);
+    fail_unless_equals_int (meta->units[0].slice_type, GST_H265_I_SLICE);
+
+    fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+    fail_unless_equals_int (map.size, 4 + slice_size);
+    fail_unless_equals_int (GST_READ_UINT32_BE (map.data), slice_size);
+    fail_unless_equals_int (map.data[meta->units[0].offset] >> 1,
+        GST_H265_NAL_SLICE_IDR_W_RADL);
+    gst_buffer_unmap (buf, &map);
+
+    n_slices++;
+    gst_buffer_unref (buf);
+  }
+  fail_unless_equals_int (n_slices, SLICES_PER_PICTURE);
+
+  gst_harness_teardown (h);
+  gst_object_unref (h265parse);
+}
+
+GST_END_TEST;
+
+static Suite *
+h265parse_suite (void)
+{
+  Suite *s = suite_create ("h265parse");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_parse_slice_threads);
+  tcase_add_test (tc_chain, test_parse_slice_threads_change);
+  tcase_add_test (tc_chain, test_parse_keyframe_index);
+  tcase_add_test (tc_chain, test_parse_keyframe_index_file);
+  tcase_add_test (tc_chain, test_parse_split_packetized_nal_meta);
+
+  return s;
+}
+
+GST_CHECK_MAIN (h265parse);
@@ -613,6 +613,39 @@ GST_START_TEST (test_playlist_with_encryption)
 
 GST_END_TEST;
 
+GST_START_TEST (test_get_upcoming_keys)
+{
+  GstM3U8Client *client;
+  gchar **keys;
+
+  client = load_playlist (AES_128_ENCRYPTED_PLAYLIST);
+
+  /* Unencrypted fragments are skipped and consecutive fragments using
+   * the same key only report it once */
+  keys = gst_m3u8_client_get_upcoming_keys (client, 4, TRUE);
+  fail_unless (keys != NULL);
+  assert_equals_int (g_strv_length (keys), 2);
+  assert_equals_string (keys[0], "https://priv.example.com/key.bin");
+  assert_equals_string (keys[1], "https://priv.example.com/key2.bin");
+  g_strfreev (keys);
+
+  keys = gst_m3u8_client_get_upcoming_keys (client, 1, TRUE);
+  assert_equals_int (g_strv_length (keys), 1);
+  assert_equals_string (keys[0], "https://priv.example.com/key.bin");
+  g_strfreev (keys);
+
+  /* Start from the last fragment */
+  client->sequence = 4;
+  keys = gst_m3u8_client_get_upcoming_keys (client, 4, TRUE);
+  assert_equals_int (g_strv_length (keys), 1);
+  assert_equals_string (keys[0], "https://priv.example.com/key2.bin");
+  g_strfreev (keys);
+
+  gst_m3u8_client_free (client);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_update_invalid_playlist)
 {
   GstM3U8Client *client;
@@ -1341,6 +1374,7 @@ hlsdemux_suite (void)
 #endif
   tcase_add_test (tc_m3u8, test_playlist_with_doubles_duration);
   tcase_add_test (tc_m3u8, test_playlist_with_encryption);
+  tcase_add_test (tc_m3u8, test_get_upcoming_keys);
 
   return s;
 }
@@ -118,6 +118,7 @@ verify_buffer (buffer_verify_data_s * vdata, GstBuffer * buffer)
 }
 
 #define  GOP_SPLIT           "gop-split"
+#define  FAST_PARSE          "fast-parse"
 
 static GstElement *
 setup_element (const gchar * desc)
@@ -127,6 +128,9 @@ setup_element (const gchar * desc)
   if (strcmp (desc, GOP_SPLIT) == 0) {
     element = gst_check_setup_element ("mpegvideoparse");
     g_object_set (G_OBJECT (element), "gop-split", TRUE, NULL);
+  } else if (strcmp (desc, FAST_PARSE) == 0) {
+    element = gst_check_setup_element ("mpegvideoparse");
+    g_object_set (G_OBJECT (element), "fast-parse", TRUE, NULL);
   } else {
     element = gst_check_setup_element ("mpegvideoparse");
   }
@@ -234,6 +238,18 @@ GST_START_TEST (test_parse_gop_split)
 GST_END_TEST;
 
 
+GST_START_TEST (test_parse_fast)
+{
+  /* same frames as without fast-parse, slices included */
+  ctx_factory = FAST_PARSE;
+  gst_parser_test_normal (mpeg2_iframe, sizeof (mpeg2_iframe));
+  gst_parser_test_split (mpeg2_iframe, sizeof (mpeg2_iframe));
+  ctx_factory = "mpegvideoparse";
+}
+
+GST_END_TEST;
+
+
 static Suite *
 mpegvideoparse_suite (void)
 {
@@ -257,6 +273,7 @@ mpegvideoparse_suite (void)
   tcase_add_test (tc_chain, test_parse_detect_stream_mpeg1);
   tcase_add_test (tc_chain, test_parse_detect_stream_mpeg2);
   tcase_add_test (tc_chain, test_parse_gop_split);
+  tcase_add_test (tc_chain, test_parse_fast);
 
   return s;
 }
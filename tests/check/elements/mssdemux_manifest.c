@@ -0,0 +1,167 @@
+/* GStreamer unit test for the Smooth Streaming manifest
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "../../ext/smoothstreaming/gstmssmanifest.c"
+#undef GST_CAT_DEFAULT
+
+#include <gst/check/gstcheck.h>
+
+GST_DEBUG_CATEGORY (mssdemux_debug);
+
+#define MANIFEST_HEADER \
+  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" \
+  "<SmoothStreamingMedia MajorVersion=\"2\" MinorVersion=\"0\" " \
+  "    Duration=\"0\" IsLive=\"TRUE\">" \
+  "  <StreamIndex Type=\"video\" Chunks=\"0\" " \
+  "      Url=\"QualityLevels({bitrate})/Fragments(video={start time})\">" \
+  "    <QualityLevel Index=\"0\" Bitrate=\"1000000\" FourCC=\"H264\" " \
+  "        MaxWidth=\"640\" MaxHeight=\"480\"/>"
+
+#define MANIFEST_FOOTER \
+  "  </StreamIndex>" \
+  "</SmoothStreamingMedia>"
+
+static GstBuffer *
+make_manifest (const gchar * fragments)
+{
+  gchar *xml = g_strconcat (MANIFEST_HEADER, fragments, MANIFEST_FOOTER,
+      NULL);
+
+  return gst_buffer_new_wrapped (xml, strlen (xml));
+}
+
+static GstMssStream *
+setup_stream (GstMssManifest * manifest)
+{
+  GstMssStream *stream;
+
+  fail_unless (manifest != NULL);
+  fail_unless (gst_mss_manifest_is_live (manifest));
+  fail_unless_equals_int (g_slist_length (gst_mss_manifest_get_streams
+          (manifest)), 1);
+
+  stream = gst_mss_manifest_get_streams (manifest)->data;
+  gst_mss_stream_set_active (stream, TRUE);
+
+  return stream;
+}
+
+/* the start time of the current fragment, in the manifest timescale */
+static guint64
+get_position (GstMssStream * stream)
+{
+  GstMssStreamFragment *fragment = stream->current_fragment->data;
+
+  return fragment->time + fragment->duration * stream->fragment_repetition_index;
+}
+
+static void
+reload (GstMssManifest * manifest, const gchar * fragments)
+{
+  GstBuffer *buf = make_manifest (fragments);
+
+  gst_mss_manifest_reload_fragments (manifest, buf);
+  gst_buffer_unref (buf);
+}
+
+/* Checks that the fragments from the current position on start at @start
+ * and follow each other every @duration up to @end, exclusive */
+static void
+check_positions (GstMssStream * stream, guint64 start, guint64 duration,
+    guint64 end)
+{
+  guint64 expected;
+
+  for (expected = start; expected < end; expected += duration) {
+    fail_unless (gst_mss_stream_has_next_fragment (stream));
+    fail_unless_equals_uint64 (get_position (stream), expected);
+    gst_mss_stream_advance_fragment (stream);
+  }
+  fail_if (gst_mss_stream_has_next_fragment (stream));
+}
+
+GST_START_TEST (test_reload_append)
+{
+  GstMssManifest *manifest;
+  GstMssStream *stream;
+  GstBuffer *buf;
+  guint i;
+
+  buf = make_manifest ("<c t=\"100\" d=\"2\" r=\"3\"/>");
+  manifest = gst_mss_manifest_new (buf);
+  gst_buffer_unref (buf);
+  stream = setup_stream (manifest);
+
+  /* 100, 102 */
+  for (i = 0; i < 2; i++)
+    gst_mss_stream_advance_fragment (stream);
+
+  /* the same last fragment with more repetitions, and a new one */
+  reload (manifest, "<c t=\"100\" d=\"2\" r=\"4\"/><c t=\"108\" d=\"2\"/>");
+  check_positions (stream, 104, 2, 110);
+
+  gst_mss_manifest_free (manifest);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_reload_inside_repetitions)
+{
+  GstMssManifest *manifest;
+  GstMssStream *stream;
+  GstBuffer *buf;
+  guint i;
+
+  buf = make_manifest ("<c t=\"94\" d=\"2\" r=\"3\"/>"
+      "<c t=\"100\" d=\"2\" r=\"3\"/>");
+  manifest = gst_mss_manifest_new (buf);
+  gst_buffer_unref (buf);
+  stream = setup_stream (manifest);
+
+  /* 94, 96, 98, 100 */
+  for (i = 0; i < 4; i++)
+    gst_mss_stream_advance_fragment (stream);
+
+  /* the refreshed window starts inside the last repeated fragment, which
+   * ends at 106: 102 and 104 are known, 106 to 110 extend it */
+  reload (manifest, "<c t=\"102\" d=\"2\" r=\"5\"/><c t=\"112\" d=\"2\"/>");
+
+  /* no fragment twice, and no going back in time */
+  check_positions (stream, 102, 2, 114);
+
+  gst_mss_manifest_free (manifest);
+}
+
+GST_END_TEST;
+
+static Suite *
+mssdemux_manifest_suite (void)
+{
+  Suite *s = suite_create ("mssdemux_manifest");
+  TCase *tc_chain = tcase_create ("general");
+
+  GST_DEBUG_CATEGORY_INIT (mssdemux_debug, "mssdemux", 0, "mssdemux");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_reload_append);
+  tcase_add_test (tc_chain, test_reload_inside_repetitions);
+
+  return s;
+}
+
+GST_CHECK_MAIN (mssdemux_manifest);
@@ -1,5 +1,8 @@
 #include "parser.h"
 #include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <glib/gstdio.h>
+#include <unistd.h>
 
 static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
@@ -69,6 +72,381 @@ GST_START_TEST (test_parse_frames_with_eth_padding)
 }
 GST_END_TEST;
 
+#define ADDR(a, b, c, d) (((a) << 24) | ((b) << 16) | ((c) << 8) | (d))
+
+/* seven MPEG-TS packets, as in most UDP streams */
+#define PAYLOAD_SIZE (7 * 188)
+
+/* Ethernet, IPv4 and UDP headers followed by @payload_size bytes */
+static guint
+append_udp_frame (GByteArray * array, guint32 src_ip, guint16 src_port,
+    guint32 dst_ip, guint16 dst_port, guint payload_size)
+{
+  guint8 headers[14 + 20 + 8] = { 0, };
+  guint8 *payload;
+
+  GST_WRITE_UINT16_BE (headers + 12, 0x0800);
+  headers[14] = 0x45;
+  GST_WRITE_UINT16_BE (headers + 16, 20 + 8 + payload_size);
+  headers[22] = 64;
+  headers[23] = 17;
+  GST_WRITE_UINT32_BE (headers + 26, src_ip);
+  GST_WRITE_UINT32_BE (headers + 30, dst_ip);
+  GST_WRITE_UINT16_BE (headers + 34, src_port);
+  GST_WRITE_UINT16_BE (headers + 36, dst_port);
+  GST_WRITE_UINT16_BE (headers + 38, 8 + payload_size);
+  g_byte_array_append (array, headers, sizeof (headers));
+
+  payload = g_malloc (payload_size);
+  memset (payload, dst_port & 0xff, payload_size);
+  g_byte_array_append (array, payload, payload_size);
+  g_free (payload);
+
+  return sizeof (headers) + payload_size;
+}
+
+/* A pcap record with a UDP packet */
+static void
+append_pcap_packet (GByteArray * array, guint32 ts_sec, guint32 src_ip,
+    guint16 src_port, guint32 dst_ip, guint16 dst_port, guint payload_size)
+{
+  guint8 header[16];
+  guint frame_size = 14 + 20 + 8 + payload_size;
+
+  GST_WRITE_UINT32_LE (header, ts_sec);
+  GST_WRITE_UINT32_LE (header + 4, 0);
+  GST_WRITE_UINT32_LE (header + 8, frame_size);
+  GST_WRITE_UINT32_LE (header + 12, frame_size);
+  g_byte_array_append (array, header, sizeof (header));
+  append_udp_frame (array, src_ip, src_port, dst_ip, dst_port, payload_size);
+}
+
+static void
+append_pcapng_block (GByteArray * array, guint32 type, const guint8 * body,
+    guint body_size)
+{
+  static const guint8 padding[3] = { 0, };
+  guint8 field[4];
+  guint len = 12 + GST_ROUND_UP_4 (body_size);
+
+  GST_WRITE_UINT32_LE (field, type);
+  g_byte_array_append (array, field, 4);
+  GST_WRITE_UINT32_LE (field, len);
+  g_byte_array_append (array, field, 4);
+  g_byte_array_append (array, body, body_size);
+  g_byte_array_append (array, padding, GST_ROUND_UP_4 (body_size) - body_size);
+  g_byte_array_append (array, field, 4);
+}
+
+/* A section with one Ethernet interface with nanosecond timestamps */
+static void
+append_pcapng_header (GByteArray * array)
+{
+  guint8 shb[16];
+  guint8 idb[16] = { 0, };
+
+  GST_WRITE_UINT32_LE (shb, 0x1A2B3C4D);
+  GST_WRITE_UINT16_LE (shb + 4, 1);
+  GST_WRITE_UINT16_LE (shb + 6, 0);
+  memset (shb + 8, 0xff, 8);
+  append_pcapng_block (array, 0x0A0D0D0A, shb, sizeof (shb));
+
+  /* linktype, reserved, snaplen, if_tsresol 9, end of options */
+  GST_WRITE_UINT16_LE (idb, 1);
+  GST_WRITE_UINT16_LE (idb + 8, 9);
+  GST_WRITE_UINT16_LE (idb + 10, 1);
+  idb[12] = 9;
+  append_pcapng_block (array, 0x00000001, idb, sizeof (idb));
+}
+
+static void
+append_pcapng_packet (GByteArray * array, guint64 ts, guint16 dst_port,
+    guint payload_size)
+{
+  GByteArray *body = g_byte_array_new ();
+  guint8 header[20];
+  guint frame_size = 14 + 20 + 8 + payload_size;
+
+  GST_WRITE_UINT32_LE (header, 0);
+  GST_WRITE_UINT32_LE (header + 4, ts >> 32);
+  GST_WRITE_UINT32_LE (header + 8, ts & G_MAXUINT32);
+  GST_WRITE_UINT32_LE (header + 12, frame_size);
+  GST_WRITE_UINT32_LE (header + 16, frame_size);
+  g_byte_array_append (body, header, sizeof (header));
+  append_udp_frame (body, ADDR (10, 0, 0, 1), 4000, ADDR (239, 0, 0, 1),
+      dst_port, payload_size);
+
+  append_pcapng_block (array, 0x00000006, body->data, body->len);
+  g_byte_array_unref (body);
+}
+
+static GstHarness *
+setup_pcapparse (const gchar * filter)
+{
+  GstHarness *h;
+
+  h = gst_harness_new ("pcapparse");
+  if (filter)
+    g_object_set (h->element, "filter", filter, NULL);
+  gst_harness_set_src_caps_str (h, "raw/x-pcap");
+
+  return h;
+}
+
+static void
+push_array (GstHarness * h, GByteArray * array)
+{
+  gsize size = array->len;
+
+  fail_unless_equals_int (gst_harness_push (h,
+          gst_buffer_new_wrapped (g_byte_array_free (array, FALSE), size)),
+      GST_FLOW_OK);
+}
+
+GST_START_TEST (test_parse_pcapng)
+{
+  static const guint8 unknown[8] = { 0, };
+  GstHarness *h;
+  GByteArray *array;
+  GstBuffer *buf;
+  guint i;
+
+  array = g_byte_array_new ();
+  append_pcapng_header (array);
+  for (i = 1; i <= 3; i++) {
+    append_pcapng_packet (array, i * GST_SECOND + i, 5004, i * 101);
+    /* skipped */
+    append_pcapng_block (array, 0x00000bad, unknown, sizeof (unknown));
+  }
+
+  h = setup_pcapparse (NULL);
+  push_array (h, array);
+
+  for (i = 1; i <= 3; i++) {
+    buf = gst_harness_pull (h);
+    fail_unless_equals_int (gst_buffer_get_size (buf), i * 101);
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), i * GST_SECOND + i);
+    gst_buffer_unref (buf);
+  }
+  fail_unless (gst_harness_try_pull (h) == NULL);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parse_filter)
+{
+  GstHarness *h;
+  GByteArray *array;
+  GstBuffer *buf;
+  gchar *filter;
+
+  array = g_byte_array_new ();
+  g_byte_array_append (array, pcap_header, sizeof (pcap_header));
+  append_pcap_packet (array, 1, ADDR (10, 0, 0, 1), 4000, ADDR (239, 0, 0, 1),
+      5004, 100);
+  append_pcap_packet (array, 2, ADDR (10, 0, 0, 1), 4000, ADDR (239, 0, 0, 2),
+      5004, 200);
+  append_pcap_packet (array, 3, ADDR (10, 1, 2, 3), 4000, ADDR (239, 0, 0, 2),
+      6000, 300);
+  append_pcap_packet (array, 4, ADDR (10, 2, 0, 1), 4000, ADDR (239, 0, 0, 1),
+      6000, 400);
+
+  h = setup_pcapparse ("udp and dst host 239.0.0.1 and dst port 5004 or "
+      "src net 10.1.0.0/16");
+
+  /* an invalid filter is ignored */
+  g_object_set (h->element, "filter", "udp and", NULL);
+  g_object_get (h->element, "filter", &filter, NULL);
+  fail_unless_equals_string (filter, "udp and dst host 239.0.0.1 and "
+      "dst port 5004 or src net 10.1.0.0/16");
+  g_free (filter);
+
+  push_array (h, array);
+
+  buf = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buf), 100);
+  gst_buffer_unref (buf);
+  buf = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buf), 300);
+  gst_buffer_unref (buf);
+  fail_unless (gst_harness_try_pull (h) == NULL);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static void
+on_handoff (GstElement * fakesink, GstBuffer * buf, GstPad * pad,
+    guint * n_buffers)
+{
+  GstPad *srcpad = GST_PAD_PEER (pad);
+  GstElement *pcapparse = GST_ELEMENT (GST_OBJECT_PARENT (srcpad));
+  GstPad *pcap_sinkpad = gst_element_get_static_pad (pcapparse, "sink");
+
+  fail_unless_equals_int (GST_PAD_MODE (pcap_sinkpad), GST_PAD_MODE_PULL);
+  gst_object_unref (pcap_sinkpad);
+
+  fail_unless_equals_int (gst_buffer_get_size (buf), PAYLOAD_SIZE);
+  /* a sub-buffer of a block read from the file, not a copy, except for the
+   * payloads that span two blocks */
+  fail_unless_equals_int (gst_buffer_n_memory (buf), 1);
+  if (gst_buffer_peek_memory (buf, 0)->parent != NULL)
+    (*n_buffers)++;
+  else
+    GST_LOG ("payload copied");
+}
+
+/* Reads @n_packets packets from a file, half of them filtered out. Returns
+ * in @n_shared how many were output without copying */
+static void
+run_pull_mode (guint n_packets, guint * n_shared)
+{
+  GstElement *pipeline, *fakesink;
+  GByteArray *array;
+  GstBus *bus;
+  GstMessage *msg;
+  GError *error = NULL;
+  gchar *path, *desc;
+  gint fd;
+  guint i;
+
+  array = g_byte_array_new ();
+  g_byte_array_append (array, pcap_header, sizeof (pcap_header));
+  for (i = 0; i < n_packets; i++)
+    append_pcap_packet (array, i, ADDR (10, 0, 0, 1), 4000,
+        ADDR (239, 0, 0, 1), i % 2 ? 5006 : 5004, PAYLOAD_SIZE);
+
+  fd = g_file_open_tmp ("pcapparse-XXXXXX.pcap", &path, &error);
+  fail_unless (fd >= 0);
+  close (fd);
+  fail_unless (g_file_set_contents (path, (const gchar *) array->data,
+          array->len, &error));
+  g_byte_array_unref (array);
+
+  desc = g_strdup_printf ("filesrc location=%s ! pcapparse "
+      "filter=\"dst port 5004\" ! fakesink name=sink signal-handoffs=true "
+      "sync=false", path);
+  pipeline = gst_parse_launch (desc, &error);
+  fail_unless (pipeline != NULL);
+  g_free (desc);
+
+  *n_shared = 0;
+  fakesink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (fakesink, "handoff", G_CALLBACK (on_handoff), n_shared);
+  gst_object_unref (fakesink);
+
+  fail_unless (gst_element_set_state (pipeline, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  g_unlink (path);
+  g_free (path);
+}
+
+GST_START_TEST (test_parse_pull_mode)
+{
+  guint n_shared;
+
+  run_pull_mode (1000, &n_shared);
+  /* the records cross a block boundary only once */
+  fail_unless (n_shared >= 500 - 1);
+}
+
+GST_END_TEST;
+
+/* Replays @n_packets captured every @interval at @speed in batches of 1 ms,
+ * checks the payloads and returns the replay statistics and the time it
+ * took */
+static GstStructure *
+run_replay (guint n_packets, GstClockTime interval, guint payload_size,
+    gdouble speed, gint64 * elapsed)
+{
+  GstHarness *h;
+  GByteArray *array;
+  GstBuffer *buf;
+  GstStructure *stats;
+  gint64 start;
+  guint i;
+
+  array = g_byte_array_new ();
+  append_pcapng_header (array);
+  for (i = 0; i < n_packets; i++)
+    append_pcapng_packet (array, GST_SECOND + i * interval, 5004,
+        payload_size);
+
+  h = setup_pcapparse (NULL);
+  g_object_set (h->element, "replay", TRUE, "replay-speed", speed,
+      "batch-duration", GST_MSECOND, NULL);
+
+  start = g_get_monotonic_time ();
+  push_array (h, array);
+  /* pushes the last batch */
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+  *elapsed = g_get_monotonic_time () - start;
+
+  for (i = 0; i < n_packets; i++) {
+    buf = gst_harness_pull (h);
+    fail_unless_equals_int (gst_buffer_get_size (buf), payload_size);
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buf),
+        GST_SECOND + i * interval);
+    gst_buffer_unref (buf);
+  }
+  fail_unless (gst_harness_try_pull (h) == NULL);
+
+  g_object_get (h->element, "stats", &stats, NULL);
+  gst_harness_teardown (h);
+
+  return stats;
+}
+
+GST_START_TEST (test_parse_replay)
+{
+  GstStructure *stats;
+  gint64 elapsed;
+  guint64 n;
+
+  /* 40 packets in 10 ms */
+  stats = run_replay (40, 250 * GST_USECOND, 100, 1.0, &elapsed);
+
+  /* the last batch is due 9 ms after the first */
+  fail_unless (elapsed >= 9 * 1000);
+  fail_unless (gst_structure_get_uint64 (stats, "batches", &n));
+  fail_unless_equals_uint64 (n, 10);
+  fail_unless (gst_structure_get_uint64 (stats, "packets", &n));
+  fail_unless_equals_uint64 (n, 40);
+  gst_structure_free (stats);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parse_replay_speed)
+{
+  GstStructure *stats;
+  gint64 elapsed;
+  guint64 n;
+
+  /* 200 ms of capture replayed in 20 ms */
+  stats = run_replay (21, 10 * GST_MSECOND, 100, 10.0, &elapsed);
+
+  fail_unless (elapsed >= 20 * 1000);
+  fail_unless (elapsed < 200 * 1000);
+  fail_unless (gst_structure_get_uint64 (stats, "batches", &n));
+  fail_unless_equals_uint64 (n, 21);
+  gst_structure_free (stats);
+}
+
+GST_END_TEST;
+
 static Suite *
 pcapparse_suite (void)
 {
@@ -86,6 +464,11 @@ pcapparse_suite (void)
 
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_parse_frames_with_eth_padding);
+  tcase_add_test (tc_chain, test_parse_pcapng);
+  tcase_add_test (tc_chain, test_parse_filter);
+  tcase_add_test (tc_chain, test_parse_pull_mode);
+  tcase_add_test (tc_chain, test_parse_replay);
+  tcase_add_test (tc_chain, test_parse_replay_speed);
 
   return s;
 }
@@ -0,0 +1,513 @@
+/*
+ * GStreamer
+ *
+ * unit test for rtmpsink
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#ifndef G_OS_WIN32
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+#include <gio/gio.h>
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#include <librtmp/rtmp.h>
+#include <librtmp/amf.h>
+
+#define FLV_TAG_AUDIO 8
+#define FLV_TAG_VIDEO 9
+
+#define N_TAGS 200
+#define AUDIO_TAG_SIZE 64
+#define VIDEO_TAG_SIZE (8 * 1024)
+#define KEYFRAME_INTERVAL 25
+
+/* enough video to fill the socket buffers of a stalled connection */
+#define STALL_TAGS 4000
+#define LEAKY_QUEUE_SIZE (64 * 1024)
+
+/* A stand-in for an RTMP server: it accepts one publisher and counts the
+ * audio and video messages it receives. While paused, it stops reading once
+ * the publishing started, like a server behind a stalled network */
+typedef struct
+{
+  GSocket *listener;
+  guint port;
+  GThread *thread;
+
+  GMutex lock;
+  GCond cond;
+  gboolean publishing;
+  gboolean paused;
+  guint n_media;
+  guint64 media_bytes;
+} Server;
+
+static const AVal av_connect = AVC ("connect");
+static const AVal av_createStream = AVC ("createStream");
+static const AVal av_publish = AVC ("publish");
+
+static void
+server_send_invoke (RTMP * r, const gchar * method, gdouble txn,
+    gdouble stream_id, const gchar * code)
+{
+  static const AVal av_level = AVC ("level");
+  static const AVal av_status = AVC ("status");
+  static const AVal av_code = AVC ("code");
+  gchar pbuf[512], *pend = pbuf + sizeof (pbuf), *enc;
+  RTMPPacket packet;
+  AVal av;
+  gboolean ret;
+
+  memset (&packet, 0, sizeof (packet));
+  packet.m_nChannel = 0x03;
+  packet.m_headerType = RTMP_PACKET_SIZE_MEDIUM;
+  packet.m_packetType = RTMP_PACKET_TYPE_INVOKE;
+  packet.m_body = pbuf + RTMP_MAX_HEADER_SIZE;
+
+  enc = packet.m_body;
+  av.av_val = (char *) method;
+  av.av_len = strlen (method);
+  enc = AMF_EncodeString (enc, pend, &av);
+  enc = AMF_EncodeNumber (enc, pend, txn);
+  *enc++ = AMF_NULL;
+  if (code) {
+    av.av_val = (char *) code;
+    av.av_len = strlen (code);
+    *enc++ = AMF_OBJECT;
+    enc = AMF_EncodeNamedString (enc, pend, &av_level, &av_status);
+    enc = AMF_EncodeNamedString (enc, pend, &av_code, &av);
+    *enc++ = 0;
+    *enc++ = 0;
+    *enc++ = AMF_OBJECT_END;
+  } else if (stream_id > 0) {
+    enc = AMF_EncodeNumber (enc, pend, stream_id);
+  }
+  packet.m_nBodySize = enc - packet.m_body;
+
+  ret = RTMP_SendPacket (r, &packet, FALSE);
+  fail_unless (ret);
+}
+
+/* Answers what librtmp waits for before it can publish */
+static void
+server_handle_invoke (Server * server, RTMP * r, RTMPPacket * packet)
+{
+  AMFObject obj;
+  AVal method;
+  gdouble txn;
+
+  if (AMF_Decode (&obj, packet->m_body, packet->m_nBodySize, FALSE) < 0)
+    return;
+
+  AMFProp_GetString (AMF_GetProp (&obj, NULL, 0), &method);
+  txn = AMFProp_GetNumber (AMF_GetProp (&obj, NULL, 1));
+
+  if (AVMATCH (&method, &av_connect)) {
+    server_send_invoke (r, "_result", txn, 0, NULL);
+  } else if (AVMATCH (&method, &av_createStream)) {
+    server_send_invoke (r, "_result", txn, 1, NULL);
+  } else if (AVMATCH (&method, &av_publish)) {
+    server_send_invoke (r, "onStatus", 0, 0, "NetStream.Publish.Start");
+    g_mutex_lock (&server->lock);
+    server->publishing = TRUE;
+    g_mutex_unlock (&server->lock);
+  }
+
+  AMF_Reset (&obj);
+}
+
+static gpointer
+server_thread (Server * server)
+{
+  RTMPPacket packet = { 0 };
+  GSocket *conn;
+  RTMP *r;
+  gboolean ret;
+
+  conn = g_socket_accept (server->listener, NULL, NULL);
+  fail_unless (conn != NULL);
+
+  r = RTMP_Alloc ();
+  RTMP_Init (r);
+  r->m_sb.sb_socket = g_socket_get_fd (conn);
+
+  ret = RTMP_Serve (r);
+  fail_unless (ret);
+  while (TRUE) {
+    g_mutex_lock (&server->lock);
+    while (server->paused && server->publishing)
+      g_cond_wait (&server->cond, &server->lock);
+    g_mutex_unlock (&server->lock);
+
+    if (!RTMP_IsConnected (r) || !RTMP_ReadPacket (r, &packet))
+      break;
+    if (!RTMPPacket_IsReady (&packet))
+      continue;
+
+    switch (packet.m_packetType) {
+      case RTMP_PACKET_TYPE_AUDIO:
+      case RTMP_PACKET_TYPE_VIDEO:
+        g_mutex_lock (&server->lock);
+        server->n_media++;
+        server->media_bytes += packet.m_nBodySize;
+        g_cond_broadcast (&server->cond);
+        g_mutex_unlock (&server->lock);
+        break;
+      case RTMP_PACKET_TYPE_INVOKE:
+        server_handle_invoke (server, r, &packet);
+        break;
+      default:
+        break;
+    }
+    RTMPPacket_Free (&packet);
+  }
+  RTMPPacket_Free (&packet);
+
+  /* the socket belongs to the GSocket */
+  r->m_sb.sb_socket = -1;
+  RTMP_Close (r);
+  RTMP_Free (r);
+  g_object_unref (conn);
+
+  return NULL;
+}
+
+static void
+server_start (Server * server, gboolean paused)
+{
+  GInetAddress *addr;
+  GSocketAddress *sockaddr, *bound;
+
+  memset (server, 0, sizeof (Server));
+  g_mutex_init (&server->lock);
+  g_cond_init (&server->cond);
+  server->paused = paused;
+
+  server->listener = g_socket_new (G_SOCKET_FAMILY_IPV4,
+      G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, NULL);
+  fail_unless (server->listener != NULL);
+
+  addr = g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4);
+  sockaddr = g_inet_socket_address_new (addr, 0);
+  fail_unless (g_socket_bind (server->listener, sockaddr, TRUE, NULL));
+  fail_unless (g_socket_listen (server->listener, NULL));
+  g_object_unref (sockaddr);
+  g_object_unref (addr);
+
+  bound = g_socket_get_local_address (server->listener, NULL);
+  server->port =
+      g_inet_socket_address_get_port (G_INET_SOCKET_ADDRESS (bound));
+  g_object_unref (bound);
+
+  server->thread = g_thread_new ("rtmp-server",
+      (GThreadFunc) server_thread, server);
+}
+
+static void
+server_set_paused (Server * server, gboolean paused)
+{
+  g_mutex_lock (&server->lock);
+  server->paused = paused;
+  g_cond_broadcast (&server->cond);
+  g_mutex_unlock (&server->lock);
+}
+
+/* Waits until the server received @n_media messages */
+static void
+server_wait (Server * server, guint n_media)
+{
+  gint64 end_time = g_get_monotonic_time () + 30 * G_TIME_SPAN_SECOND;
+
+  g_mutex_lock (&server->lock);
+  while (server->n_media < n_media)
+    fail_unless (g_cond_wait_until (&server->cond, &server->lock, end_time));
+  g_mutex_unlock (&server->lock);
+}
+
+/* Must be called once the publisher is disconnected */
+static void
+server_stop (Server * server)
+{
+  g_thread_join (server->thread);
+  g_object_unref (server->listener);
+  g_mutex_clear (&server->lock);
+  g_cond_clear (&server->cond);
+}
+
+static GstHarness *
+setup_rtmpsink (Server * server, gboolean async_send)
+{
+  GstElement *rtmpsink;
+  GstHarness *h;
+  gchar *location;
+
+  location = g_strdup_printf ("rtmp://127.0.0.1:%u/live/test", server->port);
+  rtmpsink = gst_element_factory_make ("rtmpsink", NULL);
+  g_object_set (rtmpsink, "location", location, "async-send", async_send,
+      NULL);
+  g_free (location);
+
+  h = gst_harness_new_with_element (rtmpsink, "sink", NULL);
+  gst_harness_set_src_caps_str (h, "video/x-flv");
+  gst_object_unref (rtmpsink);
+
+  return h;
+}
+
+static GstBuffer *
+make_flv_header (void)
+{
+  static const guint8 header[] = {
+    'F', 'L', 'V', 0x01, 0x05, 0x00, 0x00, 0x00, 0x09,
+    0x00, 0x00, 0x00, 0x00
+  };
+
+  return gst_buffer_new_wrapped (g_memdup (header, sizeof (header)),
+      sizeof (header));
+}
+
+static GstBuffer *
+make_flv_tag (guint8 type, guint32 ts, guint body_size, gboolean keyframe)
+{
+  guint size = 11 + body_size + 4;
+  GstBuffer *buf;
+  guint8 *data;
+
+  data = g_malloc0 (size);
+  data[0] = type;
+  GST_WRITE_UINT24_BE (data + 1, body_size);
+  GST_WRITE_UINT24_BE (data + 4, ts & 0xffffff);
+  data[7] = ts >> 24;
+  if (type == FLV_TAG_VIDEO)
+    data[11] = keyframe ? 0x17 : 0x27;
+  else
+    data[11] = 0xaf;
+  GST_WRITE_UINT32_BE (data + 11 + body_size, 11 + body_size);
+
+  buf = gst_buffer_new_wrapped (data, size);
+  if (!keyframe)
+    GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
+
+  return buf;
+}
+
+static guint64
+get_stat (GstHarness * h, const gchar * field)
+{
+  GstStructure *stats;
+  guint64 value;
+
+  g_object_get (h->element, "stats", &stats, NULL);
+  fail_unless (gst_structure_get_uint64 (stats, field, &value));
+  gst_structure_free (stats);
+
+  return value;
+}
+
+/* Sends @n_tags audio tags, returns the number of writes */
+static guint64
+run_audio (gboolean async_send, guint n_tags)
+{
+  Server server;
+  GstHarness *h;
+  guint64 writes;
+  guint i;
+
+  server_start (&server, FALSE);
+  h = setup_rtmpsink (&server, async_send);
+
+  fail_unless_equals_int (gst_harness_push (h, make_flv_header ()),
+      GST_FLOW_OK);
+  for (i = 0; i < n_tags; i++)
+    fail_unless_equals_int (gst_harness_push (h, make_flv_tag (FLV_TAG_AUDIO,
+                i * 20, AUDIO_TAG_SIZE, TRUE)), GST_FLOW_OK);
+  /* everything is written once EOS went through */
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  server_wait (&server, n_tags);
+  fail_unless_equals_uint64 (server.media_bytes,
+      (guint64) n_tags * AUDIO_TAG_SIZE);
+  fail_unless_equals_uint64 (get_stat (h, "bytes-sent"),
+      13 + (guint64) n_tags * (11 + AUDIO_TAG_SIZE + 4));
+  fail_unless_equals_uint64 (get_stat (h, "queued-bytes"), 0);
+  writes = get_stat (h, "writes");
+
+  gst_harness_teardown (h);
+  server_stop (&server);
+
+  return writes;
+}
+
+GST_START_TEST (test_send)
+{
+  /* the header is sent with the first tag */
+  fail_unless_equals_uint64 (run_audio (FALSE, N_TAGS), N_TAGS);
+}
+
+GST_END_TEST;
+
+#ifdef TCP_CORK
+GST_START_TEST (test_send_async)
+{
+  Server server;
+  GstHarness *h;
+  guint i;
+
+  server_start (&server, TRUE);
+  h = setup_rtmpsink (&server, TRUE);
+  g_object_set (h->element, "max-queue-size", 0, NULL);
+
+  /* the send thread blocks once the socket buffers are full, and the tags
+   * queue up behind it */
+  fail_unless_equals_int (gst_harness_push (h, make_flv_header ()),
+      GST_FLOW_OK);
+  for (i = 0; i < STALL_TAGS; i++)
+    fail_unless_equals_int (gst_harness_push (h, make_flv_tag (FLV_TAG_VIDEO,
+                i * 40, VIDEO_TAG_SIZE, i % KEYFRAME_INTERVAL == 0)),
+        GST_FLOW_OK);
+  fail_unless (get_stat (h, "queued-bytes") > 0);
+
+  server_set_paused (&server, FALSE);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+  server_wait (&server, STALL_TAGS);
+  fail_unless_equals_uint64 (server.media_bytes,
+      (guint64) STALL_TAGS * VIDEO_TAG_SIZE);
+
+  /* the queued tags went out in corked batches, not one write each */
+  fail_unless (get_stat (h, "writes") < STALL_TAGS);
+
+  gst_harness_teardown (h);
+  server_stop (&server);
+}
+
+GST_END_TEST;
+#endif
+
+GST_START_TEST (test_send_leaky)
+{
+  Server server;
+  GstHarness *h;
+  guint64 dropped;
+  guint i;
+
+  server_start (&server, TRUE);
+  h = setup_rtmpsink (&server, TRUE);
+  g_object_set (h->element, "leaky", TRUE, "max-queue-size", LEAKY_QUEUE_SIZE,
+      NULL);
+
+  /* the server doesn't read, the streaming thread is never blocked */
+  fail_unless_equals_int (gst_harness_push (h, make_flv_header ()),
+      GST_FLOW_OK);
+  for (i = 0; i < STALL_TAGS; i++)
+    fail_unless_equals_int (gst_harness_push (h, make_flv_tag (FLV_TAG_VIDEO,
+                i * 40, VIDEO_TAG_SIZE, i % KEYFRAME_INTERVAL == 0)),
+        GST_FLOW_OK);
+  fail_unless (get_stat (h, "queued-bytes") <= LEAKY_QUEUE_SIZE);
+
+  dropped = get_stat (h, "dropped");
+  fail_unless (dropped > 0);
+
+  server_set_paused (&server, FALSE);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+  server_wait (&server, STALL_TAGS - dropped);
+  fail_unless_equals_uint64 (server.media_bytes,
+      (STALL_TAGS - dropped) * VIDEO_TAG_SIZE);
+
+  gst_harness_teardown (h);
+  server_stop (&server);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_send_flush)
+{
+  Server server;
+  GstHarness *h;
+  GstSegment segment;
+  guint64 dropped, flushed, sent;
+  guint i;
+
+  server_start (&server, TRUE);
+  h = setup_rtmpsink (&server, TRUE);
+  g_object_set (h->element, "leaky", TRUE, "max-queue-size", LEAKY_QUEUE_SIZE,
+      NULL);
+
+  /* fill the queue until tags get dropped, ending on a delta frame so that
+   * the sink waits for a keyframe */
+  fail_unless_equals_int (gst_harness_push (h, make_flv_header ()),
+      GST_FLOW_OK);
+  for (i = 0; i < STALL_TAGS; i++)
+    fail_unless_equals_int (gst_harness_push (h, make_flv_tag (FLV_TAG_VIDEO,
+                i * 40, VIDEO_TAG_SIZE, i % KEYFRAME_INTERVAL == 0)),
+        GST_FLOW_OK);
+  fail_unless ((STALL_TAGS - 1) % KEYFRAME_INTERVAL != 0);
+  dropped = get_stat (h, "dropped");
+  fail_unless (dropped > 0);
+
+  /* the send thread is stuck writing, what is still queued is thrown away
+   * by the flush */
+  flushed = get_stat (h, "queued-bytes") / (11 + VIDEO_TAG_SIZE + 4);
+  fail_unless (flushed > 0);
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_start ()));
+  fail_unless_equals_uint64 (get_stat (h, "queued-bytes"), 0);
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_stop (TRUE)));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  fail_unless (gst_harness_push_event (h, gst_event_new_segment (&segment)));
+
+  /* a delta frame right after the flush is not dropped */
+  fail_unless_equals_int (gst_harness_push (h, make_flv_tag (FLV_TAG_VIDEO,
+              0, VIDEO_TAG_SIZE, FALSE)), GST_FLOW_OK);
+  fail_unless_equals_uint64 (get_stat (h, "dropped"), dropped);
+
+  server_set_paused (&server, FALSE);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  /* the server reads until the sink disconnects, nothing queued before the
+   * flush showed up */
+  gst_harness_teardown (h);
+  server_stop (&server);
+  sent = STALL_TAGS - dropped - flushed + 1;
+  fail_unless_equals_uint64 (server.n_media, sent);
+  fail_unless_equals_uint64 (server.media_bytes, sent * VIDEO_TAG_SIZE);
+}
+
+GST_END_TEST;
+
+static Suite *
+rtmpsink_suite (void)
+{
+  Suite *s = suite_create ("rtmpsink");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_set_timeout (tc_chain, 60);
+  tcase_add_test (tc_chain, test_send);
+#ifdef TCP_CORK
+  tcase_add_test (tc_chain, test_send_async);
+#endif
+  tcase_add_test (tc_chain, test_send_leaky);
+  tcase_add_test (tc_chain, test_send_flush);
+
+  return s;
+}
+
+GST_CHECK_MAIN (rtmpsink);
@@ -0,0 +1,239 @@
+/*
+ * GStreamer
+ *
+ * unit test for rtph265depay
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/rtp/gstrtpbuffer.h>
+
+/* Main profile, level 6.1, 7680x4320, 64x64 CTBs */
+static const guint8 h265_vps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x40, 0x01, 0x0c, 0x01, 0xff, 0xff, 0x01, 0x60,
+  0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00,
+  0xb7, 0xf0, 0x24
+};
+
+static const guint8 h265_sps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03,
+  0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0xb7, 0xa0, 0x00,
+  0xf0, 0x08, 0x00, 0x43, 0x85, 0x97, 0xe4, 0x93, 0x08, 0x20
+};
+
+static const guint8 h265_pps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x44, 0x01, 0xc0, 0x71, 0x81, 0x12
+};
+
+/* A 4K access unit: a few small slices and a big one, fragmented */
+#define SMALL_SLICES 4
+#define SMALL_SLICE_SIZE 120
+#define BIG_SLICE_SIZE (96 * 1024)
+
+static void
+append_slice (GByteArray * au, guint size, guint8 fill)
+{
+  static const guint8 start_code[] = { 0x00, 0x00, 0x00, 0x01 };
+  guint8 *slice;
+
+  slice = g_malloc (size);
+  memset (slice, fill, size);
+  /* TRAIL_R, nuh_layer_id 0, nuh_temporal_id_plus1 1 */
+  slice[0] = 0x01 << 1;
+  slice[1] = 0x01;
+  slice[size - 1] = 0x80;
+
+  g_byte_array_append (au, start_code, sizeof (start_code));
+  g_byte_array_append (au, slice, size);
+  g_free (slice);
+}
+
+/* Returns the access unit, and the size of everything before the big
+ * slice in @prefix_size */
+static GByteArray *
+make_access_unit (guint frame, guint * prefix_size)
+{
+  GByteArray *au = g_byte_array_new ();
+  guint i;
+
+  g_byte_array_append (au, h265_vps, sizeof (h265_vps));
+  g_byte_array_append (au, h265_sps, sizeof (h265_sps));
+  g_byte_array_append (au, h265_pps, sizeof (h265_pps));
+  for (i = 0; i < SMALL_SLICES; i++)
+    append_slice (au, SMALL_SLICE_SIZE, 0x11 * (i + 1));
+  if (prefix_size)
+    *prefix_size = au->len;
+  append_slice (au, BIG_SLICE_SIZE, 0x55 + frame);
+
+  return au;
+}
+
+/* Payloads @n_frames access units with rtph265pay, and returns the RTP
+ * packets in a list */
+static GList *
+payload_access_units (guint n_frames)
+{
+  GstHarness *pay;
+  GstBuffer *buf;
+  GList *packets = NULL;
+  guint i;
+
+  pay = gst_harness_new ("rtph265pay");
+  gst_harness_set_src_caps_str (pay, "video/x-h265, "
+      "stream-format=(string)byte-stream, alignment=(string)au");
+
+  for (i = 0; i < n_frames; i++) {
+    GByteArray *au = make_access_unit (i, NULL);
+    gsize size = au->len;
+
+    buf = gst_buffer_new_wrapped (g_byte_array_free (au, FALSE), size);
+    GST_BUFFER_PTS (buf) = GST_BUFFER_DTS (buf) = i * GST_SECOND / 30;
+    fail_unless_equals_int (gst_harness_push (pay, buf), GST_FLOW_OK);
+  }
+  fail_unless (gst_harness_push_event (pay, gst_event_new_eos ()));
+
+  while ((buf = gst_harness_try_pull (pay)))
+    packets = g_list_prepend (packets, buf);
+
+  gst_harness_teardown (pay);
+
+  return g_list_reverse (packets);
+}
+
+static GstHarness *
+setup_rtph265depay (void)
+{
+  GstHarness *h;
+
+  h = gst_harness_new ("rtph265depay");
+  gst_harness_set_src_caps_str (h, "application/x-rtp, "
+      "media=(string)video, clock-rate=(int)90000, "
+      "encoding-name=(string)H265");
+  gst_harness_set_sink_caps_str (h, "video/x-h265, "
+      "stream-format=(string)byte-stream, alignment=(string)au");
+
+  return h;
+}
+
+static gboolean
+is_fragmentation_unit (GstBuffer * packet)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *payload;
+  guint8 header = 0;
+
+  fail_unless (gst_rtp_buffer_map (packet, GST_MAP_READ, &rtp));
+  payload = gst_rtp_buffer_get_payload_buffer (&rtp);
+  gst_rtp_buffer_unmap (&rtp);
+
+  gst_buffer_extract (payload, 0, &header, 1);
+  gst_buffer_unref (payload);
+
+  return ((header >> 1) & 0x3f) == 49;
+}
+
+/* Pushes the packets. If @drop is not 0, the fragmentation unit packet with
+ * that index, counting from 0, is lost */
+static void
+push_packets (GstHarness * h, GList * packets, guint drop)
+{
+  GList *l;
+  guint n_fragments = 0;
+
+  for (l = packets; l; l = l->next) {
+    GstBuffer *packet = l->data;
+
+    if (drop && is_fragmentation_unit (packet) &&
+        ++n_fragments == drop + 1) {
+      gst_buffer_unref (packet);
+      continue;
+    }
+    fail_unless_equals_int (gst_harness_push (h, packet), GST_FLOW_OK);
+  }
+  g_list_free (packets);
+}
+
+GST_START_TEST (test_depay_access_unit)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+  GByteArray *au;
+
+  h = setup_rtph265depay ();
+
+  /* the first AU is complete once the second one starts */
+  push_packets (h, payload_access_units (2), 0);
+
+  buf = gst_harness_pull (h);
+  au = make_access_unit (0, NULL);
+  fail_unless_equals_int (gst_buffer_get_size (buf), au->len);
+  fail_unless (gst_buffer_memcmp (buf, 0, au->data, au->len) == 0);
+  fail_if (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_CORRUPTED));
+
+  /* the NAL units are referenced, not merged in one copy */
+  fail_unless (gst_buffer_n_memory (buf) > 1);
+
+  g_byte_array_unref (au);
+  gst_buffer_unref (buf);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_depay_fragment_lost)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+  GByteArray *au;
+  guint prefix_size;
+
+  h = setup_rtph265depay ();
+
+  /* lose a fragment in the middle of the big slice of the first AU */
+  push_packets (h, payload_access_units (2), 10);
+
+  /* the big slice is dropped, the rest of the AU is kept and flagged */
+  buf = gst_harness_pull (h);
+  au = make_access_unit (0, &prefix_size);
+  fail_unless_equals_int (gst_buffer_get_size (buf), prefix_size);
+  fail_unless (gst_buffer_memcmp (buf, 0, au->data, prefix_size) == 0);
+  fail_unless (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_CORRUPTED));
+  g_byte_array_unref (au);
+  gst_buffer_unref (buf);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+rtph265depay_suite (void)
+{
+  Suite *s = suite_create ("rtph265depay");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_depay_access_unit);
+  tcase_add_test (tc_chain, test_depay_fragment_lost);
+
+  return s;
+}
+
+GST_CHECK_MAIN (rtph265depay);
@@ -0,0 +1,342 @@
+/*
+ * GStreamer
+ *
+ * unit test for rtph265pay
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/rtp/gstrtpbuffer.h>
+
+/* Main profile, level 6.1, 7680x4320, 64x64 CTBs */
+static const guint8 h265_vps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x40, 0x01, 0x0c, 0x01, 0xff, 0xff, 0x01, 0x60,
+  0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00,
+  0xb7, 0xf0, 0x24
+};
+
+static const guint8 h265_sps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03,
+  0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0xb7, 0xa0, 0x00,
+  0xf0, 0x08, 0x00, 0x43, 0x85, 0x97, 0xe4, 0x93, 0x08, 0x20
+};
+
+static const guint8 h265_pps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x44, 0x01, 0xc0, 0x71, 0x81, 0x12
+};
+
+#define MTU 1400
+
+/* A 4K access unit: a few small slices, like the static parts of the
+ * picture, and a big one */
+#define SMALL_SLICES 4
+#define SMALL_SLICE_SIZE 120
+#define BIG_SLICE_SIZE (96 * 1024)
+
+#define N_FRAMES 10
+
+static void
+append_slice (GByteArray * au, guint size)
+{
+  static const guint8 start_code[] = { 0x00, 0x00, 0x00, 0x01 };
+  guint8 *slice;
+
+  slice = g_malloc (size);
+  memset (slice, 0x55, size);
+  /* TRAIL_R, nuh_layer_id 0, nuh_temporal_id_plus1 1 */
+  slice[0] = 0x01 << 1;
+  slice[1] = 0x01;
+  slice[size - 1] = 0x80;
+
+  g_byte_array_append (au, start_code, sizeof (start_code));
+  g_byte_array_append (au, slice, size);
+  g_free (slice);
+}
+
+static GstBuffer *
+make_access_unit_full (guint frame, gboolean big_slice)
+{
+  GByteArray *au = g_byte_array_new ();
+  GstBuffer *buf;
+  gsize size;
+  guint i;
+
+  g_byte_array_append (au, h265_vps, sizeof (h265_vps));
+  g_byte_array_append (au, h265_sps, sizeof (h265_sps));
+  g_byte_array_append (au, h265_pps, sizeof (h265_pps));
+  for (i = 0; i < SMALL_SLICES; i++)
+    append_slice (au, SMALL_SLICE_SIZE);
+  if (big_slice)
+    append_slice (au, BIG_SLICE_SIZE);
+
+  size = au->len;
+  buf = gst_buffer_new_wrapped (g_byte_array_free (au, FALSE), size);
+  GST_BUFFER_PTS (buf) = GST_BUFFER_DTS (buf) = frame * GST_SECOND / 30;
+
+  return buf;
+}
+
+static GstBuffer *
+make_access_unit (guint frame)
+{
+  return make_access_unit_full (frame, TRUE);
+}
+
+static GstHarness *
+setup_rtph265pay (gboolean aggregate)
+{
+  GstElement *rtph265pay;
+  GstHarness *h;
+
+  rtph265pay = gst_element_factory_make ("rtph265pay", NULL);
+  g_object_set (rtph265pay, "aggregate", aggregate, "mtu", MTU, NULL);
+
+  h = gst_harness_new_with_element (rtph265pay, "sink", "src");
+  gst_harness_set_src_caps_str (h, "video/x-h265, "
+      "stream-format=(string)byte-stream, alignment=(string)au");
+  gst_object_unref (rtph265pay);
+
+  return h;
+}
+
+static guint8
+get_payload_type (GstBuffer * buf)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  guint8 type;
+
+  fail_unless (gst_rtp_buffer_map (buf, GST_MAP_READ, &rtp));
+  fail_unless (gst_rtp_buffer_get_packet_len (&rtp) <= MTU);
+  type = (((guint8 *) gst_rtp_buffer_get_payload (&rtp))[0] >> 1) & 0x3f;
+  gst_rtp_buffer_unmap (&rtp);
+
+  return type;
+}
+
+static gboolean
+get_marker (GstBuffer * buf)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  gboolean marker;
+
+  fail_unless (gst_rtp_buffer_map (buf, GST_MAP_READ, &rtp));
+  marker = gst_rtp_buffer_get_marker (&rtp);
+  gst_rtp_buffer_unmap (&rtp);
+
+  return marker;
+}
+
+/* Number of fragmentation units of a NAL unit, 3 bytes of headers each */
+static guint
+n_fragments (guint nal_size)
+{
+  guint payload_size = MTU - 12 - 3;
+
+  return (nal_size - 2 + payload_size - 1) / payload_size;
+}
+
+GST_START_TEST (test_aggregate)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  const guint8 *payload;
+  guint payload_len, offset, i, n_packets = 0;
+  guint expected[3 + SMALL_SLICES];
+
+  h = setup_rtph265pay (TRUE);
+
+  fail_unless_equals_int (gst_harness_push (h, make_access_unit (0)),
+      GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  /* the parameter sets and the small slices share one aggregation packet */
+  buf = gst_harness_pull (h);
+  fail_unless_equals_int (get_payload_type (buf), 48);
+  /* the access unit goes on */
+  fail_if (get_marker (buf));
+
+  expected[0] = sizeof (h265_vps) - 4;
+  expected[1] = sizeof (h265_sps) - 4;
+  expected[2] = sizeof (h265_pps) - 4;
+  for (i = 0; i < SMALL_SLICES; i++)
+    expected[3 + i] = SMALL_SLICE_SIZE;
+
+  fail_unless (gst_rtp_buffer_map (buf, GST_MAP_READ, &rtp));
+  payload = gst_rtp_buffer_get_payload (&rtp);
+  payload_len = gst_rtp_buffer_get_payload_len (&rtp);
+  offset = 2;
+  for (i = 0; i < G_N_ELEMENTS (expected); i++) {
+    guint nal_size;
+
+    fail_unless (offset + 2 <= payload_len);
+    nal_size = GST_READ_UINT16_BE (payload + offset);
+    fail_unless_equals_int (nal_size, expected[i]);
+    offset += 2;
+    fail_unless (offset + nal_size <= payload_len);
+    if (i == 0)
+      fail_unless (memcmp (payload + offset, h265_vps + 4, nal_size) == 0);
+    offset += nal_size;
+  }
+  fail_unless_equals_int (offset, payload_len);
+  gst_rtp_buffer_unmap (&rtp);
+  gst_buffer_unref (buf);
+
+  /* the big slice does not fit, it is fragmented and its last fragment
+   * ends the access unit */
+  while ((buf = gst_harness_try_pull (h))) {
+    fail_unless_equals_int (get_payload_type (buf), 49);
+    n_packets++;
+    fail_unless_equals_int (get_marker (buf),
+        n_packets == n_fragments (BIG_SLICE_SIZE));
+    gst_buffer_unref (buf);
+  }
+  fail_unless_equals_int (n_packets, n_fragments (BIG_SLICE_SIZE));
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_aggregate_marker)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+  guint i;
+
+  h = setup_rtph265pay (TRUE);
+
+  /* access units small enough to fit in one aggregation packet each */
+  for (i = 0; i < 2; i++) {
+    fail_unless_equals_int (gst_harness_push (h, make_access_unit_full (i,
+                FALSE)), GST_FLOW_OK);
+
+    buf = gst_harness_pull (h);
+    fail_unless_equals_int (get_payload_type (buf), 48);
+    fail_unless (get_marker (buf));
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), i * GST_SECOND / 30);
+    gst_buffer_unref (buf);
+
+    fail_unless (gst_harness_try_pull (h) == NULL);
+  }
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_fragment_zero_copy)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+  GstMemory *mem;
+  guint n_packets = 0;
+
+  h = setup_rtph265pay (FALSE);
+
+  buf = make_access_unit (0);
+  mem = gst_memory_ref (gst_buffer_peek_memory (buf, 0));
+  fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  /* VPS, SPS, PPS and the small slices are sent one per packet */
+  while ((buf = gst_harness_try_pull (h))) {
+    if (n_packets >= 3 + SMALL_SLICES) {
+      guint n = gst_buffer_n_memory (buf);
+
+      /* the payload of the fragmentation units refers to the input. Check
+       * before mapping the payload, which merges the memories */
+      fail_unless (n >= 2);
+      fail_unless (gst_buffer_peek_memory (buf, n - 1)->parent == mem);
+      fail_unless_equals_int (get_payload_type (buf), 49);
+    }
+    gst_buffer_unref (buf);
+    n_packets++;
+  }
+  fail_unless_equals_int (n_packets,
+      3 + SMALL_SLICES + n_fragments (BIG_SLICE_SIZE));
+
+  gst_memory_unref (mem);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* Returns the number of packets sent for @n_frames access units */
+static guint
+run_rtph265pay (gboolean aggregate, guint n_frames)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+  guint i, n_packets = 0;
+
+  h = setup_rtph265pay (aggregate);
+
+  for (i = 0; i < n_frames; i++) {
+    fail_unless_equals_int (gst_harness_push (h, make_access_unit (i)),
+        GST_FLOW_OK);
+    /* don't let the packets pile up in the harness */
+    while ((buf = gst_harness_try_pull (h))) {
+      gst_buffer_unref (buf);
+      n_packets++;
+    }
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  while ((buf = gst_harness_try_pull (h))) {
+    gst_buffer_unref (buf);
+    n_packets++;
+  }
+
+  gst_harness_teardown (h);
+
+  return n_packets;
+}
+
+GST_START_TEST (test_aggregate_packet_count)
+{
+  guint n;
+
+  n = run_rtph265pay (FALSE, N_FRAMES);
+  fail_unless_equals_int (n,
+      N_FRAMES * (3 + SMALL_SLICES + n_fragments (BIG_SLICE_SIZE)));
+
+  n = run_rtph265pay (TRUE, N_FRAMES);
+  fail_unless_equals_int (n, N_FRAMES * (1 + n_fragments (BIG_SLICE_SIZE)));
+}
+
+GST_END_TEST;
+
+static Suite *
+rtph265pay_suite (void)
+{
+  Suite *s = suite_create ("rtph265pay");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_aggregate);
+  tcase_add_test (tc_chain, test_aggregate_marker);
+  tcase_add_test (tc_chain, test_fragment_zero_copy);
+  tcase_add_test (tc_chain, test_aggregate_packet_count);
+
+  return s;
+}
+
+GST_CHECK_MAIN (rtph265pay);
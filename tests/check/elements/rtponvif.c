@@ -40,6 +40,8 @@ static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
 #define NTP_OFFSET (guint64) 1245
 #define TIMESTAMP 42
 
+#define PAYLOAD_SIZE 1400
+
 static void
 setup_element (GstElement * element)
 {
@@ -197,6 +199,52 @@ create_extension_buffer (GstBuffer * buffer_in, gboolean clean_point,
   return buffer_out;
 }
 
+/* Create a RTP buffer with the header and the payload in separate
+ * memories, like payloaders output them, and the payload memory in
+ * @payload_mem */
+static GstBuffer *
+create_rtp_buffer_with_payload (guint64 timestamp, GstMemory ** payload_mem)
+{
+  GstBuffer *buf;
+  GstMemory *mem;
+
+  buf = gst_rtp_buffer_new_allocate (0, 0, 0);
+  buf->pts = timestamp;
+
+  mem = gst_allocator_alloc (NULL, PAYLOAD_SIZE, NULL);
+  gst_memory_memset (mem, 0, 0x55, PAYLOAD_SIZE);
+  gst_buffer_append_memory (buf, mem);
+  if (payload_mem)
+    *payload_mem = mem;
+
+  return buf;
+}
+
+static void
+push_segment (void)
+{
+  GstSegment segment;
+
+  fail_unless (gst_pad_push_event (mysrcpad,
+          gst_event_new_stream_start ("test")));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_segment (&segment)));
+}
+
+static guint8
+get_extension_flags (GstBuffer * buf)
+{
+  guint8 ext[16];
+
+  fail_unless_equals_int (gst_buffer_extract (buf, 12, ext, 16), 16);
+  fail_unless_equals_int (GST_READ_UINT16_BE (ext), 0xABAC);
+  fail_unless_equals_int (GST_READ_UINT16_BE (ext + 2), 3);
+  fail_unless_equals_uint64 (GST_READ_UINT64_BE (ext + 4),
+      convert_to_ntp (TIMESTAMP + NTP_OFFSET));
+
+  return ext[12];
+}
+
 static void
 do_one_buffer_test_apply (gboolean clean_point, gboolean discont)
 {
@@ -325,6 +373,115 @@ GST_START_TEST (test_apply_e_bit)
 
 GST_END_TEST;
 
+GST_START_TEST (test_apply_payload_not_copied)
+{
+  GstElement *apply;
+  GstBuffer *buf;
+  GstMemory *payload_mem;
+  guint n;
+
+  apply = setup_rtponviftimestamp (FALSE);
+  push_segment ();
+
+  buf = create_rtp_buffer_with_payload (TIMESTAMP, &payload_mem);
+  gst_memory_ref (payload_mem);
+  fail_unless (gst_pad_push (mysrcpad, buf) == GST_FLOW_OK);
+
+  /* a new header was put in front of the same payload memory */
+  g_assert_cmpuint (g_list_length (buffers), ==, 1);
+  buf = buffers->data;
+  n = gst_buffer_n_memory (buf);
+  fail_unless (n >= 2);
+  fail_unless (gst_buffer_peek_memory (buf, n - 1) == payload_mem);
+  fail_unless_equals_int (gst_buffer_get_size (buf), 12 + 16 + PAYLOAD_SIZE);
+  get_extension_flags (buf);
+
+  gst_memory_unref (payload_mem);
+  g_list_foreach (buffers, (GFunc) gst_mini_object_unref, NULL);
+  g_list_free (buffers);
+  buffers = NULL;
+
+  cleanup_rtponviftimestamp (apply);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_apply_in_place)
+{
+  GstElement *apply;
+  GstBuffer *buf;
+  GstMemory *mem;
+  GstMapInfo map;
+
+  apply = setup_rtponviftimestamp (FALSE);
+  push_segment ();
+
+  /* a packet with room for the extension already */
+  buf = gst_buffer_new_allocate (NULL, 12 + 16 + 4, NULL);
+  gst_buffer_memset (buf, 0, 0, 12 + 16 + 4);
+  fail_unless (gst_buffer_map (buf, &map, GST_MAP_WRITE));
+  map.data[0] = 0x90;
+  map.data[1] = 96;
+  GST_WRITE_UINT16_BE (map.data + 12, 0xABAC);
+  GST_WRITE_UINT16_BE (map.data + 14, 3);
+  gst_buffer_unmap (buf, &map);
+  buf->pts = TIMESTAMP;
+  mem = gst_memory_ref (gst_buffer_peek_memory (buf, 0));
+
+  fail_unless (gst_pad_push (mysrcpad, buf) == GST_FLOW_OK);
+
+  g_assert_cmpuint (g_list_length (buffers), ==, 1);
+  buf = buffers->data;
+  fail_unless_equals_int (gst_buffer_n_memory (buf), 1);
+  fail_unless (gst_buffer_peek_memory (buf, 0) == mem);
+  fail_unless_equals_int (get_extension_flags (buf), 1 << 7);
+
+  gst_memory_unref (mem);
+  g_list_foreach (buffers, (GFunc) gst_mini_object_unref, NULL);
+  g_list_free (buffers);
+  buffers = NULL;
+
+  cleanup_rtponviftimestamp (apply);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_apply_list)
+{
+  GstElement *apply;
+  GstBufferList *list;
+  GstBuffer *buf;
+  guint8 header[1];
+  guint i;
+
+  apply = setup_rtponviftimestamp (FALSE);
+  push_segment ();
+
+  list = gst_buffer_list_new ();
+  for (i = 0; i < 3; i++)
+    gst_buffer_list_add (list, create_rtp_buffer_with_payload (TIMESTAMP,
+            NULL));
+  fail_unless (gst_pad_push_list (mysrcpad, list) == GST_FLOW_OK);
+
+  /* only the first packet of the list gets the extension */
+  g_assert_cmpuint (g_list_length (buffers), ==, 3);
+  get_extension_flags (buffers->data);
+  for (i = 1; i < 3; i++) {
+    buf = g_list_nth_data (buffers, i);
+    fail_unless_equals_int (gst_buffer_get_size (buf), 12 + PAYLOAD_SIZE);
+    gst_buffer_extract (buf, 0, header, 1);
+    fail_if (header[0] & 0x10);
+  }
+
+  g_list_foreach (buffers, (GFunc) gst_mini_object_unref, NULL);
+  g_list_free (buffers);
+  buffers = NULL;
+
+  cleanup_rtponviftimestamp (apply);
+}
+
+GST_END_TEST;
+
 static GstElement *
 setup_rtponvifparse (gboolean set_e_bit)
 {
@@ -413,6 +570,41 @@ GST_START_TEST (test_parse_discont)
 
 GST_END_TEST;
 
+GST_START_TEST (test_parse_list)
+{
+  GstElement *parse;
+  GstBufferList *list;
+  GstBuffer *rtp, *buf;
+
+  parse = setup_rtponvifparse (FALSE);
+  push_segment ();
+
+  list = gst_buffer_list_new ();
+  rtp = gst_rtp_buffer_new_allocate (4, 0, 0);
+  gst_buffer_list_add (list, create_extension_buffer (rtp, TRUE, FALSE,
+          FALSE));
+  gst_buffer_list_add (list, create_extension_buffer (rtp, FALSE, FALSE,
+          TRUE));
+  gst_buffer_unref (rtp);
+  fail_unless (gst_pad_push_list (mysrcpad, list) == GST_FLOW_OK);
+
+  g_assert_cmpuint (g_list_length (buffers), ==, 2);
+  buf = buffers->data;
+  fail_if (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT));
+  fail_if (GST_BUFFER_IS_DISCONT (buf));
+  buf = buffers->next->data;
+  fail_unless (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT));
+  fail_unless (GST_BUFFER_IS_DISCONT (buf));
+
+  g_list_foreach (buffers, (GFunc) gst_mini_object_unref, NULL);
+  g_list_free (buffers);
+  buffers = NULL;
+
+  cleanup_rtponvifparse (parse);
+}
+
+GST_END_TEST;
+
 static Suite *
 onviftimestamp_suite (void)
 {
@@ -426,12 +618,16 @@ onviftimestamp_suite (void)
   tcase_add_test (tc_chain, test_apply_clean_point);
   tcase_add_test (tc_chain, test_apply_no_e_bit);
   tcase_add_test (tc_chain, test_apply_e_bit);
+  tcase_add_test (tc_chain, test_apply_payload_not_copied);
+  tcase_add_test (tc_chain, test_apply_in_place);
+  tcase_add_test (tc_chain, test_apply_list);
 
   tc_chain = tcase_create ("parse");
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_parse_no_flag);
   tcase_add_test (tc_chain, test_parse_clean_point);
   tcase_add_test (tc_chain, test_parse_discont);
+  tcase_add_test (tc_chain, test_parse_list);
 
   return s;
 }
@@ -0,0 +1,298 @@
+/* GStreamer unit test for sdpdemux
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "../../gst/sdp/gstsdpdemux.c"
+#undef GST_CAT_DEFAULT
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#define RTP_PACKET_SIZE 32
+
+/* the video stream has its own bandwidth, the first audio stream too, in
+ * another unit, the second one only has a type that doesn't apply and
+ * gets the session bandwidth */
+static const gchar sdp_text[] =
+    "v=0\r\n"
+    "o=- 0 0 IN IP4 127.0.0.1\r\n"
+    "s=test\r\n"
+    "c=IN IP4 127.0.0.1\r\n"
+    "b=AS:2000\r\n"
+    "t=0 0\r\n"
+    "m=video 5000 RTP/AVP 96\r\n"
+    "b=TIAS:1500000\r\n"
+    "a=rtpmap:96 H264/90000\r\n"
+    "m=audio 5002 RTP/AVP 97\r\n"
+    "b=AS:64\r\n"
+    "a=rtpmap:97 L16/8000\r\n"
+    "m=audio 5004 RTP/AVP 98\r\n"
+    "b=RR:800\r\n"
+    "a=rtpmap:98 L16/8000\r\n";
+
+static GstSDPDemux *demux;
+static GstSDPMessage *sdp;
+
+static void
+setup_demux (void)
+{
+  guint i;
+
+  demux = g_object_new (GST_TYPE_SDP_DEMUX, NULL);
+  gst_object_ref_sink (demux);
+
+  fail_unless_equals_int (gst_sdp_message_new (&sdp), GST_SDP_OK);
+  fail_unless_equals_int (gst_sdp_message_parse_buffer ((const guint8 *)
+          sdp_text, strlen (sdp_text), sdp), GST_SDP_OK);
+
+  for (i = 0; i < gst_sdp_message_medias_len (sdp); i++)
+    fail_unless (gst_sdp_demux_create_stream (demux, sdp, i) != NULL);
+}
+
+static void
+teardown_demux (void)
+{
+  gst_sdp_demux_cleanup (demux);
+  gst_object_unref (demux);
+  gst_sdp_message_free (sdp);
+}
+
+static GstSDPStream *
+get_stream (guint idx)
+{
+  GstSDPStream *stream = g_list_nth_data (demux->streams, idx);
+
+  fail_unless (stream != NULL);
+
+  return stream;
+}
+
+/* The buffers pushed into the harness go through the probe the demuxer
+ * puts on the RTP udpsrc */
+static GstHarness *
+setup_probe (GstSDPStream * stream)
+{
+  GstHarness *h = gst_harness_new ("identity");
+
+  gst_harness_set_src_caps_str (h, "application/x-rtp");
+  gst_pad_add_probe (h->srcpad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      gst_sdp_demux_stream_probe, stream, NULL);
+
+  return h;
+}
+
+static GstBuffer *
+make_rtp (guint16 seq)
+{
+  guint8 *data = g_malloc0 (RTP_PACKET_SIZE);
+
+  data[0] = 0x80;
+  data[1] = 96;
+  GST_WRITE_UINT16_BE (data + 2, seq);
+
+  return gst_buffer_new_wrapped (data, RTP_PACKET_SIZE);
+}
+
+static void
+push_seqs (GstHarness * h, const guint16 * seqs, guint n_seqs)
+{
+  guint i;
+
+  for (i = 0; i < n_seqs; i++)
+    fail_unless_equals_int (gst_harness_push (h, make_rtp (seqs[i])),
+        GST_FLOW_OK);
+}
+
+static guint64
+get_stat (guint idx, const gchar * field)
+{
+  GstStructure *stats;
+  const GValue *streams;
+  const GstStructure *s;
+  guint64 value;
+
+  g_object_get (demux, "stats", &stats, NULL);
+  fail_unless (gst_structure_has_name (stats, "application/x-sdp-demux-stats"));
+  streams = gst_structure_get_value (stats, "streams");
+  fail_unless_equals_int (gst_value_array_get_size (streams),
+      g_list_length (demux->streams));
+  s = gst_value_get_structure (gst_value_array_get_value (streams, idx));
+  fail_unless (gst_structure_get_uint64 (s, field, &value));
+  gst_structure_free (stats);
+
+  return value;
+}
+
+GST_START_TEST (test_stats_gaps)
+{
+  static const guint16 seqs[] = { 0, 1, 2, 5, 6 };
+  GstBufferList *list;
+  GstHarness *h;
+
+  setup_demux ();
+  h = setup_probe (get_stream (0));
+
+  push_seqs (h, seqs, G_N_ELEMENTS (seqs));
+  fail_unless_equals_uint64 (get_stat (0, "packets"), 5);
+  fail_unless_equals_uint64 (get_stat (0, "lost"), 2);
+
+  /* buffer lists are counted too */
+  list = gst_buffer_list_new ();
+  gst_buffer_list_add (list, make_rtp (7));
+  gst_buffer_list_add (list, make_rtp (9));
+  fail_unless_equals_int (gst_pad_push_list (h->srcpad, list), GST_FLOW_OK);
+
+  fail_unless_equals_uint64 (get_stat (0, "packets"), 7);
+  fail_unless_equals_uint64 (get_stat (0, "bytes"), 7 * RTP_PACKET_SIZE);
+  fail_unless_equals_uint64 (get_stat (0, "lost"), 3);
+
+  /* the other streams saw nothing */
+  fail_unless_equals_uint64 (get_stat (1, "packets"), 0);
+  fail_unless_equals_uint64 (get_stat (2, "packets"), 0);
+
+  gst_harness_teardown (h);
+  teardown_demux ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_stats_wrap)
+{
+  static const guint16 seqs[] = { 65534, 65535, 0, 2 };
+  GstHarness *h;
+
+  setup_demux ();
+  h = setup_probe (get_stream (0));
+
+  push_seqs (h, seqs, G_N_ELEMENTS (seqs));
+  fail_unless_equals_uint64 (get_stat (0, "packets"), 4);
+  fail_unless_equals_uint64 (get_stat (0, "lost"), 1);
+
+  gst_harness_teardown (h);
+  teardown_demux ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_stats_late)
+{
+  /* 12 arrives late, 13 twice */
+  static const guint16 seqs[] = { 10, 11, 13, 12, 13, 14, 15 };
+  GstHarness *h;
+
+  setup_demux ();
+  h = setup_probe (get_stream (0));
+
+  push_seqs (h, seqs, G_N_ELEMENTS (seqs));
+  fail_unless_equals_uint64 (get_stat (0, "packets"), 7);
+  fail_unless_equals_uint64 (get_stat (0, "lost"), 1);
+
+  gst_harness_teardown (h);
+  teardown_demux ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_stats_restart)
+{
+  /* the sender restarts forwards beyond the dropout limit, then backwards
+   * beyond the misorder limit but not enough to look like a wrap */
+  static const guint16 seqs[] = { 100, 101, 5000, 5001, 1000, 1001, 1003 };
+  GstHarness *h;
+
+  setup_demux ();
+  h = setup_probe (get_stream (0));
+
+  push_seqs (h, seqs, G_N_ELEMENTS (seqs));
+  fail_unless_equals_uint64 (get_stat (0, "packets"), 7);
+  fail_unless_equals_uint64 (get_stat (0, "lost"), 1);
+
+  /* not RTP, counted as received but without a sequence number */
+  fail_unless_equals_int (gst_harness_push (h,
+          gst_buffer_new_allocate (NULL, 2, NULL)), GST_FLOW_OK);
+  fail_unless_equals_int (gst_harness_push (h, make_rtp (1004)), GST_FLOW_OK);
+  fail_unless_equals_uint64 (get_stat (0, "packets"), 9);
+  fail_unless_equals_uint64 (get_stat (0, "lost"), 1);
+
+  gst_harness_teardown (h);
+  teardown_demux ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_bandwidth)
+{
+  setup_demux ();
+
+  /* TIAS as is, AS in kbit/s, else the session bandwidth */
+  fail_unless_equals_uint64 (get_stream (0)->bandwidth, 1500000);
+  fail_unless_equals_uint64 (get_stream (1)->bandwidth, 64000);
+  fail_unless_equals_uint64 (get_stream (2)->bandwidth, 2000000);
+  fail_unless_equals_uint64 (get_stat (1, "bandwidth"), 64000);
+
+  teardown_demux ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_udp_buffer_size)
+{
+  setup_demux ();
+
+  /* the system default unless asked for */
+  fail_unless_equals_int (gst_sdp_demux_udp_buffer_size (demux,
+          get_stream (0)), 0);
+
+  g_object_set (demux, "udp-buffer-time", 500, NULL);
+  fail_unless_equals_int (gst_sdp_demux_udp_buffer_size (demux,
+          get_stream (0)), 1500000 / 8 / 2);
+  fail_unless_equals_int (gst_sdp_demux_udp_buffer_size (demux,
+          get_stream (1)), 64000 / 8 / 2);
+
+  /* nothing to size it from */
+  get_stream (2)->bandwidth = 0;
+  fail_unless_equals_int (gst_sdp_demux_udp_buffer_size (demux,
+          get_stream (2)), 0);
+
+  g_object_set (demux, "udp-buffer-time", G_MAXUINT, NULL);
+  fail_unless_equals_int (gst_sdp_demux_udp_buffer_size (demux,
+          get_stream (0)), G_MAXINT);
+
+  teardown_demux ();
+}
+
+GST_END_TEST;
+
+static Suite *
+sdpdemux_suite (void)
+{
+  Suite *s = suite_create ("sdpdemux");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_stats_gaps);
+  tcase_add_test (tc_chain, test_stats_wrap);
+  tcase_add_test (tc_chain, test_stats_late);
+  tcase_add_test (tc_chain, test_stats_restart);
+  tcase_add_test (tc_chain, test_bandwidth);
+  tcase_add_test (tc_chain, test_udp_buffer_size);
+
+  return s;
+}
+
+GST_CHECK_MAIN (sdpdemux);
@@ -0,0 +1,300 @@
+/*
+ * GStreamer
+ *
+ * unit test for srtpenc and srtpdec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/rtp/gstrtpbuffer.h>
+
+/* AES-128-ICM: 16 bytes of key and 14 bytes of salt */
+#define KEY_SIZE 30
+
+#define PAYLOAD_SIZE 160
+#define FIRST_SSRC 0x1000
+
+#define N_SSRCS 32
+#define N_ROUNDS 20
+
+/* more than the room srtpenc needs after a packet for the trailer */
+#define SPARE_ROOM 64
+
+static GstBuffer *
+make_key (void)
+{
+  GstBuffer *key = gst_buffer_new_allocate (NULL, KEY_SIZE, NULL);
+  GstMapInfo map;
+  guint i;
+
+  gst_buffer_map (key, &map, GST_MAP_WRITE);
+  for (i = 0; i < map.size; i++)
+    map.data[i] = i * 7;
+  gst_buffer_unmap (key, &map);
+
+  return key;
+}
+
+static GstBuffer *
+make_rtp_packet (guint32 ssrc, guint16 seq)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *buf;
+  guint8 *payload;
+  guint i;
+
+  buf = gst_rtp_buffer_new_allocate (PAYLOAD_SIZE, 0, 0);
+  gst_rtp_buffer_map (buf, GST_MAP_WRITE, &rtp);
+  gst_rtp_buffer_set_payload_type (&rtp, 96);
+  gst_rtp_buffer_set_ssrc (&rtp, ssrc);
+  gst_rtp_buffer_set_seq (&rtp, seq);
+  gst_rtp_buffer_set_timestamp (&rtp, seq * 160);
+  payload = gst_rtp_buffer_get_payload (&rtp);
+  for (i = 0; i < PAYLOAD_SIZE; i++)
+    payload[i] = ssrc + seq + i;
+  gst_rtp_buffer_unmap (&rtp);
+
+  return buf;
+}
+
+/* Same as make_rtp_packet(), in @data of @size bytes, which the buffer
+ * does not own */
+static GstBuffer *
+make_rtp_packet_in (guint8 * data, gsize size, guint32 ssrc, guint16 seq)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *buf;
+  guint8 *payload;
+  guint i;
+
+  memset (data, 0, size);
+  /* version 2 */
+  data[0] = 0x80;
+  buf = gst_buffer_new_wrapped_full (0, data, size, 0, 12 + PAYLOAD_SIZE,
+      NULL, NULL);
+  fail_unless (gst_rtp_buffer_map (buf, GST_MAP_WRITE, &rtp));
+  gst_rtp_buffer_set_payload_type (&rtp, 96);
+  gst_rtp_buffer_set_ssrc (&rtp, ssrc);
+  gst_rtp_buffer_set_seq (&rtp, seq);
+  gst_rtp_buffer_set_timestamp (&rtp, seq * 160);
+  payload = gst_rtp_buffer_get_payload (&rtp);
+  for (i = 0; i < PAYLOAD_SIZE; i++)
+    payload[i] = ssrc + seq + i;
+  gst_rtp_buffer_unmap (&rtp);
+
+  return buf;
+}
+
+static GstCaps *
+request_key (GstElement * srtpdec, guint ssrc, GstBuffer * key)
+{
+  return gst_caps_new_simple ("application/x-srtp",
+      "srtp-key", GST_TYPE_BUFFER, key,
+      "srtp-cipher", G_TYPE_STRING, "aes-128-icm",
+      "srtp-auth", G_TYPE_STRING, "hmac-sha1-80",
+      "srtcp-cipher", G_TYPE_STRING, "aes-128-icm",
+      "srtcp-auth", G_TYPE_STRING, "hmac-sha1-80", NULL);
+}
+
+/* Checks that the packets of each SSRC come in order, and the payload if
+ * the packets are not protected */
+static void
+check_packet (GstBuffer * buf, guint16 * next_seq, gboolean protected)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  guint32 ssrc;
+  guint16 seq;
+
+  fail_unless (gst_rtp_buffer_map (buf, GST_MAP_READ, &rtp));
+  ssrc = gst_rtp_buffer_get_ssrc (&rtp);
+  seq = gst_rtp_buffer_get_seq (&rtp);
+
+  fail_unless (ssrc >= FIRST_SSRC && ssrc - FIRST_SSRC < N_SSRCS);
+  fail_unless_equals_int (seq, next_seq[ssrc - FIRST_SSRC]);
+  next_seq[ssrc - FIRST_SSRC]++;
+
+  if (protected) {
+    fail_unless (gst_buffer_get_size (buf) > 12 + PAYLOAD_SIZE);
+  } else {
+    guint8 *payload = gst_rtp_buffer_get_payload (&rtp);
+    guint i;
+
+    fail_unless_equals_int (gst_rtp_buffer_get_payload_len (&rtp),
+        PAYLOAD_SIZE);
+    for (i = 0; i < PAYLOAD_SIZE; i++)
+      fail_unless_equals_int (payload[i], (guint8) (ssrc + seq + i));
+  }
+
+  gst_rtp_buffer_unmap (&rtp);
+}
+
+/* Protects @n_rounds buffer lists of one packet per SSRC, like a gateway
+ * sending to many peers, then unprotects them */
+static void
+run_roundtrip (guint shards, guint n_ssrcs, guint n_rounds)
+{
+  GstElement *srtpenc, *srtpdec;
+  GstHarness *enc, *dec;
+  GstBuffer *key, *buf;
+  guint16 next_seq[N_SSRCS] = { 0, };
+  guint i, j, n_out = 0;
+
+  key = make_key ();
+
+  srtpenc = gst_element_factory_make ("srtpenc", NULL);
+  g_object_set (srtpenc, "key", key, "shards", shards, NULL);
+  enc = gst_harness_new_with_element (srtpenc, "rtp_sink_0", "rtp_src_0");
+  gst_harness_set_src_caps_str (enc, "application/x-rtp");
+
+  srtpdec = gst_element_factory_make ("srtpdec", NULL);
+  g_object_set (srtpdec, "shards", shards, NULL);
+  g_signal_connect (srtpdec, "request-key", G_CALLBACK (request_key), key);
+  dec = gst_harness_new_with_element (srtpdec, "rtp_sink", "rtp_src");
+  gst_harness_set_src_caps_str (dec, "application/x-srtp");
+
+  for (i = 0; i < n_rounds; i++) {
+    GstBufferList *list = gst_buffer_list_new_sized (n_ssrcs);
+
+    for (j = 0; j < n_ssrcs; j++)
+      gst_buffer_list_add (list, make_rtp_packet (FIRST_SSRC + j, i));
+    fail_unless_equals_int (gst_pad_push_list (enc->srcpad, list),
+        GST_FLOW_OK);
+  }
+
+  while ((buf = gst_harness_try_pull (enc))) {
+    check_packet (buf, next_seq, TRUE);
+    fail_unless_equals_int (gst_harness_push (dec, buf), GST_FLOW_OK);
+  }
+
+  memset (next_seq, 0, sizeof (next_seq));
+  while ((buf = gst_harness_try_pull (dec))) {
+    check_packet (buf, next_seq, FALSE);
+    gst_buffer_unref (buf);
+    n_out++;
+  }
+  fail_unless_equals_int (n_out, n_ssrcs * n_rounds);
+
+  gst_harness_teardown (enc);
+  gst_harness_teardown (dec);
+  gst_object_unref (srtpenc);
+  gst_object_unref (srtpdec);
+  gst_buffer_unref (key);
+}
+
+GST_START_TEST (test_roundtrip)
+{
+  run_roundtrip (1, N_SSRCS, N_ROUNDS);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_roundtrip_sharded)
+{
+  run_roundtrip (4, N_SSRCS, N_ROUNDS);
+  /* more shards than SSRCs */
+  run_roundtrip (8, 3, N_ROUNDS);
+}
+
+GST_END_TEST;
+
+/* Packets with room for the trailer after them are protected in their own
+ * memory, the others are copied */
+GST_START_TEST (test_protect_in_place)
+{
+  const gsize packet_size = 12 + PAYLOAD_SIZE;
+  GstElement *srtpenc;
+  GstHarness *enc;
+  GstBuffer *key, *buf;
+  GstBufferList *list;
+  GstMapInfo map;
+  guint8 *data[N_SSRCS + 1];
+  guint16 next_seq[N_SSRCS] = { 0, };
+  guint i;
+
+  key = make_key ();
+  srtpenc = gst_element_factory_make ("srtpenc", NULL);
+  g_object_set (srtpenc, "key", key, "shards", 4, NULL);
+  enc = gst_harness_new_with_element (srtpenc, "rtp_sink_0", "rtp_src_0");
+  gst_harness_set_src_caps_str (enc, "application/x-rtp");
+
+  for (i = 0; i < G_N_ELEMENTS (data); i++)
+    data[i] = g_malloc (packet_size + SPARE_ROOM);
+
+  /* single buffers */
+  buf = make_rtp_packet_in (data[0], packet_size + SPARE_ROOM, FIRST_SSRC, 0);
+  fail_unless_equals_int (gst_harness_push (enc, buf), GST_FLOW_OK);
+  buf = gst_harness_pull (enc);
+  check_packet (buf, next_seq, TRUE);
+  fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+  fail_unless (map.data == data[0]);
+  fail_unless (map.size > packet_size);
+  gst_buffer_unmap (buf, &map);
+  gst_buffer_unref (buf);
+
+  /* no room left, protected in a new buffer */
+  buf = make_rtp_packet_in (data[0], packet_size, FIRST_SSRC, 1);
+  fail_unless_equals_int (gst_harness_push (enc, buf), GST_FLOW_OK);
+  buf = gst_harness_pull (enc);
+  check_packet (buf, next_seq, TRUE);
+  fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+  fail_if (map.data == data[0]);
+  gst_buffer_unmap (buf, &map);
+  gst_buffer_unref (buf);
+
+  /* buffer lists, spread over the shards */
+  list = gst_buffer_list_new_sized (N_SSRCS);
+  for (i = 0; i < N_SSRCS; i++)
+    gst_buffer_list_add (list, make_rtp_packet_in (data[i + 1],
+            packet_size + SPARE_ROOM, FIRST_SSRC + i, i == 0 ? 2 : 0));
+  fail_unless_equals_int (gst_pad_push_list (enc->srcpad, list), GST_FLOW_OK);
+
+  for (i = 0; i < N_SSRCS; i++) {
+    buf = gst_harness_pull (enc);
+    check_packet (buf, next_seq, TRUE);
+    fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+    fail_unless (map.data == data[i + 1]);
+    gst_buffer_unmap (buf, &map);
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (enc);
+  gst_object_unref (srtpenc);
+  gst_buffer_unref (key);
+  for (i = 0; i < G_N_ELEMENTS (data); i++)
+    g_free (data[i]);
+}
+
+GST_END_TEST;
+
+static Suite *
+srtp_suite (void)
+{
+  Suite *s = suite_create ("srtp");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_roundtrip);
+  tcase_add_test (tc_chain, test_roundtrip_sharded);
+  tcase_add_test (tc_chain, test_protect_in_place);
+
+  return s;
+}
+
+GST_CHECK_MAIN (srtp);
@@ -0,0 +1,142 @@
+/*
+ * GStreamer
+ *
+ * unit test for vc1parse
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+/* Advanced profile, level 2, 1920x1080 */
+static const guint8 vc1_seq_hdr[] = {
+  0x00, 0x00, 0x01, 0x0f, 0xd2, 0x00, 0x3b, 0xf2, 0x1b, 0x08, 0x80
+};
+
+static const guint8 vc1_entrypoint[] = {
+  0x00, 0x00, 0x01, 0x0e, 0x5a, 0xc7, 0xf9, 0xc8, 0x80
+};
+
+#define FRAME_DATA_SIZE (256 * 1024)
+#define FRAMES_PER_ENTRYPOINT 15
+
+#define N_FRAMES 30
+
+/* sized like what a demuxer or filesrc would push */
+#define CHUNK_SIZE 4096
+
+/* BDU stream with the sequence header and entrypoint repeated every
+ * FRAMES_PER_ENTRYPOINT frames. The frame data is filler */
+static GByteArray *
+make_bdu_stream (guint n_frames, guint * n_bdus)
+{
+  GByteArray *stream = g_byte_array_new ();
+  guint8 *frame_data;
+  guint i;
+
+  frame_data = g_malloc (FRAME_DATA_SIZE);
+  memset (frame_data, 0x55, FRAME_DATA_SIZE);
+  frame_data[0] = 0x00;
+  frame_data[1] = 0x00;
+  frame_data[2] = 0x01;
+  frame_data[3] = 0x0d;
+
+  *n_bdus = 0;
+  for (i = 0; i < n_frames; i++) {
+    if (i % FRAMES_PER_ENTRYPOINT == 0) {
+      g_byte_array_append (stream, vc1_seq_hdr, sizeof (vc1_seq_hdr));
+      g_byte_array_append (stream, vc1_entrypoint, sizeof (vc1_entrypoint));
+      *n_bdus += 2;
+    }
+    g_byte_array_append (stream, frame_data, FRAME_DATA_SIZE);
+    (*n_bdus)++;
+  }
+
+  g_free (frame_data);
+
+  return stream;
+}
+
+/* Pushes the stream in CHUNK_SIZE buffers and checks that each BDU comes
+ * out as is */
+static void
+run_vc1parse (guint n_frames)
+{
+  GstHarness *h;
+  GByteArray *stream;
+  GstBuffer *buf;
+  guint n_bdus, n_out = 0;
+  gsize off, out_off = 0;
+
+  h = gst_harness_new ("vc1parse");
+  gst_harness_set_src_caps_str (h, "video/x-wmv, wmvversion=(int)3, "
+      "format=(string)WVC1, stream-format=(string)bdu, "
+      "header-format=(string)none");
+  gst_harness_set_sink_caps_str (h, "video/x-wmv, wmvversion=(int)3, "
+      "format=(string)WVC1, stream-format=(string)bdu, "
+      "header-format=(string)none");
+
+  stream = make_bdu_stream (n_frames, &n_bdus);
+
+  for (off = 0; off < stream->len; off += CHUNK_SIZE) {
+    gsize size = MIN (CHUNK_SIZE, stream->len - off);
+
+    buf = gst_buffer_new_allocate (NULL, size, NULL);
+    gst_buffer_fill (buf, 0, stream->data + off, size);
+    fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  while ((buf = gst_harness_try_pull (h))) {
+    gsize size = gst_buffer_get_size (buf);
+
+    fail_unless (out_off + size <= stream->len);
+    fail_unless (gst_buffer_memcmp (buf, 0, stream->data + out_off,
+            size) == 0);
+    out_off += size;
+    n_out++;
+    gst_buffer_unref (buf);
+  }
+  fail_unless_equals_int (n_out, n_bdus);
+  fail_unless_equals_uint64 (out_off, stream->len);
+
+  g_byte_array_unref (stream);
+  gst_harness_teardown (h);
+}
+
+GST_START_TEST (test_parse_bdu_chunked)
+{
+  run_vc1parse (N_FRAMES);
+}
+
+GST_END_TEST;
+
+static Suite *
+vc1parse_suite (void)
+{
+  Suite *s = suite_create ("vc1parse");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_parse_bdu_chunked);
+
+  return s;
+}
+
+GST_CHECK_MAIN (vc1parse);
@@ -0,0 +1,239 @@
+/* GStreamer
+ *
+ * unit test for the GstAdaptiveDemux bitrate estimation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/adaptivedemux/gstadaptivedemuxabr.h>
+
+/* Representations available in the simulated manifest, in bits per second */
+static const guint64 ladder[] = {
+  250000, 500000, 1000000, 2000000, 4000000
+};
+
+#define FRAGMENT_DURATION (2 * GST_SECOND)
+#define MAX_BUFFER_LEVEL (30 * GST_SECOND)
+#define BITRATE_LIMIT 0.8
+
+/* Bandwidth traces, one entry per downloaded fragment, repeated */
+static const guint64 oscillating_trace[] = { 3000000, 1200000 };
+
+static const guint64 drop_trace[] = {
+  5500000, 5500000, 5500000, 5500000, 5500000, 5500000, 5500000, 5500000,
+  5500000, 5500000,
+  900000, 900000, 900000, 900000, 900000, 900000, 900000, 900000,
+  900000, 900000, 900000, 900000, 900000, 900000, 900000, 900000,
+  900000, 900000, 900000, 900000, 900000, 900000, 900000, 900000,
+  900000, 900000, 900000, 900000, 900000, 900000, 900000, 900000,
+  900000, 900000, 900000, 900000, 900000, 900000, 900000, 900000
+};
+
+/* Same as what dashdemux/hlsdemux do: highest bitrate not above target */
+static guint64
+select_representation (guint64 target)
+{
+  guint64 selected = ladder[0];
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (ladder); i++) {
+    if (ladder[i] <= target)
+      selected = ladder[i];
+  }
+  return selected;
+}
+
+/* Replays @trace against a player that starts playback with the first
+ * fragment, consumes FRAGMENT_DURATION of data per fragment and stops
+ * downloading while MAX_BUFFER_LEVEL is buffered. Everything is computed
+ * from the trace, so the result is deterministic */
+static void
+simulate (GstAdaptiveDemuxAbrAlgorithm algorithm, const guint64 * trace,
+    guint trace_len, guint n_fragments, guint * stalls, guint * switches)
+{
+  GstAdaptiveDemuxAbr *abr;
+  GstClockTime buffer_level = 0;
+  guint64 selected = ladder[0];
+  guint i;
+
+  *stalls = 0;
+  *switches = 0;
+
+  abr = gst_adaptive_demux_abr_new (algorithm, 3);
+
+  for (i = 0; i < n_fragments; i++) {
+    guint64 bandwidth = trace[i % trace_len];
+    guint64 size = selected * (FRAGMENT_DURATION / GST_SECOND) / 8;
+    GstClockTime download_time =
+        gst_util_uint64_scale (size * 8, GST_SECOND, bandwidth);
+    guint64 next;
+
+    if (download_time > buffer_level) {
+      if (i > 0)
+        (*stalls)++;
+      buffer_level = 0;
+    } else {
+      buffer_level -= download_time;
+    }
+    buffer_level = MIN (buffer_level + FRAGMENT_DURATION, MAX_BUFFER_LEVEL);
+
+    gst_adaptive_demux_abr_add_fragment (abr, size, download_time);
+    next = select_representation (gst_adaptive_demux_abr_get_bitrate (abr,
+            buffer_level, BITRATE_LIMIT));
+    if (next != selected)
+      (*switches)++;
+    selected = next;
+  }
+
+  gst_adaptive_demux_abr_free (abr);
+}
+
+GST_START_TEST (test_average_matches_previous_behaviour)
+{
+  GstAdaptiveDemuxAbr *abr;
+
+  abr = gst_adaptive_demux_abr_new (GST_ADAPTIVE_DEMUX_ABR_AVERAGE, 3);
+
+  /* 1 Mbit in 1 second */
+  gst_adaptive_demux_abr_add_fragment (abr, 125000, GST_SECOND);
+  assert_equals_uint64 (gst_adaptive_demux_abr_get_bitrate (abr,
+          GST_CLOCK_TIME_NONE, 1.0), 1000000);
+
+  /* 3 Mbit/s: the average is 2 Mbit/s, the minimum is used */
+  gst_adaptive_demux_abr_add_fragment (abr, 375000, GST_SECOND);
+  assert_equals_uint64 (gst_adaptive_demux_abr_get_bitrate (abr,
+          GST_CLOCK_TIME_NONE, 1.0), 2000000);
+
+  /* bitrate-limit is applied */
+  assert_equals_uint64 (gst_adaptive_demux_abr_get_bitrate (abr,
+          GST_CLOCK_TIME_NONE, 0.5), 1000000);
+
+  gst_adaptive_demux_abr_reset (abr);
+  assert_equals_uint64 (gst_adaptive_demux_abr_get_bitrate (abr,
+          GST_CLOCK_TIME_NONE, 1.0), 0);
+
+  gst_adaptive_demux_abr_free (abr);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_ewma_constant_bandwidth)
+{
+  GstAdaptiveDemuxAbr *abr;
+  guint64 bitrate;
+
+  abr = gst_adaptive_demux_abr_new (GST_ADAPTIVE_DEMUX_ABR_EWMA, 3);
+
+  /* The startup bias is corrected, a constant rate is reported as is */
+  gst_adaptive_demux_abr_add_fragment (abr, 250000, GST_SECOND);
+  bitrate = gst_adaptive_demux_abr_get_bitrate (abr, GST_CLOCK_TIME_NONE, 1.0);
+  fail_unless (bitrate > 1990000 && bitrate <= 2000000);
+
+  gst_adaptive_demux_abr_add_fragment (abr, 250000, GST_SECOND);
+  bitrate = gst_adaptive_demux_abr_get_bitrate (abr, GST_CLOCK_TIME_NONE, 1.0);
+  fail_unless (bitrate > 1990000 && bitrate <= 2000000);
+
+  gst_adaptive_demux_abr_free (abr);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_buffer_no_upswitch_when_low)
+{
+  GstAdaptiveDemuxAbr *abr;
+  guint64 first, bitrate;
+
+  abr = gst_adaptive_demux_abr_new (GST_ADAPTIVE_DEMUX_ABR_BUFFER, 3);
+
+  gst_adaptive_demux_abr_add_fragment (abr, 125000, GST_SECOND);
+  first = gst_adaptive_demux_abr_get_bitrate (abr, GST_SECOND, 1.0);
+  fail_unless (first > 0);
+  /* Buffer almost empty: not the whole throughput is used */
+  fail_unless (first < 1000000);
+
+  /* Bandwidth increased but the buffer is still low */
+  gst_adaptive_demux_abr_add_fragment (abr, 1250000, GST_SECOND);
+  bitrate = gst_adaptive_demux_abr_get_bitrate (abr, 2 * GST_SECOND, 1.0);
+  assert_equals_uint64 (bitrate, first);
+
+  /* Enough data buffered, switch up */
+  bitrate = gst_adaptive_demux_abr_get_bitrate (abr, 10 * GST_SECOND, 1.0);
+  fail_unless (bitrate > first);
+
+  gst_adaptive_demux_abr_free (abr);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_simulate_oscillating_bandwidth)
+{
+  guint avg_stalls, avg_switches;
+  guint buf_stalls, buf_switches;
+
+  simulate (GST_ADAPTIVE_DEMUX_ABR_AVERAGE, oscillating_trace,
+      G_N_ELEMENTS (oscillating_trace), 100, &avg_stalls, &avg_switches);
+  simulate (GST_ADAPTIVE_DEMUX_ABR_BUFFER, oscillating_trace,
+      G_N_ELEMENTS (oscillating_trace), 100, &buf_stalls, &buf_switches);
+
+  GST_INFO ("average: %u stalls, %u switches", avg_stalls, avg_switches);
+  GST_INFO ("buffer: %u stalls, %u switches", buf_stalls, buf_switches);
+
+  assert_equals_int (buf_stalls, 0);
+  fail_unless (buf_switches * 10 < avg_switches);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_simulate_bandwidth_drop)
+{
+  guint avg_stalls, avg_switches;
+  guint buf_stalls, buf_switches;
+
+  simulate (GST_ADAPTIVE_DEMUX_ABR_AVERAGE, drop_trace,
+      G_N_ELEMENTS (drop_trace), G_N_ELEMENTS (drop_trace), &avg_stalls,
+      &avg_switches);
+  simulate (GST_ADAPTIVE_DEMUX_ABR_BUFFER, drop_trace,
+      G_N_ELEMENTS (drop_trace), G_N_ELEMENTS (drop_trace), &buf_stalls,
+      &buf_switches);
+
+  GST_INFO ("average: %u stalls, %u switches", avg_stalls, avg_switches);
+  GST_INFO ("buffer: %u stalls, %u switches", buf_stalls, buf_switches);
+
+  fail_unless (avg_stalls > 0);
+  assert_equals_int (buf_stalls, 0);
+}
+
+GST_END_TEST;
+
+static Suite *
+adaptivedemuxabr_suite (void)
+{
+  Suite *s = suite_create ("Adaptive demux bitrate estimation");
+
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_average_matches_previous_behaviour);
+  tcase_add_test (tc_chain, test_ewma_constant_bandwidth);
+  tcase_add_test (tc_chain, test_buffer_no_upswitch_when_low);
+  tcase_add_test (tc_chain, test_simulate_oscillating_bandwidth);
+  tcase_add_test (tc_chain, test_simulate_bandwidth_drop);
+
+  return s;
+}
+
+GST_CHECK_MAIN (adaptivedemuxabr);
@@ -18,8 +18,11 @@
  * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
  * Boston, MA 02110-1301, USA.
  */
+#include <string.h>
+
 #include <gst/check/gstcheck.h>
 #include <gst/codecparsers/gsth264parser.h>
+#include <gst/codecparsers/gsth264nalmeta.h>
 
 static guint8 slice_dpa[] = {
   0x00, 0x00, 0x01, 0x02, 0x00, 0x02, 0x01, 0x03, 0x00,
@@ -144,6 +147,25 @@ static guint8 slice_eoseq_slice[] = {
   0x00, 0x00, 0x00, 0x01, 0x0b
 };
 
+/* SPS with an emulation prevention byte, PPS and IDR slice, from a real
+ * stream */
+static guint8 h264_sps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x67, 0x4d, 0x40, 0x15,
+  0xec, 0xa4, 0xbf, 0x2e, 0x02, 0x20, 0x00, 0x00,
+  0x03, 0x00, 0x2e, 0xe6, 0xb2, 0x80, 0x01, 0xe2,
+  0xc5, 0xb2, 0xc0
+};
+
+static guint8 h264_pps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x68, 0xeb, 0xec, 0xb2
+};
+
+static guint8 h264_idr_slice[] = {
+  0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00,
+  0x10, 0xff, 0xfe, 0xf6, 0xf0, 0xfe, 0x05, 0x36,
+  0x56, 0x04, 0x50, 0x96, 0x7b, 0x3f, 0x53, 0xe1
+};
+
 GST_START_TEST (test_h264_parse_slice_dpa)
 {
   GstH264ParserResult res;
@@ -211,6 +233,200 @@ GST_START_TEST (test_h264_parse_slice_eoseq_slice)
 
 GST_END_TEST;
 
+/* The start code has to be found wherever it is with respect to the blocks
+ * the scanner works on */
+GST_START_TEST (test_h264_parse_start_code_positions)
+{
+  GstH264ParserResult res;
+  GstH264NalUnit nalu;
+  GstH264NalParser *const parser = gst_h264_nal_parser_new ();
+  guint8 buf[96];
+  guint pos;
+
+  for (pos = 0; pos + 4 <= sizeof (buf); pos++) {
+    memset (buf, 0xff, sizeof (buf));
+    buf[pos] = 0x00;
+    buf[pos + 1] = 0x00;
+    buf[pos + 2] = 0x01;
+    buf[pos + 3] = 0x65;
+
+    res = gst_h264_parser_identify_nalu_unchecked (parser, buf, 0,
+        sizeof (buf), &nalu);
+    assert_equals_int (res, GST_H264_PARSER_OK);
+    assert_equals_int (nalu.sc_offset, pos);
+    assert_equals_int (nalu.offset, pos + 3);
+  }
+
+  /* 00 00 01 at the very end, without a NAL header, is not a start code */
+  memset (buf, 0xff, sizeof (buf));
+  buf[sizeof (buf) - 3] = 0x00;
+  buf[sizeof (buf) - 2] = 0x00;
+  buf[sizeof (buf) - 1] = 0x01;
+  res = gst_h264_parser_identify_nalu_unchecked (parser, buf, 0,
+      sizeof (buf), &nalu);
+  assert_equals_int (res, GST_H264_PARSER_NO_NAL);
+
+  gst_h264_nal_parser_free (parser);
+}
+
+GST_END_TEST;
+
+/* The VUI timing info comes after an emulation prevention byte */
+GST_START_TEST (test_h264_parse_sps_emulation_prevention)
+{
+  GstH264ParserResult res;
+  GstH264NalUnit nalu;
+  GstH264SPS sps;
+  GstH264NalParser *const parser = gst_h264_nal_parser_new ();
+
+  res = gst_h264_parser_identify_nalu_unchecked (parser, h264_sps, 0,
+      sizeof (h264_sps), &nalu);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+
+  res = gst_h264_parser_parse_sps (parser, &nalu, &sps, TRUE);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  assert_equals_int (sps.profile_idc, 77);
+  assert_equals_int (sps.level_idc, 21);
+  assert_equals_int (sps.width, 32);
+  assert_equals_int (sps.height, 32);
+  assert_equals_int (sps.crop_rect_height, 24);
+  assert_equals_int (sps.vui_parameters.timing_info_present_flag, 1);
+  assert_equals_int (sps.vui_parameters.num_units_in_tick, 1);
+  assert_equals_uint64 (sps.vui_parameters.time_scale, 2000000000);
+
+  gst_h264_nal_parser_free (parser);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_h264_parse_slice_hdr_partial)
+{
+  GstH264ParserResult res;
+  GstH264NalUnit sps_nalu, pps_nalu, slice_nalu;
+  GstH264SPS sps;
+  GstH264PPS pps;
+  GstH264SliceHdr full, partial;
+  GstH264NalParser *parser = gst_h264_nal_parser_new ();
+
+  res = gst_h264_parser_identify_nalu_unchecked (parser, h264_sps, 0,
+      sizeof (h264_sps), &sps_nalu);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  res = gst_h264_parser_parse_nal (parser, &sps_nalu);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  res = gst_h264_parser_identify_nalu_unchecked (parser, h264_pps, 0,
+      sizeof (h264_pps), &pps_nalu);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  res = gst_h264_parser_parse_nal (parser, &pps_nalu);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  res = gst_h264_parser_identify_nalu_unchecked (parser, h264_idr_slice, 0,
+      sizeof (h264_idr_slice), &slice_nalu);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+
+  res = gst_h264_parser_parse_slice_hdr (parser, &slice_nalu, &full, TRUE,
+      TRUE);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  fail_unless (full.header_size > 0);
+
+  gst_h264_nal_parser_set_partial_slice_hdr (parser, TRUE);
+  res = gst_h264_parser_parse_slice_hdr (parser, &slice_nalu, &partial, TRUE,
+      TRUE);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+
+  /* Everything needed to find picture boundaries and keyframes is there */
+  assert_equals_int (partial.first_mb_in_slice, full.first_mb_in_slice);
+  assert_equals_int (partial.type, full.type);
+  assert_equals_int (partial.pps->id, full.pps->id);
+  assert_equals_int (partial.frame_num, full.frame_num);
+  assert_equals_int (partial.field_pic_flag, full.field_pic_flag);
+  assert_equals_int (partial.idr_pic_id, full.idr_pic_id);
+  assert_equals_int (partial.pic_order_cnt_lsb, full.pic_order_cnt_lsb);
+  assert_equals_int (partial.header_size, 0);
+
+  gst_h264_nal_parser_free (parser);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_h264_parse_repeated_parameter_sets)
+{
+  GstH264ParserResult res;
+  GstH264NalUnit sps_nalu, pps_nalu;
+  GstH264SPS sps1, sps2;
+  GstH264PPS pps1, pps2;
+  GstH264NalParser *parser = gst_h264_nal_parser_new ();
+
+  res = gst_h264_parser_identify_nalu_unchecked (parser, h264_sps, 0,
+      sizeof (h264_sps), &sps_nalu);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  res = gst_h264_parser_identify_nalu_unchecked (parser, h264_pps, 0,
+      sizeof (h264_pps), &pps_nalu);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+
+  res = gst_h264_parser_parse_sps (parser, &sps_nalu, &sps1, TRUE);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  res = gst_h264_parser_parse_pps (parser, &pps_nalu, &pps1);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+
+  /* Repeated parameter sets are taken from the parser state */
+  res = gst_h264_parser_parse_sps (parser, &sps_nalu, &sps2, TRUE);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  fail_unless (memcmp (&sps1, &sps2, sizeof (GstH264SPS)) == 0);
+  res = gst_h264_parser_parse_pps (parser, &pps_nalu, &pps2);
+  assert_equals_int (res, GST_H264_PARSER_OK);
+  assert_equals_int (pps2.id, pps1.id);
+  fail_unless (pps2.sequence == pps1.sequence);
+  assert_equals_int (pps2.entropy_coding_mode_flag,
+      pps1.entropy_coding_mode_flag);
+  assert_equals_int (pps2.pic_init_qp_minus26, pps1.pic_init_qp_minus26);
+
+  gst_h264_sps_clear (&sps1);
+  gst_h264_sps_clear (&sps2);
+  gst_h264_pps_clear (&pps1);
+  gst_h264_pps_clear (&pps2);
+  gst_h264_nal_parser_free (parser);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_h264_nal_meta)
+{
+  GstH264NalMetaUnit units[2] = {
+    {4, 23, GST_H264_NAL_SPS, -1},
+    {31, 4, GST_H264_NAL_PPS, -1}
+  };
+  GstBuffer *buf, *copy;
+  GstH264NalMeta *meta;
+
+  buf = gst_buffer_new_allocate (NULL, 35, NULL);
+  meta = gst_buffer_add_h264_nal_meta (buf, units, G_N_ELEMENTS (units));
+  meta->keyframe = TRUE;
+
+  /* units are copied */
+  units[0].offset = 0;
+
+  /* copied along with the whole data */
+  copy = gst_buffer_copy (buf);
+  meta = gst_buffer_get_h264_nal_meta (copy);
+  fail_unless (meta != NULL);
+  assert_equals_int (meta->n_units, 2);
+  assert_equals_int (meta->units[0].offset, 4);
+  assert_equals_int (meta->units[0].size, 23);
+  assert_equals_int (meta->units[0].type, GST_H264_NAL_SPS);
+  assert_equals_int (meta->units[1].offset, 31);
+  assert_equals_int (meta->units[1].type, GST_H264_NAL_PPS);
+  fail_unless (meta->keyframe);
+  gst_buffer_unref (copy);
+
+  /* offsets would not match a part of the data */
+  copy = gst_buffer_copy_region (buf, GST_BUFFER_COPY_ALL, 4, 23);
+  fail_unless (gst_buffer_get_h264_nal_meta (copy) == NULL);
+  gst_buffer_unref (copy);
+
+  gst_buffer_unref (buf);
+}
+
+GST_END_TEST;
+
 static Suite *
 h264parser_suite (void)
 {
@@ -221,6 +437,11 @@ h264parser_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_h264_parse_slice_dpa);
   tcase_add_test (tc_chain, test_h264_parse_slice_eoseq_slice);
+  tcase_add_test (tc_chain, test_h264_parse_start_code_positions);
+  tcase_add_test (tc_chain, test_h264_parse_sps_emulation_prevention);
+  tcase_add_test (tc_chain, test_h264_parse_slice_hdr_partial);
+  tcase_add_test (tc_chain, test_h264_parse_repeated_parameter_sets);
+  tcase_add_test (tc_chain, test_h264_nal_meta);
 
   return s;
 }
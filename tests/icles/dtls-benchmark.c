@@ -0,0 +1,204 @@
+/* GStreamer
+ *
+ * dtlsenc and dtlsdec handshake rate benchmark
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Runs the handshakes of many loopback connections at once from one
+ * thread, like a server receiving from all its peers on one socket, with
+ * an increasing number of handshake threads, and prints the handshake
+ * rate.
+ *
+ * Run from the build tree with GST_PLUGIN_PATH pointing to ext/dtls:
+ *   ./dtls-benchmark [n_peers]
+ */
+
+#include <stdlib.h>
+
+#include <gst/gst.h>
+#include <gst/check/gstharness.h>
+
+#define DEFAULT_PEERS 64
+#define TIMEOUT (60 * G_USEC_PER_SEC)
+
+/* all the runs share the agent with the generated certificate, whose pool
+ * only grows */
+static const guint handshake_threads[] = { 0, 2, 4, 8 };
+
+/* Both ends of a connection, connected back to back: what a client dtlsenc
+ * sends goes to the server dtlsdec and the other way around */
+typedef struct
+{
+  GstElement *client_enc, *client_dec, *server_enc, *server_dec;
+  GstHarness *client_enc_h, *client_dec_h, *server_enc_h, *server_dec_h;
+  gint keys_received;
+} Peer;
+
+static void
+on_key_received (GstElement * dtlsdec, Peer * peer)
+{
+  g_atomic_int_inc (&peer->keys_received);
+}
+
+static GstElement *
+make_element (const gchar * name)
+{
+  GstElement *element = gst_element_factory_make (name, NULL);
+
+  if (element == NULL) {
+    g_printerr ("%s not found, is GST_PLUGIN_PATH set?\n", name);
+    exit (1);
+  }
+
+  return element;
+}
+
+static void
+setup_end (Peer * peer, const gchar * role, guint id, guint threads,
+    gboolean is_client, GstElement ** enc, GstHarness ** enc_h,
+    GstElement ** dec, GstHarness ** dec_h)
+{
+  /* connection ids are process wide, keep them unique across runs */
+  static gint n_connections = 0;
+  gchar *connection_id;
+
+  connection_id = g_strdup_printf ("%s-%u-%d", role, id,
+      g_atomic_int_add (&n_connections, 1));
+
+  *dec = make_element ("dtlsdec");
+  g_object_set (*dec, "connection-id", connection_id, "handshake-threads",
+      threads, NULL);
+  g_signal_connect (*dec, "on-key-received", G_CALLBACK (on_key_received),
+      peer);
+  *dec_h = gst_harness_new_with_element (*dec, "sink", NULL);
+  gst_harness_set_src_caps_str (*dec_h, "application/x-dtls");
+
+  /* the encoder finds the connection of the decoder by id */
+  *enc = make_element ("dtlsenc");
+  g_object_set (*enc, "connection-id", connection_id, "is-client", is_client,
+      NULL);
+  *enc_h = gst_harness_new_with_element (*enc, NULL, "src");
+
+  g_free (connection_id);
+}
+
+static void
+setup_peer (Peer * peer, guint id, guint threads)
+{
+  peer->keys_received = 0;
+  setup_end (peer, "server", id, threads, FALSE, &peer->server_enc,
+      &peer->server_enc_h, &peer->server_dec, &peer->server_dec_h);
+  setup_end (peer, "client", id, threads, TRUE, &peer->client_enc,
+      &peer->client_enc_h, &peer->client_dec, &peer->client_dec_h);
+}
+
+static void
+teardown_peer (Peer * peer)
+{
+  gst_harness_teardown (peer->client_enc_h);
+  gst_harness_teardown (peer->server_enc_h);
+  gst_harness_teardown (peer->client_dec_h);
+  gst_harness_teardown (peer->server_dec_h);
+  gst_object_unref (peer->client_enc);
+  gst_object_unref (peer->server_enc);
+  gst_object_unref (peer->client_dec);
+  gst_object_unref (peer->server_dec);
+}
+
+/* Moves what was sent so far to the other end, returns the number of
+ * buffers moved */
+static guint
+forward (GstHarness * from, GstHarness * to)
+{
+  GstBuffer *buf;
+  guint n = 0;
+
+  while ((buf = gst_harness_try_pull (from))) {
+    gst_harness_push (to, buf);
+    n++;
+  }
+
+  return n;
+}
+
+/* Returns the number of completed handshakes, and in @elapsed the time it
+ * took for them to complete */
+static guint
+run_handshakes (guint threads, guint n_peers, gint64 * elapsed)
+{
+  Peer *peers;
+  gint64 start;
+  guint i, n_done = 0;
+
+  peers = g_new0 (Peer, n_peers);
+  for (i = 0; i < n_peers; i++)
+    setup_peer (&peers[i], i, threads);
+
+  start = g_get_monotonic_time ();
+  while (n_done < n_peers && g_get_monotonic_time () - start < TIMEOUT) {
+    guint n_moved = 0;
+
+    n_done = 0;
+    for (i = 0; i < n_peers; i++) {
+      n_moved += forward (peers[i].client_enc_h, peers[i].server_dec_h);
+      n_moved += forward (peers[i].server_enc_h, peers[i].client_dec_h);
+
+      /* both decoders got their key */
+      if (g_atomic_int_get (&peers[i].keys_received) == 2)
+        n_done++;
+    }
+
+    /* the handshake threads or the encoder tasks are busy */
+    if (!n_moved)
+      g_usleep (100);
+  }
+  *elapsed = g_get_monotonic_time () - start;
+
+  for (i = 0; i < n_peers; i++)
+    teardown_peer (&peers[i]);
+  g_free (peers);
+
+  return n_done;
+}
+
+int
+main (int argc, char **argv)
+{
+  guint n_peers = DEFAULT_PEERS;
+  guint i;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    n_peers = atoi (argv[1]);
+
+  for (i = 0; i < G_N_ELEMENTS (handshake_threads); i++) {
+    gint64 elapsed;
+    guint n;
+
+    n = run_handshakes (handshake_threads[i], n_peers, &elapsed);
+    if (n != n_peers)
+      g_printerr ("handshake-threads=%u: only %u of %u handshakes "
+          "completed\n", handshake_threads[i], n, n_peers);
+
+    g_print ("handshake-threads=%u: %u handshakes in %" G_GINT64_FORMAT
+        " us, %.1f handshakes per second\n", handshake_threads[i], n,
+        elapsed, n * (gdouble) G_USEC_PER_SEC / MAX (elapsed, 1));
+  }
+
+  return 0;
+}
@@ -0,0 +1,189 @@
+/* GStreamer
+ *
+ * h265parse slice-threads benchmark
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Parses 8K pictures made of many slices with an increasing number of
+ * slice threads, and prints the time per picture and the speedup over
+ * parsing the slice headers in the streaming thread.
+ *
+ * Run from the build tree with GST_PLUGIN_PATH pointing to gst/videoparsers:
+ *   ./h265parse-benchmark [n_pictures]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/check/gstharness.h>
+
+/* Main profile, level 6.1, 7680x4320, 64x64 CTBs */
+static const guint8 h265_vps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x40, 0x01, 0x0c, 0x01, 0xff, 0xff, 0x01, 0x60,
+  0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00,
+  0xb7, 0xf0, 0x24
+};
+
+static const guint8 h265_sps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03,
+  0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0xb7, 0xa0, 0x00,
+  0xf0, 0x08, 0x00, 0x43, 0x85, 0x97, 0xe4, 0x93, 0x08, 0x20
+};
+
+static const guint8 h265_pps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x44, 0x01, 0xc0, 0x71, 0x81, 0x12
+};
+
+#define PIC_SIZE_IN_CTBS (120 * 68)
+#define SLICES_PER_PICTURE 256
+#define SLICE_DATA_SIZE 256
+
+/* IDR_W_RADL */
+#define NAL_SLICE_IDR 19
+
+#define DEFAULT_PICTURES 500
+
+static const guint slice_threads[] = { 0, 1, 2, 4, 8 };
+
+/* Byte-stream with @n_pictures IDR pictures made of SLICES_PER_PICTURE I
+ * slices each. Only the start of the slice headers is valid, the slice
+ * data is filler */
+static GstBuffer *
+make_many_slices_stream (guint n_pictures)
+{
+  GByteArray *stream = g_byte_array_new ();
+  guint8 slice_data[SLICE_DATA_SIZE];
+  guint i, j;
+  gsize size;
+
+  memset (slice_data, 0x55, sizeof (slice_data));
+  slice_data[SLICE_DATA_SIZE - 1] = 0x80;
+
+  g_byte_array_append (stream, h265_vps, sizeof (h265_vps));
+  g_byte_array_append (stream, h265_sps, sizeof (h265_sps));
+  g_byte_array_append (stream, h265_pps, sizeof (h265_pps));
+
+  for (i = 0; i < n_pictures; i++) {
+    for (j = 0; j < SLICES_PER_PICTURE; j++) {
+      guint8 slice_hdr[9] = { 0x00, 0x00, 0x00, 0x01,
+        NAL_SLICE_IDR << 1, 0x01
+      };
+
+      if (j == 0) {
+        /* first_slice_segment_in_pic_flag 1, no_output_of_prior_pics_flag 0,
+         * slice_pic_parameter_set_id 0, slice_type I */
+        slice_hdr[6] = 0xae;
+        slice_hdr[7] = 0xaa;
+        slice_hdr[8] = 0xaa;
+      } else {
+        /* same with first_slice_segment_in_pic_flag 0 and a 13 bits
+         * slice_segment_address */
+        guint32 bits = (1 << 16) | ((j * PIC_SIZE_IN_CTBS /
+                SLICES_PER_PICTURE) << 3) | 3;
+
+        bits = (bits << 5) | 0x15;
+        slice_hdr[6] = bits >> 16;
+        slice_hdr[7] = bits >> 8;
+        slice_hdr[8] = bits;
+      }
+
+      g_byte_array_append (stream, slice_hdr, sizeof (slice_hdr));
+      g_byte_array_append (stream, slice_data, sizeof (slice_data));
+    }
+  }
+
+  size = stream->len;
+  return gst_buffer_new_wrapped (g_byte_array_free (stream, FALSE), size);
+}
+
+/* Returns the time taken to parse @stream into AUs */
+static gint64
+run_h265parse (guint threads, GstBuffer * stream, guint n_pictures)
+{
+  GstElement *h265parse;
+  GstHarness *h;
+  GstBuffer *buf;
+  gint64 start, elapsed;
+  guint n_frames = 0;
+
+  h265parse = gst_element_factory_make ("h265parse", NULL);
+  if (h265parse == NULL) {
+    g_printerr ("h265parse not found, is GST_PLUGIN_PATH set?\n");
+    exit (1);
+  }
+  g_object_set (h265parse, "slice-threads", threads, NULL);
+  h = gst_harness_new_with_element (h265parse, "sink", "src");
+  gst_harness_set_src_caps_str (h,
+      "video/x-h265, stream-format=(string)byte-stream");
+  gst_harness_set_sink_caps_str (h, "video/x-h265, "
+      "stream-format=(string)byte-stream, alignment=(string)au");
+  gst_object_unref (h265parse);
+
+  start = g_get_monotonic_time ();
+  gst_harness_push (h, gst_buffer_ref (stream));
+  gst_harness_push_event (h, gst_event_new_eos ());
+  elapsed = g_get_monotonic_time () - start;
+
+  while ((buf = gst_harness_try_pull (h))) {
+    gst_buffer_unref (buf);
+    n_frames++;
+  }
+  if (n_frames != n_pictures)
+    g_printerr ("slice-threads=%u: got %u pictures instead of %u\n", threads,
+        n_frames, n_pictures);
+
+  gst_harness_teardown (h);
+
+  return elapsed;
+}
+
+int
+main (int argc, char **argv)
+{
+  guint n_pictures = DEFAULT_PICTURES;
+  GstBuffer *stream;
+  gint64 sequential = 0;
+  guint i;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    n_pictures = atoi (argv[1]);
+
+  stream = make_many_slices_stream (n_pictures);
+
+  /* warm up, so that the first run does not pay for the page faults */
+  run_h265parse (0, stream, n_pictures);
+
+  for (i = 0; i < G_N_ELEMENTS (slice_threads); i++) {
+    gint64 elapsed;
+
+    elapsed = MAX (run_h265parse (slice_threads[i], stream, n_pictures), 1);
+    if (slice_threads[i] == 0)
+      sequential = elapsed;
+
+    g_print ("slice-threads=%u: parsed %u pictures of %u slices in %"
+        G_GINT64_FORMAT " us, %.3f us per picture, speedup %.2f\n",
+        slice_threads[i], n_pictures, SLICES_PER_PICTURE, elapsed,
+        (gdouble) elapsed / n_pictures, (gdouble) sequential / elapsed);
+  }
+
+  gst_buffer_unref (stream);
+
+  return 0;
+}
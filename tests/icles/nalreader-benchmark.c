@@ -0,0 +1,347 @@
+/* GStreamer
+ *
+ * codecparsers NalReader benchmark
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Header parsing is made of many small reads and Exp-Golomb codes at the
+ * start of NAL units spread over the stream. Reads such headers, placed
+ * NAL_STRIDE bytes apart in a buffer much bigger than the CPU caches and
+ * visited in random order, with the NalReader of codecparsers and with
+ * the byte by byte reader it replaced, and prints the time per header.
+ *
+ *   ./nalreader-benchmark [buffer_size_in_MiB]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/gst.h>
+
+/* the reader is not exported by the library, build it in */
+#include "nalutils.c"
+
+#define NAL_STRIDE 4096
+#define CODES_PER_HEADER 48
+#define MAX_UE 4096
+
+#define DEFAULT_BUFFER_MIB 256
+
+/* The reader as it was before it refilled its cache 8 bytes at a time and
+ * decoded Exp-Golomb codes with clz, kept for comparison */
+typedef struct
+{
+  const guint8 *data;
+  guint size;
+
+  guint n_epb;
+  guint byte;
+  guint bits_in_cache;
+  guint8 first_byte;
+  guint64 cache;
+} OldNalReader;
+
+static void
+old_nal_reader_init (OldNalReader * nr, const guint8 * data, guint size)
+{
+  nr->data = data;
+  nr->size = size;
+  nr->n_epb = 0;
+
+  nr->byte = 0;
+  nr->bits_in_cache = 0;
+  /* fill with something other than 0 to detect emulation prevention bytes */
+  nr->first_byte = 0xff;
+  nr->cache = 0xff;
+}
+
+static inline gboolean
+old_nal_reader_read (OldNalReader * nr, guint nbits)
+{
+  if (G_UNLIKELY (nr->byte * 8 + (nbits - nr->bits_in_cache) > nr->size * 8))
+    return FALSE;
+
+  while (nr->bits_in_cache < nbits) {
+    guint8 byte;
+    gboolean check_three_byte;
+
+    check_three_byte = TRUE;
+  next_byte:
+    if (G_UNLIKELY (nr->byte >= nr->size))
+      return FALSE;
+
+    byte = nr->data[nr->byte++];
+
+    /* check if the byte is a emulation_prevention_three_byte */
+    if (check_three_byte && byte == 0x03 && nr->first_byte == 0x00 &&
+        ((nr->cache & 0xff) == 0)) {
+      /* next byte goes unconditionally to the cache, even if it's 0x03 */
+      check_three_byte = FALSE;
+      nr->n_epb++;
+      goto next_byte;
+    }
+    nr->cache = (nr->cache << 8) | nr->first_byte;
+    nr->first_byte = byte;
+    nr->bits_in_cache += 8;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+old_nal_reader_get_bits_uint32 (OldNalReader * nr, guint32 * val, guint nbits)
+{
+  guint shift;
+
+  if (!old_nal_reader_read (nr, nbits))
+    return FALSE;
+
+  /* bring the required bits down and truncate */
+  shift = nr->bits_in_cache - nbits;
+  *val = nr->first_byte >> shift;
+
+  *val |= nr->cache << (8 - shift);
+  /* mask out required bits */
+  if (nbits < 32)
+    *val &= ((guint32) 1 << nbits) - 1;
+
+  nr->bits_in_cache = shift;
+
+  return TRUE;
+}
+
+static gboolean
+old_nal_reader_get_ue (OldNalReader * nr, guint32 * val)
+{
+  guint i = 0;
+  guint32 bit;
+  guint32 value;
+
+  if (G_UNLIKELY (!old_nal_reader_get_bits_uint32 (nr, &bit, 1)))
+    return FALSE;
+
+  while (bit == 0) {
+    i++;
+    if (G_UNLIKELY (!old_nal_reader_get_bits_uint32 (nr, &bit, 1)))
+      return FALSE;
+  }
+
+  if (G_UNLIKELY (i > 32))
+    return FALSE;
+
+  if (G_UNLIKELY (!old_nal_reader_get_bits_uint32 (nr, &value, i)))
+    return FALSE;
+
+  *val = (1 << i) - 1 + value;
+
+  return TRUE;
+}
+
+/* minimal bit writer for the headers */
+typedef struct
+{
+  guint8 data[NAL_STRIDE];
+  guint bit;
+} BitWriter;
+
+static void
+put_bits (BitWriter * bw, guint32 value, guint nbits)
+{
+  while (nbits--) {
+    if (value & (1U << nbits))
+      bw->data[bw->bit / 8] |= 0x80 >> (bw->bit % 8);
+    bw->bit++;
+  }
+}
+
+static void
+put_ue (BitWriter * bw, guint32 value)
+{
+  guint len = g_bit_storage (value + 1);
+
+  put_bits (bw, 0, len - 1);
+  put_bits (bw, value + 1, len);
+}
+
+/* The codes of a header alternate between Exp-Golomb codes, mostly small,
+ * and fixed length fields of 1 to 8 bits */
+static guint
+code_bits (guint i)
+{
+  return i % 2 ? i / 2 % 8 + 1 : 0;
+}
+
+/* Writes a random header at @dest, with emulation prevention bytes, and
+ * returns the sum of its values */
+static guint64
+write_header (GRand * rand, guint8 * dest)
+{
+  BitWriter bw;
+  guint64 sum = 0;
+  guint i, j, n, zeros = 0;
+
+  memset (&bw, 0, sizeof (bw));
+  for (i = 0; i < CODES_PER_HEADER; i++) {
+    guint nbits = code_bits (i);
+    guint32 value;
+
+    if (nbits) {
+      value = g_rand_int (rand) & ((1 << nbits) - 1);
+      put_bits (&bw, value, nbits);
+    } else {
+      /* favour small values, as in real headers */
+      value = g_rand_int_range (rand, 0, 1 << g_rand_int_range (rand, 0, 13));
+      value = MIN (value, MAX_UE);
+      put_ue (&bw, value);
+    }
+    sum += value;
+  }
+  /* rbsp_stop_one_bit */
+  put_bits (&bw, 1, 1);
+
+  n = (bw.bit + 7) / 8;
+  for (i = 0, j = 0; i < n; i++) {
+    if (zeros == 2 && bw.data[i] <= 0x03) {
+      dest[j++] = 0x03;
+      zeros = 0;
+    }
+    dest[j++] = bw.data[i];
+    zeros = bw.data[i] == 0x00 ? zeros + 1 : 0;
+  }
+  g_assert (j <= NAL_STRIDE);
+
+  return sum;
+}
+
+static guint64
+read_header_old (const guint8 * data)
+{
+  OldNalReader nr;
+  guint64 sum = 0;
+  guint i;
+
+  old_nal_reader_init (&nr, data, NAL_STRIDE);
+  for (i = 0; i < CODES_PER_HEADER; i++) {
+    guint nbits = code_bits (i);
+    guint32 value;
+
+    if (nbits) {
+      if (!old_nal_reader_get_bits_uint32 (&nr, &value, nbits))
+        return G_MAXUINT64;
+    } else {
+      if (!old_nal_reader_get_ue (&nr, &value))
+        return G_MAXUINT64;
+    }
+    sum += value;
+  }
+
+  return sum;
+}
+
+static guint64
+read_header_new (const guint8 * data)
+{
+  NalReader nr;
+  guint64 sum = 0;
+  guint i;
+
+  nal_reader_init (&nr, data, NAL_STRIDE);
+  for (i = 0; i < CODES_PER_HEADER; i++) {
+    guint nbits = code_bits (i);
+    guint32 value;
+
+    if (nbits) {
+      if (!nal_reader_get_bits_uint32 (&nr, &value, nbits))
+        return G_MAXUINT64;
+    } else {
+      if (!nal_reader_get_ue (&nr, &value))
+        return G_MAXUINT64;
+    }
+    sum += value;
+  }
+
+  return sum;
+}
+
+static void
+run (const gchar * name, guint64 (*read_header) (const guint8 *),
+    const guint8 * data, const guint * order, guint n_headers,
+    guint64 expected)
+{
+  guint64 sum = 0;
+  gint64 start, elapsed;
+  guint i;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n_headers; i++)
+    sum += read_header (data + (gsize) order[i] * NAL_STRIDE);
+  elapsed = g_get_monotonic_time () - start;
+
+  if (sum != expected)
+    g_printerr ("%s: read %" G_GUINT64_FORMAT " instead of %"
+        G_GUINT64_FORMAT "\n", name, sum, expected);
+
+  g_print ("%s reader: parsed %u headers of %u codes in %" G_GINT64_FORMAT
+      " us, %.3f us per header\n", name, n_headers, CODES_PER_HEADER,
+      elapsed, (gdouble) elapsed / MAX (n_headers, 1));
+}
+
+int
+main (int argc, char **argv)
+{
+  gsize size = (gsize) DEFAULT_BUFFER_MIB * 1024 * 1024;
+  guint8 *data;
+  guint *order;
+  guint64 expected = 0;
+  guint i, n_headers;
+  GRand *rand;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    size = (gsize) atoi (argv[1]) * 1024 * 1024;
+
+  n_headers = size / NAL_STRIDE;
+  data = g_malloc0 ((gsize) n_headers * NAL_STRIDE);
+  order = g_new (guint, n_headers);
+  rand = g_rand_new_with_seed (1);
+
+  for (i = 0; i < n_headers; i++) {
+    expected += write_header (rand, data + (gsize) i * NAL_STRIDE);
+    order[i] = i;
+  }
+  /* visit the headers in random order so that the prefetcher can't help */
+  for (i = n_headers; i > 1; i--) {
+    guint j = g_rand_int_range (rand, 0, i);
+    guint tmp = order[i - 1];
+
+    order[i - 1] = order[j];
+    order[j] = tmp;
+  }
+
+  /* each run starts with a cold cache, the buffer is much bigger than it */
+  run ("old", read_header_old, data, order, n_headers, expected);
+  run ("new", read_header_new, data, order, n_headers, expected);
+  run ("old", read_header_old, data, order, n_headers, expected);
+  run ("new", read_header_new, data, order, n_headers, expected);
+
+  g_rand_free (rand);
+  g_free (order);
+  g_free (data);
+
+  return 0;
+}
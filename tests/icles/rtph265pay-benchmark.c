@@ -0,0 +1,174 @@
+/* GStreamer
+ *
+ * rtph265pay packet rate benchmark
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Payloads 4K access units made of a few small slices and a big one, with
+ * and without aggregation packets, and prints the packet rate.
+ *
+ * Run from the build tree with GST_PLUGIN_PATH pointing to gst/rtp:
+ *   ./rtph265pay-benchmark [n_frames]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/check/gstharness.h>
+
+#define MTU 1400
+
+#define SMALL_SLICES 4
+#define SMALL_SLICE_SIZE 120
+#define BIG_SLICE_SIZE (96 * 1024)
+
+#define DEFAULT_FRAMES 300
+
+/* Main profile, level 6.1, 7680x4320, 64x64 CTBs */
+static const guint8 h265_vps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x40, 0x01, 0x0c, 0x01, 0xff, 0xff, 0x01, 0x60,
+  0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00,
+  0xb7, 0xf0, 0x24
+};
+
+static const guint8 h265_sps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03,
+  0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0xb7, 0xa0, 0x00,
+  0xf0, 0x08, 0x00, 0x43, 0x85, 0x97, 0xe4, 0x93, 0x08, 0x20
+};
+
+static const guint8 h265_pps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x44, 0x01, 0xc0, 0x71, 0x81, 0x12
+};
+
+static void
+append_slice (GByteArray * au, guint size)
+{
+  static const guint8 start_code[] = { 0x00, 0x00, 0x00, 0x01 };
+  guint8 *slice;
+
+  slice = g_malloc (size);
+  memset (slice, 0x55, size);
+  /* TRAIL_R, nuh_layer_id 0, nuh_temporal_id_plus1 1 */
+  slice[0] = 0x01 << 1;
+  slice[1] = 0x01;
+  slice[size - 1] = 0x80;
+
+  g_byte_array_append (au, start_code, sizeof (start_code));
+  g_byte_array_append (au, slice, size);
+  g_free (slice);
+}
+
+static GstBuffer *
+make_access_unit (guint frame)
+{
+  GByteArray *au = g_byte_array_new ();
+  GstBuffer *buf;
+  gsize size;
+  guint i;
+
+  g_byte_array_append (au, h265_vps, sizeof (h265_vps));
+  g_byte_array_append (au, h265_sps, sizeof (h265_sps));
+  g_byte_array_append (au, h265_pps, sizeof (h265_pps));
+  for (i = 0; i < SMALL_SLICES; i++)
+    append_slice (au, SMALL_SLICE_SIZE);
+  append_slice (au, BIG_SLICE_SIZE);
+
+  size = au->len;
+  buf = gst_buffer_new_wrapped (g_byte_array_free (au, FALSE), size);
+  GST_BUFFER_PTS (buf) = GST_BUFFER_DTS (buf) = frame * GST_SECOND / 30;
+
+  return buf;
+}
+
+/* Returns the number of packets sent, and in @elapsed the time taken to
+ * payload @n_frames access units, not counting their creation */
+static guint
+run_rtph265pay (gboolean aggregate, guint n_frames, gint64 * elapsed)
+{
+  GstElement *rtph265pay;
+  GstHarness *h;
+  GstBuffer *buf;
+  GList *frames = NULL, *l;
+  gint64 start;
+  guint i, n_packets = 0;
+
+  rtph265pay = gst_element_factory_make ("rtph265pay", NULL);
+  if (rtph265pay == NULL) {
+    g_printerr ("rtph265pay not found, is GST_PLUGIN_PATH set?\n");
+    exit (1);
+  }
+  g_object_set (rtph265pay, "aggregate", aggregate, "mtu", MTU, NULL);
+  h = gst_harness_new_with_element (rtph265pay, "sink", "src");
+  gst_harness_set_src_caps_str (h, "video/x-h265, "
+      "stream-format=(string)byte-stream, alignment=(string)au");
+  gst_object_unref (rtph265pay);
+
+  for (i = 0; i < n_frames; i++)
+    frames = g_list_prepend (frames, make_access_unit (i));
+  frames = g_list_reverse (frames);
+
+  start = g_get_monotonic_time ();
+  for (l = frames; l; l = l->next) {
+    gst_harness_push (h, l->data);
+    /* don't let the packets pile up in the harness */
+    while ((buf = gst_harness_try_pull (h))) {
+      gst_buffer_unref (buf);
+      n_packets++;
+    }
+  }
+  gst_harness_push_event (h, gst_event_new_eos ());
+  *elapsed = g_get_monotonic_time () - start;
+
+  while ((buf = gst_harness_try_pull (h))) {
+    gst_buffer_unref (buf);
+    n_packets++;
+  }
+
+  g_list_free (frames);
+  gst_harness_teardown (h);
+
+  return n_packets;
+}
+
+int
+main (int argc, char **argv)
+{
+  guint n_frames = DEFAULT_FRAMES;
+  guint i;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    n_frames = atoi (argv[1]);
+
+  for (i = 0; i < 2; i++) {
+    gboolean aggregate = (i == 1);
+    gint64 elapsed;
+    guint n;
+
+    n = run_rtph265pay (aggregate, n_frames, &elapsed);
+
+    g_print ("aggregate=%d: sent %u packets for %u access units of %u "
+        "bytes in %" G_GINT64_FORMAT " us, %.0f packets per second\n",
+        aggregate, n, n_frames, BIG_SLICE_SIZE, elapsed,
+        n * (gdouble) G_USEC_PER_SEC / MAX (elapsed, 1));
+  }
+
+  return 0;
+}
@@ -0,0 +1,193 @@
+/* GStreamer
+ *
+ * srtpenc and srtpdec multi-SSRC throughput benchmark
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Protects buffer lists of one packet per SSRC, like a gateway sending to
+ * many peers, with the SSRCs spread over an increasing number of shards,
+ * then unprotects them. Prints the packet rate of both directions.
+ *
+ * Run from the build tree with GST_PLUGIN_PATH pointing to ext/srtp:
+ *   ./srtp-benchmark [n_rounds]
+ */
+
+#include <stdlib.h>
+
+#include <gst/gst.h>
+#include <gst/check/gstharness.h>
+#include <gst/rtp/gstrtpbuffer.h>
+
+/* AES-128-ICM: 16 bytes of key and 14 bytes of salt */
+#define KEY_SIZE 30
+
+#define PAYLOAD_SIZE 160
+#define FIRST_SSRC 0x1000
+
+#define N_SSRCS 256
+#define DEFAULT_ROUNDS 100
+
+static const guint shards[] = { 1, 2, 4, 8 };
+
+static GstBuffer *
+make_key (void)
+{
+  GstBuffer *key = gst_buffer_new_allocate (NULL, KEY_SIZE, NULL);
+  GstMapInfo map;
+  guint i;
+
+  gst_buffer_map (key, &map, GST_MAP_WRITE);
+  for (i = 0; i < map.size; i++)
+    map.data[i] = i * 7;
+  gst_buffer_unmap (key, &map);
+
+  return key;
+}
+
+static GstBuffer *
+make_rtp_packet (guint32 ssrc, guint16 seq)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *buf;
+  guint8 *payload;
+  guint i;
+
+  buf = gst_rtp_buffer_new_allocate (PAYLOAD_SIZE, 0, 0);
+  gst_rtp_buffer_map (buf, GST_MAP_WRITE, &rtp);
+  gst_rtp_buffer_set_payload_type (&rtp, 96);
+  gst_rtp_buffer_set_ssrc (&rtp, ssrc);
+  gst_rtp_buffer_set_seq (&rtp, seq);
+  gst_rtp_buffer_set_timestamp (&rtp, seq * 160);
+  payload = gst_rtp_buffer_get_payload (&rtp);
+  for (i = 0; i < PAYLOAD_SIZE; i++)
+    payload[i] = ssrc + seq + i;
+  gst_rtp_buffer_unmap (&rtp);
+
+  return buf;
+}
+
+static GstCaps *
+request_key (GstElement * srtpdec, guint ssrc, GstBuffer * key)
+{
+  return gst_caps_new_simple ("application/x-srtp",
+      "srtp-key", GST_TYPE_BUFFER, key,
+      "srtp-cipher", G_TYPE_STRING, "aes-128-icm",
+      "srtp-auth", G_TYPE_STRING, "hmac-sha1-80",
+      "srtcp-cipher", G_TYPE_STRING, "aes-128-icm",
+      "srtcp-auth", G_TYPE_STRING, "hmac-sha1-80", NULL);
+}
+
+static GstElement *
+make_element (const gchar * name)
+{
+  GstElement *element = gst_element_factory_make (name, NULL);
+
+  if (element == NULL) {
+    g_printerr ("%s not found, is GST_PLUGIN_PATH set?\n", name);
+    exit (1);
+  }
+
+  return element;
+}
+
+static void
+run_roundtrip (guint n_shards, guint n_rounds)
+{
+  GstElement *srtpenc, *srtpdec;
+  GstHarness *enc, *dec;
+  GstBuffer *key, *buf;
+  GList *lists = NULL, *protected = NULL, *l;
+  gint64 start, protect_time, unprotect_time;
+  guint i, j, n_protected = 0, n_out = 0;
+
+  key = make_key ();
+
+  srtpenc = make_element ("srtpenc");
+  g_object_set (srtpenc, "key", key, "shards", n_shards, NULL);
+  enc = gst_harness_new_with_element (srtpenc, "rtp_sink_0", "rtp_src_0");
+  gst_harness_set_src_caps_str (enc, "application/x-rtp");
+
+  srtpdec = make_element ("srtpdec");
+  g_object_set (srtpdec, "shards", n_shards, NULL);
+  g_signal_connect (srtpdec, "request-key", G_CALLBACK (request_key), key);
+  dec = gst_harness_new_with_element (srtpdec, "rtp_sink", "rtp_src");
+  gst_harness_set_src_caps_str (dec, "application/x-srtp");
+
+  /* the packets are made beforehand, only the protection is timed */
+  for (i = 0; i < n_rounds; i++) {
+    GstBufferList *list = gst_buffer_list_new_sized (N_SSRCS);
+
+    for (j = 0; j < N_SSRCS; j++)
+      gst_buffer_list_add (list, make_rtp_packet (FIRST_SSRC + j, i));
+    lists = g_list_prepend (lists, list);
+  }
+  lists = g_list_reverse (lists);
+
+  start = g_get_monotonic_time ();
+  for (l = lists; l; l = l->next)
+    gst_pad_push_list (enc->srcpad, l->data);
+  protect_time = g_get_monotonic_time () - start;
+
+  while ((buf = gst_harness_try_pull (enc))) {
+    protected = g_list_prepend (protected, buf);
+    n_protected++;
+  }
+  protected = g_list_reverse (protected);
+
+  start = g_get_monotonic_time ();
+  for (l = protected; l; l = l->next)
+    gst_harness_push (dec, l->data);
+  unprotect_time = g_get_monotonic_time () - start;
+
+  while ((buf = gst_harness_try_pull (dec))) {
+    gst_buffer_unref (buf);
+    n_out++;
+  }
+  if (n_protected != N_SSRCS * n_rounds || n_out != n_protected)
+    g_printerr ("shards=%u: protected %u and unprotected %u packets out of "
+        "%u\n", n_shards, n_protected, n_out, N_SSRCS * n_rounds);
+
+  g_print ("shards=%u: %u SSRCs, protected %.0f packets per second, "
+      "unprotected %.0f packets per second\n", n_shards, N_SSRCS,
+      n_protected * (gdouble) G_USEC_PER_SEC / MAX (protect_time, 1),
+      n_out * (gdouble) G_USEC_PER_SEC / MAX (unprotect_time, 1));
+
+  g_list_free (lists);
+  g_list_free (protected);
+  gst_harness_teardown (enc);
+  gst_harness_teardown (dec);
+  gst_object_unref (srtpenc);
+  gst_object_unref (srtpdec);
+  gst_buffer_unref (key);
+}
+
+int
+main (int argc, char **argv)
+{
+  guint n_rounds = DEFAULT_ROUNDS;
+  guint i;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    n_rounds = atoi (argv[1]);
+
+  for (i = 0; i < G_N_ELEMENTS (shards); i++)
+    run_roundtrip (shards[i], n_rounds);
+
+  return 0;
+}
@@ -0,0 +1,164 @@
+/* GStreamer
+ *
+ * codecparsers start code scanning benchmark
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Intra-heavy streams are made of big slices, where most of the parsing
+ * time is spent looking for the next start code. Splits big random NAL
+ * units with the H.264 and H.265 parsers and prints the scanning rate.
+ *
+ *   ./startcode-benchmark [n_runs]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/codecparsers/gsth264parser.h>
+#include <gst/codecparsers/gsth265parser.h>
+
+#define NAL_SIZE (256 * 1024)
+#define N_NALS 32
+
+#define DEFAULT_RUNS 8
+
+/* N_NALS NAL units of NAL_SIZE bytes, with 3 bytes start codes and
+ * random payloads without emulated start codes */
+static guint8 *
+make_stream (const guint8 * nal_header, guint nal_header_size, gsize * size)
+{
+  GRand *rand = g_rand_new_with_seed (1);
+  guint8 *data;
+  gsize i;
+
+  *size = NAL_SIZE * N_NALS;
+  data = g_malloc (*size);
+
+  for (i = 0; i < *size; i++)
+    data[i] = g_rand_int_range (rand, 0, 256);
+  for (i = 0; i + 2 < *size; i++) {
+    /* emulation prevention, no start code inside the slices */
+    if (data[i] == 0x00 && data[i + 1] == 0x00 && data[i + 2] <= 0x03)
+      data[i + 2] = 0x03;
+  }
+  for (i = 0; i < N_NALS; i++) {
+    guint8 *nal = data + i * NAL_SIZE;
+
+    nal[0] = 0x00;
+    nal[1] = 0x00;
+    nal[2] = 0x01;
+    memcpy (nal + 3, nal_header, nal_header_size);
+    /* don't let the previous slice end in zeroes */
+    if (i > 0)
+      nal[-1] = 0x80;
+  }
+
+  g_rand_free (rand);
+
+  return data;
+}
+
+static void
+print_rate (const gchar * codec, gsize size, guint n_runs, guint n_nals,
+    gint64 elapsed)
+{
+  /* the last NAL of each run has no end */
+  if (n_nals != (N_NALS - 1) * n_runs)
+    g_printerr ("%s: found %u NAL units instead of %u\n", codec, n_nals,
+        (N_NALS - 1) * n_runs);
+
+  g_print ("%s: scanned %" G_GSIZE_FORMAT " bytes in %" G_GINT64_FORMAT
+      " us, %.1f MB/s\n", codec, size * n_runs, elapsed,
+      (gdouble) size * n_runs / MAX (elapsed, 1));
+}
+
+static void
+run_h264 (guint n_runs)
+{
+  /* IDR slice */
+  static const guint8 nal_header[] = { 0x65 };
+  GstH264NalParser *parser = gst_h264_nal_parser_new ();
+  GstH264NalUnit nalu;
+  guint8 *data;
+  gsize size;
+  gint64 start;
+  guint run, n_nals = 0;
+
+  data = make_stream (nal_header, sizeof (nal_header), &size);
+
+  start = g_get_monotonic_time ();
+  for (run = 0; run < n_runs; run++) {
+    guint offset = 0;
+
+    while (gst_h264_parser_identify_nalu (parser, data, offset, size,
+            &nalu) == GST_H264_PARSER_OK) {
+      offset = nalu.offset + nalu.size;
+      n_nals++;
+    }
+  }
+  print_rate ("h264", size, n_runs, n_nals, g_get_monotonic_time () - start);
+
+  g_free (data);
+  gst_h264_nal_parser_free (parser);
+}
+
+static void
+run_h265 (guint n_runs)
+{
+  /* IDR_W_RADL slice */
+  static const guint8 nal_header[] = { 0x26, 0x01 };
+  GstH265Parser *parser = gst_h265_parser_new ();
+  GstH265NalUnit nalu;
+  guint8 *data;
+  gsize size;
+  gint64 start;
+  guint run, n_nals = 0;
+
+  data = make_stream (nal_header, sizeof (nal_header), &size);
+
+  start = g_get_monotonic_time ();
+  for (run = 0; run < n_runs; run++) {
+    guint offset = 0;
+
+    while (gst_h265_parser_identify_nalu (parser, data, offset, size,
+            &nalu) == GST_H265_PARSER_OK) {
+      offset = nalu.offset + nalu.size;
+      n_nals++;
+    }
+  }
+  print_rate ("h265", size, n_runs, n_nals, g_get_monotonic_time () - start);
+
+  g_free (data);
+  gst_h265_parser_free (parser);
+}
+
+int
+main (int argc, char **argv)
+{
+  guint n_runs = DEFAULT_RUNS;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    n_runs = atoi (argv[1]);
+
+  run_h264 (n_runs);
+  run_h265 (n_runs);
+
+  return 0;
+}
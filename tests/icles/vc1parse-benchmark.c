@@ -0,0 +1,143 @@
+/* GStreamer
+ *
+ * vc1parse BDU parsing benchmark
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Parses an advanced profile BDU stream of big frames, pushed in small
+ * buffers like a demuxer or filesrc would, and prints the time per frame.
+ *
+ * Run from the build tree with GST_PLUGIN_PATH pointing to gst/videoparsers:
+ *   ./vc1parse-benchmark [n_frames]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/check/gstharness.h>
+
+/* Advanced profile, level 2, 1920x1080 */
+static const guint8 vc1_seq_hdr[] = {
+  0x00, 0x00, 0x01, 0x0f, 0xd2, 0x00, 0x3b, 0xf2, 0x1b, 0x08, 0x80
+};
+
+static const guint8 vc1_entrypoint[] = {
+  0x00, 0x00, 0x01, 0x0e, 0x5a, 0xc7, 0xf9, 0xc8, 0x80
+};
+
+#define FRAME_DATA_SIZE (256 * 1024)
+#define FRAMES_PER_ENTRYPOINT 15
+
+#define DEFAULT_FRAMES 200
+
+#define CHUNK_SIZE 4096
+
+/* BDU stream with the sequence header and entrypoint repeated every
+ * FRAMES_PER_ENTRYPOINT frames. The frame data is filler */
+static GByteArray *
+make_bdu_stream (guint n_frames)
+{
+  GByteArray *stream = g_byte_array_new ();
+  guint8 *frame_data;
+  guint i;
+
+  frame_data = g_malloc (FRAME_DATA_SIZE);
+  memset (frame_data, 0x55, FRAME_DATA_SIZE);
+  frame_data[0] = 0x00;
+  frame_data[1] = 0x00;
+  frame_data[2] = 0x01;
+  frame_data[3] = 0x0d;
+
+  for (i = 0; i < n_frames; i++) {
+    if (i % FRAMES_PER_ENTRYPOINT == 0) {
+      g_byte_array_append (stream, vc1_seq_hdr, sizeof (vc1_seq_hdr));
+      g_byte_array_append (stream, vc1_entrypoint, sizeof (vc1_entrypoint));
+    }
+    g_byte_array_append (stream, frame_data, FRAME_DATA_SIZE);
+  }
+
+  g_free (frame_data);
+
+  return stream;
+}
+
+int
+main (int argc, char **argv)
+{
+  guint n_frames = DEFAULT_FRAMES;
+  GstHarness *h;
+  GByteArray *stream;
+  GList *chunks = NULL, *l;
+  GstBuffer *buf;
+  gint64 start, elapsed;
+  gsize off, out_size = 0;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    n_frames = atoi (argv[1]);
+
+  h = gst_harness_new ("vc1parse");
+  gst_harness_set_src_caps_str (h, "video/x-wmv, wmvversion=(int)3, "
+      "format=(string)WVC1, stream-format=(string)bdu, "
+      "header-format=(string)none");
+  gst_harness_set_sink_caps_str (h, "video/x-wmv, wmvversion=(int)3, "
+      "format=(string)WVC1, stream-format=(string)bdu, "
+      "header-format=(string)none");
+
+  /* split the stream beforehand, only the parsing is timed */
+  stream = make_bdu_stream (n_frames);
+  for (off = 0; off < stream->len; off += CHUNK_SIZE) {
+    gsize size = MIN (CHUNK_SIZE, stream->len - off);
+
+    buf = gst_buffer_new_allocate (NULL, size, NULL);
+    gst_buffer_fill (buf, 0, stream->data + off, size);
+    chunks = g_list_prepend (chunks, buf);
+  }
+  chunks = g_list_reverse (chunks);
+
+  start = g_get_monotonic_time ();
+  for (l = chunks; l; l = l->next) {
+    gst_harness_push (h, l->data);
+    /* don't let the frames pile up in the harness */
+    while ((buf = gst_harness_try_pull (h))) {
+      out_size += gst_buffer_get_size (buf);
+      gst_buffer_unref (buf);
+    }
+  }
+  gst_harness_push_event (h, gst_event_new_eos ());
+  elapsed = g_get_monotonic_time () - start;
+
+  while ((buf = gst_harness_try_pull (h))) {
+    out_size += gst_buffer_get_size (buf);
+    gst_buffer_unref (buf);
+  }
+  if (out_size != stream->len)
+    g_printerr ("got %" G_GSIZE_FORMAT " bytes out of %u\n", out_size,
+        stream->len);
+
+  g_print ("parsed %u frames of %u bytes pushed in %u bytes buffers in %"
+      G_GINT64_FORMAT " us, %.3f us per frame\n", n_frames, FRAME_DATA_SIZE,
+      CHUNK_SIZE, elapsed, (gdouble) elapsed / MAX (n_frames, 1));
+
+  g_list_free (chunks);
+  g_byte_array_unref (stream);
+  gst_harness_teardown (h);
+
+  return 0;
+}